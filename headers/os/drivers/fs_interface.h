@@ -16,6 +16,7 @@
 #include <sys/uio.h>
 
 
+struct attr_vec;
 struct dirent;
 struct stat;
 struct fs_info;
@@ -250,6 +251,10 @@ struct fs_vnode_ops {
 				const struct flock* lock, bool wait);
 	status_t (*release_lock)(fs_volume* volume, fs_vnode* vnode, void* cookie,
 				const struct flock* lock);
+
+	/* bulk attribute operations */
+	status_t (*read_attrs)(fs_volume* volume, fs_vnode* vnode,
+				struct attr_vec* vecs, size_t count);
 };
 
 struct file_system_module_info {
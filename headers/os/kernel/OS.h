@@ -90,6 +90,9 @@ typedef struct area_info {
 	// "stack" protection is not available on most platforms - it's used
 	// to only commit memory as needed, and have guard pages at the
 	// bottom of the stack.
+#define B_LARGE_PAGES			0x200
+	// back the area with large pages (e.g. 2 MB on x86-64) where possible;
+	// implies B_FULL_LOCK
 
 extern area_id		create_area(const char *name, void **startAddress,
 						uint32 addressSpec, size_t size, uint32 lock,
@@ -767,7 +770,7 @@ typedef struct {
 	int32			cached_pages;
 	uint32			abi;				/* the system API */
 	int32			ignored_pages;		/* # of ignored/inaccessible pages */
-	int32			pad;
+	int32			large_pages;		/* # of pages mapped via large pages */
 } system_info;
 
 /* system private, use macro instead */
@@ -15,6 +15,15 @@ typedef struct attr_info {
 	off_t	size;
 } attr_info;
 
+/* used by the fs_{read,write}_attrs() calls */
+typedef struct attr_vec {
+	const char*	name;
+	void*		buffer;			/* may be NULL to only stat the attribute */
+	size_t		buffer_size;
+	attr_info	info;			/* filled in when reading, type to write */
+	ssize_t		result;			/* bytes read or written, or an error code */
+} attr_vec;
+
 
 #ifdef  __cplusplus
 extern "C" {
@@ -28,6 +37,11 @@ extern int		fs_remove_attr(int fd, const char *attribute);
 extern int		fs_stat_attr(int fd, const char *attribute,
 					struct attr_info *attrInfo);
 
+extern ssize_t	fs_read_attrs(int fd, attr_vec *vecs, size_t count);
+extern ssize_t	fs_write_attrs(int fd, attr_vec *vecs, size_t count);
+extern ssize_t	fs_read_node_attrs(dev_t device, const ino_t *nodes,
+					size_t nodeCount, attr_vec *vecs, size_t count);
+
 extern int		fs_open_attr(const char *path, const char *attribute,
 					uint32 type, int openMode);
 extern int		fs_fopen_attr(int fd, const char *attribute, uint32 type,
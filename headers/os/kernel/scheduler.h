@@ -49,6 +49,12 @@ enum be_task_flags {
 	B_MIDI_PROCESSING			= 0x800
 };
 
+/* system wide scheduling policies, see set_scheduler_mode() */
+enum scheduler_mode {
+	SCHEDULER_MODE_LOW_LATENCY	= 0,	/* spread threads, short quanta */
+	SCHEDULER_MODE_THROUGHPUT	= 1		/* pack threads, long quanta */
+};
+
 #if defined(__cplusplus)
 extern "C" {
 
@@ -58,6 +64,9 @@ int32 suggest_thread_priority(uint32 task_flags = B_DEFAULT_MEDIA_PRIORITY,
 bigtime_t estimate_max_scheduling_latency(thread_id th = -1);
 	/* default is current thread */
 
+status_t set_scheduler_mode(int32 mode);
+int32 get_scheduler_mode(void);
+
 }
 #else
 
@@ -67,6 +76,9 @@ int32 suggest_thread_priority(uint32 what, int32 period, bigtime_t jitter,
 bigtime_t estimate_max_scheduling_latency(thread_id th);
 	/* default is current thread */
 
+status_t set_scheduler_mode(int32 mode);
+int32 get_scheduler_mode(void);
+
 #endif
 
 #endif // SCHEDULER_H
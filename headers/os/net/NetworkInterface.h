@@ -75,6 +75,8 @@ public:
 			uint32				Metric() const;
 			uint32				Type() const;
 			status_t			GetStats(ifreq_stats& stats);
+			status_t			GetReceiveQueues(
+									ifreq_receive_queues& queues);
 			bool				HasLink() const;
 
 			status_t			SetFlags(uint32 flags);
@@ -64,6 +64,10 @@ public:
 									const char* newName);
 			status_t			GetAttrInfo(const char* name,
 									struct attr_info* info) const;
+			ssize_t				ReadAttrs(struct attr_vec* vecs,
+									size_t count) const;
+			ssize_t				WriteAttrs(struct attr_vec* vecs,
+									size_t count);
 			status_t			GetNextAttrName(char* buffer);
 			status_t			RewindAttrs();
 			status_t			WriteAttrString(const char* name,
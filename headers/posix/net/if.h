@@ -30,6 +30,20 @@ struct ifreq_stats {
 	uint32_t	collisions;
 };
 
+#define IF_MAX_RECEIVE_QUEUES	16
+
+struct ifreq_receive_queue {
+	uint64_t	packets;
+	uint64_t	dropped;
+};
+
+struct ifreq_receive_queues {
+	uint32_t	count;
+	uint32_t	hardware;
+		/* whether or not the queues are provided by the device */
+	struct ifreq_receive_queue queues[IF_MAX_RECEIVE_QUEUES];
+};
+
 struct ifreq {
 	char			ifr_name[IF_NAMESIZE];
 	union {
@@ -64,6 +78,12 @@ struct ifaliasreq {
 	uint32_t		ifra_flags;
 };
 
+/* used with B_SOCKET_GET_RECEIVE_QUEUES */
+struct ifqueuesreq {
+	char			ifq_name[IF_NAMESIZE];
+	struct ifreq_receive_queues ifq_queues;
+};
+
 /* used with SIOCGIFMEDIA */
 struct ifmediareq {
 	char			ifm_name[IF_NAMESIZE];
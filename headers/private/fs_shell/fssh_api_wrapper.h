@@ -43,6 +43,7 @@
 
 #include "DoublyLinkedList.h"
 #include "SinglyLinkedList.h"
+#include "SplayTree.h"
 #include "Stack.h"
 
 
@@ -794,6 +795,7 @@
 // #pragma mark - fssh_fs_attr.h
 
 #define attr_info	fssh_attr_info
+#define attr_vec	fssh_attr_vec
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -859,6 +861,7 @@
 
 /* entry cache */
 #define entry_cache_add					fssh_entry_cache_add
+#define entry_cache_add_missing			fssh_entry_cache_add_missing
 #define entry_cache_remove				fssh_entry_cache_remove
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -15,6 +15,14 @@ typedef struct fssh_attr_info {
 	fssh_off_t	size;
 } fssh_attr_info;
 
+typedef struct fssh_attr_vec {
+	const char*		name;
+	void*			buffer;
+	fssh_size_t		buffer_size;
+	fssh_attr_info	info;
+	fssh_ssize_t	result;
+} fssh_attr_vec;
+
 
 #ifdef  __cplusplus
 extern "C" {
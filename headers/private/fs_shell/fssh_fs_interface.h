@@ -13,6 +13,7 @@
 #include "fssh_os.h"
 
 
+struct fssh_attr_vec;
 struct fssh_dirent;
 struct fssh_fs_info;
 struct fssh_iovec;
@@ -272,6 +273,10 @@ struct fssh_fs_vnode_ops {
 	fssh_status_t (*get_super_vnode)(fssh_fs_volume *volume,
 				fssh_fs_vnode *vnode, fssh_fs_volume *superVolume,
 				fssh_fs_vnode *superVnode);
+
+	/* bulk attribute operations */
+	fssh_status_t (*read_attrs)(fssh_fs_volume *volume, fssh_fs_vnode *vnode,
+				struct fssh_attr_vec *vecs, fssh_size_t count);
 };
 
 typedef struct fssh_file_system_module_info {
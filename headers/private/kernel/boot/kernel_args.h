@@ -21,8 +21,10 @@
 #include <util/FixedWidthPointer.h>
 
 
-#define CURRENT_KERNEL_ARGS_VERSION	1
+#define CURRENT_KERNEL_ARGS_VERSION	2
 #define MAX_KERNEL_ARGS_RANGE		20
+#define MAX_NUMA_NODES				8
+#define MAX_NUMA_MEMORY_RANGES		32
 
 // names of common boot_volume fields
 #define BOOT_METHOD						"boot method"
@@ -40,6 +42,12 @@ enum {
 	BOOT_METHOD_DEFAULT		= BOOT_METHOD_HARD_DISK
 };
 
+typedef struct numa_addr_range {
+	uint64		start;
+	uint64		size;
+	uint32		node;
+} _PACKED numa_addr_range;
+
 typedef struct kernel_args {
 	uint32		kernel_args_size;
 	uint32		version;
@@ -60,6 +68,14 @@ typedef struct kernel_args {
 	uint32		num_cpus;
 	addr_range	cpu_kstack[MAX_BOOT_CPUS];
 
+	// NUMA topology as reported by the firmware; num_numa_nodes is 0 if
+	// there is none
+	uint32		num_numa_nodes;
+	uint32		cpu_numa_node[MAX_BOOT_CPUS];
+	uint32		num_numa_memory_ranges;
+	numa_addr_range	numa_memory_range[MAX_NUMA_MEMORY_RANGES];
+	uint8		numa_distance[MAX_NUMA_NODES][MAX_NUMA_NODES];
+
 	// boot volume KMessage data
 	FixedWidthPointer<void> boot_volume;
 	int32		boot_volume_size;
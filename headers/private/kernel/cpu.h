@@ -56,6 +56,12 @@ typedef struct cpu_ent {
 	bool			invoke_scheduler_if_idle;
 	bool			disabled;
 
+	// topology, filled in by the architecture specific code; CPUs with the
+	// same package and core ID are SMT siblings
+	int32			package_id;
+	int32			core_id;
+	int32			smt_id;
+
 	// arch-specific stuff
 	arch_cpu_info arch;
 } cpu_ent __attribute__((aligned(64)));
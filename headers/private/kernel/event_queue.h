@@ -0,0 +1,33 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _KERNEL_EVENT_QUEUE_H
+#define _KERNEL_EVENT_QUEUE_H
+
+
+#include <event_queue_defs.h>
+
+#include <wait_for_objects.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+extern status_t	event_queue_notify(select_info* info, uint16 events);
+extern void		event_queue_put_select_sync(select_sync* sync);
+
+extern int		_user_event_queue_create(int openFlags);
+extern status_t	_user_event_queue_select(int queue, event_wait_info* infos,
+					int numInfos);
+extern ssize_t	_user_event_queue_wait(int queue, event_wait_info* infos,
+					int numInfos, uint32 flags, bigtime_t timeout);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// _KERNEL_EVENT_QUEUE_H
@@ -16,6 +16,7 @@
 
 #define CACHE_CLEAR			1	// takes no parameters
 #define CACHE_SET_MODULE	2	// gets the module name as parameter
+#define CACHE_GET_STATS		3	// fills in a file_cache_stats structure
 
 #define CACHE_MODULES_NAME	"file_cache"
 
@@ -23,6 +24,13 @@
 #define FILE_CACHE_LOADED_COMPLETELY 	0x02
 #define FILE_CACHE_NO_IO				0x04
 
+struct file_cache_stats {
+	uint64		hits;				// pages read that were already cached
+	uint64		misses;				// pages that had to be read synchronously
+	uint64		readahead_pages;	// pages read ahead asynchronously
+	uint64		readahead_wasted;	// read ahead pages the reader skipped
+};
+
 struct cache_module_info {
 	module_info	info;
 
@@ -9,6 +9,7 @@
 
 #include <cpu.h>
 #include <int.h>
+#include <scheduler.h>
 #include <smp.h>
 #include <thread_types.h>
 
@@ -67,6 +68,12 @@ struct scheduler_ops {
 		lock.
 	*/
 	void (*start)(void);
+
+	/*!	Switches to the given scheduling policy, one of the SCHEDULER_MODE_*
+		constants. Threads already in the run queue are left where they are.
+		The caller must hold the scheduler lock (with disabled interrupts).
+	*/
+	void (*set_operation_mode)(int32 mode);
 };
 
 extern struct scheduler_ops* gScheduler;
@@ -96,6 +103,8 @@ void scheduler_init(void);
 void scheduler_enable_scheduling(void);
 
 bigtime_t _user_estimate_max_scheduling_latency(thread_id thread);
+status_t _user_set_scheduler_mode(int32 mode);
+int32 _user_get_scheduler_mode(void);
 status_t _user_analyze_scheduling(bigtime_t from, bigtime_t until, void* buffer,
 	size_t size, struct scheduling_analysis* analysis);
 
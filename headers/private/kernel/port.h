@@ -1,5 +1,5 @@
 /*
- * Copyright 2005-2009, Haiku Inc. All Rights Reserved.
+ * Copyright 2005-2013, Haiku Inc. All Rights Reserved.
  * Distributed under the terms of the MIT license.
  */
 #ifndef _KERNEL_PORT_H
@@ -43,6 +43,12 @@ status_t deselect_port(int32 object, struct select_info *info, bool kernel);
 status_t writev_port_etc(port_id id, int32 msgCode, const iovec *msgVecs,
 				size_t vecCount, size_t bufferSize, uint32 flags,
 				bigtime_t timeout);
+ssize_t		read_port_area_etc(port_id id, int32 *msgCode, void *msgBuffer,
+				size_t bufferSize, area_id *_area, uint32 flags,
+				bigtime_t timeout);
+status_t	write_port_area_etc(port_id id, int32 msgCode,
+				const void *msgBuffer, size_t bufferSize, area_id area,
+				uint32 flags, bigtime_t timeout);
 
 // user syscalls
 port_id		_user_create_port(int32 queueLength, const char *name);
@@ -68,6 +74,12 @@ status_t	_user_writev_port_etc(port_id id, int32 msgCode,
 status_t	_user_get_port_message_info_etc(port_id port,
 				port_message_info *info, size_t infoSize, uint32 flags,
 				bigtime_t timeout);
+ssize_t		_user_read_port_area_etc(port_id port, int32 *msgCode,
+				void *msgBuffer, size_t bufferSize, area_id *_area,
+				uint32 flags, bigtime_t timeout);
+status_t	_user_write_port_area_etc(port_id port, int32 msgCode,
+				const void *msgBuffer, size_t bufferSize, area_id area,
+				uint32 flags, bigtime_t timeout);
 
 #ifdef __cplusplus
 }
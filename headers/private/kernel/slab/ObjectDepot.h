@@ -22,13 +22,39 @@ typedef struct object_depot {
 	size_t					empty_count;
 	size_t					max_count;
 	size_t					magazine_capacity;
+	size_t					min_magazine_capacity;
+	size_t					max_magazine_capacity;
 	struct depot_cpu_store*	stores;
 	void*					cookie;
 
 	void (*return_object)(struct object_depot* depot, void* cookie,
 		void* object, uint32 flags);
+
+	// statistics; the magazine counts are changed atomically, the others
+	// are protected by inner_lock
+	vint32					magazine_count;
+	vint32					magazine_rounds;
+	uint32					recent_exchanges;
+	uint32					recent_contention;
+	uint64					full_exchanges;
+	uint64					empty_exchanges;
+	uint64					contention;
+	uint32					resize_count;
 } object_depot;
 
+typedef struct object_depot_stats {
+	uint64					hits;
+	uint64					misses;
+	uint64					stores;
+	uint64					full_exchanges;
+	uint64					empty_exchanges;
+	uint64					contention;
+	size_t					magazine_capacity;
+	size_t					magazine_count;
+	size_t					memory_usage;
+	uint32					resize_count;
+} object_depot_stats;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +71,8 @@ void object_depot_store(object_depot* depot, void* object, uint32 flags);
 
 void object_depot_make_empty(object_depot* depot, uint32 flags);
 
+void object_depot_get_stats(object_depot* depot, object_depot_stats* stats);
+
 #if PARANOID_KERNEL_FREE
 bool object_depot_contains_object(object_depot* depot, void* object);
 #endif
@@ -32,6 +32,7 @@
 #define B_UNMOUNT_BUSY_PARTITION	0x80000000
 
 struct attr_info;
+struct attr_vec;
 struct file_descriptor;
 struct generic_io_vec;
 struct kernel_args;
@@ -125,6 +126,8 @@ void		vfs_unlock_vnode_if_locked(struct file_descriptor *descriptor);
 status_t	vfs_unmount(dev_t mountID, uint32 flags);
 status_t	vfs_disconnect_vnode(dev_t mountID, ino_t vnodeID);
 void		vfs_free_unused_vnodes(int32 level);
+void		vfs_entry_cache_remove_missing(dev_t mountID, ino_t dirID,
+				const char *name);
 
 status_t	vfs_read_stat(int fd, const char *path, bool traverseLeafLink,
 				struct stat *stat, bool kernel);
@@ -213,6 +216,10 @@ ssize_t		_user_write_attr(int fd, const char *attribute, uint32 type,
 				off_t pos, const void *buffer, size_t readBytes);
 status_t	_user_stat_attr(int fd, const char *attribute,
 				struct attr_info *attrInfo);
+ssize_t		_user_read_attrs(int fd, struct attr_vec *vecs, size_t count);
+ssize_t		_user_write_attrs(int fd, struct attr_vec *vecs, size_t count);
+ssize_t		_user_read_node_attrs(dev_t device, const ino_t *nodes,
+				size_t nodeCount, struct attr_vec *vecs, size_t count);
 int			_user_open_attr(int fd, const char* path, const char *name,
 				uint32 type, int openMode);
 status_t	_user_remove_attr(int fd, const char *name);
@@ -264,6 +271,7 @@ ssize_t		_user_send(int socket, const void *data, size_t length, int flags);
 ssize_t		_user_sendto(int socket, const void *data, size_t length, int flags,
 				const struct sockaddr *address, socklen_t addressLength);
 ssize_t		_user_sendmsg(int socket, const struct msghdr *message, int flags);
+ssize_t		_user_sendfile(int socket, int fd, off_t *_offset, size_t count);
 status_t	_user_getsockopt(int socket, int level, int option, void *value,
 				socklen_t *_length);
 status_t	_user_setsockopt(int socket, int level, int option,
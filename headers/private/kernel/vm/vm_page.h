@@ -14,8 +14,10 @@
 
 
 struct kernel_args;
+struct system_numa_info;
 
 extern int32 gMappedPagesCount;
+extern int32 gLargeMappedPagesCount;
 
 
 struct vm_page_reservation {
@@ -44,6 +46,7 @@ page_num_t vm_page_num_free_pages(void);
 page_num_t vm_page_num_available_pages(void);
 page_num_t vm_page_num_unused_pages(void);
 void vm_page_get_stats(system_info *info);
+void vm_page_get_numa_info(struct system_numa_info *info);
 phys_addr_t vm_page_max_address();
 
 status_t vm_page_write_modified_page_range(struct VMCache *cache,
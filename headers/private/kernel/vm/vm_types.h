@@ -154,8 +154,10 @@ public:
 	uint8					unused : 1;
 
 	uint8					usage_count;
+	uint8					numa_node;
+		// the NUMA node the page's memory belongs to
 
-	inline void Init(page_num_t pageNumber);
+	inline void Init(page_num_t pageNumber, uint8 numaNode);
 
 	VMCacheRef* CacheRef() const			{ return cache_ref; }
 	void SetCacheRef(VMCacheRef* cacheRef)	{ this->cache_ref = cacheRef; }
@@ -202,9 +204,10 @@ enum {
 
 
 inline void
-vm_page::Init(page_num_t pageNumber)
+vm_page::Init(page_num_t pageNumber, uint8 numaNode)
 {
 	physical_page_number = pageNumber;
+	numa_node = numaNode;
 	InitState(PAGE_STATE_FREE);
 	new(&mappings) vm_page_mappings();
 	fWiredCount = 0;
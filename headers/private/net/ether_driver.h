@@ -9,6 +9,7 @@
 
 
 #include <Drivers.h>
+#include <sys/uio.h>
 
 
 /* ioctl() opcodes a driver should support */
@@ -23,8 +24,13 @@ enum {
 	ETHER_GETFRAMESIZE,						/* get frame size (required) (int *) */
 	ETHER_SET_LINK_STATE_SEM,
 		/* pass over a semaphore to release on link state changes (sem_id *) */
-	ETHER_GET_LINK_STATE
+	ETHER_GET_LINK_STATE,
 		/* get line speed, quality, duplex mode, etc. (ether_link_state_t *) */
+	ETHER_GET_OFFLOAD,
+		/* get the offload capabilities, ETHER_OFFLOAD_* (uint32 *) */
+	ETHER_SEND_OFFLOADED
+		/* send a frame that needs offload processing
+		   (ether_offload_frame_t *) */
 };
 
 
@@ -40,4 +46,20 @@ typedef struct ether_link_state {
 	uint64	speed;		/* in bit/s */
 } ether_link_state_t;
 
+/* ETHER_GET_OFFLOAD - what the device can do in hardware */
+#define ETHER_OFFLOAD_TCP_CHECKSUM		0x01
+	/* computes the IPv4/TCP checksum; the checksum field contains the sum
+	   of the pseudo header without its length */
+#define ETHER_OFFLOAD_TCP_SEGMENTATION	0x02
+	/* cuts an IPv4/TCP frame of up to 64 KB into segments, and fixes the
+	   IP length, ID, and checksum, and the TCP sequence and flags of each */
+
+/* ETHER_SEND_OFFLOADED - a frame, and the offloading it needs */
+typedef struct ether_offload_frame {
+	const struct iovec*	vecs;
+	uint32				vec_count;
+	uint32				offload;		/* ETHER_OFFLOAD_* */
+	uint16				segment_size;	/* TCP payload per segment */
+} ether_offload_frame_t;
+
 #endif	/* _ETHER_DRIVER_H */
@@ -13,8 +13,20 @@
 #include <util/list.h>
 
 
+class BReferenceable;
+
+
 #define NET_BUFFER_MODULE_NAME "network/stack/buffer/v1"
 
+// Offload capabilities of a device or interface, and the work that still
+// needs to be done for an outgoing buffer (net_buffer::offload)
+#define NET_OFFLOAD_TCP_CHECKSUM		0x01
+	// the TCP checksum field only contains the sum of the pseudo header
+	// without its length, and has to be completed
+#define NET_OFFLOAD_TCP_SEGMENTATION	0x02
+	// the TCP payload has to be cut into segments of segment_size bytes,
+	// each with a copy of the headers
+
 
 typedef struct net_buffer {
 	struct list_link		link;
@@ -35,6 +47,8 @@ typedef struct net_buffer {
 	uint32					flags;
 	uint32					size;
 	uint8					protocol;
+	uint8					offload;
+	uint16					segment_size;
 } net_buffer;
 
 struct ancillary_data_container;
@@ -101,6 +115,9 @@ struct net_buffer_module_info {
 	void			(*swap_addresses)(net_buffer* buffer);
 
 	void			(*dump)(net_buffer* buffer);
+
+	status_t		(*append_external)(net_buffer* buffer, const void* data,
+						size_t bytes, BReferenceable* reference);
 };
 
 
@@ -50,6 +50,9 @@ typedef struct net_interface {
 	uint8				type;
 	uint32				mtu;
 	uint32				metric;
+	uint32				offload;
+		// NET_OFFLOAD_* of the device, plus those its framing can do in
+		// software
 } net_interface;
 
 typedef struct net_route {
@@ -31,6 +31,7 @@ typedef struct net_device {
 	uint64	link_speed;
 	uint32	link_quality;
 	size_t	header_length;
+	uint32	offload;	// NET_OFFLOAD_* the hardware can do
 
 	struct net_hardware_address address;
 
@@ -61,6 +62,17 @@ struct net_device_module_info {
 					const struct sockaddr* address);
 	status_t	(*remove_multicast)(net_device* device,
 					const struct sockaddr* address);
+
+	// optional, for devices with more than one hardware receive queue; they
+	// are expected to keep the packets of a flow in the same queue
+	uint32		(*count_receive_queues)(net_device* device);
+	status_t	(*receive_queue_data)(net_device* device, uint32 queue,
+					net_buffer** _buffer);
+
+	// optional, receives up to *_count buffers at once; it blocks until at
+	// least one is available
+	status_t	(*receive_data_batch)(net_device* device, net_buffer** buffers,
+					uint32* _count);
 };
 
 
@@ -112,6 +112,9 @@ struct net_protocol_module_info {
 	ssize_t		(*read_data_no_buffer)(net_protocol* self, const iovec* vecs,
 					size_t vecCount, ancillary_data_container** _ancillaryData,
 					struct sockaddr* _address, socklen_t* _addressLength);
+
+	// optional; unlike receive_data(), it always takes over the buffers
+	void		(*receive_data_batch)(net_buffer** buffers, uint32 count);
 };
 
 
@@ -117,6 +117,9 @@ struct net_socket_module_info {
 	int			(*shutdown)(net_socket* socket, int direction);
 	status_t	(*socketpair)(int family, int type, int protocol,
 					net_socket* _sockets[2]);
+
+	ssize_t		(*send_external)(net_socket* socket, const void* data,
+					size_t length, int flags, BReferenceable* reference);
 };
 
 
@@ -19,6 +19,7 @@
 
 struct net_socket;
 struct net_stat;
+class BReferenceable;
 
 
 struct net_stack_interface_module_info {
@@ -75,6 +76,9 @@ struct net_stack_interface_module_info {
 
 	status_t (*get_next_socket_stat)(int family, uint32 *cookie,
 					struct net_stat *stat);
+
+	ssize_t (*send_external)(net_socket* socket, const void* data,
+					size_t length, int flags, BReferenceable* reference);
 };
 
 
@@ -7,4 +7,9 @@
 // notifications if the entry stays in the query.
 #define B_ATTR_CHANGE_NOTIFICATION		0x0000F000
 
+// B_QUERY_EXPLAIN makes the query return a description of how it would be
+// run instead of the matching entries, one line per entry, with a d_ino of
+// zero. File systems that don't support it just ignore it.
+#define B_QUERY_EXPLAIN					0x00010000
+
 #endif
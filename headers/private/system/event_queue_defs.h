@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_EVENT_QUEUE_DEFS_H
+#define _SYSTEM_EVENT_QUEUE_DEFS_H
+
+
+#include <OS.h>
+
+
+// event_wait_info::behavior
+enum {
+	B_EVENT_LEVEL_TRIGGERED	= 0x0000,	/* report the events as long as they
+										   persist */
+	B_EVENT_EDGE_TRIGGERED	= 0x0001,	/* report the events only when they
+										   occur */
+	B_EVENT_ONE_SHOT		= 0x0002	/* remove the object from the queue
+										   after the events have been
+										   reported */
+};
+
+
+typedef struct event_wait_info {
+	int32	object;
+	uint16	type;		/* B_OBJECT_TYPE_* */
+	uint16	behavior;	/* B_EVENT_{LEVEL,EDGE}_TRIGGERED, B_EVENT_ONE_SHOT */
+	uint16	events;		/* B_EVENT_*; 0 removes the object from the queue */
+	void*	user_data;
+} event_wait_info;
+
+/* An event queue is a persistent set of objects (FDs, semaphores, ports,
+   threads) a team is interested in. Objects are registered once with
+   event_queue_select() and stay selected until they are removed again, so
+   that event_queue_wait() only needs to look at the objects that actually
+   reported events. The event_wait_info::events field works like the one of
+   object_wait_info; B_EVENT_INVALID, B_EVENT_ERROR, and B_EVENT_DISCONNECTED
+   are always reported. Objects reporting B_EVENT_INVALID are removed from
+   the queue automatically.
+*/
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int		event_queue_create(int openFlags);
+extern status_t	event_queue_select(int queue, event_wait_info* infos,
+					int numInfos);
+extern ssize_t	event_queue_wait(int queue, event_wait_info* infos,
+					int numInfos, uint32 flags, bigtime_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif	/* _SYSTEM_EVENT_QUEUE_DEFS_H */
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_OBJECT_CACHE_DEFS_H
+#define _SYSTEM_OBJECT_CACHE_DEFS_H
+
+
+#include <OS.h>
+
+
+#define B_OBJECT_CACHE_NO_DEPOT	0x01
+
+struct object_cache_info {
+	char		name[32];
+	uint32		flags;
+	size_t		object_size;
+	size_t		used_objects;
+	size_t		total_objects;
+	size_t		memory_usage;
+		// bytes used by the slabs
+	size_t		depot_memory_usage;
+		// bytes used by the magazines of the depot
+
+	uint64		allocations;
+	uint64		frees;
+
+	// depot statistics, all zero if there is no depot
+	uint64		depot_hits;
+	uint64		depot_misses;
+	uint64		full_magazine_exchanges;
+	uint64		empty_magazine_exchanges;
+	uint64		depot_contention;
+	uint32		magazine_capacity;
+	uint32		magazine_count;
+	uint32		magazine_resizes;
+};
+
+
+#endif	/* _SYSTEM_OBJECT_CACHE_DEFS_H */
@@ -32,6 +32,7 @@ struct scheduling_analysis_thread {
 	bigtime_t	unspecified_wait_time;
 
 	int64		preemptions;
+	int64		migrations;
 
 	scheduling_analysis_thread_wait_object* wait_objects;
 };
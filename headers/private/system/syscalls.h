@@ -21,13 +21,16 @@ extern "C" {
 #endif
 
 struct attr_info;
+struct attr_vec;
 struct dirent;
+struct event_wait_info;
 struct fd_info;
 struct fd_set;
 struct fs_info;
 struct iovec;
 struct msqid_ds;
 struct net_stat;
+struct object_cache_info;
 struct pollfd;
 struct rlimit;
 struct scheduling_analysis;
@@ -73,6 +76,14 @@ extern status_t		_kern_get_safemode_option(const char *parameter,
 extern ssize_t		_kern_wait_for_objects(object_wait_info* infos, int numInfos,
 						uint32 flags, bigtime_t timeout);
 
+/* event queue functions */
+extern int			_kern_event_queue_create(int openFlags);
+extern status_t		_kern_event_queue_select(int queue,
+						struct event_wait_info* infos, int numInfos);
+extern ssize_t		_kern_event_queue_wait(int queue,
+						struct event_wait_info* infos, int numInfos,
+						uint32 flags, bigtime_t timeout);
+
 /* user mutex functions */
 extern status_t		_kern_mutex_lock(int32* mutex, const char* name,
 						uint32 flags, bigtime_t timeout);
@@ -191,6 +202,8 @@ extern status_t		_kern_unblock_threads(thread_id* threads, uint32 count,
 						status_t status);
 
 extern bigtime_t	_kern_estimate_max_scheduling_latency(thread_id thread);
+extern status_t		_kern_set_scheduler_mode(int32 mode);
+extern int32		_kern_get_scheduler_mode(void);
 
 // user/group functions
 extern gid_t		_kern_getgid(bool effective);
@@ -288,6 +301,12 @@ extern ssize_t		_kern_write_attr(int fd, const char *attribute, uint32 type,
 						off_t pos, const void *buffer, size_t readBytes);
 extern status_t		_kern_stat_attr(int fd, const char *attribute,
 						struct attr_info *attrInfo);
+extern ssize_t		_kern_read_attrs(int fd, struct attr_vec *vecs,
+						size_t count);
+extern ssize_t		_kern_write_attrs(int fd, struct attr_vec *vecs,
+						size_t count);
+extern ssize_t		_kern_read_node_attrs(dev_t device, const ino_t *nodes,
+						size_t nodeCount, struct attr_vec *vecs, size_t count);
 extern int			_kern_open_attr(int fd, const char* path, const char *name,
 						uint32 type, int openMode);
 extern status_t		_kern_remove_attr(int fd, const char *name);
@@ -355,6 +374,8 @@ extern ssize_t		_kern_sendto(int socket, const void *data, size_t length,
 						socklen_t addressLength);
 extern ssize_t		_kern_sendmsg(int socket, const struct msghdr *message,
 						int flags);
+extern ssize_t		_kern_sendfile(int socket, int fd, off_t *_offset,
+						size_t count);
 extern status_t		_kern_getsockopt(int socket, int level, int option,
 						void *value, socklen_t *_length);
 extern status_t		_kern_setsockopt(int socket, int level, int option,
@@ -439,6 +460,9 @@ extern status_t		_kern_memory_advice(void *address, size_t size,
 extern status_t		_kern_get_memory_properties(team_id teamID,
 						const void *address, uint32* _protected, uint32* _lock);
 
+extern status_t		_kern_get_next_object_cache_info(int32 *cookie,
+						struct object_cache_info *info, size_t size);
+
 /* kernel port functions */
 extern port_id		_kern_create_port(int32 queue_length, const char *name);
 extern status_t		_kern_close_port(port_id id);
@@ -463,6 +487,12 @@ extern status_t		_kern_writev_port_etc(port_id id, int32 msgCode,
 extern status_t		_kern_get_port_message_info_etc(port_id port,
 						port_message_info *info, size_t infoSize, uint32 flags,
 						bigtime_t timeout);
+extern ssize_t		_kern_read_port_area_etc(port_id port, int32 *msgCode,
+						void *msgBuffer, size_t bufferSize, area_id *_area,
+						uint32 flags, bigtime_t timeout);
+extern status_t		_kern_write_port_area_etc(port_id port, int32 msgCode,
+						const void *msgBuffer, size_t bufferSize, area_id area,
+						uint32 flags, bigtime_t timeout);
 
 // debug support functions
 extern status_t		_kern_kernel_debugger(const char *message);
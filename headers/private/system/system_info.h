@@ -23,6 +23,24 @@ struct system_memory_info {
 	// TODO: add active/inactive page counts, swap in/out, ...
 };
 
+#define B_NUMA_INFO		'numa'
+#define B_MAX_NUMA_NODES	8
+
+struct system_numa_node_info {
+	uint64		total_memory;
+	uint64		free_memory;
+	uint64		remote_allocations;
+		// pages allocated for CPUs of this node from other nodes
+	uint8		distance[B_MAX_NUMA_NODES];
+		// relative distance to the other nodes, 10 means local
+};
+
+struct system_numa_info {
+	uint32		node_count;
+	uint32		cpu_node[B_MAX_CPU_COUNT];
+	system_numa_node_info nodes[B_MAX_NUMA_NODES];
+};
+
 
 enum {
 	// team creation or deletion; object == -1; either one also triggers on
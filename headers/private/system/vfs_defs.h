@@ -20,4 +20,8 @@ struct fd_info {
 	ino_t	node;
 };
 
+// maximum number of attr_vecs a single _kern_{read,write}_attrs() or
+// _kern_read_node_attrs() call accepts
+#define MAX_ATTR_VECS	256
+
 #endif	/* _SYSTEM_VFS_DEFS_H */
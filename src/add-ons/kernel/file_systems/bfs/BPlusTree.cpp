@@ -1146,6 +1146,91 @@ BPlusTree::_SeekDown(Stack<node_and_key>& stack, const uint8* key,
 }
 
 
+static const uint64 kTreePositionScale = 1ULL << 32;
+
+
+/*!	Returns how many values are stored under the key at \a index of the
+	leaf \a node - for duplicates, this is only a guess, as the duplicate
+	nodes are not read.
+*/
+static inline uint32
+estimated_values(const bplustree_node* node, uint16 index)
+{
+	off_t link = BFS_ENDIAN_TO_HOST_INT64(node->Values()[index]);
+	if (!bplustree_node::IsDuplicate(link))
+		return 1;
+	if (bplustree_node::LinkType(link) == BPLUSTREE_DUPLICATE_FRAGMENT)
+		return NUM_FRAGMENT_VALUES / 2 + 1;
+
+	return NUM_DUPLICATE_VALUES;
+}
+
+
+/*!	Follows the key from the root node down to its leaf, and interpolates
+	its relative position in the tree from the key index on every level.
+	If \a after is \c true, the position behind an exactly matching key is
+	returned. A \c NULL key stands for the first key in the tree.
+	On the way, the number of entries in the tree is extrapolated from the
+	fan-out of the visited nodes.
+*/
+status_t
+BPlusTree::_FindPosition(const uint8* key, uint16 keyLength, bool after,
+	tree_position& position)
+{
+	position.nodeOffset = fHeader.RootNode();
+	position.position = 0;
+	position.entries = 1;
+
+	uint64 width = kTreePositionScale;
+	uint32 levels = 0;
+
+	CachedNode cached(this);
+	const bplustree_node* node;
+	while ((node = cached.SetTo(position.nodeOffset)) != NULL) {
+		uint16 keyCount = node->NumKeys();
+		uint16 keyIndex = 0;
+		off_t nextOffset = keyCount > 0
+			? BFS_ENDIAN_TO_HOST_INT64(node->Values()[0])
+			: node->OverflowLink();
+		status_t status = B_ENTRY_NOT_FOUND;
+
+		if (key != NULL) {
+			status = _FindKey(node, key, keyLength, &keyIndex, &nextOffset);
+			if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+				return status;
+		}
+
+		if (node->IsLeaf()) {
+			if (status == B_OK && after)
+				keyIndex++;
+
+			uint64 values = 0;
+			for (uint16 i = 0; i < keyCount; i++)
+				values += estimated_values(node, i);
+
+			position.keyIndex = keyIndex;
+			if (keyCount > 0)
+				position.position += width * keyIndex / keyCount;
+			position.entries = min_c(position.entries * max_c(values, 1),
+				kTreePositionScale);
+			return B_OK;
+		}
+
+		if (nextOffset == position.nodeOffset
+			|| ++levels > fHeader.MaxNumberOfLevels())
+			RETURN_ERROR(B_BAD_DATA);
+
+		position.position += width * keyIndex / (keyCount + 1);
+		width /= keyCount + 1;
+		position.entries = min_c(position.entries * (keyCount + 1),
+			kTreePositionScale);
+		position.nodeOffset = nextOffset;
+	}
+
+	RETURN_ERROR(B_ERROR);
+}
+
+
 /*!	This will find a free duplicate fragment in the given bplustree_node.
 	The CachedNode will be set to the writable fragment on success.
 */
@@ -2324,6 +2409,72 @@ BPlusTree::Find(const uint8* key, uint16 keyLength, off_t* _value)
 
 
 #if !_BOOT_MODE
+/*!	Estimates the number of values stored under the keys between \a from
+	and \a to without iterating over them; a \c NULL key leaves the range
+	open on that side.
+	Ranges that begin and end in the same leaf are counted, larger ones are
+	interpolated from the positions of their bounds, which costs no more
+	than two lookups.
+*/
+status_t
+BPlusTree::EstimateRange(const uint8* from, uint16 fromLength,
+	bool fromIncluded, const uint8* to, uint16 toLength, bool toIncluded,
+	off_t& _count)
+{
+	if ((from != NULL && (fromLength < BPLUSTREE_MIN_KEY_LENGTH
+			|| fromLength > BPLUSTREE_MAX_KEY_LENGTH))
+		|| (to != NULL && (toLength < BPLUSTREE_MIN_KEY_LENGTH
+			|| toLength > BPLUSTREE_MAX_KEY_LENGTH)))
+		RETURN_ERROR(B_BAD_VALUE);
+
+	InodeReadLocker locker(fStream);
+
+	tree_position first;
+	status_t status = _FindPosition(from, fromLength, !fromIncluded, first);
+	if (status != B_OK)
+		return status;
+
+	tree_position last;
+	if (to != NULL) {
+		status = _FindPosition(to, toLength, toIncluded, last);
+		if (status != B_OK)
+			return status;
+	} else {
+		last = first;
+		last.nodeOffset = BPLUSTREE_NULL;
+		last.position = kTreePositionScale;
+	}
+
+	if (first.nodeOffset == last.nodeOffset) {
+		// both ends are in the same leaf, so we can just count the keys
+		CachedNode cached(this);
+		const bplustree_node* node = cached.SetTo(first.nodeOffset);
+		if (node == NULL)
+			RETURN_ERROR(B_IO_ERROR);
+
+		off_t count = 0;
+		for (uint16 i = first.keyIndex;
+				i < last.keyIndex && i < node->NumKeys(); i++) {
+			count += estimated_values(node, i);
+		}
+
+		_count = count;
+		return B_OK;
+	}
+
+	if (last.position <= first.position) {
+		_count = 0;
+		return B_OK;
+	}
+
+	// the range spans more than one leaf, and therefore has at least one entry
+	uint64 entries = (first.entries + last.entries) / 2;
+	_count = max_c((((last.position - first.position) >> 8) * entries) >> 24,
+		1);
+	return B_OK;
+}
+
+
 status_t
 BPlusTree::_ValidateChildren(TreeCheck& check, uint32 level, off_t offset,
 	const uint8* largestKey, uint16 largestKeyLength,
@@ -159,6 +159,16 @@ struct node_and_key {
 	off_t	nodeOffset;
 	uint16	keyIndex;
 };
+
+// the position of a key in the tree, used for estimating key ranges
+struct tree_position {
+	off_t	nodeOffset;
+	uint16	keyIndex;
+	uint64	position;
+		// the relative position in the tree, out of kTreePositionScale
+	uint64	entries;
+		// the number of entries in the tree, extrapolated along the path
+};
 #endif // !_BOOT_MODE
 
 
@@ -291,6 +301,13 @@ public:
 			status_t			Find(const uint8* key, uint16 keyLength,
 									off_t* value);
 
+#if !_BOOT_MODE
+			status_t			EstimateRange(const uint8* from,
+									uint16 fromLength, bool fromIncluded,
+									const uint8* to, uint16 toLength,
+									bool toIncluded, off_t& _count);
+#endif
+
 #if !_BOOT_MODE
 	static	int32				TypeCodeToKeyType(type_code code);
 	static	int32				ModeToKeyType(mode_t mode);
@@ -313,6 +330,9 @@ private:
 #if !_BOOT_MODE
 			status_t			_SeekDown(Stack<node_and_key>& stack,
 									const uint8* key, uint16 keyLength);
+			status_t			_FindPosition(const uint8* key,
+									uint16 keyLength, bool after,
+									tree_position& position);
 
 			status_t			_FindFreeDuplicateFragment(
 									Transaction& transaction,
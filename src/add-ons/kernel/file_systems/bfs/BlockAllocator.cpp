@@ -13,6 +13,7 @@
 #include "BPlusTree.h"
 #include "Debug.h"
 #include "Inode.h"
+#include "Journal.h"
 #include "Volume.h"
 
 
@@ -222,9 +223,90 @@ private:
 };
 
 
+/*!	A range of free blocks within an allocation group. Every extent is part
+	of two trees: one sorted by its start, used to find the extent at or after
+	a position and to merge neighbours, and one sorted by its length, used to
+	find the best fitting extent for an allocation.
+*/
+struct free_extent {
+	SplayTreeLink<free_extent>	start_link;
+	SplayTreeLink<free_extent>	size_link;
+	int32						start;
+	int32						length;
+	uint64						size_key;
+		// the length in the upper, and the start in the lower 32 bits, so
+		// that all keys are unique
+
+	void UpdateSizeKey()
+	{
+		size_key = ((uint64)length << 32) | (uint32)start;
+	}
+};
+
+
+struct FreeExtentStartDefinition {
+	typedef int32		KeyType;
+	typedef free_extent	NodeType;
+
+	static int32 GetKey(const free_extent* node)
+	{
+		return node->start;
+	}
+
+	static SplayTreeLink<free_extent>* GetLink(free_extent* node)
+	{
+		return &node->start_link;
+	}
+
+	static int Compare(int32 key, const free_extent* node)
+	{
+		if (key < node->start)
+			return -1;
+		return key > node->start ? 1 : 0;
+	}
+};
+
+
+struct FreeExtentSizeDefinition {
+	typedef uint64		KeyType;
+	typedef free_extent	NodeType;
+
+	static uint64 GetKey(const free_extent* node)
+	{
+		return node->size_key;
+	}
+
+	static SplayTreeLink<free_extent>* GetLink(free_extent* node)
+	{
+		return &node->size_link;
+	}
+
+	static int Compare(uint64 key, const free_extent* node)
+	{
+		if (key < node->size_key)
+			return -1;
+		return key > node->size_key ? 1 : 0;
+	}
+};
+
+
+typedef SplayTree<FreeExtentStartDefinition> FreeExtentStartTree;
+typedef SplayTree<FreeExtentSizeDefinition> FreeExtentSizeTree;
+
+
+// If a group is fragmented into more free extents than this, we stop
+// tracking them, and fall back to scanning its block bitmap.
+static const int32 kMaxExtentsPerGroup = 4096;
+
+// Bounds of the reservation windows for file data
+static const uint32 kMinReservationSize = 256 * 1024;
+static const uint32 kMaxReservationSize = 8 * 1024 * 1024;
+
+
 class AllocationGroup {
 public:
 	AllocationGroup();
+	~AllocationGroup();
 
 	void AddFreeRange(int32 start, int32 blocks);
 	bool IsFull() const { return fFreeBits == 0; }
@@ -236,7 +318,20 @@ public:
 	uint32 NumBlocks() const { return fNumBlocks; }
 	int32 Start() const { return fStart; }
 
+	bool HasExtents() const { return fExtentsValid; }
+	int32 CountExtents() const { return fExtentCount; }
+	void AddExtent(int32 start, int32 length);
+	void RemoveExtents(int32 start, int32 length);
+	bool FindExtent(int32 goal, int32 maximum, int32& _start,
+		int32& _length);
+	void ResetExtents();
+	void InvalidateExtents();
+
 private:
+	void _InsertExtent(free_extent* extent);
+	void _RemoveExtent(free_extent* extent);
+	void _ClearExtents();
+
 	friend class BlockAllocator;
 
 	uint32	fNumBits;
@@ -248,6 +343,71 @@ private:
 	int32	fLargestStart;
 	int32	fLargestLength;
 	bool	fLargestValid;
+
+	FreeExtentStartTree	fExtentsByStart;
+	FreeExtentSizeTree	fExtentsBySize;
+	int32	fExtentCount;
+	bool	fExtentsValid;
+};
+
+
+/*!	Listens to the transaction that allocated or freed blocks, and lets the
+	BlockAllocator update its free extents once its outcome is known.
+*/
+class AllocatorTransactionListener : public TransactionListener {
+public:
+	AllocatorTransactionListener(BlockAllocator* allocator)
+		:
+		fAllocator(allocator),
+		fListening(false)
+	{
+	}
+
+	bool IsListening() const { return fListening; }
+	void StartListening(Transaction& transaction)
+	{
+		transaction.AddListener(this);
+		fListening = true;
+	}
+
+	status_t AddRun(int32 group, uint16 start, uint16 length)
+	{
+		pending_run run = { group, start, length };
+		return fRuns.Push(run);
+	}
+
+	bool RemoveRun(int32& group, int32& start, int32& length)
+	{
+		pending_run run;
+		if (!fRuns.Pop(&run))
+			return false;
+
+		group = run.group;
+		start = run.start;
+		length = run.length;
+		return true;
+	}
+
+	virtual void TransactionDone(bool success)
+	{
+		fAllocator->_TransactionDone();
+	}
+
+	virtual void RemovedFromTransaction()
+	{
+		fListening = false;
+	}
+
+private:
+	struct pending_run {
+		int32	group;
+		uint16	start;
+		uint16	length;
+	};
+
+	BlockAllocator*		fAllocator;
+	Stack<pending_run>	fRuns;
+	bool				fListening;
 };
 
 
@@ -377,8 +537,16 @@ AllocationGroup::AllocationGroup()
 	:
 	fFirstFree(-1),
 	fFreeBits(0),
-	fLargestValid(false)
+	fLargestValid(false),
+	fExtentCount(0),
+	fExtentsValid(true)
+{
+}
+
+
+AllocationGroup::~AllocationGroup()
 {
+	_ClearExtents();
 }
 
 
@@ -398,6 +566,207 @@ AllocationGroup::AddFreeRange(int32 start, int32 blocks)
 	}
 
 	fFreeBits += blocks;
+
+	AddExtent(start, blocks);
+}
+
+
+/*!	Adds the free range to the extent trees, and merges it with its direct
+	neighbours. If the range cannot be tracked, the group falls back to
+	scanning its bitmap.
+*/
+void
+AllocationGroup::AddExtent(int32 start, int32 length)
+{
+	if (!fExtentsValid || length <= 0)
+		return;
+
+	free_extent* extent = NULL;
+
+	free_extent* previous = fExtentsByStart.FindClosest(start, false, false);
+	if (previous != NULL && previous->start + previous->length >= start) {
+		ASSERT(previous->start + previous->length == start);
+		_RemoveExtent(previous);
+		length += start - previous->start;
+		start = previous->start;
+		extent = previous;
+	}
+
+	free_extent* next = fExtentsByStart.FindClosest(start + length, true,
+		true);
+	if (next != NULL && next->start == start + length) {
+		_RemoveExtent(next);
+		length += next->length;
+		if (extent == NULL)
+			extent = next;
+		else {
+			free(next);
+			fExtentCount--;
+		}
+	}
+
+	if (extent == NULL) {
+		if (fExtentCount >= kMaxExtentsPerGroup) {
+			InvalidateExtents();
+			return;
+		}
+
+		extent = (free_extent*)malloc(sizeof(free_extent));
+		if (extent == NULL) {
+			InvalidateExtents();
+			return;
+		}
+		fExtentCount++;
+	}
+
+	extent->start = start;
+	extent->length = length;
+	_InsertExtent(extent);
+}
+
+
+/*!	Removes all free extents, or parts of them, that intersect with the
+	given range.
+*/
+void
+AllocationGroup::RemoveExtents(int32 start, int32 length)
+{
+	if (!fExtentsValid)
+		return;
+
+	int32 end = start + length;
+
+	free_extent* extent = fExtentsByStart.FindClosest(start, false, true);
+	if (extent == NULL || extent->start + extent->length <= start)
+		extent = fExtentsByStart.FindClosest(start, true, false);
+
+	while (extent != NULL && extent->start < end) {
+		free_extent* next = fExtentsByStart.FindClosest(extent->start, true,
+			false);
+		int32 extentEnd = extent->start + extent->length;
+
+		_RemoveExtent(extent);
+
+		if (extent->start < start) {
+			// keep the part before the range
+			extent->length = start - extent->start;
+			_InsertExtent(extent);
+			extent = NULL;
+		}
+
+		if (extentEnd > end) {
+			// keep the part after the range
+			if (extent == NULL) {
+				if (fExtentCount >= kMaxExtentsPerGroup) {
+					InvalidateExtents();
+					return;
+				}
+				extent = (free_extent*)malloc(sizeof(free_extent));
+				if (extent == NULL) {
+					InvalidateExtents();
+					return;
+				}
+				fExtentCount++;
+			}
+
+			extent->start = end;
+			extent->length = extentEnd - end;
+			_InsertExtent(extent);
+			extent = NULL;
+		}
+
+		if (extent != NULL) {
+			free(extent);
+			fExtentCount--;
+		}
+
+		extent = next;
+	}
+}
+
+
+/*!	Looks for a free range for an allocation of \a maximum blocks. A range
+	at or right after \a goal is preferred if it is large enough, then the
+	smallest extent that can hold the whole allocation; if there is none,
+	the largest extent of the group is returned.
+	The returned range covers the rest of the extent, and may therefore be
+	larger than \a maximum.
+*/
+bool
+AllocationGroup::FindExtent(int32 goal, int32 maximum, int32& _start,
+	int32& _length)
+{
+	free_extent* extent = fExtentsByStart.FindClosest(goal, false, true);
+	if (extent == NULL || extent->start + extent->length <= goal)
+		extent = fExtentsByStart.FindClosest(goal, true, false);
+
+	if (extent != NULL) {
+		int32 start = max_c(goal, extent->start);
+		int32 length = extent->start + extent->length - start;
+		if (length >= maximum) {
+			_start = start;
+			_length = length;
+			return true;
+		}
+	}
+
+	extent = fExtentsBySize.FindClosest((uint64)maximum << 32, true, true);
+	if (extent == NULL)
+		extent = fExtentsBySize.FindMax();
+	if (extent == NULL)
+		return false;
+
+	_start = extent->start;
+	_length = extent->length;
+	return true;
+}
+
+
+/*!	Empties the extent trees, and starts tracking free extents again. */
+void
+AllocationGroup::ResetExtents()
+{
+	_ClearExtents();
+	fExtentsValid = true;
+}
+
+
+/*!	Stops tracking the free extents of this group until ResetExtents() is
+	called.
+*/
+void
+AllocationGroup::InvalidateExtents()
+{
+	_ClearExtents();
+	fExtentsValid = false;
+}
+
+
+void
+AllocationGroup::_InsertExtent(free_extent* extent)
+{
+	extent->UpdateSizeKey();
+	fExtentsByStart.Insert(extent);
+	fExtentsBySize.Insert(extent);
+}
+
+
+void
+AllocationGroup::_RemoveExtent(free_extent* extent)
+{
+	fExtentsByStart.Remove(extent);
+	fExtentsBySize.Remove(extent);
+}
+
+
+void
+AllocationGroup::_ClearExtents()
+{
+	while (free_extent* extent = fExtentsByStart.FindMin()) {
+		_RemoveExtent(extent);
+		free(extent);
+	}
+	fExtentCount = 0;
 }
 
 
@@ -538,7 +907,8 @@ BlockAllocator::BlockAllocator(Volume* volume)
 	fVolume(volume),
 	fGroups(NULL),
 	fCheckBitmap(NULL),
-	fCheckCookie(NULL)
+	fCheckCookie(NULL),
+	fTransactionListener(NULL)
 {
 	recursive_lock_init(&fLock, "bfs allocator");
 }
@@ -547,6 +917,7 @@ BlockAllocator::BlockAllocator(Volume* volume)
 BlockAllocator::~BlockAllocator()
 {
 	recursive_lock_destroy(&fLock);
+	delete fTransactionListener;
 	delete[] fGroups;
 }
 
@@ -563,6 +934,11 @@ BlockAllocator::Initialize(bool full)
 	if (fGroups == NULL)
 		return B_NO_MEMORY;
 
+	fTransactionListener = new(std::nothrow) AllocatorTransactionListener(
+		this);
+	if (fTransactionListener == NULL)
+		return B_NO_MEMORY;
+
 	if (!full)
 		return B_OK;
 
@@ -621,6 +997,8 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 		fGroups[i].fFirstFree = fGroups[i].fLargestStart = 0;
 		fGroups[i].fFreeBits = fGroups[i].fLargestLength = fGroups[i].fNumBits;
 		fGroups[i].fLargestValid = true;
+		fGroups[i].ResetExtents();
+		fGroups[i].AddExtent(0, fGroups[i].fNumBits);
 
 		offset += fBlocksPerGroup;
 	}
@@ -633,6 +1011,7 @@ BlockAllocator::InitializeAndClearBitmap(Transaction& transaction)
 		FATAL(("could not allocate reserved space for block bitmap/log!\n"));
 		return B_ERROR;
 	}
+	fGroups[0].RemoveExtents(0, reservedBlocks);
 	fVolume->SuperBlock().used_blocks
 		= HOST_ENDIAN_TO_BFS_INT64(reservedBlocks);
 
@@ -698,81 +1077,348 @@ BlockAllocator::_Initialize(BlockAllocator* allocator)
 		if (range)
 			groups[i].AddFreeRange(start, range);
 
-		freeBlocks += groups[i].fFreeBits;
+		freeBlocks += groups[i].fFreeBits;
+
+		offset += blocks;
+	}
+	free(buffer);
+
+	// check if block bitmap and log area are reserved
+	uint32 reservedBlocks = volume->Log().Start() + volume->Log().Length();
+
+	if (allocator->CheckBlocks(0, reservedBlocks) != B_OK) {
+		if (volume->IsReadOnly()) {
+			FATAL(("Space for block bitmap or log area is not reserved "
+				"(volume is mounted read-only)!\n"));
+		} else {
+			Transaction transaction(volume, 0);
+			if (groups[0].Allocate(transaction, 0, reservedBlocks) != B_OK) {
+				FATAL(("Could not allocate reserved space for block "
+					"bitmap/log!\n"));
+				volume->Panic();
+			} else {
+				groups[0].RemoveExtents(0, reservedBlocks);
+				transaction.Done();
+				FATAL(("Space for block bitmap or log area was not "
+					"reserved!\n"));
+			}
+		}
+	}
+
+	off_t usedBlocks = volume->NumBlocks() - freeBlocks;
+	if (volume->UsedBlocks() != usedBlocks) {
+		// If the disk in a dirty state at mount time, it's
+		// normal that the values don't match
+		INFORM(("volume reports %" B_PRIdOFF " used blocks, correct is %"
+			B_PRIdOFF "\n", volume->UsedBlocks(), usedBlocks));
+		volume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(usedBlocks);
+	}
+
+	return B_OK;
+}
+
+
+void
+BlockAllocator::Uninitialize()
+{
+	// We only have to make sure that the initializer thread isn't running
+	// anymore.
+	recursive_lock_lock(&fLock);
+}
+
+
+/*!	Tries to allocate between \a minimum, and \a maximum blocks starting
+	at group \a groupIndex with offset \a start. The resulting allocation
+	is put into \a run.
+
+	The number of allocated blocks is always a multiple of \a minimum which
+	has to be a power of two value.
+
+	If \a reservation is given, and the free range the blocks were taken from
+	is larger than needed, up to \c reservation->window of the following
+	blocks are set aside for the next allocations of the same file.
+*/
+status_t
+BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
+	uint16 start, uint16 maximum, uint16 minimum, block_run& run,
+	block_reservation* reservation)
+{
+	if (maximum == 0)
+		return B_BAD_VALUE;
+
+	FUNCTION_START(("group = %ld, start = %u, maximum = %u, minimum = %u\n",
+		groupIndex, start, maximum, minimum));
+
+	RecursiveLocker lock(fLock);
+
+	// Find the block_run that can fulfill the request best
+	int32 bestGroup;
+	int32 bestStart;
+	int32 bestLength;
+	status_t status = _FindRange(groupIndex, start, maximum, true, bestGroup,
+		bestStart, bestLength);
+	if (status != B_OK)
+		return status;
+
+	bool fromBitmap = bestLength < minimum
+		|| !fGroups[bestGroup].HasExtents();
+	if (bestLength < minimum) {
+		// The free extents neither contain the reserved blocks, nor those
+		// that were freed by a transaction that is still running -- give
+		// up the reservations, and look at the block bitmap itself.
+		_ReleaseReservations();
+
+		status = _FindRange(groupIndex, start, maximum, false, bestGroup,
+			bestStart, bestLength);
+		if (status != B_OK)
+			return status;
+	} else if (fromBitmap) {
+		// The range was found in the bitmap of a group that doesn't track
+		// its extents (anymore); it may overlap the reservations there.
+		_ReleaseReservations(bestGroup);
+	}
+
+	// If we found a suitable range, mark the blocks as in use, and
+	// write the updated block bitmap back to disk
+	if (bestLength < minimum)
+		return B_DEVICE_FULL;
+
+	int32 freeLength = bestLength;
+
+	if (bestLength > maximum)
+		bestLength = maximum;
+	else if (minimum > 1) {
+		// make sure bestLength is a multiple of minimum
+		bestLength = round_down(bestLength, minimum);
+	}
+
+	status = _AllocateRun(transaction, bestGroup, bestStart, bestLength, run);
+	if (status != B_OK)
+		return status;
+
+	// Only reserve blocks that came from the free extents: a range found in
+	// the bitmap may contain blocks freed by the running transaction, which
+	// become used again if it is aborted.
+	if (reservation != NULL && !fromBitmap) {
+		int32 length = min_c(freeLength - bestLength, reservation->window);
+		if (length > 0) {
+			ASSERT(reservation->length == 0);
+
+			fGroups[bestGroup].RemoveExtents(bestStart + bestLength, length);
+			reservation->group = bestGroup;
+			reservation->start = bestStart + bestLength;
+			reservation->length = length;
+			fReservations.Add(reservation);
+		}
+	}
+
+	return B_OK;
+}
+
+
+status_t
+BlockAllocator::AllocateForInode(Transaction& transaction,
+	const block_run* parent, mode_t type, block_run& run)
+{
+	// Apply some allocation policies here (AllocateBlocks() will break them
+	// if necessary) - we will start with those described in Dominic Giampaolo's
+	// "Practical File System Design", and see how good they work
+
+	// Files are going in the same allocation group as its parent,
+	// sub-directories will be inserted 8 allocation groups after
+	// the one of the parent
+	uint16 group = parent->AllocationGroup();
+	if ((type & (S_DIRECTORY | S_INDEX_DIR | S_ATTR_DIR)) == S_DIRECTORY)
+		group += 8;
+
+	return AllocateBlocks(transaction, group, 0, 1, 1, run);
+}
+
+
+status_t
+BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
+	off_t numBlocks, block_run& run, uint16 minimum)
+{
+	if (numBlocks <= 0)
+		return B_ERROR;
+
+	// one block_run can't hold more data than there is in one allocation group
+	if (numBlocks > fGroups[0].NumBits())
+		numBlocks = fGroups[0].NumBits();
+
+	// since block_run.length is uint16, the largest number of blocks that
+	// can be covered by a block_run is 65535
+	// TODO: if we drop compatibility, couldn't we do this any better?
+	// There are basically two possibilities:
+	// a) since a length of zero doesn't have any sense, take that for 65536 -
+	//    but that could cause many problems (bugs) in other areas
+	// b) reduce the maximum amount of blocks per block_run, so that the
+	//    remaining number of free blocks can be used in a useful manner
+	//    (like 4 blocks) - but that would also reduce the maximum file size
+	// c) have BlockRun::Length() return (length + 1).
+	if (numBlocks > MAX_BLOCK_RUN_LENGTH)
+		numBlocks = MAX_BLOCK_RUN_LENGTH;
+
+	RecursiveLocker lock(fLock);
+
+	// Files take their blocks from their reservation window first, so that
+	// files that grow concurrently don't interleave on disk
+	block_reservation* reservation = NULL;
+	if (inode->IsFile()) {
+		reservation = &inode->Reservation();
+
+		int32 length = min_c(numBlocks, reservation->length);
+		if (minimum > 1)
+			length = round_down(length, minimum);
+
+		if (length > 0 && CheckBlocks(((off_t)reservation->group
+					<< fVolume->AllocationGroupShift()) + reservation->start,
+				length, false) != B_OK) {
+			// Reservations are only kept in memory; if the group stopped
+			// tracking its extents before the reservation could be given
+			// up, a bitmap scan may have handed out some of its blocks.
+			fReservations.Remove(reservation);
+			reservation->length = 0;
+			length = 0;
+		}
+
+		if (length > 0) {
+			status_t status = _AllocateRun(transaction, reservation->group,
+				reservation->start, length, run);
+			if (status != B_OK)
+				return status;
+
+			reservation->start += length;
+			reservation->length -= length;
+			if (reservation->length == 0) {
+				// the file used up its window, give it a larger one next time
+				fReservations.Remove(reservation);
+				reservation->window = min_c(reservation->window * 2,
+					min_c(kMaxReservationSize >> fVolume->BlockShift(),
+						MAX_BLOCK_RUN_LENGTH));
+			}
+			return B_OK;
+		}
+
+		_ReleaseReservation(*reservation);
+		if (reservation->window == 0) {
+			reservation->window = max_c(
+				kMinReservationSize >> fVolume->BlockShift(), 1);
+		}
+	}
+
+	// Apply some allocation policies here (AllocateBlocks() will break them
+	// if necessary)
+	uint16 group = inode->BlockRun().AllocationGroup();
+	uint16 start = 0;
+
+	// Are there already allocated blocks? (then just try to allocate near the
+	// last one)
+	if (inode->Size() > 0) {
+		const data_stream& data = inode->Node().data;
+		// TODO: we currently don't care for when the data stream
+		// is already grown into the indirect ranges
+		if (data.max_double_indirect_range == 0
+			&& data.max_indirect_range == 0) {
+			// Since size > 0, there must be a valid block run in this stream
+			int32 last = 0;
+			for (; last < NUM_DIRECT_BLOCKS - 1; last++)
+				if (data.direct[last + 1].IsZero())
+					break;
+
+			group = data.direct[last].AllocationGroup();
+			start = data.direct[last].Start() + data.direct[last].Length();
+		}
+	} else if (inode->IsContainer() || inode->IsSymLink()) {
+		// directory and symbolic link data will go in the same allocation
+		// group as the inode is in but after the inode data
+		start = inode->BlockRun().Start();
+	} else {
+		// file data will start in the next allocation group
+		group = inode->BlockRun().AllocationGroup() + 1;
+	}
+
+	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run,
+		reservation);
+}
+
+
+status_t
+BlockAllocator::Free(Transaction& transaction, block_run run)
+{
+	RecursiveLocker lock(fLock);
+
+	int32 group = run.AllocationGroup();
+	uint16 start = run.Start();
+	uint16 length = run.Length();
+
+	FUNCTION_START(("group = %ld, start = %u, length = %u\n", group, start,
+		length));
+	T(Free(run));
+
+	// doesn't use Volume::IsValidBlockRun() here because it can check better
+	// against the group size (the last group may have a different length)
+	if (group < 0 || group >= fNumGroups
+		|| start > fGroups[group].NumBits()
+		|| uint32(start + length) > fGroups[group].NumBits()
+		|| length == 0) {
+		FATAL(("tried to free an invalid block_run (%d, %u, %u)\n", (int)group,
+			start, length));
+		DEBUGGER(("tried to free invalid block_run"));
+		return B_BAD_VALUE;
+	}
+	// check if someone tries to free reserved areas at the beginning of the
+	// drive
+	if (group == 0
+		&& start < uint32(fVolume->Log().Start() + fVolume->Log().Length())) {
+		FATAL(("tried to free a reserved block_run (%d, %u, %u)\n", (int)group,
+			start, length));
+		DEBUGGER(("tried to free reserved block"));
+		return B_BAD_VALUE;
+	}
+#ifdef DEBUG
+	if (CheckBlockRun(run) != B_OK)
+		return B_BAD_DATA;
+#endif
+
+	CHECK_ALLOCATION_GROUP(group);
 
-		offset += blocks;
-	}
-	free(buffer);
+	if (fGroups[group].Free(transaction, start, length) != B_OK)
+		RETURN_ERROR(B_IO_ERROR);
 
-	// check if block bitmap and log area are reserved
-	uint32 reservedBlocks = volume->Log().Start() + volume->Log().Length();
+	_AddPendingRun(transaction, group, start, length);
 
-	if (allocator->CheckBlocks(0, reservedBlocks) != B_OK) {
-		if (volume->IsReadOnly()) {
-			FATAL(("Space for block bitmap or log area is not reserved "
-				"(volume is mounted read-only)!\n"));
-		} else {
-			Transaction transaction(volume, 0);
-			if (groups[0].Allocate(transaction, 0, reservedBlocks) != B_OK) {
-				FATAL(("Could not allocate reserved space for block "
-					"bitmap/log!\n"));
-				volume->Panic();
-			} else {
-				transaction.Done();
-				FATAL(("Space for block bitmap or log area was not "
-					"reserved!\n"));
-			}
-		}
-	}
+	CHECK_ALLOCATION_GROUP(group);
 
-	off_t usedBlocks = volume->NumBlocks() - freeBlocks;
-	if (volume->UsedBlocks() != usedBlocks) {
-		// If the disk in a dirty state at mount time, it's
-		// normal that the values don't match
-		INFORM(("volume reports %" B_PRIdOFF " used blocks, correct is %"
-			B_PRIdOFF "\n", volume->UsedBlocks(), usedBlocks));
-		volume->SuperBlock().used_blocks = HOST_ENDIAN_TO_BFS_INT64(usedBlocks);
+#ifdef DEBUG
+	if (CheckBlockRun(run, NULL, false) != B_OK) {
+		DEBUGGER(("CheckBlockRun() reports allocated blocks (which were just "
+			"freed)\n"));
 	}
+#endif
 
+	fVolume->SuperBlock().used_blocks =
+		HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() - run.Length());
 	return B_OK;
 }
 
 
-void
-BlockAllocator::Uninitialize()
-{
-	// We only have to make sure that the initializer thread isn't running
-	// anymore.
-	recursive_lock_lock(&fLock);
-}
-
-
-/*!	Tries to allocate between \a minimum, and \a maximum blocks starting
-	at group \a groupIndex with offset \a start. The resulting allocation
-	is put into \a run.
-
-	The number of allocated blocks is always a multiple of \a minimum which
-	has to be a power of two value.
+/*!	Finds the free range that fulfills an allocation of \a maximum blocks
+	best, starting at group \a groupIndex with offset \a start. If
+	\a useExtents is \c true, the free extents are used for all groups that
+	have them, otherwise the block bitmap is scanned.
+	If no range is found, \a bestLength is set to a negative value.
 */
 status_t
-BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
-	uint16 start, uint16 maximum, uint16 minimum, block_run& run)
+BlockAllocator::_FindRange(int32 groupIndex, uint16 start, uint16 maximum,
+	bool useExtents, int32& bestGroup, int32& bestStart, int32& bestLength)
 {
-	if (maximum == 0)
-		return B_BAD_VALUE;
-
-	FUNCTION_START(("group = %ld, start = %u, maximum = %u, minimum = %u\n",
-		groupIndex, start, maximum, minimum));
-
 	AllocationBlock cached(fVolume);
-	RecursiveLocker lock(fLock);
-
 	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
 
-	// Find the block_run that can fulfill the request best
-	int32 bestGroup = -1;
-	int32 bestStart = -1;
-	int32 bestLength = -1;
+	bestGroup = -1;
+	bestStart = -1;
+	bestLength = -1;
 
 	for (int32 i = 0; i < fNumGroups + 1; i++, groupIndex++, start = 0) {
 		groupIndex = groupIndex % fNumGroups;
@@ -783,6 +1429,21 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 		if (start >= group.NumBits() || group.IsFull())
 			continue;
 
+		if (useExtents && group.HasExtents()) {
+			int32 rangeStart;
+			int32 rangeLength;
+			if (group.FindExtent(start, maximum, rangeStart, rangeLength)
+				&& rangeLength > bestLength) {
+				bestGroup = groupIndex;
+				bestStart = rangeStart;
+				bestLength = rangeLength;
+
+				if (bestLength >= maximum)
+					break;
+			}
+			continue;
+		}
+
 		// The wanted maximum is smaller than the largest free block in the
 		// group or already smaller than the minimum
 
@@ -903,29 +1564,32 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 			break;
 	}
 
-	// If we found a suitable range, mark the blocks as in use, and
-	// write the updated block bitmap back to disk
-	if (bestLength < minimum)
-		return B_DEVICE_FULL;
+	return B_OK;
+}
 
-	if (bestLength > maximum)
-		bestLength = maximum;
-	else if (minimum > 1) {
-		// make sure bestLength is a multiple of minimum
-		bestLength = round_down(bestLength, minimum);
-	}
 
-	if (fGroups[bestGroup].Allocate(transaction, bestStart, bestLength) != B_OK)
+/*!	Marks the run as used in the block bitmap, and in all of the in-memory
+	structures that describe it.
+*/
+status_t
+BlockAllocator::_AllocateRun(Transaction& transaction, int32 groupIndex,
+	uint16 start, uint16 length, block_run& run)
+{
+	AllocationGroup& group = fGroups[groupIndex];
+	if (group.Allocate(transaction, start, length) != B_OK)
 		RETURN_ERROR(B_IO_ERROR);
 
-	CHECK_ALLOCATION_GROUP(bestGroup);
+	group.RemoveExtents(start, length);
+	_AddPendingRun(transaction, groupIndex, start, length);
 
-	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(bestGroup);
-	run.start = HOST_ENDIAN_TO_BFS_INT16(bestStart);
-	run.length = HOST_ENDIAN_TO_BFS_INT16(bestLength);
+	CHECK_ALLOCATION_GROUP(groupIndex);
+
+	run.allocation_group = HOST_ENDIAN_TO_BFS_INT32(groupIndex);
+	run.start = HOST_ENDIAN_TO_BFS_INT16(start);
+	run.length = HOST_ENDIAN_TO_BFS_INT16(length);
 
 	fVolume->SuperBlock().used_blocks
-		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + bestLength);
+		= HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() + length);
 		// We are not writing back the disk's superblock - it's
 		// either done by the journaling code, or when the disk
 		// is unmounted.
@@ -942,139 +1606,169 @@ BlockAllocator::AllocateBlocks(Transaction& transaction, int32 groupIndex,
 }
 
 
-status_t
-BlockAllocator::AllocateForInode(Transaction& transaction,
-	const block_run* parent, mode_t type, block_run& run)
+/*!	Remembers a run whose state in the block bitmap has been changed by the
+	current transaction. Its free extents are updated once the transaction
+	is done, and it is known whether the change stays or is reverted.
+	Until then, freed blocks cannot be reused through the free extents.
+*/
+void
+BlockAllocator::_AddPendingRun(Transaction& transaction, int32 group,
+	uint16 start, uint16 length)
 {
-	// Apply some allocation policies here (AllocateBlocks() will break them
-	// if necessary) - we will start with those described in Dominic Giampaolo's
-	// "Practical File System Design", and see how good they work
+	if (!fGroups[group].HasExtents())
+		return;
 
-	// Files are going in the same allocation group as its parent,
-	// sub-directories will be inserted 8 allocation groups after
-	// the one of the parent
-	uint16 group = parent->AllocationGroup();
-	if ((type & (S_DIRECTORY | S_INDEX_DIR | S_ATTR_DIR)) == S_DIRECTORY)
-		group += 8;
+	if (!fTransactionListener->IsListening())
+		fTransactionListener->StartListening(transaction);
 
-	return AllocateBlocks(transaction, group, 0, 1, 1, run);
+	if (fTransactionListener->AddRun(group, start, length) != B_OK) {
+		// we won't be able to keep the extents of this group up to date
+		_ReleaseReservations(group);
+		fGroups[group].InvalidateExtents();
+	}
 }
 
 
-status_t
-BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
-	off_t numBlocks, block_run& run, uint16 minimum)
+/*!	Called when the transaction that changed the bitmap is done; updates
+	the free extents of all runs it touched from the block bitmap.
+*/
+void
+BlockAllocator::_TransactionDone()
 {
-	if (numBlocks <= 0)
-		return B_ERROR;
+	RecursiveLocker lock(fLock);
 
-	// one block_run can't hold more data than there is in one allocation group
-	if (numBlocks > fGroups[0].NumBits())
-		numBlocks = fGroups[0].NumBits();
+	int32 group;
+	int32 start;
+	int32 length;
+	while (fTransactionListener->RemoveRun(group, start, length))
+		_AddFreeExtents(group, start, length);
+}
 
-	// since block_run.length is uint16, the largest number of blocks that
-	// can be covered by a block_run is 65535
-	// TODO: if we drop compatibility, couldn't we do this any better?
-	// There are basically two possibilities:
-	// a) since a length of zero doesn't have any sense, take that for 65536 -
-	//    but that could cause many problems (bugs) in other areas
-	// b) reduce the maximum amount of blocks per block_run, so that the
-	//    remaining number of free blocks can be used in a useful manner
-	//    (like 4 blocks) - but that would also reduce the maximum file size
-	// c) have BlockRun::Length() return (length + 1).
-	if (numBlocks > MAX_BLOCK_RUN_LENGTH)
-		numBlocks = MAX_BLOCK_RUN_LENGTH;
 
-	// Apply some allocation policies here (AllocateBlocks() will break them
-	// if necessary)
-	uint16 group = inode->BlockRun().AllocationGroup();
-	uint16 start = 0;
+/*!	Adds all blocks within the range that are free in the block bitmap to
+	the free extents of the group.
+*/
+void
+BlockAllocator::_AddFreeExtents(int32 groupIndex, int32 start, int32 length)
+{
+	AllocationGroup& group = fGroups[groupIndex];
+	if (!group.HasExtents())
+		return;
 
-	// Are there already allocated blocks? (then just try to allocate near the
-	// last one)
-	if (inode->Size() > 0) {
-		const data_stream& data = inode->Node().data;
-		// TODO: we currently don't care for when the data stream
-		// is already grown into the indirect ranges
-		if (data.max_double_indirect_range == 0
-			&& data.max_indirect_range == 0) {
-			// Since size > 0, there must be a valid block run in this stream
-			int32 last = 0;
-			for (; last < NUM_DIRECT_BLOCKS - 1; last++)
-				if (data.direct[last + 1].IsZero())
-					break;
+	// the run might have been recorded more than once
+	group.RemoveExtents(start, length);
 
-			group = data.direct[last].AllocationGroup();
-			start = data.direct[last].Start() + data.direct[last].Length();
+	AllocationBlock cached(fVolume);
+	uint32 bitsPerFullBlock = fVolume->BlockSize() << 3;
+	int32 end = start + length;
+	int32 rangeStart = -1;
+
+	for (int32 bit = start; bit < end; bit++) {
+		if (bit == start || bit % bitsPerFullBlock == 0) {
+			if (cached.SetTo(group, bit / bitsPerFullBlock) != B_OK) {
+				_ReleaseReservations(groupIndex);
+				group.InvalidateExtents();
+				return;
+			}
+		}
+
+		if (!cached.IsUsed(bit % bitsPerFullBlock)) {
+			if (rangeStart < 0)
+				rangeStart = bit;
+		} else if (rangeStart >= 0) {
+			group.AddExtent(rangeStart, bit - rangeStart);
+			rangeStart = -1;
 		}
-	} else if (inode->IsContainer() || inode->IsSymLink()) {
-		// directory and symbolic link data will go in the same allocation
-		// group as the inode is in but after the inode data
-		start = inode->BlockRun().Start();
-	} else {
-		// file data will start in the next allocation group
-		group = inode->BlockRun().AllocationGroup() + 1;
 	}
 
-	return AllocateBlocks(transaction, group, start, numBlocks, minimum, run);
+	if (rangeStart >= 0)
+		group.AddExtent(rangeStart, end - rangeStart);
 }
 
 
+/*!	Rebuilds all in-memory information about the group from its block
+	bitmap.
+*/
 status_t
-BlockAllocator::Free(Transaction& transaction, block_run run)
+BlockAllocator::_RescanGroup(int32 groupIndex)
 {
-	RecursiveLocker lock(fLock);
+	AllocationGroup& group = fGroups[groupIndex];
 
-	int32 group = run.AllocationGroup();
-	uint16 start = run.Start();
-	uint16 length = run.Length();
+	_ReleaseReservations(groupIndex);
+	group.ResetExtents();
+	group.fFirstFree = -1;
+	group.fFreeBits = 0;
+	group.fLargestValid = false;
 
-	FUNCTION_START(("group = %ld, start = %u, length = %u\n", group, start,
-		length));
-	T(Free(run));
+	AllocationBlock cached(fVolume);
+	int32 rangeStart = -1;
+	int32 bit = 0;
 
-	// doesn't use Volume::IsValidBlockRun() here because it can check better
-	// against the group size (the last group may have a different length)
-	if (group < 0 || group >= fNumGroups
-		|| start > fGroups[group].NumBits()
-		|| uint32(start + length) > fGroups[group].NumBits()
-		|| length == 0) {
-		FATAL(("tried to free an invalid block_run (%d, %u, %u)\n", (int)group,
-			start, length));
-		DEBUGGER(("tried to free invalid block_run"));
-		return B_BAD_VALUE;
-	}
-	// check if someone tries to free reserved areas at the beginning of the
-	// drive
-	if (group == 0
-		&& start < uint32(fVolume->Log().Start() + fVolume->Log().Length())) {
-		FATAL(("tried to free a reserved block_run (%d, %u, %u)\n", (int)group,
-			start, length));
-		DEBUGGER(("tried to free reserved block"));
-		return B_BAD_VALUE;
+	for (uint32 block = 0; block < group.NumBlocks(); block++) {
+		if (cached.SetTo(group, block) != B_OK) {
+			group.InvalidateExtents();
+			RETURN_ERROR(B_IO_ERROR);
+		}
+
+		for (uint32 i = 0; i < cached.NumBlockBits(); i++, bit++) {
+			if (!cached.IsUsed(i)) {
+				if (rangeStart < 0)
+					rangeStart = bit;
+			} else if (rangeStart >= 0) {
+				group.AddFreeRange(rangeStart, bit - rangeStart);
+				rangeStart = -1;
+			}
+		}
 	}
-#ifdef DEBUG
-	if (CheckBlockRun(run) != B_OK)
-		return B_BAD_DATA;
-#endif
 
-	CHECK_ALLOCATION_GROUP(group);
+	if (rangeStart >= 0)
+		group.AddFreeRange(rangeStart, bit - rangeStart);
 
-	if (fGroups[group].Free(transaction, start, length) != B_OK)
-		RETURN_ERROR(B_IO_ERROR);
+	return B_OK;
+}
 
-	CHECK_ALLOCATION_GROUP(group);
 
-#ifdef DEBUG
-	if (CheckBlockRun(run, NULL, false) != B_OK) {
-		DEBUGGER(("CheckBlockRun() reports allocated blocks (which were just "
-			"freed)\n"));
-	}
-#endif
+void
+BlockAllocator::ReleaseReservation(block_reservation& reservation)
+{
+	if (reservation.length == 0)
+		return;
 
-	fVolume->SuperBlock().used_blocks =
-		HOST_ENDIAN_TO_BFS_INT64(fVolume->UsedBlocks() - run.Length());
-	return B_OK;
+	RecursiveLocker lock(fLock);
+	_ReleaseReservation(reservation);
+}
+
+
+/*!	Gives the reserved blocks back to the free extents of their group. */
+void
+BlockAllocator::_ReleaseReservation(block_reservation& reservation)
+{
+	if (reservation.length == 0)
+		return;
+
+	fReservations.Remove(&reservation);
+	fGroups[reservation.group].AddExtent(reservation.start,
+		reservation.length);
+	reservation.length = 0;
+}
+
+
+/*!	Releases all reservations in the given group, or in all groups if
+	\a group is -1.
+*/
+void
+BlockAllocator::_ReleaseReservations(int32 group)
+{
+	ReservationList::Iterator iterator = fReservations.GetIterator();
+	while (block_reservation* reservation = iterator.Next()) {
+		if (group != -1 && reservation->group != group)
+			continue;
+
+		iterator.Remove();
+		fGroups[reservation->group].AddExtent(reservation->start,
+			reservation->length);
+		reservation->length = 0;
+	}
 }
 
 
@@ -1111,6 +1805,8 @@ BlockAllocator::Fragment()
 
 			transaction.Done();
 		}
+
+		_RescanGroup(i);
 	}
 }
 #endif	// DEBUG_FRAGMENTER
@@ -1623,7 +2319,6 @@ BlockAllocator::_WriteBackCheckBitmap()
 	size_t size = BitmapSize();
 	off_t usedBlocks = 0LL;
 
-	// TODO: update the allocation groups used blocks info
 	for (uint32 i = size >> 2; i-- > 0;) {
 		uint32 compare = 1;
 		// Count the number of bits set
@@ -1684,6 +2379,10 @@ BlockAllocator::_WriteBackCheckBitmap()
 			}
 			transaction.Done();
 		}
+
+		// update the allocation groups to match the new bitmap
+		for (int32 i = 0; i < fNumGroups; i++)
+			_RescanGroup(i);
 	}
 
 	return B_OK;
@@ -2150,6 +2849,22 @@ BlockAllocator::Dump(int32 index)
 			group.fLargestValid ? "" : "  (invalid)");
 		kprintf("      largest length: %" B_PRId32 "\n", group.fLargestLength);
 		kprintf("      free bits:      %" B_PRId32 "\n", group.fFreeBits);
+		if (group.HasExtents()) {
+			kprintf("      free extents:   %" B_PRId32 "\n",
+				group.CountExtents());
+		} else
+			kprintf("      free extents:   (not tracked)\n");
+	}
+
+	kprintf("reservations:\n");
+	ReservationList::Iterator iterator = fReservations.GetIterator();
+	while (block_reservation* reservation = iterator.Next()) {
+		if (index != -1 && reservation->group != index)
+			continue;
+
+		kprintf("  %p: %" B_PRId32 ".%" B_PRId32 ".%" B_PRId32 ", window %"
+			B_PRId32 "\n", reservation, reservation->group, reservation->start,
+			reservation->length, reservation->window);
 	}
 }
 
@@ -10,6 +10,7 @@
 
 
 class AllocationGroup;
+class AllocatorTransactionListener;
 class BPlusTree;
 class Inode;
 class Transaction;
@@ -24,6 +25,31 @@ struct check_cookie;
 //#define DEBUG_FRAGMENTER
 
 
+/*!	A range of free blocks that is set aside in memory for the data stream of
+	a single file. Growing the file takes its blocks from here first, so that
+	files written concurrently don't interleave their blocks on disk.
+	Reservations are never written to disk.
+*/
+struct block_reservation : DoublyLinkedListLinkImpl<block_reservation> {
+	block_reservation()
+		:
+		group(-1),
+		start(0),
+		length(0),
+		window(0)
+	{
+	}
+
+	int32	group;
+	int32	start;
+	int32	length;
+	int32	window;
+		// size of the next reservation in blocks
+};
+
+typedef DoublyLinkedList<block_reservation> ReservationList;
+
+
 class BlockAllocator {
 public:
 							BlockAllocator(Volume* volume);
@@ -41,10 +67,13 @@ public:
 								off_t numBlocks, block_run& run,
 								uint16 minimum = 1);
 			status_t		Free(Transaction& transaction, block_run run);
+			void			ReleaseReservation(
+								block_reservation& reservation);
 
 			status_t		AllocateBlocks(Transaction& transaction,
 								int32 group, uint16 start, uint16 numBlocks,
-								uint16 minimum, block_run& run);
+								uint16 minimum, block_run& run,
+								block_reservation* reservation = NULL);
 
 			status_t		StartChecking(const check_control* control);
 			status_t		StopChecking(check_control* control);
@@ -67,6 +96,25 @@ public:
 #endif
 
 private:
+	friend class AllocatorTransactionListener;
+
+			status_t		_FindRange(int32 groupIndex, uint16 start,
+								uint16 maximum, bool useExtents,
+								int32& bestGroup, int32& bestStart,
+								int32& bestLength);
+			status_t		_AllocateRun(Transaction& transaction,
+								int32 group, uint16 start, uint16 length,
+								block_run& run);
+			void			_AddPendingRun(Transaction& transaction,
+								int32 group, uint16 start, uint16 length);
+			void			_TransactionDone();
+			void			_AddFreeExtents(int32 group, int32 start,
+								int32 length);
+			status_t		_RescanGroup(int32 group);
+			void			_ReleaseReservation(
+								block_reservation& reservation);
+			void			_ReleaseReservations(int32 group = -1);
+
 			status_t		_RemoveInvalidNode(Inode* parent, BPlusTree* tree,
 								Inode* inode, const char* name);
 #ifdef DEBUG_ALLOCATION_GROUPS
@@ -94,6 +142,9 @@ private:
 
 			uint32*			fCheckBitmap;
 			check_cookie*	fCheckCookie;
+
+			AllocatorTransactionListener* fTransactionListener;
+			ReservationList	fReservations;
 };
 
 #ifdef BFS_DEBUGGER_COMMANDS
@@ -404,6 +404,8 @@ Inode::~Inode()
 	file_map_delete(Map());
 	delete fTree;
 
+	fVolume->Allocator().ReleaseReservation(fReservation);
+
 	rw_lock_destroy(&fLock);
 	recursive_lock_destroy(&fSmallDataLock);
 }
@@ -1064,6 +1066,82 @@ Inode::ReadAttribute(const char* name, int32 type, off_t pos, uint8* buffer,
 }
 
 
+/*!	Reads and stats all attributes in \a vecs at once; the small_data
+	section is only searched once for all of them, and only those attributes
+	that are not found there are looked up in the attribute directory.
+	The result of every attribute is reported in its attr_vec::result.
+	The buffers may be userland buffers.
+*/
+void
+Inode::ReadAttributes(attr_vec* vecs, size_t count)
+{
+	size_t pending = 0;
+
+	{
+		NodeGetter node(fVolume, this);
+		RecursiveLocker locker(fSmallDataLock);
+
+		for (size_t i = 0; i < count; i++) {
+			attr_vec& vec = vecs[i];
+
+			if (vec.name[0] == FILE_NAME_NAME && vec.name[1] == '\0') {
+				vec.result = B_NOT_ALLOWED;
+				continue;
+			}
+
+			small_data* smallData = FindSmallData(node.Node(), vec.name);
+			if (smallData == NULL) {
+				vec.result = B_ENTRY_NOT_FOUND;
+				pending++;
+				continue;
+			}
+
+			vec.info.type = smallData->Type();
+			vec.info.size = smallData->DataSize();
+
+			size_t length = min_c(vec.buffer_size, smallData->DataSize());
+			if (vec.buffer != NULL && length > 0
+				&& user_memcpy(vec.buffer, smallData->Data(), length) != B_OK) {
+				vec.result = B_BAD_ADDRESS;
+				continue;
+			}
+
+			vec.result = vec.buffer != NULL ? length : 0;
+		}
+	}
+
+	// search the remaining ones in the attribute directory
+
+	for (size_t i = 0; pending > 0 && i < count; i++) {
+		attr_vec& vec = vecs[i];
+		if (vec.result != B_ENTRY_NOT_FOUND)
+			continue;
+
+		pending--;
+
+		Inode* attribute;
+		status_t status = GetAttribute(vec.name, &attribute);
+		if (status != B_OK) {
+			vec.result = status;
+			continue;
+		}
+
+		vec.info.type = attribute->Type();
+		vec.info.size = attribute->Size();
+
+		size_t length = vec.buffer_size;
+		if (vec.buffer != NULL && length > 0)
+			status = attribute->ReadAt(0, (uint8*)vec.buffer, &length);
+		else
+			length = 0;
+
+		vec.result = status == B_OK ? (ssize_t)length : status;
+
+		ReleaseAttribute(attribute);
+	}
+}
+
+
 /*!	Writes data to the specified attribute.
 	This is a high-level attribute function that understands attributes
 	in the small_data section as well as real attribute files.
@@ -2296,6 +2374,8 @@ Inode::TrimPreallocation(Transaction& transaction)
 	T(Resize(this, max_c(Node().data.MaxDirectRange(),
 		Node().data.MaxIndirectRange()), Size(), true));
 
+	fVolume->Allocator().ReleaseReservation(fReservation);
+
 	status_t status = _ShrinkStream(transaction, Size());
 	if (status < B_OK)
 		return status;
@@ -2304,6 +2384,189 @@ Inode::TrimPreallocation(Transaction& transaction)
 }
 
 
+/*!	Counts the number of contiguous pieces the data stream is split into on
+	disk; block runs that directly follow each other are counted as one.
+*/
+status_t
+Inode::CountFragments(uint32& _fragments)
+{
+	_fragments = 0;
+
+	if (IsSymLink() && (Flags() & INODE_LONG_SYMLINK) == 0)
+		return B_OK;
+
+	off_t size = round_up(Size(), fVolume->BlockSize());
+	off_t lastBlock = -1;
+	off_t offset = 0;
+
+	while (offset < size) {
+		block_run run;
+		off_t runOffset;
+		status_t status = FindBlockRun(offset, run, runOffset);
+		if (status != B_OK)
+			return status;
+
+		off_t block = fVolume->ToBlock(run)
+			+ ((offset - runOffset) >> fVolume->BlockShift());
+		if (block != lastBlock)
+			_fragments++;
+
+		offset = runOffset + ((off_t)run.Length() << fVolume->BlockShift());
+		lastBlock = fVolume->ToBlock(run) + run.Length();
+	}
+
+	return B_OK;
+}
+
+
+/*!	Moves the data stream into a single contiguous block run, if it is split
+	into several fragments on disk. Any preallocated blocks are dropped.
+	The inode must be write locked in the \a transaction.
+
+	The data of files is copied directly on the device, as it is not part of
+	the block cache. The caller should file_cache_sync() the file before it
+	locks the inode, so that the device holds its current contents; the
+	page writer cannot do that while the lock is held, as it has to wait for
+	it. All file I/O goes through bfs_read_pages(), bfs_write_pages(), or
+	bfs_io(), which read lock the inode, so nothing can be written to the
+	old blocks while they are copied, and pages that were modified since are
+	written to the new location afterwards, as the file map is invalidated
+	before the lock is released.
+	The stream of containers (B+trees) goes through the block cache, and
+	therefore the log, so that their size is limited by the size of the log.
+*/
+status_t
+Inode::Defragment(Transaction& transaction, off_t& _blocksMoved)
+{
+	_blocksMoved = 0;
+
+	uint32 fragments;
+	status_t status = CountFragments(fragments);
+	if (status != B_OK || fragments <= 1)
+		return status;
+
+	uint32 blockShift = fVolume->BlockShift();
+	off_t numBlocks = round_up(Size(), fVolume->BlockSize()) >> blockShift;
+	if (numBlocks > MAX_BLOCK_RUN_LENGTH
+		|| (IsContainer() && numBlocks > fVolume->Log().Length() / 4))
+		return B_NOT_SUPPORTED;
+
+	fVolume->Allocator().ReleaseReservation(fReservation);
+
+	// Files go into the allocation group after the inode, everything else
+	// into the same group (see BlockAllocator::Allocate())
+	int32 group = BlockRun().AllocationGroup();
+	if (FileCache() != NULL)
+		group++;
+
+	block_run newRun;
+	status = fVolume->Allocator().AllocateBlocks(transaction, group, 0,
+		numBlocks, numBlocks, newRun);
+	if (status != B_OK)
+		return status;
+
+	off_t target = fVolume->ToBlock(newRun);
+	off_t offset = 0;
+
+	while (offset < (numBlocks << blockShift)) {
+		block_run run;
+		off_t runOffset;
+		status = FindBlockRun(offset, run, runOffset);
+		if (status != B_OK)
+			return status;
+
+		off_t skip = (offset - runOffset) >> blockShift;
+		off_t length = min_c(run.Length() - skip,
+			numBlocks - (offset >> blockShift));
+
+		status = _CopyBlocks(transaction, fVolume->ToBlock(run) + skip,
+			target + (offset >> blockShift), length);
+		if (status != B_OK)
+			return status;
+
+		offset += length << blockShift;
+	}
+
+	// Replace the old data stream with the new run
+
+	off_t size = Size();
+	status = _ShrinkStream(transaction, 0);
+	if (status != B_OK)
+		return status;
+
+	data_stream& data = Node().data;
+	data.direct[0] = newRun;
+	data.max_direct_range = HOST_ENDIAN_TO_BFS_INT64(numBlocks << blockShift);
+	data.size = HOST_ENDIAN_TO_BFS_INT64(size);
+
+	if (Map() != NULL)
+		file_map_invalidate(Map(), 0, size);
+
+	status = WriteBack(transaction);
+	if (status != B_OK)
+		return status;
+
+	_blocksMoved = numBlocks;
+	return B_OK;
+}
+
+
+status_t
+Inode::_CopyBlocks(Transaction& transaction, off_t from, off_t to,
+	off_t length)
+{
+	uint32 blockShift = fVolume->BlockShift();
+
+	if (FileCache() == NULL) {
+		// the stream lives in the block cache
+		CachedBlock source(fVolume);
+		CachedBlock target(fVolume);
+
+		for (off_t i = 0; i < length; i++) {
+			const uint8* sourceBlock = source.SetTo(from + i);
+			uint8* targetBlock = target.SetToWritable(transaction, to + i,
+				true);
+			if (sourceBlock == NULL || targetBlock == NULL)
+				RETURN_ERROR(B_IO_ERROR);
+
+			memcpy(targetBlock, sourceBlock, fVolume->BlockSize());
+		}
+		return B_OK;
+	}
+
+	off_t bufferBlocks = min_c(length, 256);
+	uint8* buffer = (uint8*)malloc(bufferBlocks << blockShift);
+	if (buffer == NULL)
+		RETURN_ERROR(B_NO_MEMORY);
+
+	status_t status = B_OK;
+
+	while (length > 0) {
+		size_t bytes = min_c(length, bufferBlocks) << blockShift;
+		ssize_t bytesRead = read_pos(fVolume->Device(), from << blockShift,
+			buffer, bytes);
+		if (bytesRead != (ssize_t)bytes) {
+			status = bytesRead < 0 ? bytesRead : B_IO_ERROR;
+			break;
+		}
+
+		ssize_t bytesWritten = write_pos(fVolume->Device(), to << blockShift,
+			buffer, bytes);
+		if (bytesWritten != (ssize_t)bytes) {
+			status = bytesWritten < 0 ? bytesWritten : B_IO_ERROR;
+			break;
+		}
+
+		from += bytes >> blockShift;
+		to += bytes >> blockShift;
+		length -= bytes >> blockShift;
+	}
+
+	free(buffer);
+	RETURN_ERROR(status);
+}
+
+
 //!	Frees the file's data stream and removes all attributes
 status_t
 Inode::Free(Transaction& transaction)
@@ -2313,6 +2576,8 @@ Inode::Free(Transaction& transaction)
 	// Perhaps there should be an implementation of Inode::ShrinkStream() that
 	// just frees the data_stream, but doesn't change the inode (since it is
 	// freed anyway) - that would make an undelete command possible
+	fVolume->Allocator().ReleaseReservation(fReservation);
+
 	if (!IsSymLink() || (Flags() & INODE_LONG_SYMLINK) != 0) {
 		status_t status = SetFileSize(transaction, 0);
 		if (status < B_OK)
@@ -113,6 +113,7 @@ public:
 			// high-level attribute methods
 			status_t			ReadAttribute(const char* name, int32 type,
 									off_t pos, uint8* buffer, size_t* _length);
+			void				ReadAttributes(attr_vec* vecs, size_t count);
 			status_t			WriteAttribute(Transaction& transaction,
 									const char* name, int32 type, off_t pos,
 									const uint8* buffer, size_t* _length,
@@ -148,6 +149,9 @@ public:
 			status_t			Append(Transaction& transaction, off_t bytes);
 			status_t			TrimPreallocation(Transaction& transaction);
 			bool				NeedsTrimming() const;
+			status_t			CountFragments(uint32& _fragments);
+			status_t			Defragment(Transaction& transaction,
+									off_t& _blocksMoved);
 
 			status_t			Free(Transaction& transaction);
 			status_t			Sync();
@@ -185,6 +189,9 @@ public:
 			void*				Map() const { return fMap; }
 			void				SetMap(void* map) { fMap = map; }
 
+			// blocks set aside for the data stream, see BlockAllocator
+			block_reservation&	Reservation() { return fReservation; }
+
 #if _KERNEL_MODE && KDEBUG
 			void				AssertReadLocked()
 									{ ASSERT_READ_LOCKED_RW_LOCK(&fLock); }
@@ -246,6 +253,8 @@ private:
 									off_t size);
 			status_t			_ShrinkStream(Transaction& transaction,
 									off_t size);
+			status_t			_CopyBlocks(Transaction& transaction,
+									off_t from, off_t to, off_t length);
 
 private:
 			rw_lock				fLock;
@@ -256,6 +265,7 @@ private:
 			void*				fCache;
 			void*				fMap;
 			bfs_inode			fNode;
+			block_reservation	fReservation;
 
 			off_t				fOldSize;
 			off_t				fOldLastModified;
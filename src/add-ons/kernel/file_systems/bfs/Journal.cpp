@@ -85,6 +85,35 @@ private:
 #endif
 };
 
+/*!	Collects the blocks of a log entry in an I/O vector, and writes them to
+	the log area with as few writes as possible; the vector is only split
+	where the log wraps around, or when it runs out of space.
+*/
+class LogWriter {
+public:
+							LogWriter(Volume* volume, off_t logStart,
+								uint32 logSize);
+							~LogWriter();
+
+			status_t		InitCheck() const
+								{ return fVecs != NULL ? B_OK : B_NO_MEMORY; }
+
+			void			Add(const void* block);
+			void			Flush();
+
+			off_t			Position() const { return fPosition; }
+
+private:
+			Volume*			fVolume;
+			off_t			fLogOffset;
+			uint32			fLogSize;
+			off_t			fStart;
+			off_t			fPosition;
+			int32			fCount;
+			iovec*			fVecs;
+			int32			fIndex;
+};
+
 
 #if BFS_TRACING && !defined(BFS_SHELL) && !defined(_BOOT_MODE)
 namespace BFSJournalTracing {
@@ -138,6 +167,10 @@ private:
 #endif
 
 
+static const int32 kMaxLogVecs = 1024;
+	// the number of iovecs a single log write may use
+
+
 //	#pragma mark -
 
 
@@ -162,6 +195,19 @@ add_to_iovec(iovec* vecs, int32& index, int32 max, const void* address,
 }
 
 
+static void
+add_to_histogram(uint64* histogram, int32 slots, uint64 value)
+{
+	int32 slot = 0;
+	while (value > 1 && slot < slots - 1) {
+		value >>= 1;
+		slot++;
+	}
+
+	histogram[slot]++;
+}
+
+
 //	#pragma mark - LogEntry
 
 
@@ -393,6 +439,59 @@ RunArrays::MaxArrayLength()
 }
 
 
+//	#pragma mark - LogWriter
+
+
+LogWriter::LogWriter(Volume* volume, off_t logStart, uint32 logSize)
+	:
+	fVolume(volume),
+	fLogOffset(volume->ToBlock(volume->Log()) << volume->BlockShift()),
+	fLogSize(logSize),
+	fStart(logStart),
+	fPosition(logStart),
+	fCount(0),
+	fIndex(0)
+{
+	fVecs = (iovec*)malloc(sizeof(iovec) * kMaxLogVecs);
+}
+
+
+LogWriter::~LogWriter()
+{
+	free(fVecs);
+}
+
+
+void
+LogWriter::Add(const void* block)
+{
+	if (fStart + fCount >= fLogSize || fIndex == kMaxLogVecs) {
+		// the log wraps around, or we ran out of vecs
+		Flush();
+	}
+
+	add_to_iovec(fVecs, fIndex, kMaxLogVecs, block, fVolume->BlockSize());
+	fCount++;
+}
+
+
+void
+LogWriter::Flush()
+{
+	if (fCount == 0)
+		return;
+
+	if (writev_pos(fVolume->Device(),
+			fLogOffset + (fStart << fVolume->BlockShift()), fVecs, fIndex) < 0)
+		FATAL(("could not write log area: %s!\n", strerror(errno)));
+
+	fPosition = fStart + fCount;
+	fStart = fPosition % fLogSize;
+	fCount = 0;
+	fIndex = 0;
+}
+
+
 //	#pragma mark - Journal
 
 
@@ -404,11 +503,15 @@ Journal::Journal(Volume* volume)
 	fMaxTransactionSize(fLogSize / 2 - 5),
 	fUsed(0),
 	fUnwrittenTransactions(0),
+	fLastTransaction(0),
+	fLastLoggedTransaction(0),
 	fHasSubtransaction(false),
 	fSeparateSubTransactions(false)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
+	mutex_init(&fCommitLock, "bfs journal commit");
+	memset(&fStats, 0, sizeof(fStats));
 }
 
 
@@ -418,6 +521,7 @@ Journal::~Journal()
 
 	recursive_lock_destroy(&fLock);
 	mutex_destroy(&fEntriesLock);
+	mutex_destroy(&fCommitLock);
 }
 
 
@@ -732,10 +836,7 @@ Journal::_WriteTransactionToLog()
 
 	fHasSubtransaction = false;
 
-	int32 blockShift = fVolume->BlockShift();
-	off_t logOffset = fVolume->ToBlock(fVolume->Log()) << blockShift;
 	off_t logStart = fVolume->LogEnd() % fLogSize;
-	off_t logPosition = logStart;
 	status_t status;
 
 	// create run_array structures for all changed blocks
@@ -765,6 +866,7 @@ Journal::_WriteTransactionToLog()
 				NULL);
 			fUnwrittenTransactions = 0;
 		}
+		_TransactionsLogged(detached, 0, 0);
 		return B_OK;
 	}
 
@@ -778,80 +880,63 @@ Journal::_WriteTransactionToLog()
 		}
 	}
 
-	// Write log entries to disk
+	// Write the whole log entry to disk at once
 
-	int32 maxVecs = runArrays.MaxArrayLength() + 1;
-		// one extra for the index block
+	bigtime_t startTime = system_time();
 
-	iovec* vecs = (iovec*)malloc(sizeof(iovec) * maxVecs);
-	if (vecs == NULL) {
+	LogWriter writer(fVolume, logStart, fLogSize);
+	if (writer.InitCheck() != B_OK) {
 		// TODO: write back log entries directly?
 		return B_NO_MEMORY;
 	}
 
-	for (int32 k = 0; k < runArrays.CountArrays(); k++) {
-		run_array* array = runArrays.ArrayAt(k);
-		int32 index = 0, count = 1;
-		int32 wrap = fLogSize - logStart;
-
-		add_to_iovec(vecs, index, maxVecs, (void*)array, fVolume->BlockSize());
+	uint32 blocks = 0;
+	status = B_OK;
 
-		// add block runs
+	for (int32 k = 0; status == B_OK && k < runArrays.CountArrays(); k++) {
+		run_array* array = runArrays.ArrayAt(k);
+		writer.Add(array);
 
-		for (int32 i = 0; i < array->CountRuns(); i++) {
+		for (int32 i = 0; status == B_OK && i < array->CountRuns(); i++) {
 			const block_run& run = array->RunAt(i);
 			off_t blockNumber = fVolume->ToBlock(run);
 
 			for (int32 j = 0; j < run.Length(); j++) {
-				if (count >= wrap) {
-					// We need to write back the first half of the entry
-					// directly as the log wraps around
-					if (writev_pos(fVolume->Device(), logOffset
-						+ (logStart << blockShift), vecs, index) < 0)
-						FATAL(("could not write log area!\n"));
-
-					logPosition = logStart + count;
-					logStart = 0;
-					wrap = fLogSize;
-					count = 0;
-					index = 0;
-				}
-
-				// make blocks available in the cache
+				// make blocks available in the cache; they must stay there
+				// until the vector has been written
 				const void* data = block_cache_get(fVolume->BlockCache(),
 					blockNumber + j);
 				if (data == NULL) {
-					free(vecs);
-					return B_IO_ERROR;
+					status = B_IO_ERROR;
+					break;
 				}
 
-				add_to_iovec(vecs, index, maxVecs, data, fVolume->BlockSize());
-				count++;
+				writer.Add(data);
+				blocks++;
 			}
 		}
+	}
 
-		// write back the rest of the log entry
-		if (count > 0) {
-			logPosition = logStart + count;
-			if (writev_pos(fVolume->Device(), logOffset
-					+ (logStart << blockShift), vecs, index) < 0)
-				FATAL(("could not write log area: %s!\n", strerror(errno)));
-		}
+	if (status == B_OK)
+		writer.Flush();
+
+	// release blocks again
+	for (int32 k = 0; blocks > 0 && k < runArrays.CountArrays(); k++) {
+		run_array* array = runArrays.ArrayAt(k);
 
-		// release blocks again
-		for (int32 i = 0; i < array->CountRuns(); i++) {
+		for (int32 i = 0; blocks > 0 && i < array->CountRuns(); i++) {
 			const block_run& run = array->RunAt(i);
 			off_t blockNumber = fVolume->ToBlock(run);
 
-			for (int32 j = 0; j < run.Length(); j++) {
+			for (int32 j = 0; blocks > 0 && j < run.Length(); j++, blocks--)
 				block_cache_put(fVolume->BlockCache(), blockNumber + j);
-			}
 		}
-
-		logStart = logPosition % fLogSize;
 	}
 
-	free(vecs);
+	if (status != B_OK)
+		return status;
+
+	off_t logPosition = writer.Position();
 
 	LogEntry* logEntry = new(std::nothrow) LogEntry(this, fVolume->LogEnd(),
 		runArrays.LogEntryLength());
@@ -887,6 +972,8 @@ Journal::_WriteTransactionToLog()
 	fUsed += logEntry->Length();
 	mutex_unlock(&fEntriesLock);
 
+	_TransactionsLogged(detached, runArrays.LogEntryLength(), startTime);
+
 	if (detached) {
 		fTransactionID = cache_detach_sub_transaction(fVolume->BlockCache(),
 			fTransactionID, _TransactionWritten, logEntry);
@@ -932,6 +1019,9 @@ Journal::_FlushLog(bool canWait, bool flushBlocks)
 		status = _WriteTransactionToLog();
 		if (status < B_OK)
 			FATAL(("writing current log entry failed: %s\n", strerror(status)));
+	} else {
+		// everything that is done is already in the log
+		_TransactionsLogged(false, 0, 0);
 	}
 
 	if (flushBlocks)
@@ -952,6 +1042,55 @@ Journal::FlushLogAndBlocks()
 }
 
 
+/*!	Makes sure that all transactions that were done before this call are
+	written to the log.
+	Concurrent callers are served by the same log write: while one of them is
+	writing the log, the others wait for it on the commit lock, and will only
+	write the log themselves if their transactions are still missing.
+*/
+status_t
+Journal::Commit()
+{
+	bigtime_t startTime = system_time();
+
+	mutex_lock(&fEntriesLock);
+	int64 transaction = fLastTransaction;
+	bool logged = fLastLoggedTransaction >= transaction;
+	mutex_unlock(&fEntriesLock);
+
+	if (logged)
+		return B_OK;
+
+	status_t status = B_OK;
+
+	mutex_lock(&fCommitLock);
+
+	mutex_lock(&fEntriesLock);
+	logged = fLastLoggedTransaction >= transaction;
+	mutex_unlock(&fEntriesLock);
+
+	if (!logged)
+		status = _FlushLog(true, false);
+
+	mutex_unlock(&fCommitLock);
+
+	MutexLocker locker(fEntriesLock);
+	fStats.commits++;
+	add_to_histogram(fStats.commit_latency, BFS_JOURNAL_LATENCY_SLOTS,
+		system_time() - startTime);
+
+	return status;
+}
+
+
+void
+Journal::GetStatistics(journal_stats& stats)
+{
+	MutexLocker locker(fEntriesLock);
+	stats = fStats;
+}
+
+
 status_t
 Journal::Lock(Transaction* owner, bool separateSubTransactions)
 {
@@ -1066,6 +1205,11 @@ Journal::_TransactionDone(bool success)
 		return B_OK;
 	}
 
+	mutex_lock(&fEntriesLock);
+	fLastTransaction++;
+	fStats.transactions++;
+	mutex_unlock(&fEntriesLock);
+
 	// Up to a maximum size, we will just batch several
 	// transactions together to improve speed
 	uint32 size = _TransactionSize();
@@ -1079,16 +1223,64 @@ Journal::_TransactionDone(bool success)
 		return B_OK;
 	}
 
+	fUnwrittenTransactions++;
 	return _WriteTransactionToLog();
 }
 
 
+/*!	Updates the statistics, and remembers which transactions are safely in
+	the log now. If the current sub-transaction has been \a detached, the
+	last transaction is still pending.
+	If \a blocks is zero, nothing has been written.
+*/
+void
+Journal::_TransactionsLogged(bool detached, uint32 blocks,
+	bigtime_t startTime)
+{
+	MutexLocker locker(fEntriesLock);
+
+	fLastLoggedTransaction = detached ? fLastTransaction - 1 : fLastTransaction;
+
+	if (blocks == 0)
+		return;
+
+	int32 batchSize = detached
+		? fUnwrittenTransactions - 1 : fUnwrittenTransactions;
+
+	fStats.log_writes++;
+	fStats.log_blocks += blocks;
+	add_to_histogram(fStats.batch_sizes, BFS_JOURNAL_BATCH_SLOTS, batchSize);
+	add_to_histogram(fStats.write_latency, BFS_JOURNAL_LATENCY_SLOTS,
+		system_time() - startTime);
+}
+
+
 //	#pragma mark - debugger commands
 
 
 #ifdef BFS_DEBUGGER_COMMANDS
 
 
+static void
+dump_histogram(const char* name, const uint64* histogram, int32 slots)
+{
+	kprintf("%s:\n", name);
+
+	for (int32 i = 0; i < slots; i++) {
+		if (histogram[i] == 0)
+			continue;
+
+		if (i == slots - 1) {
+			kprintf("  %10" B_PRIu64 "+          %" B_PRIu64 "\n",
+				i == 0 ? 0 : 1ULL << i, histogram[i]);
+		} else {
+			kprintf("  %10" B_PRIu64 " - %-8" B_PRIu64 " %" B_PRIu64 "\n",
+				i == 0 ? 0 : 1ULL << i, (2ULL << i) - 1, histogram[i]);
+		}
+	}
+}
+
+
 void
 Journal::Dump()
 {
@@ -1104,6 +1296,20 @@ Journal::Dump()
 	kprintf("  transaction ID:       %" B_PRId32 "\n", fTransactionID);
 	kprintf("  has subtransaction:   %d\n", fHasSubtransaction);
 	kprintf("  separate sub-trans.:  %d\n", fSeparateSubTransactions);
+	kprintf("  last transaction:     %" B_PRId64 "\n", fLastTransaction);
+	kprintf("  last logged:          %" B_PRId64 "\n", fLastLoggedTransaction);
+	kprintf("  transactions:         %" B_PRIu64 "\n", fStats.transactions);
+	kprintf("  log writes:           %" B_PRIu64 "\n", fStats.log_writes);
+	kprintf("  log blocks:           %" B_PRIu64 "\n", fStats.log_blocks);
+	kprintf("  commits:              %" B_PRIu64 "\n", fStats.commits);
+
+	dump_histogram("transactions per log write", fStats.batch_sizes,
+		BFS_JOURNAL_BATCH_SLOTS);
+	dump_histogram("log write latency (us)", fStats.write_latency,
+		BFS_JOURNAL_LATENCY_SLOTS);
+	dump_histogram("commit latency (us)", fStats.commit_latency,
+		BFS_JOURNAL_LATENCY_SLOTS);
+
 	kprintf("entries:\n");
 	kprintf("  address        id  start length\n");
 
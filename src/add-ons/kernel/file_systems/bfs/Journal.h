@@ -8,6 +8,7 @@
 
 #include "system_dependencies.h"
 
+#include "bfs_control.h"
 #include "Volume.h"
 #include "Utility.h"
 
@@ -36,6 +37,8 @@ public:
 			bool			CurrentTransactionTooLarge() const;
 
 			status_t		FlushLogAndBlocks();
+			status_t		Commit();
+			void			GetStatistics(journal_stats& stats);
 			Volume*			GetVolume() const { return fVolume; }
 			int32			TransactionID() const { return fTransactionID; }
 
@@ -55,6 +58,8 @@ private:
 			status_t		_CheckRunArray(const run_array* array);
 			status_t		_ReplayRunArray(int32* start);
 			status_t		_TransactionDone(bool success);
+			void			_TransactionsLogged(bool detached,
+								uint32 blocks, bigtime_t startTime);
 
 	static	void			_TransactionWritten(int32 transactionID,
 								int32 event, void* _logEntry);
@@ -71,7 +76,13 @@ private:
 			uint32			fUsed;
 			int32			fUnwrittenTransactions;
 			mutex			fEntriesLock;
+				// also protects the transaction counters, and the
+				// statistics
 			LogEntryList	fEntries;
+			mutex			fCommitLock;
+			int64			fLastTransaction;
+			int64			fLastLoggedTransaction;
+			journal_stats	fStats;
 			bigtime_t		fTimestamp;
 			int32			fTransactionID;
 			bool			fHasSubtransaction;
@@ -79,6 +79,48 @@ union value {
 	char	String[INODE_FILE_NAME_LENGTH];
 };
 
+static const off_t kUnknownEstimate = 1LL << 48;
+	// the estimate for equations that cannot use their index
+static const int32 kMaxIntersectionNodes = 65536;
+static const off_t kMatchCost = 4;
+	// matching an equation against a loaded inode is regarded this much more
+	// expensive than reading an index entry
+
+
+/*!	An array of node IDs; only those added before the last call to Sort()
+	can be found by Contains().
+*/
+class NodeSet {
+public:
+						NodeSet();
+						~NodeSet();
+
+			status_t	Add(off_t node);
+			void		Sort();
+
+			bool		Contains(off_t node) const;
+			int32		Count() const { return fCount; }
+
+private:
+			off_t*		fNodes;
+			int32		fCount;
+			int32		fSortedCount;
+			int32		fSize;
+};
+
+
+/*!	What is already known about the entries of an index scan before the
+	rest of the expression is matched against them.
+*/
+struct scan_filter {
+	const NodeSet*	known;
+		// if not NULL, the entries in this set are known to match the
+		// intersection of the scanned equation
+	const NodeSet*	returned;
+		// if not NULL, the entries in this set were returned by an earlier
+		// scan
+};
+
 
 /*!	Abstract base class for the operator/equation classes.
 */
@@ -99,6 +141,7 @@ public:
 
 	virtual	void		CalculateScore(Index& index) = 0;
 	virtual	int32		Score() const = 0;
+	virtual	off_t		Estimate() const = 0;
 
 	virtual	status_t	InitCheck() = 0;
 
@@ -117,7 +160,8 @@ protected:
 	Although an Equation object is quite independent from the volume on which
 	the query is run, there are some dependencies that are produced while
 	querying:
-	The type/size of the value, the score, and if it has an index or not.
+	The type/size of the value, the score and estimate, and if it has an index
+	or not.
 	So you could run more than one query on the same volume, but it might return
 	wrong values when it runs concurrently on another volume.
 	That's not an issue right now, because we run single-threaded and don't use
@@ -138,13 +182,28 @@ public:
 							size_t size = 0);
 	virtual void		Complement();
 
+			status_t	MatchWithContext(Inode* inode, bool matchSelf,
+							Term* known = NULL);
+
 			status_t	PrepareQuery(Volume* volume, Index& index,
 							TreeIterator** iterator, bool queryNonIndexed);
 			status_t	GetNextMatching(Volume* volume, TreeIterator* iterator,
-							struct dirent* dirent, size_t bufferSize);
+							struct dirent* dirent, size_t bufferSize,
+							const scan_filter& filter);
+			status_t	CollectNodes(Volume* volume, Index& index,
+							NodeSet& nodes);
 
 	virtual	void		CalculateScore(Index &index);
 	virtual	int32		Score() const { return fScore; }
+	virtual	off_t		Estimate() const { return fEstimate; }
+
+			bool		HasIndex() const { return fHasIndex; }
+			bool		CanIntersect();
+			void		SetIntersection(Equation* equation)
+							{ fIntersection = equation; }
+			Equation*	Intersection() const { return fIntersection; }
+
+			void		Describe(char* buffer, size_t size) const;
 
 #ifdef DEBUG
 	virtual	void		PrintToStream();
@@ -159,6 +218,8 @@ private:
 			bool		CompareTo(const uint8* value, uint16 size);
 			uint8*		Value() const { return (uint8*)&fValue; }
 			status_t	MatchEmptyString();
+			bool		_IsBeyondRange(const uint8* key, uint16 keyLength);
+			void		_EstimateCount(Index& index);
 
 			char*		fAttribute;
 			char*		fString;
@@ -169,7 +230,9 @@ private:
 			bool		fIsSpecialTime;
 
 			int32		fScore;
+			off_t		fEstimate;
 			bool		fHasIndex;
+			Equation*	fIntersection;
 };
 
 
@@ -191,6 +254,7 @@ public:
 
 	virtual	void		CalculateScore(Index& index);
 	virtual	int32		Score() const;
+	virtual	off_t		Estimate() const;
 
 	virtual	status_t	InitCheck();
 
@@ -467,6 +531,98 @@ matchString(char* pattern, char* string)
 }
 
 
+static const char*
+operatorSymbol(int8 op)
+{
+	switch (op) {
+		case OP_EQUAL: return "==";
+		case OP_UNEQUAL: return "!=";
+		case OP_GREATER_THAN: return ">";
+		case OP_GREATER_THAN_OR_EQUAL: return ">=";
+		case OP_LESS_THAN: return "<";
+		case OP_LESS_THAN_OR_EQUAL: return "<=";
+	}
+	return "???";
+}
+
+
+static int
+compareNodes(const void* _a, const void* _b)
+{
+	off_t a = *(const off_t*)_a;
+	off_t b = *(const off_t*)_b;
+
+	if (a < b)
+		return -1;
+	return a > b ? 1 : 0;
+}
+
+
+//	#pragma mark -
+
+
+NodeSet::NodeSet()
+	:
+	fNodes(NULL),
+	fCount(0),
+	fSortedCount(0),
+	fSize(0)
+{
+}
+
+
+NodeSet::~NodeSet()
+{
+	free(fNodes);
+}
+
+
+status_t
+NodeSet::Add(off_t node)
+{
+	if (fCount == fSize) {
+		int32 size = max_c(fSize * 2, 256);
+		off_t* nodes = (off_t*)realloc(fNodes, size * sizeof(off_t));
+		if (nodes == NULL)
+			return B_NO_MEMORY;
+
+		fNodes = nodes;
+		fSize = size;
+	}
+
+	fNodes[fCount++] = node;
+	return B_OK;
+}
+
+
+void
+NodeSet::Sort()
+{
+	qsort(fNodes, fCount, sizeof(off_t), &compareNodes);
+	fSortedCount = fCount;
+}
+
+
+bool
+NodeSet::Contains(off_t node) const
+{
+	int32 first = 0;
+	int32 last = fSortedCount - 1;
+
+	while (first <= last) {
+		int32 i = (first + last) / 2;
+		if (fNodes[i] == node)
+			return true;
+
+		if (fNodes[i] < node)
+			first = i + 1;
+		else
+			last = i - 1;
+	}
+	return false;
+}
+
+
 //	#pragma mark -
 
 
@@ -475,7 +631,10 @@ Equation::Equation(char** expr)
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
-	fIsPattern(false)
+	fIsPattern(false),
+	fEstimate(kUnknownEstimate),
+	fHasIndex(false),
+	fIntersection(NULL)
 {
 	char* string = *expr;
 	char* start = string;
@@ -907,8 +1066,11 @@ Equation::CalculateScore(Index &index)
 	// As always, these values could be tuned and refined.
 	// And the code could also need some real world testing :-)
 
+	fEstimate = kUnknownEstimate;
+	fHasIndex = index.SetTo(fAttribute) == B_OK;
+
 	// do we have to operate on a "foreign" index?
-	if (fOp == OP_UNEQUAL || index.SetTo(fAttribute) < B_OK) {
+	if (fOp == OP_UNEQUAL || !fHasIndex) {
 		fScore = 0;
 		return;
 	}
@@ -932,6 +1094,103 @@ Equation::CalculateScore(Index &index)
 	// 2048 * 2048 == 4194304 is the maximum score (for an empty
 	// tree, since the header + 1 node are already 2048 bytes)
 	fScore = fScore * ((2048 * 1024LL) / index.Node()->Size());
+
+	_EstimateCount(index);
+}
+
+
+/*!	Estimates how many entries of the index match this equation, from the
+	key range it covers in the index' B+tree.
+	The index must already be set to the equation's attribute.
+*/
+void
+Equation::_EstimateCount(Index& index)
+{
+	BPlusTree* tree = index.Node()->Tree();
+	if (tree == NULL || ConvertValue(index.Type()) != B_OK)
+		return;
+
+	const uint8* lower = NULL;
+	const uint8* upper = NULL;
+	uint16 lowerLength = fSize;
+	uint16 upperLength = fSize;
+	bool lowerIncluded = fOp != OP_GREATER_THAN;
+	bool upperIncluded = fOp != OP_LESS_THAN;
+
+	if (fOp == OP_EQUAL || fOp == OP_GREATER_THAN
+		|| fOp == OP_GREATER_THAN_OR_EQUAL)
+		lower = Value();
+	if (fOp == OP_EQUAL || fOp == OP_LESS_THAN
+		|| fOp == OP_LESS_THAN_OR_EQUAL)
+		upper = Value();
+
+	union value end;
+	int64 lowerTime;
+	int64 upperTime;
+
+	if (fIsPattern) {
+		// only the part in front of the first pattern symbol limits the range
+		int32 prefixLength = min_c(getFirstPatternSymbol(fString),
+			(int32)fSize);
+		lower = upper = NULL;
+
+		if (prefixLength > 0) {
+			lower = Value();
+			lowerLength = prefixLength;
+			lowerIncluded = true;
+
+			memcpy(end.String, fValue.String, prefixLength);
+			if (++end.String[prefixLength - 1] != '\0') {
+				upper = (uint8*)&end;
+				upperLength = prefixLength;
+				upperIncluded = false;
+			}
+		}
+	} else if (fIsSpecialTime) {
+		// the index contains shifted values, and every unshifted value
+		// covers all of its lower bits
+		lowerTime = (fValue.Int64 + (lowerIncluded ? 0 : 1))
+			<< INODE_TIME_SHIFT;
+		upperTime = (fValue.Int64 + (upperIncluded ? 1 : 0))
+			<< INODE_TIME_SHIFT;
+		if (lower != NULL)
+			lower = (uint8*)&lowerTime;
+		if (upper != NULL)
+			upper = (uint8*)&upperTime;
+
+		lowerIncluded = true;
+		upperIncluded = false;
+	} else if (fType == B_STRING_TYPE && fSize == 0) {
+		// see PrepareQuery() for the empty string
+		lowerLength = upperLength = 1;
+	}
+
+	off_t count;
+	if (tree->EstimateRange(lower, lowerLength, lowerIncluded, upper,
+			upperLength, upperIncluded, count) == B_OK)
+		fEstimate = count;
+}
+
+
+/*!	Returns whether the nodes that match this equation can be collected
+	from its index.
+	Note, an index doesn't necessarily contain all matching nodes, for
+	example when it was created after the attribute had been written. So
+	the nodes in it are known to match, but those that are not cannot be
+	ruled out without matching the equation against their inodes.
+*/
+bool
+Equation::CanIntersect()
+{
+	return fEstimate != kUnknownEstimate;
+}
+
+
+void
+Equation::Describe(char* buffer, size_t size) const
+{
+	snprintf(buffer, size, "\"%s\" %s \"%s\"", fAttribute,
+		operatorSymbol(fOp), fString);
 }
 
 
@@ -1032,9 +1291,81 @@ Equation::PrepareQuery(Volume* /*volume*/, Index& index,
 }
 
 
+/*!	Returns true if none of the keys following \a key in the index can match
+	anymore, given that \a key itself didn't. Since we always start at the
+	beginning of the index (or the correct position), only some operations
+	need to be stopped if the entry doesn't fit.
+*/
+bool
+Equation::_IsBeyondRange(const uint8* key, uint16 keyLength)
+{
+	if (fOp == OP_LESS_THAN || fOp == OP_LESS_THAN_OR_EQUAL
+		|| (fOp == OP_EQUAL && !fIsPattern))
+		return true;
+
+	if (fOp == OP_EQUAL) {
+		// a pattern cannot match anymore once the keys no longer start with
+		// the part in front of its first pattern symbol
+		int32 prefixLength = min_c(getFirstPatternSymbol(fString),
+			(int32)fSize);
+		return prefixLength > 0 && (keyLength < prefixLength
+			|| memcmp(key, fValue.String, prefixLength) != 0);
+	}
+
+	return false;
+}
+
+
+/*!	Matches the inode against all terms that are combined with this
+	equation by an &&-operator, and therefore have to match as well.
+	If \a matchSelf is \c false, the equation itself is known to match
+	already, ie. through its index. The same goes for the \a known term.
+*/
+status_t
+Equation::MatchWithContext(Inode* inode, bool matchSelf, Term* known)
+{
+	status_t status = MATCH_OK;
+	if (matchSelf)
+		status = Match(inode);
+
+	// go up in the tree until a &&-operator is found, and check if the
+	// inode matches with the rest of the expression - we don't have to
+	// check ||-operators for that
+	Term* term = this;
+
+	while (term != NULL && status == MATCH_OK) {
+		Operator* parent = (Operator*)term->Parent();
+		if (parent == NULL)
+			break;
+
+		if (parent->Op() == OP_AND) {
+			// choose the other child of the parent
+			Term* other = parent->Right();
+			if (other == term)
+				other = parent->Left();
+
+			if (other == NULL) {
+				FATAL(("&&-operator has only one child... (parent = %p)\n",
+					parent));
+				break;
+			}
+			if (other != known)
+				status = other->Match(inode);
+			if (status < 0) {
+				REPORT_ERROR(status);
+				status = NO_MATCH;
+			}
+		}
+		term = (Term*)parent;
+	}
+
+	return status;
+}
+
+
 status_t
 Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
-	struct dirent* dirent, size_t bufferSize)
+	struct dirent* dirent, size_t bufferSize, const scan_filter& filter)
 {
 	while (true) {
 		union value indexValue;
@@ -1051,13 +1382,8 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 		// index for the equation
 		if (fHasIndex && duplicate < 2
 			&& !CompareTo((uint8*)&indexValue, keyLength)) {
-			// They aren't equal? Let the operation decide what to do. Since
-			// we always start at the beginning of the index (or the correct
-			// position), only some needs to be stopped if the entry doesn't
-			// fit.
-			if (fOp == OP_LESS_THAN
-				|| fOp == OP_LESS_THAN_OR_EQUAL
-				|| (fOp == OP_EQUAL && !fIsPattern))
+			// They aren't equal? Let the operation decide what to do.
+			if (_IsBeyondRange((uint8*)&indexValue, keyLength))
 				return B_ENTRY_NOT_FOUND;
 
 			if (duplicate > 0)
@@ -1065,6 +1391,11 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 			continue;
 		}
 
+		// the entries of earlier scans can be skipped without loading the
+		// inode
+		if (filter.returned != NULL && filter.returned->Contains(offset))
+			continue;
+
 		Vnode vnode(volume, offset);
 		Inode* inode;
 		if ((status = vnode.Get(&inode)) != B_OK) {
@@ -1084,39 +1415,13 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 		// query will do something similar (and we don't have
 		// to do it for root, either).
 
-		// go up in the tree until a &&-operator is found, and check if the
-		// inode matches with the rest of the expression - we don't have to
-		// check ||-operators for that
-		Term* term = this;
-		status = MATCH_OK;
+		// an entry in the index of the intersection doesn't need to be
+		// matched against it again
+		Term* known = NULL;
+		if (filter.known != NULL && filter.known->Contains(offset))
+			known = fIntersection;
 
-		if (!fHasIndex)
-			status = Match(inode);
-
-		while (term != NULL && status == MATCH_OK) {
-			Operator* parent = (Operator*)term->Parent();
-			if (parent == NULL)
-				break;
-
-			if (parent->Op() == OP_AND) {
-				// choose the other child of the parent
-				Term* other = parent->Right();
-				if (other == term)
-					other = parent->Left();
-
-				if (other == NULL) {
-					FATAL(("&&-operator has only one child... (parent = %p)\n",
-						parent));
-					break;
-				}
-				status = other->Match(inode);
-				if (status < 0) {
-					REPORT_ERROR(status);
-					status = NO_MATCH;
-				}
-			}
-			term = (Term*)parent;
-		}
+		status = MatchWithContext(inode, !fHasIndex, known);
 
 		if (status == MATCH_OK) {
 			dirent->d_dev = volume->ID();
@@ -1139,6 +1444,68 @@ Equation::GetNextMatching(Volume* volume, TreeIterator* iterator,
 }
 
 
+/*!	Adds all nodes whose index entries match this equation to \a nodes,
+	without loading any of their inodes, and sorts them.
+	Fails with \c B_BUFFER_OVERFLOW if there are too many of them to make
+	the intersection worthwhile.
+*/
+status_t
+Equation::CollectNodes(Volume* volume, Index& index, NodeSet& nodes)
+{
+	TreeIterator* iterator = NULL;
+	status_t status = PrepareQuery(volume, index, &iterator, false);
+	ObjectDeleter<TreeIterator> iteratorDeleter(iterator);
+
+	if (iterator == NULL)
+		return status != B_OK ? status : B_ERROR;
+	if (status == B_ENTRY_NOT_FOUND) {
+		// there is no matching entry at all
+		return B_OK;
+	}
+	if (status != B_OK)
+		return status;
+
+	bool matches = false;
+
+	while (true) {
+		union value indexValue;
+		uint16 keyLength;
+		uint16 duplicate;
+		off_t offset;
+
+		status = iterator->GetNextEntry(&indexValue, &keyLength,
+			(uint16)sizeof(indexValue), &offset, &duplicate);
+		if (status == B_ENTRY_NOT_FOUND)
+			break;
+		if (status != B_OK)
+			return status;
+
+		// all duplicates share the result of their first entry
+		if (duplicate < 2)
+			matches = CompareTo((uint8*)&indexValue, keyLength);
+
+		if (!matches) {
+			if (_IsBeyondRange((uint8*)&indexValue, keyLength))
+				break;
+
+			if (duplicate > 0)
+				iterator->SkipDuplicates();
+			continue;
+		}
+
+		if (nodes.Count() >= kMaxIntersectionNodes)
+			return B_BUFFER_OVERFLOW;
+
+		status = nodes.Add(offset);
+		if (status != B_OK)
+			return status;
+	}
+
+	nodes.Sort();
+	return B_OK;
+}
+
+
 //	#pragma mark -
 
 
@@ -1232,6 +1599,18 @@ Operator::Score() const
 }
 
 
+off_t
+Operator::Estimate() const
+{
+	// for OP_AND, only the more selective side has to be scanned, while
+	// OP_OR has to scan both
+	if (fOp == OP_AND)
+		return min_c(fLeft->Estimate(), fRight->Estimate());
+
+	return min_c(fLeft->Estimate() + fRight->Estimate(), kUnknownEstimate);
+}
+
+
 status_t
 Operator::InitCheck()
 {
@@ -1310,16 +1689,7 @@ Operator::PrintToStream()
 void
 Equation::PrintToStream()
 {
-	const char* symbol = "???";
-	switch (fOp) {
-		case OP_EQUAL: symbol = "=="; break;
-		case OP_UNEQUAL: symbol = "!="; break;
-		case OP_GREATER_THAN: symbol = ">"; break;
-		case OP_GREATER_THAN_OR_EQUAL: symbol = ">="; break;
-		case OP_LESS_THAN: symbol = "<"; break;
-		case OP_LESS_THAN_OR_EQUAL: symbol = "<="; break;
-	}
-	__out("[\"%s\" %s \"%s\"]", fAttribute, symbol, fString);
+	__out("[\"%s\" %s \"%s\"]", fAttribute, operatorSymbol(fOp), fString);
 }
 
 #endif	// DEBUG
@@ -1478,6 +1848,57 @@ Expression::InitCheck()
 //	#pragma mark -
 
 
+/*!	Finds the best equation to intersect the scan of \a equation with among
+	the equations that are combined with it by an &&-operator directly, as
+	only those can be left out by Equation::MatchWithContext().
+*/
+static void
+findIntersection(Equation* equation, Equation*& best)
+{
+	Term* term = equation;
+
+	while (Operator* parent = (Operator*)term->Parent()) {
+		Term* other = parent->Left() == term
+			? parent->Right() : parent->Left();
+
+		if (parent->Op() == OP_AND && other->Op() > OP_EQUATION) {
+			Equation* otherEquation = (Equation*)other;
+			if (otherEquation->CanIntersect() && (best == NULL
+					|| otherEquation->Estimate() < best->Estimate()))
+				best = otherEquation;
+		}
+		term = parent;
+	}
+}
+
+
+static bool
+hasContext(Equation* equation)
+{
+	for (Term* term = equation->Parent(); term != NULL;
+			term = term->Parent()) {
+		if (term->Op() == OP_AND)
+			return true;
+	}
+	return false;
+}
+
+
+static char*
+appendLine(char* buffer, const char* line)
+{
+	size_t length = strlcpy(buffer, line, B_FILE_NAME_LENGTH);
+	length = min_c(length, (size_t)B_FILE_NAME_LENGTH - 1);
+
+	buffer[length++] = '\n';
+	buffer[length] = '\0';
+	return buffer + length;
+}
+
+
+//	#pragma mark -
+
+
 Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	:
 	fVolume(volume),
@@ -1485,6 +1906,11 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	fCurrent(NULL),
 	fIterator(NULL),
 	fIndex(volume),
+	fNodes(NULL),
+	fReturned(NULL),
+	fNodeCount(0),
+	fExplanation(NULL),
+	fExplanationOffset(0),
 	fFlags(flags),
 	fPort(-1)
 {
@@ -1494,6 +1920,12 @@ Query::Query(Volume* volume, Expression* expression, uint32 flags)
 	if (volume == NULL || expression == NULL || expression->Root() == NULL)
 		return;
 
+	// the "name" index contains every node of the volume
+	if (fIndex.SetTo("name") == B_OK && fIndex.Node()->Tree() != NULL) {
+		fIndex.Node()->Tree()->EstimateRange(NULL, 0, true, NULL, 0, true,
+			fNodeCount);
+	}
+
 	// create index on the stack and delete it afterwards
 	fExpression->Root()->CalculateScore(fIndex);
 	fIndex.Unset();
@@ -1509,6 +1941,10 @@ Query::~Query()
 {
 	if ((fFlags & B_LIVE_QUERY) != 0)
 		fVolume->RemoveQuery(this);
+
+	delete fNodes;
+	delete fReturned;
+	free(fExplanation);
 }
 
 
@@ -1523,6 +1959,15 @@ Query::Rewind()
 	fIterator = NULL;
 	fCurrent = NULL;
 
+	delete fNodes;
+	fNodes = NULL;
+	delete fReturned;
+	fReturned = NULL;
+
+	free(fExplanation);
+	fExplanation = NULL;
+	fExplanationOffset = 0;
+
 	// put the whole expression on the stack
 
 	Stack<Term*> stack;
@@ -1537,9 +1982,14 @@ Query::Rewind()
 				stack.Push(op->Left());
 				stack.Push(op->Right());
 			} else {
-				// For OP_AND, we can use the scoring system to decide which
-				// path to add
-				if (op->Right()->Score() > op->Left()->Score())
+				// For OP_AND, only the path that is estimated to have the
+				// fewest matches is added; the scoring system decides if
+				// there is no difference
+				off_t left = op->Left()->Estimate();
+				off_t right = op->Right()->Estimate();
+
+				if (right < left || (right == left
+						&& op->Right()->Score() > op->Left()->Score()))
 					stack.Push(op->Right());
 				else
 					stack.Push(op->Left());
@@ -1549,6 +1999,26 @@ Query::Rewind()
 			FATAL(("Unknown term on stack or stack error"));
 	}
 
+	// Decide for every scan if its entries should be intersected with those
+	// of another index first
+	for (int32 i = 0; i < fStack.CountItems(); i++) {
+		Equation* equation = fStack.Array()[i];
+
+		Equation* other = NULL;
+		findIntersection(equation, other);
+
+		if (other != NULL
+			&& !_ShouldIntersect(equation->Estimate(), other->Estimate()))
+			other = NULL;
+
+		equation->SetIntersection(other);
+	}
+
+	// If there is more than one scan, the later ones must not return the
+	// entries of the earlier ones again
+	if (fStack.CountItems() > 1)
+		fReturned = new(std::nothrow) NodeSet;
+
 	return B_OK;
 }
 
@@ -1556,6 +2026,9 @@ Query::Rewind()
 status_t
 Query::GetNextEntry(struct dirent* dirent, size_t size)
 {
+	if ((fFlags & B_QUERY_EXPLAIN) != 0)
+		return _GetNextExplanation(dirent, size);
+
 	// If we don't have an equation to use yet/anymore, get a new one
 	// from the stack
 	while (true) {
@@ -1573,17 +2046,32 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 
 			if (status != B_OK)
 				return status;
+
+			_PrepareIntersection();
 		}
 		if (fCurrent == NULL)
 			RETURN_ERROR(B_ERROR);
 
+		scan_filter filter;
+		filter.known = fNodes;
+		filter.returned = fReturned;
+
 		status_t status = fCurrent->GetNextMatching(fVolume, fIterator, dirent,
-			size);
+			size, filter);
 		if (status != B_OK) {
 			delete fIterator;
 			fIterator = NULL;
 			fCurrent = NULL;
+
+			delete fNodes;
+			fNodes = NULL;
+
+			// the following scans must skip the entries of this one
+			if (fReturned != NULL)
+				fReturned->Sort();
 		} else {
+			_AddReturned(dirent->d_ino);
+
 			// only return if we have another entry
 			return B_OK;
 		}
@@ -1591,6 +2079,158 @@ Query::GetNextEntry(struct dirent* dirent, size_t size)
 }
 
 
+/*!	Intersecting the entries of a scan with the nodes of another index
+	costs reading all of that index' matching entries, but saves matching
+	the other equation against the inodes of those entries that are among
+	them. Assuming that both are independent, this is a fraction of
+	\a otherCount / fNodeCount of the scanned entries.
+*/
+bool
+Query::_ShouldIntersect(off_t scanCount, off_t otherCount) const
+{
+	if (otherCount > kMaxIntersectionNodes || fNodeCount <= 0)
+		return false;
+
+	scanCount = min_c(scanCount, fNodeCount);
+	off_t saved = scanCount * otherCount / fNodeCount;
+
+	return otherCount < saved * kMatchCost;
+}
+
+
+/*!	Remembers that \a node has been returned, as long as there are scans
+	left that would have to skip it. If there are too many of them, the
+	later scans may return some entries again.
+*/
+void
+Query::_AddReturned(ino_t node)
+{
+	if (fReturned == NULL || fStack.CountItems() == 0)
+		return;
+
+	if (fReturned->Count() >= kMaxIntersectionNodes
+		|| fReturned->Add(node) != B_OK) {
+		delete fReturned;
+		fReturned = NULL;
+	}
+}
+
+
+/*!	Collects the nodes the current scan is to be intersected with, if any.
+	If this fails, or if there turn out to be too many of them, the scan
+	just continues without.
+*/
+void
+Query::_PrepareIntersection()
+{
+	Equation* other = fCurrent->Intersection();
+	if (other == NULL)
+		return;
+
+	fNodes = new(std::nothrow) NodeSet;
+	if (fNodes == NULL)
+		return;
+
+	// fIndex is still in use by the current scan
+	Index index(fVolume);
+	if (other->CollectNodes(fVolume, index, *fNodes) != B_OK) {
+		delete fNodes;
+		fNodes = NULL;
+	}
+}
+
+
+/*!	Describes the plan of the query, as returned by B_QUERY_EXPLAIN queries
+	instead of the matching entries.
+*/
+status_t
+Query::_Explain()
+{
+	int32 count = fStack.CountItems();
+	size_t size = (4 * count + 1) * B_FILE_NAME_LENGTH + 1;
+
+	fExplanation = (char*)malloc(size);
+	if (fExplanation == NULL)
+		return B_NO_MEMORY;
+
+	char* buffer = fExplanation;
+	char line[B_FILE_NAME_LENGTH];
+	char equation[B_FILE_NAME_LENGTH];
+
+	snprintf(line, sizeof(line), "%" B_PRId32 " scan(s), about %" B_PRIdOFF
+		" nodes on the volume", count, fNodeCount);
+	buffer = appendLine(buffer, line);
+
+	// the stack is popped from the end
+	for (int32 i = count - 1; i >= 0; i--) {
+		Equation* current = fStack.Array()[i];
+		int32 scan = count - i;
+
+		current->Describe(equation, sizeof(equation));
+
+		if (current->Estimate() != kUnknownEstimate) {
+			snprintf(line, sizeof(line), "scan %" B_PRId32 ": index for %s, "
+				"about %" B_PRIdOFF " entries", scan, equation,
+				current->Estimate());
+		} else if (current->HasIndex()
+			|| (fFlags & B_QUERY_NON_INDEXED) != 0) {
+			snprintf(line, sizeof(line), "scan %" B_PRId32 ": all nodes for "
+				"%s, about %" B_PRIdOFF " entries", scan, equation, fNodeCount);
+		} else {
+			snprintf(line, sizeof(line), "scan %" B_PRId32 ": skipped, no "
+				"index for %s", scan, equation);
+			buffer = appendLine(buffer, line);
+			continue;
+		}
+		buffer = appendLine(buffer, line);
+
+		if (Equation* other = current->Intersection()) {
+			other->Describe(equation, sizeof(equation));
+			snprintf(line, sizeof(line), "  entries in the index for %s, about "
+				"%" B_PRIdOFF ", are known to match it", equation,
+				other->Estimate());
+			buffer = appendLine(buffer, line);
+		}
+		if (hasContext(current))
+			buffer = appendLine(buffer, "  match the remaining && terms");
+		if (scan > 1)
+			buffer = appendLine(buffer, "  skip the entries of earlier scans");
+	}
+
+	return B_OK;
+}
+
+
+status_t
+Query::_GetNextExplanation(struct dirent* dirent, size_t size)
+{
+	if (fExplanation == NULL) {
+		status_t status = _Explain();
+		if (status != B_OK)
+			return status;
+	}
+
+	const char* line = fExplanation + fExplanationOffset;
+	if (line[0] == '\0')
+		return B_ENTRY_NOT_FOUND;
+
+	size_t length = strchr(line, '\n') - line;
+	if (sizeof(struct dirent) + length + 1 > size)
+		return B_BUFFER_OVERFLOW;
+
+	dirent->d_dev = fVolume->ID();
+	dirent->d_ino = 0;
+	dirent->d_pdev = fVolume->ID();
+	dirent->d_pino = 0;
+	memcpy(dirent->d_name, line, length);
+	dirent->d_name[length] = '\0';
+	dirent->d_reclen = sizeof(struct dirent) + length;
+
+	fExplanationOffset += length + 1;
+	return B_OK;
+}
+
+
 void
 Query::SetLiveMode(port_id port, int32 token)
 {
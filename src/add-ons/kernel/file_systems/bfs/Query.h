@@ -13,6 +13,7 @@
 class Volume;
 class Term;
 class Equation;
+class NodeSet;
 class TreeIterator;
 class Query;
 
@@ -63,6 +64,15 @@ public:
 
 			Expression*		GetExpression() const { return fExpression; }
 
+private:
+			bool			_ShouldIntersect(off_t scanCount,
+								off_t otherCount) const;
+			void			_AddReturned(ino_t node);
+			void			_PrepareIntersection();
+			status_t		_Explain();
+			status_t		_GetNextExplanation(struct dirent* dirent,
+								size_t size);
+
 private:
 			Volume*			fVolume;
 			Expression*		fExpression;
@@ -70,6 +80,11 @@ private:
 			TreeIterator*	fIterator;
 			Index			fIndex;
 			Stack<Equation*> fStack;
+			NodeSet*		fNodes;
+			NodeSet*		fReturned;
+			off_t			fNodeCount;
+			char*			fExplanation;
+			size_t			fExplanationOffset;
 
 			uint32			fFlags;
 			port_id			fPort;
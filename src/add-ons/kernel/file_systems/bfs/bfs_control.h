@@ -97,5 +97,58 @@ struct check_control {
 /* check control magic value */
 #define BFS_IOCTL_CHECK_MAGIC	'BChk'
 
+/* ioctl to defragment the data stream of a single node while the volume
+ * is mounted; it uses a struct defragment_control as single parameter.
+ * Directories and indices are defragmented as well, their B+tree is then
+ * moved into a single block run.
+ */
+#define BFS_IOCTL_DEFRAGMENT_NODE	14205
+
+/* "magic", "flags", and "inode" must be set before calling
+ * BFS_IOCTL_DEFRAGMENT_NODE, the other fields are filled in.
+ */
+struct defragment_control {
+	uint32		magic;
+	uint32		flags;
+	ino_t		inode;
+	uint32		fragments_before;
+	uint32		fragments_after;
+	uint64		blocks_moved;
+	status_t	status;
+};
+
+/* values for the flags field */
+#define BFS_DEFRAGMENT_DRY_RUN	1
+	/* only counts the fragments, but doesn't move anything */
+
+/* defragment control magic value */
+#define BFS_IOCTL_DEFRAGMENT_MAGIC	'BDfg'
+
+/* ioctl to retrieve the statistics of the journal; it uses a struct
+ * journal_stats as single parameter.
+ */
+#define BFS_IOCTL_GET_JOURNAL_STATS	14206
+
+#define BFS_JOURNAL_BATCH_SLOTS		12
+#define BFS_JOURNAL_LATENCY_SLOTS	24
+
+/* Slot i of the histograms counts the values from 2^i to 2^(i + 1) - 1,
+ * the first slot includes zero, and the last one everything above.
+ * Latencies are measured in microseconds.
+ */
+struct journal_stats {
+	uint64		transactions;
+	uint64		log_writes;
+	uint64		log_blocks;
+	uint64		commits;
+		/* explicit requests to write the log, ie. fsync() */
+	uint64		batch_sizes[BFS_JOURNAL_BATCH_SLOTS];
+		/* transactions per log write */
+	uint64		write_latency[BFS_JOURNAL_LATENCY_SLOTS];
+		/* time to write the log, including the drive cache flush */
+	uint64		commit_latency[BFS_JOURNAL_LATENCY_SLOTS];
+		/* time an explicit commit waited for its transactions */
+};
+
 
 #endif	/* BFS_CONTROL_H */
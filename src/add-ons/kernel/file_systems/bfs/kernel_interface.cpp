@@ -583,6 +583,12 @@ bfs_lookup(fs_volume* _volume, fs_vnode* _directory, const char* file,
 		RETURN_ERROR(B_BAD_VALUE);
 
 	status = tree->Find((uint8*)file, (uint16)strlen(file), _vnodeID);
+	if (status == B_ENTRY_NOT_FOUND) {
+		// Remember that the entry doesn't exist; all code paths that create
+		// entries update the entry cache while holding the directory's
+		// write lock.
+		entry_cache_add_missing(volume->ID(), directory->ID(), file);
+	}
 	if (status != B_OK) {
 		//PRINT(("bfs_walk() could not find %Ld:\"%s\": %s\n", directory->BlockNumber(), file, strerror(status)));
 		return status;
@@ -613,6 +619,66 @@ bfs_get_vnode_name(fs_volume* _volume, fs_vnode* _node, char* buffer,
 }
 
 
+/*!	Moves the data stream of the node specified in the \a control structure
+	into a single block run, and fills in the statistics.
+*/
+static status_t
+defragment_node(Volume* volume, defragment_control& control)
+{
+	control.fragments_before = 0;
+	control.fragments_after = 0;
+	control.blocks_moved = 0;
+
+	if (volume->IsReadOnly() && (control.flags & BFS_DEFRAGMENT_DRY_RUN) == 0)
+		return B_READ_ONLY_DEVICE;
+	if (volume->IsCheckingThread())
+		return B_BUSY;
+
+	Vnode vnode(volume, control.inode);
+	Inode* inode;
+	status_t status = vnode.Get(&inode);
+	if (status != B_OK)
+		return status;
+
+	if ((control.flags & BFS_DEFRAGMENT_DRY_RUN) != 0) {
+		InodeReadLocker locker(inode);
+		status = inode->CountFragments(control.fragments_before);
+		control.fragments_after = control.fragments_before;
+		return status;
+	}
+
+	// Write back the file cache first, as Inode::Defragment() copies the
+	// data on the device; the page writer needs the inode lock to do this
+	if (inode->FileCache() != NULL) {
+		status = file_cache_sync(inode->FileCache());
+		if (status != B_OK)
+			return status;
+	}
+
+	Transaction transaction(volume, inode->BlockNumber());
+	inode->WriteLockInTransaction(transaction);
+
+	if (inode->IsDeleted())
+		return B_ENTRY_NOT_FOUND;
+
+	status = inode->CountFragments(control.fragments_before);
+	if (status != B_OK)
+		return status;
+
+	off_t blocksMoved;
+	status = inode->Defragment(transaction, blocksMoved);
+	if (status == B_OK)
+		status = transaction.Done();
+	if (status != B_OK)
+		return status;
+
+	control.blocks_moved = blocksMoved;
+
+	InodeReadLocker locker(inode);
+	return inode->CountFragments(control.fragments_after);
+}
+
+
 static status_t
 bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 	void* buffer, size_t bufferLength)
@@ -672,6 +738,30 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 
 			return status;
 		}
+		case BFS_IOCTL_DEFRAGMENT_NODE:
+		{
+			defragment_control control;
+			if (bufferLength != sizeof(defragment_control))
+				return B_BAD_VALUE;
+			if (user_memcpy(&control, buffer, sizeof(defragment_control))
+					!= B_OK)
+				return B_BAD_ADDRESS;
+			if (control.magic != BFS_IOCTL_DEFRAGMENT_MAGIC)
+				return B_BAD_VALUE;
+
+			control.status = defragment_node(volume, control);
+
+			return user_memcpy(buffer, &control, sizeof(defragment_control));
+		}
+		case BFS_IOCTL_GET_JOURNAL_STATS:
+		{
+			journal_stats stats;
+			if (bufferLength != sizeof(journal_stats))
+				return B_BAD_VALUE;
+
+			volume->GetJournal(0)->GetStatistics(stats);
+			return user_memcpy(buffer, &stats, sizeof(journal_stats));
+		}
 		case BFS_IOCTL_UPDATE_BOOT_BLOCK:
 		{
 			// let's makebootable (or anyone else) update the boot block
@@ -748,8 +838,15 @@ bfs_fsync(fs_volume* _volume, fs_vnode* _node)
 {
 	FUNCTION();
 
+	Volume* volume = (Volume*)_volume->private_volume;
 	Inode* inode = (Inode*)_node->private_node;
-	return inode->Sync();
+
+	status_t status = inode->Sync();
+	if (status != B_OK || volume->IsReadOnly())
+		return status;
+
+	// make sure the metadata changes made so far are in the log as well
+	return volume->GetJournal(0)->Commit();
 }
 
 
@@ -1892,6 +1989,23 @@ bfs_write_attr_stat(fs_volume* _volume, fs_vnode* file, void* cookie,
 }
 
 
+static status_t
+bfs_read_attrs(fs_volume* _volume, fs_vnode* _node, attr_vec* vecs,
+	size_t count)
+{
+	FUNCTION();
+
+	Inode* inode = (Inode*)_node->private_node;
+
+	status_t status = inode->CheckPermissions(R_OK);
+	if (status != B_OK)
+		return status;
+
+	inode->ReadAttributes(vecs, count);
+	return B_OK;
+}
+
+
 static status_t
 bfs_rename_attr(fs_volume* _volume, fs_vnode* fromFile, const char* fromName,
 	fs_vnode* toFile, const char* toName)
@@ -2455,7 +2569,18 @@ fs_vnode_ops gBFSVnodeOps = {
 	&bfs_remove_attr,
 
 	/* special nodes */
-	&bfs_create_special_node
+	&bfs_create_special_node,
+	NULL,	// get_super_vnode
+
+#ifndef BFS_SHELL
+	/* lock operations */
+	NULL,	// test_lock
+	NULL,	// acquire_lock
+	NULL,	// release_lock
+#endif
+
+	/* bulk attribute operations */
+	&bfs_read_attrs
 };
 
 static file_system_module_info sBeFileSystem = {
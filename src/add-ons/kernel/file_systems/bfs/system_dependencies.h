@@ -19,6 +19,7 @@
 #include <util/AutoLock.h>
 #include <util/DoublyLinkedList.h>
 #include <util/SinglyLinkedList.h>
+#include <util/SplayTree.h>
 #include <util/Stack.h>
 
 #include <ByteOrder.h>
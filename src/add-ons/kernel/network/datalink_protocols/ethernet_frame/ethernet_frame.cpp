@@ -13,6 +13,7 @@
 #include <net_datalink.h>
 #include <net_stack.h>
 #include <NetBufferUtilities.h>
+#include <NetUtilities.h>
 
 #include <ByteOrder.h>
 #include <KernelExport.h>
@@ -20,7 +21,10 @@
 #include <net/if.h>
 #include <net/if_types.h>
 #include <net/if_dl.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
 #include <new>
+#include <stddef.h>
 #include <string.h>
 
 
@@ -30,6 +34,23 @@ struct ethernet_frame_protocol : net_datalink_protocol {
 
 static const uint8 kBroadcastAddress[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 
+// The offloading we can do in software for devices that cannot do it
+static const uint32 kSoftwareOffload = NET_OFFLOAD_TCP_CHECKSUM
+	| NET_OFFLOAD_TCP_SEGMENTATION;
+
+// Ethernet, and maximum IPv4, and TCP headers
+static const size_t kMaxOffloadHeaderLength = ETHER_HEADER_LENGTH + 60 + 60;
+
+// TCP header fields we need to change per segment
+static const uint32 kTCPSequenceOffset = 4;
+static const uint32 kTCPHeaderLengthOffset = 12;
+static const uint32 kTCPFlagsOffset = 13;
+static const uint32 kTCPChecksumOffset = 16;
+static const uint32 kTCPMinHeaderLength = 20;
+static const uint8 kTCPFlagFinish = 0x01;
+static const uint8 kTCPFlagPush = 0x08;
+static const uint8 kTCPFlagCongestionWindowReduced = 0x80;
+
 struct net_buffer_module_info* gBufferModule;
 
 
@@ -137,6 +158,142 @@ ethernet_frame_uninit(net_datalink_protocol* protocol)
 }
 
 
+/*!	Computes the TCP checksum of the frame in \a buffer, whose TCP header
+	starts at \a tcpOffset, and writes it into the header.
+*/
+static status_t
+complete_tcp_checksum(net_buffer* buffer, const struct ip& ipHeader,
+	uint32 tcpOffset)
+{
+	uint16 tcpLength = buffer->size - tcpOffset;
+	uint16 sum = 0;
+	status_t status = gBufferModule->write(buffer,
+		tcpOffset + kTCPChecksumOffset, &sum, sizeof(sum));
+	if (status != B_OK)
+		return status;
+
+	Checksum checksum;
+	checksum << (uint32)ipHeader.ip_src.s_addr
+		<< (uint32)ipHeader.ip_dst.s_addr << (uint16)htons(IPPROTO_TCP)
+		<< (uint16)htons(tcpLength)
+		<< (uint16)gBufferModule->checksum(buffer, tcpOffset, tcpLength,
+			false);
+	sum = checksum;
+
+	return gBufferModule->write(buffer, tcpOffset + kTCPChecksumOffset, &sum,
+		sizeof(sum));
+}
+
+
+/*!	Does the offloading work for an IPv4/TCP frame that the device cannot do
+	itself: cuts the frame into segments of buffer::segment_size bytes, and
+	computes their checksums. The segments share the payload with \a buffer,
+	it is not copied.
+	If this succeeds, \a buffer has been freed.
+*/
+static status_t
+ethernet_frame_offload(net_datalink_protocol* protocol, net_buffer* buffer)
+{
+	uint8 header[kMaxOffloadHeaderLength];
+	size_t headerLength = min_c(buffer->size, sizeof(header));
+	status_t status = gBufferModule->read(buffer, 0, header, headerLength);
+	if (status != B_OK)
+		return status;
+
+	struct ip& ipHeader = *(struct ip*)(header + ETHER_HEADER_LENGTH);
+	uint32 tcpOffset = ETHER_HEADER_LENGTH + ipHeader.ip_hl * 4;
+	if (((ether_header*)header)->type != htons(ETHER_TYPE_IP)
+		|| ipHeader.ip_v != IPVERSION || ipHeader.ip_p != IPPROTO_TCP
+		|| tcpOffset + kTCPMinHeaderLength > headerLength)
+		return B_BAD_VALUE;
+
+	headerLength = tcpOffset
+		+ (header[tcpOffset + kTCPHeaderLengthOffset] >> 4) * 4;
+	if (headerLength > buffer->size)
+		return B_BAD_VALUE;
+
+	uint32 payload = buffer->size - headerLength;
+	uint32 segmentSize = buffer->segment_size;
+	if ((buffer->offload & NET_OFFLOAD_TCP_SEGMENTATION) == 0
+		|| segmentSize == 0 || payload <= segmentSize) {
+		// there is only the checksum left to do
+		buffer->offload = 0;
+		buffer->segment_size = 0;
+
+		status = complete_tcp_checksum(buffer, ipHeader, tcpOffset);
+		if (status != B_OK)
+			return status;
+
+		return protocol->next->module->send_data(protocol->next, buffer);
+	}
+
+	uint32 sequence = ntohl(*(uint32*)&header[tcpOffset + kTCPSequenceOffset]);
+	uint8 flags = header[tcpOffset + kTCPFlagsOffset];
+	uint16 id = ntohs(ipHeader.ip_id);
+		// IPv4 reserved consecutive IDs for all segments
+
+	for (uint32 offset = 0; offset < payload; offset += segmentSize) {
+		uint32 length = min_c(segmentSize, payload - offset);
+
+		// only the first segment may signal a reduced congestion window,
+		// and only the last one finishes the connection, or pushes the data
+		uint8 segmentFlags = flags;
+		if (offset > 0)
+			segmentFlags &= ~kTCPFlagCongestionWindowReduced;
+		if (offset + length < payload)
+			segmentFlags &= ~(kTCPFlagFinish | kTCPFlagPush);
+
+		ipHeader.ip_len = htons(headerLength - ETHER_HEADER_LENGTH + length);
+		ipHeader.ip_id = htons(id++);
+		ipHeader.ip_sum = 0;
+		*(uint32*)&header[tcpOffset + kTCPSequenceOffset]
+			= htonl(sequence + offset);
+		header[tcpOffset + kTCPFlagsOffset] = segmentFlags;
+
+		net_buffer* segment = gBufferModule->create(headerLength);
+		if (segment == NULL) {
+			status = B_NO_MEMORY;
+			break;
+		}
+
+		status = gBufferModule->append_cloned(segment, buffer,
+			headerLength + offset, length);
+		if (status == B_OK)
+			status = gBufferModule->prepend(segment, header, headerLength);
+		if (status == B_OK) {
+			uint16 ipChecksum = gBufferModule->checksum(segment,
+				ETHER_HEADER_LENGTH, tcpOffset - ETHER_HEADER_LENGTH, true);
+			status = gBufferModule->write(segment,
+				ETHER_HEADER_LENGTH + offsetof(struct ip, ip_sum), &ipChecksum,
+				sizeof(ipChecksum));
+		}
+		if (status == B_OK)
+			status = complete_tcp_checksum(segment, ipHeader, tcpOffset);
+		if (status == B_OK) {
+			memcpy(segment->source, buffer->source, buffer->source->sa_len);
+			memcpy(segment->destination, buffer->destination,
+				buffer->destination->sa_len);
+			segment->flags = buffer->flags;
+			segment->protocol = buffer->protocol;
+			segment->type = buffer->type;
+
+			status = protocol->next->module->send_data(protocol->next,
+				segment);
+		}
+		if (status != B_OK) {
+			gBufferModule->free(segment);
+			break;
+		}
+	}
+
+	if (status != B_OK)
+		return status;
+
+	gBufferModule->free(buffer);
+	return B_OK;
+}
+
+
 status_t
 ethernet_frame_send_data(net_datalink_protocol* protocol, net_buffer* buffer)
 {
@@ -162,6 +319,9 @@ ethernet_frame_send_data(net_datalink_protocol* protocol, net_buffer* buffer)
 	bufferHeader.Sync();
 		// make sure the framing is already written to the buffer at this point
 
+	if ((buffer->offload & ~protocol->interface->device->offload) != 0)
+		return ethernet_frame_offload(protocol, buffer);
+
 	return protocol->next->module->send_data(protocol->next, buffer);
 }
 
@@ -169,7 +329,13 @@ ethernet_frame_send_data(net_datalink_protocol* protocol, net_buffer* buffer)
 status_t
 ethernet_frame_up(net_datalink_protocol* protocol)
 {
-	return protocol->next->module->interface_up(protocol->next);
+	status_t status = protocol->next->module->interface_up(protocol->next);
+	if (status != B_OK)
+		return status;
+
+	// we can do what the device cannot do on its own
+	protocol->interface->offload |= kSoftwareOffload;
+	return B_OK;
 }
 
 
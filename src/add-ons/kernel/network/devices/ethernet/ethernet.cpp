@@ -37,6 +37,8 @@ struct ethernet_device : net_device, DoublyLinkedListLinkImpl<ethernet_device> {
 
 static const bigtime_t kLinkCheckInterval = 1000000;
 	// 1 second
+static const uint32 kMaxOffloadVecs = 64;
+	// enough for a 64 KB frame
 
 net_buffer_module_info *gBufferModule;
 static net_stack_module_info *sStackModule;
@@ -201,6 +203,18 @@ ethernet_up(net_device *_device)
 		sCheckList.Add(device);
 	}
 
+	uint32 offload;
+	if (ioctl(device->fd, ETHER_GET_OFFLOAD, &offload, sizeof(uint32)) < 0) {
+		// this call is optional as well
+		offload = 0;
+	}
+
+	device->offload = 0;
+	if ((offload & ETHER_OFFLOAD_TCP_CHECKSUM) != 0)
+		device->offload |= NET_OFFLOAD_TCP_CHECKSUM;
+	if ((offload & ETHER_OFFLOAD_TCP_SEGMENTATION) != 0)
+		device->offload |= NET_OFFLOAD_TCP_SEGMENTATION;
+
 	device->address.length = ETHER_ADDRESS_LENGTH;
 	device->mtu = device->frame_size - device->header_length;
 	return B_OK;
@@ -239,11 +253,50 @@ ethernet_control(net_device *_device, int32 op, void *argument,
 }
 
 
+/*!	Hands a frame that still needs offload processing to the driver. As such
+	a frame is usually larger than the frame size, it is passed on as is,
+	without being copied into a contiguous buffer.
+*/
+static status_t
+ethernet_send_offloaded(ethernet_device *device, net_buffer *buffer)
+{
+	iovec vecs[kMaxOffloadVecs];
+	uint32 count = gBufferModule->get_iovecs(buffer, vecs, kMaxOffloadVecs);
+	if (count < gBufferModule->count_iovecs(buffer))
+		return B_NOT_SUPPORTED;
+
+	ether_offload_frame frame;
+	frame.vecs = vecs;
+	frame.vec_count = count;
+	frame.offload = 0;
+	if ((buffer->offload & NET_OFFLOAD_TCP_CHECKSUM) != 0)
+		frame.offload |= ETHER_OFFLOAD_TCP_CHECKSUM;
+	if ((buffer->offload & NET_OFFLOAD_TCP_SEGMENTATION) != 0)
+		frame.offload |= ETHER_OFFLOAD_TCP_SEGMENTATION;
+	frame.segment_size = buffer->segment_size;
+
+	if (ioctl(device->fd, ETHER_SEND_OFFLOADED, &frame, sizeof(frame)) < 0) {
+		device->stats.send.errors++;
+		return errno;
+	}
+
+	// a segmented frame is only counted once
+	device->stats.send.packets++;
+	device->stats.send.bytes += buffer->size;
+
+	gBufferModule->free(buffer);
+	return B_OK;
+}
+
+
 status_t
 ethernet_send_data(net_device *_device, net_buffer *buffer)
 {
 	ethernet_device *device = (ethernet_device *)_device;
 
+	if (buffer->offload != 0)
+		return ethernet_send_offloaded(device, buffer);
+
 //dprintf("try to send ethernet packet of %lu bytes (flags %ld):\n", buffer->size, buffer->flags);
 	if (buffer->size > device->frame_size || buffer->size < ETHER_HEADER_LENGTH)
 		return B_BAD_VALUE;
@@ -1404,8 +1404,17 @@ ipv4_send_routed_data(net_protocol* _protocol, struct net_route* route,
 		header->header_length = sizeof(ipv4_header) / 4;
 		header->service_type = protocol ? protocol->service_type : 0;
 		header->total_length = htons(buffer->size);
-		header->id = htons(atomic_add(&sPacketID, 1));
 		header->fragment_offset = 0;
+
+		// A buffer that is cut into segments later on uses consecutive IDs
+		// for them; reserve at least one for each segment
+		int32 idCount = 1;
+		if ((buffer->offload & NET_OFFLOAD_TCP_SEGMENTATION) != 0
+			&& buffer->segment_size != 0) {
+			idCount = (buffer->size + buffer->segment_size - 1)
+				/ buffer->segment_size;
+		}
+		header->id = htons(atomic_add(&sPacketID, idCount));
 		if (protocol) {
 			header->time_to_live = (buffer->flags & MSG_MCAST) != 0
 				? protocol->multicast_time_to_live : protocol->time_to_live;
@@ -1455,8 +1464,10 @@ ipv4_send_routed_data(net_protocol* _protocol, struct net_route* route,
 		ntohl(destination.sin_addr.s_addr));
 
 	uint32 mtu = route->mtu ? route->mtu : interface->mtu;
-	if (buffer->size > mtu) {
-		// we need to fragment the packet
+	if (buffer->size > mtu
+		&& (buffer->offload & NET_OFFLOAD_TCP_SEGMENTATION) == 0) {
+		// we need to fragment the packet; segmented buffers are cut into
+		// pieces that fit by the interface instead
 		return send_fragments(protocol, route, buffer, mtu);
 	}
 
@@ -1569,8 +1580,14 @@ ipv4_get_mtu(net_protocol* protocol, const struct sockaddr* address)
 }
 
 
-status_t
-ipv4_receive_data(net_buffer* buffer)
+/*!	Checks the IPv4 header of a received \a buffer, and removes it. On
+	success, \a _module is set to the protocol the buffer has to be passed
+	on to, or \a buffer is set to \c NULL if it has already been consumed
+	(as a fragment, or a multicast packet). On failure, the caller has to free
+	the buffer.
+*/
+static status_t
+receive_header(net_buffer*& buffer, net_protocol_module_info*& _module)
 {
 	TRACE("ipv4_receive_data(%p [%ld bytes])", buffer, buffer->size);
 
@@ -1704,13 +1721,67 @@ ipv4_receive_data(net_buffer* buffer)
 		// for this multicast group.
 		deliver_multicast(module, buffer, false);
 		gBufferModule->free(buffer);
+		buffer = NULL;
 		return B_OK;
 	}
 
+	_module = module;
+	return B_OK;
+}
+
+
+status_t
+ipv4_receive_data(net_buffer* buffer)
+{
+	net_protocol_module_info* module;
+	status_t status = receive_header(buffer, module);
+	if (status != B_OK || buffer == NULL)
+		return status;
+
 	return module->receive_data(buffer);
 }
 
 
+/*!	Receives a batch of buffers: consecutive buffers for the same protocol
+	are passed on together, if the protocol supports it.
+*/
+void
+ipv4_receive_data_batch(net_buffer** buffers, uint32 count)
+{
+	net_protocol_module_info* batchModule = NULL;
+	uint32 batchCount = 0;
+
+	for (uint32 i = 0; i < count; i++) {
+		net_buffer* buffer = buffers[i];
+		net_protocol_module_info* module;
+		if (receive_header(buffer, module) != B_OK) {
+			gBufferModule->free(buffer);
+			continue;
+		}
+		if (buffer == NULL)
+			continue;
+
+		if (module->receive_data_batch == NULL) {
+			if (module->receive_data(buffer) != B_OK)
+				gBufferModule->free(buffer);
+			continue;
+		}
+
+		if (module != batchModule && batchCount > 0) {
+			batchModule->receive_data_batch(buffers, batchCount);
+			batchCount = 0;
+		}
+
+		// the batch can reuse the array, as it never gets ahead of us
+		batchModule = module;
+		buffers[batchCount++] = buffer;
+	}
+
+	if (batchCount > 0)
+		batchModule->receive_data_batch(buffers, batchCount);
+}
+
+
 status_t
 ipv4_deliver_data(net_protocol* _protocol, net_buffer* buffer)
 {
@@ -1961,7 +2032,8 @@ net_protocol_module_info gIPv4Module = {
 	NULL,		// process_ancillary_data()
 	ipv4_process_ancillary_data_no_container,
 	NULL,		// send_data_no_buffer()
-	NULL		// read_data_no_buffer()
+	NULL,		// read_data_no_buffer()
+	ipv4_receive_data_batch
 };
 
 module_dependency module_dependencies[] = {
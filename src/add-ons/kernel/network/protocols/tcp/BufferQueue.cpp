@@ -417,6 +417,68 @@ BufferQueue::Get(size_t bytes, bool remove, net_buffer **_buffer)
 }
 
 
+/*!	Fills \a sacks with the ranges of data that have been received after the
+	first hole in the queue, as needed for the SACK option (RFC 2018).
+	The range that contains \a recent, the most recently received segment,
+	comes first, the others follow in descending order. Returns the number
+	of ranges filled in.
+*/
+int
+BufferQueue::GetSackBlocks(tcp_sack* sacks, int maxCount,
+	tcp_sequence recent) const
+{
+	if (IsContiguous() || maxCount <= 0)
+		return 0;
+
+	if (maxCount > TCP_MAX_SACK_BLOCKS)
+		maxCount = TCP_MAX_SACK_BLOCKS;
+
+	tcp_sack others[TCP_MAX_SACK_BLOCKS];
+	int count = 0;
+	bool haveRecent = false;
+	tcp_sequence nextSequence = NextSequence();
+	tcp_sequence left = 0;
+	tcp_sequence right = 0;
+
+	SegmentList::ConstReverseIterator iterator = fList.GetReverseIterator();
+	net_buffer* buffer = iterator.Next();
+	while (buffer != NULL) {
+		// collect all adjacent buffers into a single range
+		left = buffer->sequence;
+		right = left + buffer->size;
+
+		while ((buffer = iterator.Next()) != NULL
+			&& buffer->sequence + buffer->size == left.Number()
+			&& tcp_sequence(buffer->sequence) >= nextSequence) {
+			left = buffer->sequence;
+		}
+
+		if (left < nextSequence)
+			break;
+
+		if (!haveRecent && recent >= left && recent < right) {
+			sacks[0].left_edge = left.Number();
+			sacks[0].right_edge = right.Number();
+			haveRecent = true;
+		} else if (count < maxCount) {
+			others[count].left_edge = left.Number();
+			others[count].right_edge = right.Number();
+			count++;
+		}
+
+		if ((haveRecent && count + 1 >= maxCount) || buffer == NULL
+			|| tcp_sequence(buffer->sequence) < nextSequence)
+			break;
+	}
+
+	int filled = haveRecent ? 1 : 0;
+	for (int i = 0; i < count && filled < maxCount; i++)
+		sacks[filled++] = others[i];
+
+	return filled;
+}
+
+
 size_t
 BufferQueue::Available(tcp_sequence sequence) const
 {
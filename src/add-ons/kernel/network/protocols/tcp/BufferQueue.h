@@ -36,6 +36,8 @@ public:
 									size_t bytes);
 			status_t			Get(size_t bytes, bool remove,
 									net_buffer** _buffer);
+			int					GetSackBlocks(tcp_sack* sacks, int maxCount,
+									tcp_sequence recent) const;
 
 			size_t				Available() const { return fContiguousBytes; }
 			size_t				Available(tcp_sequence sequence) const;
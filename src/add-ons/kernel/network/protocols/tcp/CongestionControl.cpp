@@ -0,0 +1,354 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "CongestionControl.h"
+
+#include <errno.h>
+#include <new>
+#include <string.h>
+
+#include <KernelExport.h>
+#include <OS.h>
+
+
+// References:
+//	- RFC 5681 - TCP Congestion Control
+//	- RFC 8312 - CUBIC for Fast Long-Distance Networks
+
+
+class RenoCongestionControl : public CongestionControl {
+public:
+	virtual	const char*			Name() const { return "reno"; }
+
+	virtual	void				Acknowledged(congestion_state& state,
+									uint32 bytes);
+	virtual	void				LossDetected(congestion_state& state);
+};
+
+
+/*!	Implements CUBIC as specified in RFC 8312, with C = 0.4 and beta = 0.7.
+	Since we cannot use floating point in the kernel, all computations are
+	done in bytes and milliseconds, with the constants folded into integer
+	factors.
+*/
+class CubicCongestionControl : public CongestionControl {
+public:
+								CubicCongestionControl();
+
+	virtual	const char*			Name() const { return "cubic"; }
+
+	virtual	void				Init(congestion_state& state);
+	virtual	void				Acknowledged(congestion_state& state,
+									uint32 bytes);
+	virtual	void				LossDetected(congestion_state& state);
+	virtual	void				RetransmitTimeout(congestion_state& state);
+
+	virtual	void				Dump() const;
+
+private:
+			void				_StartEpoch(const congestion_state& state,
+									bigtime_t now);
+
+private:
+			bigtime_t			fEpochStart;
+			uint32				fMaxWindow;
+			uint32				fOriginWindow;
+			uint32				fTimeToOrigin;
+			uint32				fFriendlyWindow;
+			uint64				fAcknowledgedBytes;
+};
+
+
+struct congestion_control_info {
+	const char*			name;
+	CongestionControl*	(*create)();
+};
+
+
+// The time in milliseconds after which the cubic function stops growing;
+// this keeps its third power within 64 bit.
+static const int64 kMaxCubicTime = 1 << 20;
+
+
+template<typename Algorithm> static CongestionControl*
+create_algorithm()
+{
+	return new(std::nothrow) Algorithm;
+}
+
+
+static const congestion_control_info kCongestionControls[] = {
+	// the first entry is the default
+	{"cubic", &create_algorithm<CubicCongestionControl>},
+	{"reno", &create_algorithm<RenoCongestionControl>},
+};
+static const size_t kCongestionControlCount
+	= sizeof(kCongestionControls) / sizeof(kCongestionControls[0]);
+
+
+static uint32
+cube_root(uint64 value)
+{
+	uint64 root = 0;
+	for (int32 shift = 63; shift >= 0; shift -= 3) {
+		root <<= 1;
+		uint64 bit = 3 * root * (root + 1) + 1;
+		if ((value >> shift) >= bit) {
+			value -= bit << shift;
+			root++;
+		}
+	}
+
+	return (uint32)root;
+}
+
+
+/*!	Returns C * t^3 in bytes, with \a time given in milliseconds. With
+	C = 0.4 segments/s^3, this is 4 * t^3 / 10^10 segments.
+*/
+static int64
+cubic_offset(int64 time, uint32 maxSegmentSize)
+{
+	bool negative = time < 0;
+	uint64 t = negative ? -time : time;
+	if (t > (uint64)kMaxCubicTime)
+		t = kMaxCubicTime;
+
+	uint64 offset = t * t * t * 4 / 1000000 * maxSegmentSize / 10000;
+	return negative ? -(int64)offset : (int64)offset;
+}
+
+
+//	#pragma mark - CongestionControl
+
+
+CongestionControl::~CongestionControl()
+{
+}
+
+
+void
+CongestionControl::Init(congestion_state& state)
+{
+	state.window = 2 * state.max_segment_size;
+}
+
+
+void
+CongestionControl::RetransmitTimeout(congestion_state& state)
+{
+	state.slow_start_threshold = max_c(state.flight_size / 2,
+		2 * state.max_segment_size);
+	state.window = state.max_segment_size;
+}
+
+
+void
+CongestionControl::Dump() const
+{
+}
+
+
+//	#pragma mark - Reno
+
+
+void
+RenoCongestionControl::Acknowledged(congestion_state& state, uint32 bytes)
+{
+	if (state.window < state.slow_start_threshold) {
+		state.window += min_c(bytes, state.max_segment_size);
+		return;
+	}
+
+	uint32 increment = state.max_segment_size * state.max_segment_size;
+	if (increment < state.window)
+		increment = 1;
+	else
+		increment /= state.window;
+
+	state.window += increment;
+}
+
+
+void
+RenoCongestionControl::LossDetected(congestion_state& state)
+{
+	state.slow_start_threshold = max_c(state.flight_size / 2,
+		2 * state.max_segment_size);
+	state.window = state.slow_start_threshold;
+}
+
+
+//	#pragma mark - CUBIC
+
+
+CubicCongestionControl::CubicCongestionControl()
+	:
+	fEpochStart(0),
+	fMaxWindow(0),
+	fOriginWindow(0),
+	fTimeToOrigin(0),
+	fFriendlyWindow(0),
+	fAcknowledgedBytes(0)
+{
+}
+
+
+void
+CubicCongestionControl::Init(congestion_state& state)
+{
+	CongestionControl::Init(state);
+
+	fEpochStart = 0;
+	fMaxWindow = 0;
+}
+
+
+void
+CubicCongestionControl::Acknowledged(congestion_state& state, uint32 bytes)
+{
+	uint32 maxSegmentSize = state.max_segment_size;
+
+	if (state.window < state.slow_start_threshold) {
+		state.window += min_c(bytes, maxSegmentSize);
+		return;
+	}
+
+	bigtime_t now = system_time();
+	if (fEpochStart == 0)
+		_StartEpoch(state, now);
+
+	// The window the standard TCP algorithm would have by now; as long as
+	// it is larger than what CUBIC computes, we use that one instead
+	// (alpha = 3 * (1 - beta) / (1 + beta) = 9 / 17)
+	fFriendlyWindow += (uint64)9 * bytes * maxSegmentSize
+		/ (17 * (uint64)state.window);
+
+	// The window the cubic function reaches one round trip from now
+	int64 time = (now + state.round_trip_time - fEpochStart) / 1000
+		- fTimeToOrigin;
+	int64 target = (int64)fOriginWindow + cubic_offset(time, maxSegmentSize);
+
+	if (target < (int64)fFriendlyWindow) {
+		if (fFriendlyWindow > state.window)
+			state.window = fFriendlyWindow;
+		return;
+	}
+
+	// grow by at most half the window per round trip
+	if (target > (int64)state.window + state.window / 2)
+		target = (int64)state.window + state.window / 2;
+
+	// the number of acknowledged bytes it takes to grow by one segment
+	uint64 bytesPerSegment;
+	if (target > (int64)state.window) {
+		bytesPerSegment = (uint64)state.window * maxSegmentSize
+			/ (target - state.window);
+	} else
+		bytesPerSegment = 100 * (uint64)state.window;
+
+	fAcknowledgedBytes += bytes;
+	if (fAcknowledgedBytes >= bytesPerSegment) {
+		uint64 segments = fAcknowledgedBytes / bytesPerSegment;
+		state.window += segments * maxSegmentSize;
+		fAcknowledgedBytes -= segments * bytesPerSegment;
+	}
+}
+
+
+void
+CubicCongestionControl::LossDetected(congestion_state& state)
+{
+	fEpochStart = 0;
+
+	// fast convergence: if the window did not reach the previous maximum,
+	// release some more bandwidth for new flows
+	if (state.window < fMaxWindow)
+		fMaxWindow = (uint64)state.window * 17 / 20;
+	else
+		fMaxWindow = state.window;
+
+	uint32 threshold = (uint64)state.window * 7 / 10;
+	state.slow_start_threshold = max_c(threshold, 2 * state.max_segment_size);
+	state.window = state.slow_start_threshold;
+}
+
+
+void
+CubicCongestionControl::RetransmitTimeout(congestion_state& state)
+{
+	LossDetected(state);
+	state.window = state.max_segment_size;
+}
+
+
+void
+CubicCongestionControl::Dump() const
+{
+	kprintf("    epoch start: %" B_PRId64 "\n", fEpochStart);
+	kprintf("    max window: %" B_PRIu32 "\n", fMaxWindow);
+	kprintf("    origin window: %" B_PRIu32 ", reached after %" B_PRIu32
+		" ms\n", fOriginWindow, fTimeToOrigin);
+	kprintf("    friendly window: %" B_PRIu32 "\n", fFriendlyWindow);
+}
+
+
+void
+CubicCongestionControl::_StartEpoch(const congestion_state& state,
+	bigtime_t now)
+{
+	fEpochStart = now;
+	fFriendlyWindow = state.window;
+	fAcknowledgedBytes = 0;
+
+	if (state.window < fMaxWindow) {
+		// K = cbrt((W_max - cwnd) / C), in milliseconds
+		fTimeToOrigin = cube_root((uint64)(fMaxWindow - state.window)
+			* 2500000000ULL / state.max_segment_size);
+		fOriginWindow = fMaxWindow;
+	} else {
+		fTimeToOrigin = 0;
+		fOriginWindow = state.window;
+	}
+}
+
+
+//	#pragma mark -
+
+
+/*!	Creates the congestion control algorithm with the given \a name, or the
+	default one if \a name is \c NULL. The name does not need to be null
+	terminated, as it is passed in via setsockopt().
+*/
+status_t
+create_congestion_control(const char* name, size_t length,
+	CongestionControl** _algorithm)
+{
+	const congestion_control_info* info = NULL;
+
+	if (name == NULL)
+		info = &kCongestionControls[0];
+	else {
+		length = strnlen(name, length);
+
+		for (size_t i = 0; i < kCongestionControlCount; i++) {
+			if (strlen(kCongestionControls[i].name) == length
+				&& !strncmp(kCongestionControls[i].name, name, length)) {
+				info = &kCongestionControls[i];
+				break;
+			}
+		}
+		if (info == NULL)
+			return ENOENT;
+	}
+
+	CongestionControl* algorithm = info->create();
+	if (algorithm == NULL)
+		return B_NO_MEMORY;
+
+	*_algorithm = algorithm;
+	return B_OK;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef CONGESTION_CONTROL_H
+#define CONGESTION_CONTROL_H
+
+
+#include <SupportDefs.h>
+
+
+struct congestion_state {
+	uint32		window;
+	uint32		slow_start_threshold;
+
+	// filled in by the endpoint before every call
+	uint32		max_segment_size;
+	uint32		flight_size;
+	bigtime_t	round_trip_time;
+};
+
+
+/*!	A congestion control algorithm. Every endpoint owns its own instance, so
+	that an algorithm can keep per connection state.
+	The endpoint decides on when the window may grow, and when a segment is
+	to be considered lost, the algorithm only decides by how much the window
+	changes in either case.
+*/
+class CongestionControl {
+public:
+	virtual						~CongestionControl();
+
+	virtual	const char*			Name() const = 0;
+
+	virtual	void				Init(congestion_state& state);
+	virtual	void				Acknowledged(congestion_state& state,
+									uint32 bytes) = 0;
+	virtual	void				LossDetected(congestion_state& state) = 0;
+	virtual	void				RetransmitTimeout(congestion_state& state);
+
+	virtual	void				Dump() const;
+};
+
+
+status_t create_congestion_control(const char* name, size_t length,
+	CongestionControl** _algorithm);
+
+
+#endif	// CONGESTION_CONTROL_H
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "SackScoreboard.h"
+
+#include <KernelExport.h>
+
+
+// A segment is considered lost when at least this many segments above it
+// have been selectively acknowledged (DupThresh in RFC 6675).
+static const uint32 kDuplicateThreshold = 3;
+
+
+SackScoreboard::SackScoreboard()
+	:
+	fCount(0)
+{
+}
+
+
+/*!	Marks the range from \a start up to, but not including \a end as
+	received by the peer. Overlapping and adjacent ranges are merged.
+	If there is no room left, the highest range is forgotten.
+*/
+void
+SackScoreboard::Add(tcp_sequence start, tcp_sequence end)
+{
+	if (start >= end)
+		return;
+
+	// find the first range that does not end before the new one
+	int32 first = 0;
+	while (first < fCount && fRanges[first].end < start)
+		first++;
+
+	// merge all ranges that overlap with or touch the new one
+	int32 last = first;
+	while (last < fCount && fRanges[last].start <= end) {
+		if (fRanges[last].start < start)
+			start = fRanges[last].start;
+		if (fRanges[last].end > end)
+			end = fRanges[last].end;
+		last++;
+	}
+
+	int32 merged = last - first;
+	if (merged == 0) {
+		if (fCount == TCP_MAX_SACK_RANGES) {
+			if (first == fCount)
+				return;
+			fCount--;
+		}
+
+		for (int32 i = fCount; i > first; i--)
+			fRanges[i] = fRanges[i - 1];
+		fCount++;
+	} else if (merged > 1) {
+		for (int32 i = last; i < fCount; i++)
+			fRanges[i - merged + 1] = fRanges[i];
+		fCount -= merged - 1;
+	}
+
+	fRanges[first].start = start;
+	fRanges[first].end = end;
+}
+
+
+/*!	Forgets about all data before \a sequence, as it has been cumulatively
+	acknowledged.
+*/
+void
+SackScoreboard::RemoveUntil(tcp_sequence sequence)
+{
+	int32 removed = 0;
+	while (removed < fCount && fRanges[removed].end <= sequence)
+		removed++;
+
+	if (removed > 0) {
+		for (int32 i = removed; i < fCount; i++)
+			fRanges[i - removed] = fRanges[i];
+		fCount -= removed;
+	}
+
+	if (fCount > 0 && fRanges[0].start < sequence)
+		fRanges[0].start = sequence;
+}
+
+
+/*!	Returns whether or not the data at \a sequence is considered lost, that
+	is if enough data above it has been selectively acknowledged.
+*/
+bool
+SackScoreboard::IsLost(tcp_sequence sequence, uint32 maxSegmentSize) const
+{
+	for (int32 i = 0; i < fCount; i++) {
+		if (sequence >= fRanges[i].start && sequence < fRanges[i].end)
+			return false;
+	}
+
+	tcp_sequence boundary;
+	return _LostBoundary(maxSegmentSize, boundary) && sequence < boundary;
+}
+
+
+/*!	Estimates the number of bytes that are still in flight (SetPipe() in
+	RFC 6675): all data that has neither been acknowledged, nor is considered
+	lost, plus all data that has been retransmitted.
+*/
+uint32
+SackScoreboard::Pipe(tcp_sequence unacknowledged, tcp_sequence sendMax,
+	tcp_sequence highRetransmit, uint32 maxSegmentSize) const
+{
+	tcp_sequence boundary;
+	bool hasLost = _LostBoundary(maxSegmentSize, boundary);
+	tcp_sequence holeStart = unacknowledged;
+	uint32 pipe = 0;
+
+	for (int32 i = 0; i <= fCount; i++) {
+		tcp_sequence holeEnd = i < fCount ? fRanges[i].start : sendMax;
+
+		if (holeEnd > holeStart) {
+			if (!hasLost || holeEnd > boundary)
+				pipe += (holeEnd - holeStart).Number();
+
+			if (highRetransmit > holeStart) {
+				tcp_sequence retransmitted = highRetransmit < holeEnd
+					? highRetransmit : holeEnd;
+				pipe += (retransmitted - holeStart).Number();
+			}
+		}
+
+		if (i < fCount)
+			holeStart = fRanges[i].end;
+	}
+
+	return pipe;
+}
+
+
+/*!	Finds the first range of lost data that starts at or after \a from
+	(NextSeg() rule 1 in RFC 6675). Returns \c false if there is none.
+*/
+bool
+SackScoreboard::NextLost(tcp_sequence from, tcp_sequence unacknowledged,
+	uint32 maxSegmentSize, tcp_sequence& _start, tcp_sequence& _end) const
+{
+	tcp_sequence boundary;
+	if (!_LostBoundary(maxSegmentSize, boundary))
+		return false;
+
+	tcp_sequence holeStart = unacknowledged;
+
+	for (int32 i = 0; i < fCount; i++) {
+		tcp_sequence holeEnd = fRanges[i].start;
+		if (holeEnd > boundary)
+			break;
+
+		if (holeEnd > from && holeEnd > holeStart) {
+			_start = holeStart > from ? holeStart : from;
+			_end = holeEnd;
+			return true;
+		}
+
+		holeStart = fRanges[i].end;
+	}
+
+	return false;
+}
+
+
+void
+SackScoreboard::Dump() const
+{
+	for (int32 i = 0; i < fCount; i++) {
+		kprintf("      %" B_PRId32 ". %" B_PRIu32 " - %" B_PRIu32 "\n", i + 1,
+			fRanges[i].start.Number(), fRanges[i].end.Number());
+	}
+}
+
+
+/*!	Determines the sequence below which all data that has not been
+	selectively acknowledged is considered lost: a hole is lost when more than
+	(DupThresh - 1) segments, or at least DupThresh ranges above it have been
+	acknowledged. Returns \c false if nothing is lost.
+*/
+bool
+SackScoreboard::_LostBoundary(uint32 maxSegmentSize,
+	tcp_sequence& _boundary) const
+{
+	uint32 bytes = 0;
+	for (int32 i = fCount; i-- > 0;) {
+		bytes += (fRanges[i].end - fRanges[i].start).Number();
+
+		if (bytes > (kDuplicateThreshold - 1) * maxSegmentSize
+			|| (uint32)(fCount - i) >= kDuplicateThreshold) {
+			_boundary = fRanges[i].start;
+			return true;
+		}
+	}
+
+	return false;
+}
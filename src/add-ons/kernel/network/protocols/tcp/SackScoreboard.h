@@ -0,0 +1,58 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef SACK_SCOREBOARD_H
+#define SACK_SCOREBOARD_H
+
+
+#include "tcp.h"
+
+
+#define TCP_MAX_SACK_RANGES	32
+
+
+/*!	Remembers which parts of the data in flight the peer has selectively
+	acknowledged, and derives from that which parts have been lost, as
+	described in RFC 6675.
+*/
+class SackScoreboard {
+public:
+								SackScoreboard();
+
+			void				Add(tcp_sequence start, tcp_sequence end);
+			void				RemoveUntil(tcp_sequence sequence);
+			void				Clear() { fCount = 0; }
+
+			bool				IsEmpty() const { return fCount == 0; }
+
+			bool				IsLost(tcp_sequence sequence,
+									uint32 maxSegmentSize) const;
+			uint32				Pipe(tcp_sequence unacknowledged,
+									tcp_sequence sendMax,
+									tcp_sequence highRetransmit,
+									uint32 maxSegmentSize) const;
+			bool				NextLost(tcp_sequence from,
+									tcp_sequence unacknowledged,
+									uint32 maxSegmentSize,
+									tcp_sequence& _start,
+									tcp_sequence& _end) const;
+
+			void				Dump() const;
+
+private:
+			struct range {
+				tcp_sequence	start;
+				tcp_sequence	end;
+			};
+
+			bool				_LostBoundary(uint32 maxSegmentSize,
+									tcp_sequence& _boundary) const;
+
+private:
+			range				fRanges[TCP_MAX_SACK_RANGES];
+			int32				fCount;
+};
+
+
+#endif	// SACK_SCOREBOARD_H
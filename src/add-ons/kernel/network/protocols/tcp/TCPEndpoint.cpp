@@ -24,6 +24,7 @@
 
 #include <net_buffer.h>
 #include <net_datalink.h>
+#include <net_device.h>
 #include <net_stat.h>
 #include <NetBufferUtilities.h>
 #include <NetUtilities.h>
@@ -41,15 +42,18 @@
 //  - RFC 793 - Transmission Control Protocol
 //  - RFC 813 - Window and Acknowledgement Strategy in TCP
 //	- RFC 1337 - TIME_WAIT Assassination Hazards in TCP
+//	- RFC 2018 - TCP Selective Acknowledgment Options
+//	- RFC 5681 - TCP Congestion Control
+//	- RFC 6582 - The NewReno Modification to TCP's Fast Recovery Algorithm
+//	- RFC 6675 - A Conservative Loss Recovery Algorithm Based on Selective
+//	  Acknowledgment (SACK) for TCP
 //
 // Things this implementation currently doesn't implement:
-//	- TCP Slow Start, Congestion Avoidance, Fast Retransmit, and Fast Recovery,
-//	  RFC 2001, RFC 2581, RFC 3042
-//	- NewReno Modification to TCP's Fast Recovery, RFC 2582
+//	- Limited Transmit, RFC 3042
 //	- Explicit Congestion Notification (ECN), RFC 3168
 //	- SYN-Cache
 //	- TCP Extensions for High Performance, RFC 1323
-//	- SACK, Selective Acknowledgment - RFC 2018, RFC 2883, RFC 3517
+//	- D-SACK, RFC 2883, and the rescue retransmission of RFC 6675
 //	- Forward RTO-Recovery, RFC 4138
 //	- Time-Wait hash instead of keeping sockets alive
 
@@ -73,7 +77,8 @@
 	dprintf("TCP PROBE %llu %s %s %ld snxt %lu suna %lu cw %lu sst %lu win %lu swin %lu smax-suna %lu savail %lu sqused %lu rto %llu\n", \
 		system_time(), PrintAddress(buffer->source), \
 		PrintAddress(buffer->destination), buffer->size, fSendNext.Number(), \
-		fSendUnacknowledged.Number(), fCongestionWindow, fSlowStartThreshold, \
+		fSendUnacknowledged.Number(), fCongestion.window, \
+		fCongestion.slow_start_threshold, \
 		window, fSendWindow, (fSendMax - fSendUnacknowledged).Number(), \
 		fSendQueue.Available(fSendNext), fSendQueue.Used(), fRetransmitTimeout)
 #else
@@ -265,12 +270,18 @@ enum {
 	FLAG_NO_RECEIVE				= 0x04,
 	FLAG_CLOSED					= 0x08,
 	FLAG_DELETE_ON_CLOSE		= 0x10,
-	FLAG_LOCAL					= 0x20
+	FLAG_LOCAL					= 0x20,
+	FLAG_OPTION_SACK			= 0x40,
+	FLAG_RECOVERY				= 0x80
 };
 
 
 static const int kTimestampFactor = 1024;
 
+// The most data we hand to an interface that cuts it into segments for us;
+// the IPv4 total length, including headers with options, must fit 16 bits
+static const uint32 kMaxSegmentationSize = 65535 - 60 - 60;
+
 
 static inline bigtime_t
 absolute_timeout(bigtime_t timeout)
@@ -429,24 +440,29 @@ TCPEndpoint::TCPEndpoint(net_socket* socket)
 	fSendQueue(socket->send.buffer_size),
 	fInitialSendSequence(0),
 	fDuplicateAcknowledgeCount(0),
+	fRecoveryPoint(0),
+	fHighRetransmit(0),
 	fRoute(NULL),
 	fReceiveNext(0),
 	fReceiveMaxAdvertised(0),
 	fReceiveWindow(socket->receive.buffer_size),
 	fReceiveMaxSegmentSize(TCP_DEFAULT_MAX_SEGMENT_SIZE),
 	fReceiveQueue(socket->receive.buffer_size),
+	fReceiveOutOfOrder(0),
 	fRoundTripTime(TCP_INITIAL_RTT / kTimestampFactor),
 	fRoundTripDeviation(TCP_INITIAL_RTT / kTimestampFactor),
 	fRetransmitTimeout(TCP_INITIAL_RTT),
 	fReceivedTimestamp(0),
-	fCongestionWindow(0),
-	fSlowStartThreshold(0),
+	fCongestionControl(NULL),
 	fState(CLOSED),
-	fFlags(FLAG_OPTION_WINDOW_SCALE | FLAG_OPTION_TIMESTAMP)
+	fFlags(FLAG_OPTION_WINDOW_SCALE | FLAG_OPTION_TIMESTAMP | FLAG_OPTION_SACK)
 {
 	// TODO: to be replaced with a real read/write locking strategy!
 	mutex_init(&fLock, "tcp lock");
 
+	memset(&fCongestion, 0, sizeof(fCongestion));
+	create_congestion_control(NULL, 0, &fCongestionControl);
+
 	gStackModule->init_timer(&fPersistTimer, TCPEndpoint::_PersistTimer, this);
 	gStackModule->init_timer(&fRetransmitTimer, TCPEndpoint::_RetransmitTimer,
 		this);
@@ -478,6 +494,8 @@ TCPEndpoint::~TCPEndpoint()
 	gStackModule->wait_for_timer(&fTimeWaitTimer);
 
 	gDatalinkModule->put_route(Domain(), fRoute);
+
+	delete fCongestionControl;
 }
 
 
@@ -490,6 +508,9 @@ TCPEndpoint::InitCheck() const
 	if (fSendList.InitCheck() < B_OK)
 		return fSendList.InitCheck();
 
+	if (fCongestionControl == NULL)
+		return B_NO_MEMORY;
+
 	return B_OK;
 }
 
@@ -1018,6 +1039,18 @@ TCPEndpoint::SetReceiveBufferSize(size_t length)
 status_t
 TCPEndpoint::GetOption(int option, void* _value, int* _length)
 {
+	if (option == TCP_CONGESTION) {
+		if (*_length <= 0)
+			return B_BAD_VALUE;
+
+		MutexLocker _(fLock);
+
+		const char* name = fCongestionControl->Name();
+		strlcpy((char*)_value, name, *_length);
+		*_length = min_c((int)strlen(name) + 1, *_length);
+		return B_OK;
+	}
+
 	if (*_length != sizeof(int))
 		return B_BAD_VALUE;
 
@@ -1044,6 +1077,14 @@ TCPEndpoint::GetOption(int option, void* _value, int* _length)
 status_t
 TCPEndpoint::SetOption(int option, const void* _value, int length)
 {
+	if (option == TCP_CONGESTION) {
+		if (length <= 0)
+			return B_BAD_VALUE;
+
+		MutexLocker _(fLock);
+		return _SetCongestionControl((const char*)_value, length);
+	}
+
 	if (option != TCP_NODELAY)
 		return B_BAD_VALUE;
 
@@ -1240,21 +1281,86 @@ TCPEndpoint::_HandleReset(status_t error)
 void
 TCPEndpoint::_DuplicateAcknowledge(tcp_segment_header &segment)
 {
-	if (++fDuplicateAcknowledgeCount < 3)
+	fDuplicateAcknowledgeCount++;
+
+	if ((fFlags & FLAG_RECOVERY) != 0) {
+		if ((fFlags & FLAG_OPTION_SACK) == 0) {
+			// every duplicate acknowledge means that another segment has
+			// left the network
+			fCongestion.window += fSendMaxSegmentSize;
+		}
+
+		_SendQueued();
+		return;
+	}
+
+	// With SACK, we might know about a loss before the third duplicate
+	// acknowledge has arrived
+	if (fDuplicateAcknowledgeCount < 3
+		&& ((fFlags & FLAG_OPTION_SACK) == 0
+			|| !fSackScoreboard.IsLost(fSendUnacknowledged,
+				fSendMaxSegmentSize)))
 		return;
 
-	if (fDuplicateAcknowledgeCount == 3) {
-		_ResetSlowStart();
-		fCongestionWindow = fSlowStartThreshold + 3
-			* fSendMaxSegmentSize;
-		fSendNext = segment.acknowledge;
-	} else if (fDuplicateAcknowledgeCount > 3)
-		fCongestionWindow += fSendMaxSegmentSize;
+	_EnterRecovery();
+}
+
+
+/*!	Enters fast recovery after a loss has been detected: the congestion
+	control algorithm reduces the window, and the first unacknowledged segment
+	is sent again right away. Without SACK, NewReno is used to recover from
+	the loss, with SACK, the scoreboard decides what to retransmit.
+*/
+void
+TCPEndpoint::_EnterRecovery()
+{
+	TRACE("_EnterRecovery(): lost %lu, recovery point %lu",
+		fSendUnacknowledged.Number(), fSendMax.Number());
+
+	fFlags |= FLAG_RECOVERY;
+	fRecoveryPoint = fSendMax;
+	fHighRetransmit = fSendUnacknowledged;
+
+	fCongestionControl->LossDetected(_CongestionState());
+	if ((fFlags & FLAG_OPTION_SACK) == 0)
+		fCongestion.window += 3 * fSendMaxSegmentSize;
+
+	uint32 length = fSendMaxSegmentSize;
+	if (_RetransmitSegment(fSendUnacknowledged, length) == B_OK)
+		fHighRetransmit = fSendUnacknowledged + length;
 
 	_SendQueued();
 }
 
 
+/*!	Updates the parts of the congestion state that the congestion control
+	algorithm does not maintain itself, and returns it.
+*/
+congestion_state&
+TCPEndpoint::_CongestionState()
+{
+	fCongestion.max_segment_size = fSendMaxSegmentSize;
+	fCongestion.flight_size = (fSendMax - fSendUnacknowledged).Number();
+	fCongestion.round_trip_time = (bigtime_t)fRoundTripTime / 8
+		* kTimestampFactor;
+	return fCongestion;
+}
+
+
+status_t
+TCPEndpoint::_SetCongestionControl(const char* name, size_t length)
+{
+	CongestionControl* algorithm;
+	status_t status = create_congestion_control(name, length, &algorithm);
+	if (status != B_OK)
+		return status;
+
+	delete fCongestionControl;
+	fCongestionControl = algorithm;
+	return B_OK;
+}
+
+
 void
 TCPEndpoint::_UpdateTimestamps(tcp_segment_header& segment,
 	size_t segmentLength)
@@ -1356,10 +1462,16 @@ TCPEndpoint::_PrepareReceivePath(tcp_segment_header& segment)
 			fReceivedTimestamp = segment.timestamp_value;
 		} else
 			fFlags &= ~FLAG_OPTION_TIMESTAMP;
+
+		if ((segment.options & TCP_SACK_PERMITTED) != 0)
+			fFlags |= FLAG_OPTION_SACK;
+		else
+			fFlags &= ~FLAG_OPTION_SACK;
 	}
 
-	fCongestionWindow = 2 * fSendMaxSegmentSize;
-	fSlowStartThreshold = (uint32)segment.advertised_window << fSendWindowShift;
+	fCongestion.slow_start_threshold = (uint32)segment.advertised_window
+		<< fSendWindowShift;
+	fCongestionControl->Init(_CongestionState());
 }
 
 
@@ -1406,6 +1518,12 @@ TCPEndpoint::_Spawn(TCPEndpoint* parent, tcp_segment_header& segment,
 	fOptions = parent->fOptions;
 	fAcceptSemaphore = parent->fAcceptSemaphore;
 
+	if (strcmp(parent->fCongestionControl->Name(),
+			fCongestionControl->Name()) != 0) {
+		_SetCongestionControl(parent->fCongestionControl->Name(),
+			TCP_CA_NAME_MAX);
+	}
+
 	_PrepareReceivePath(segment);
 
 	// send SYN+ACK
@@ -1501,7 +1619,8 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 		&& segment.AcknowledgeOnly()
 		&& fReceiveNext == segment.sequence
 		&& advertisedWindow > 0 && advertisedWindow == fSendWindow
-		&& fSendNext == fSendMax) {
+		&& fSendNext == fSendMax
+		&& segment.sack_count == 0) {
 		_UpdateTimestamps(segment, segmentLength);
 
 		if (segmentLength == 0) {
@@ -1628,6 +1747,7 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 	}
 #endif
 
+	uint32 previousWindow = fSendWindow;
 	fSendWindow = advertisedWindow;
 	if (advertisedWindow > fSendMaxWindow)
 		fSendMaxWindow = advertisedWindow;
@@ -1642,24 +1762,29 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 		if (fSendMax < segment.acknowledge)
 			return DROP | IMMEDIATE_ACKNOWLEDGE;
 
-		if (segment.acknowledge < fSendUnacknowledged) {
-			if (buffer->size == 0 && advertisedWindow == fSendWindow
-				&& (segment.flags & TCP_FLAG_FINISH) == 0) {
-				TRACE("Receive(): duplicate ack!");
-
-				_DuplicateAcknowledge(segment);
-			}
-
+		if (segment.acknowledge < fSendUnacknowledged)
 			return DROP;
-		} else {
-			// this segment acknowledges in flight data
 
-			if (fDuplicateAcknowledgeCount >= 3) {
-				// deflate the window.
-				fCongestionWindow = fSlowStartThreshold;
+		if ((fFlags & FLAG_OPTION_SACK) != 0) {
+			for (int i = 0; i < segment.sack_count; i++) {
+				// ignore anything outside of the data in flight, including
+				// D-SACK blocks (RFC 2883)
+				tcp_sequence left = segment.sacks[i].left_edge;
+				tcp_sequence right = segment.sacks[i].right_edge;
+				if (left >= segment.acknowledge && right <= fSendMax)
+					fSackScoreboard.Add(left, right);
 			}
+		}
 
-			fDuplicateAcknowledgeCount = 0;
+		if (segment.acknowledge == fSendUnacknowledged
+			&& fSendUnacknowledged != fSendMax && buffer->size == 0
+			&& advertisedWindow == previousWindow
+			&& (segment.flags & TCP_FLAG_FINISH) == 0) {
+			TRACE("Receive(): duplicate ack!");
+
+			_DuplicateAcknowledge(segment);
+		} else {
+			// this segment acknowledges in flight data, or updates the window
 
 			if (fSendMax == segment.acknowledge)
 				TRACE("Receive(): all inflight data ack'd!");
@@ -1708,9 +1833,17 @@ TCPEndpoint::_Receive(tcp_segment_header& segment, net_buffer* buffer)
 	uint32 bufferSize = buffer->size;
 
 	if ((bufferSize > 0 || (segment.flags & TCP_FLAG_FINISH) != 0)
-		&& _ShouldReceive())
+		&& _ShouldReceive()) {
+		if (bufferSize > 0 && (fReceiveNext != segment.sequence
+				|| !fReceiveQueue.IsContiguous())) {
+			// Data out of order, or data that fills a hole: the sender
+			// needs to know about it right away (RFC 5681, section 4.2)
+			fReceiveOutOfOrder = segment.sequence;
+			action |= IMMEDIATE_ACKNOWLEDGE;
+		}
+
 		notify = _AddData(segment, buffer);
-	else {
+	} else {
 		if ((fFlags & FLAG_NO_RECEIVE) != 0)
 			fReceiveNext += buffer->size;
 
@@ -1870,7 +2003,7 @@ TCPEndpoint::_ShouldSendSegment(tcp_segment_header& segment, uint32 length,
 		// - the buffer is at least larger than half of the maximum send window,
 		//   or
 		// - we're retransmitting data
-		if (length == segmentMaxSize
+		if (length >= segmentMaxSize
 			|| (fOptions & TCP_NODELAY) != 0
 			|| tcp_sequence(fSendNext + length) == fSendQueue.LastSequence()
 			|| (fSendMaxWindow > 0 && length >= fSendMaxWindow / 2))
@@ -1906,25 +2039,20 @@ TCPEndpoint::_ShouldSendSegment(tcp_segment_header& segment, uint32 length,
 status_t
 TCPEndpoint::_SendQueued(bool force)
 {
+	if ((fFlags & (FLAG_RECOVERY | FLAG_OPTION_SACK))
+			== (FLAG_RECOVERY | FLAG_OPTION_SACK))
+		_RetransmitLost();
+
 	return _SendQueued(force, fSendWindow);
 }
 
 
-/*!	Sends one or more TCP segments with the data waiting in the queue, or some
-	specific flags that need to be sent.
+/*!	Fills in the options, the advertised window, and the acknowledge number
+	of a segment that is about to be sent.
 */
-status_t
-TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
+void
+TCPEndpoint::_PrepareSegment(tcp_segment_header& segment)
 {
-	if (fRoute == NULL)
-		return B_ERROR;
-
-	// in passive state?
-	if (fState == LISTEN)
-		return B_ERROR;
-
-	tcp_segment_header segment(_CurrentFlags());
-
 	if ((fOptions & TCP_NOOPT) == 0) {
 		if ((fFlags & FLAG_OPTION_TIMESTAMP) != 0) {
 			segment.options |= TCP_HAS_TIMESTAMPS;
@@ -1940,6 +2068,16 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 				segment.options |= TCP_HAS_WINDOW_SCALE;
 				segment.window_shift = fReceiveWindowShift;
 			}
+			if ((fFlags & FLAG_OPTION_SACK) != 0)
+				segment.options |= TCP_SACK_PERMITTED;
+		}
+
+		if ((fFlags & FLAG_OPTION_SACK) != 0
+			&& (segment.flags & TCP_FLAG_ACKNOWLEDGE) != 0
+			&& (segment.flags & TCP_FLAG_SYNCHRONIZE) == 0) {
+			// tell the peer about the out of order data we have received
+			segment.sack_count = fReceiveQueue.GetSackBlocks(segment.sacks,
+				TCP_MAX_SACK_BLOCKS, fReceiveOutOfOrder);
 		}
 	}
 
@@ -1950,6 +2088,24 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		segment.advertised_window = min_c(TCP_MAX_WINDOW, availableBytes);
 
 	segment.acknowledge = fReceiveNext.Number();
+}
+
+
+/*!	Sends one or more TCP segments with the data waiting in the queue, or some
+	specific flags that need to be sent.
+*/
+status_t
+TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
+{
+	if (fRoute == NULL)
+		return B_ERROR;
+
+	// in passive state?
+	if (fState == LISTEN)
+		return B_ERROR;
+
+	tcp_segment_header segment(_CurrentFlags());
+	_PrepareSegment(segment);
 
 	// Process urgent data
 	if (fSendUrgentOffset > fSendNext) {
@@ -1962,9 +2118,6 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		segment.urgent_offset = 0;
 	}
 
-	if (fCongestionWindow > 0 && fCongestionWindow < sendWindow)
-		sendWindow = fCongestionWindow;
-
 	// fSendUnacknowledged
 	//  |    fSendNext      fSendMax
 	//  |        |              |
@@ -1988,6 +2141,24 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 	} else
 		sendWindow -= consumedWindow;
 
+	// During SACK based recovery, the congestion window limits the estimated
+	// amount of data in the network rather than the data sent since the
+	// last acknowledge (RFC 6675)
+	uint32 inFlight = consumedWindow;
+	if ((fFlags & (FLAG_RECOVERY | FLAG_OPTION_SACK))
+			== (FLAG_RECOVERY | FLAG_OPTION_SACK)) {
+		inFlight = fSackScoreboard.Pipe(fSendUnacknowledged, fSendMax,
+			fHighRetransmit, fSendMaxSegmentSize);
+	}
+
+	if (fCongestion.window > 0) {
+		uint32 congestionWindow = 0;
+		if (fCongestion.window > inFlight)
+			congestionWindow = fCongestion.window - inFlight;
+		if (congestionWindow < sendWindow)
+			sendWindow = congestionWindow;
+	}
+
 	if (force && sendWindow == 0 && fSendNext <= fSendQueue.LastSequence()) {
 		// send one byte of data to ask for a window update
 		// (triggered by the persist timer)
@@ -1997,10 +2168,31 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 	uint32 length = min_c(fSendQueue.Available(fSendNext), sendWindow);
 	tcp_sequence previousSendNext = fSendNext;
 
+	// If the interface can cut the data into segments, and compute their
+	// checksums, we leave that to it. The checksum of a single segment is
+	// only left to the device, though; if it cannot do it in hardware, we
+	// compute it here, as the framing would have to find the headers again
+	uint32 offload = 0;
+	uint32 checksumOffload = 0;
+	if ((fFlags & FLAG_LOCAL) == 0 && Domain()->family == AF_INET) {
+		net_interface* interface = fRoute->interface_address->interface;
+		offload = interface->offload
+			& (NET_OFFLOAD_TCP_CHECKSUM | NET_OFFLOAD_TCP_SEGMENTATION);
+		checksumOffload = interface->device->offload & offload
+			& NET_OFFLOAD_TCP_CHECKSUM;
+	}
+
 	do {
 		uint32 segmentMaxSize = fSendMaxSegmentSize
 			- tcp_options_length(segment);
 		uint32 segmentLength = min_c(length, segmentMaxSize);
+		if ((offload & NET_OFFLOAD_TCP_SEGMENTATION) != 0
+			&& length > segmentMaxSize
+			&& (segment.flags & (TCP_FLAG_SYNCHRONIZE | TCP_FLAG_URGENT))
+				== 0) {
+			segmentLength = min_c(length,
+				kMaxSegmentationSize / segmentMaxSize * segmentMaxSize);
+		}
 
 		if (fSendNext + segmentLength == fSendQueue.LastSequence()) {
 			if (state_needs_finish(fState))
@@ -2034,6 +2226,13 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		LocalAddress().CopyTo(buffer->source);
 		PeerAddress().CopyTo(buffer->destination);
 
+		buffer->offload = checksumOffload;
+		if (segmentLength > segmentMaxSize) {
+			buffer->offload
+				= NET_OFFLOAD_TCP_CHECKSUM | NET_OFFLOAD_TCP_SEGMENTATION;
+			buffer->segment_size = segmentMaxSize;
+		}
+
 		uint32 size = buffer->size;
 		segment.sequence = fSendNext.Number();
 
@@ -2043,7 +2242,7 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 			buffer, buffer->size, PrintAddress(buffer->source),
 			PrintAddress(buffer->destination), segment.flags, segment.sequence,
 			segment.acknowledge, segment.advertised_window,
-			fCongestionWindow, fSlowStartThreshold, segmentLength,
+			fCongestion.window, fCongestion.slow_start_threshold, segmentLength,
 			fSendQueue.FirstSequence().Number(),
 			fSendQueue.LastSequence().Number());
 		T(Send(this, segment, buffer, fSendQueue.FirstSequence(),
@@ -2062,7 +2261,7 @@ TCPEndpoint::_SendQueued(bool force, uint32 sendWindow)
 		// for local connections as the answer is directly handled
 
 		if (segment.flags & TCP_FLAG_SYNCHRONIZE) {
-			segment.options &= ~TCP_HAS_WINDOW_SCALE;
+			segment.options &= ~(TCP_HAS_WINDOW_SCALE | TCP_SACK_PERMITTED);
 			segment.max_segment_size = 0;
 			size++;
 		}
@@ -2162,8 +2361,11 @@ void
 TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 {
 	size_t previouslyUsed = fSendQueue.Used();
+	uint32 acknowledged = (tcp_sequence(segment.acknowledge)
+		- fSendUnacknowledged).Number();
 
 	fSendQueue.RemoveUntil(segment.acknowledge);
+	fSackScoreboard.RemoveUntil(segment.acknowledge);
 	fSendUnacknowledged = segment.acknowledge;
 
 	if (fSendNext < fSendUnacknowledged)
@@ -2171,6 +2373,8 @@ TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 
 	if (fSendUnacknowledged == fSendMax)
 		gStackModule->cancel_timer(&fRetransmitTimer);
+	else if (acknowledged > 0)
+		gStackModule->set_timer(&fRetransmitTimer, fRetransmitTimeout);
 
 	if (fSendQueue.Used() < previouslyUsed) {
 		// this ACK acknowledged data
@@ -2186,20 +2390,38 @@ TCPEndpoint::_Acknowledged(tcp_segment_header& segment)
 			fSendList.Signal();
 			gSocketModule->notify(socket, B_SELECT_WRITE, fSendQueue.Used());
 		}
-
-		if (fCongestionWindow < fSlowStartThreshold)
-			fCongestionWindow += fSendMaxSegmentSize;
 	}
 
-	if (fCongestionWindow >= fSlowStartThreshold) {
-		uint32 increment = fSendMaxSegmentSize * fSendMaxSegmentSize;
-
-		if (increment < fCongestionWindow)
-			increment = 1;
-		else
-			increment /= fCongestionWindow;
+	if (acknowledged > 0) {
+		fDuplicateAcknowledgeCount = 0;
+
+		if ((fFlags & FLAG_RECOVERY) == 0)
+			fCongestionControl->Acknowledged(_CongestionState(), acknowledged);
+		else if (fSendUnacknowledged >= fRecoveryPoint) {
+			// all data outstanding when the loss was detected has arrived;
+			// deflate the window
+			TRACE("_Acknowledged(): recovery done");
+			fFlags &= ~FLAG_RECOVERY;
+			fSackScoreboard.Clear();
+			fCongestion.window = fCongestion.slow_start_threshold;
+		} else if ((fFlags & FLAG_OPTION_SACK) == 0) {
+			// A partial acknowledge: the next segment has been lost as well
+			// (RFC 6582, section 3.2)
+			uint32 length = fSendMaxSegmentSize;
+			if (_RetransmitSegment(fSendUnacknowledged, length) == B_OK
+				&& fHighRetransmit < fSendUnacknowledged + length)
+				fHighRetransmit = fSendUnacknowledged + length;
+
+			if (fCongestion.window > acknowledged)
+				fCongestion.window -= acknowledged;
+			else
+				fCongestion.window = 0;
+			if (acknowledged >= fSendMaxSegmentSize)
+				fCongestion.window += fSendMaxSegmentSize;
+		}
 
-		fCongestionWindow += increment;
+		if (fHighRetransmit < fSendUnacknowledged)
+			fHighRetransmit = fSendUnacknowledged;
 	}
 
 	// if there is data left to be send, send it now
@@ -2212,12 +2434,121 @@ void
 TCPEndpoint::_Retransmit()
 {
 	TRACE("Retransmit()");
-	_ResetSlowStart();
+
+	fCongestionControl->RetransmitTimeout(_CongestionState());
+
+	// The peer may have dropped out of order data it has acknowledged
+	// selectively, so we start over from the first unacknowledged byte
+	fFlags &= ~FLAG_RECOVERY;
+	fDuplicateAcknowledgeCount = 0;
+	fSackScoreboard.Clear();
 	fSendNext = fSendUnacknowledged;
+	fHighRetransmit = fSendUnacknowledged;
 	_SendQueued();
 }
 
 
+/*!	Sends the segment starting at \a sequence once again, without changing
+	fSendNext. On input, \a length is the maximum number of bytes to send,
+	on return, it contains the number of bytes actually sent.
+*/
+status_t
+TCPEndpoint::_RetransmitSegment(tcp_sequence sequence, uint32& length)
+{
+	if (fRoute == NULL)
+		return B_ERROR;
+
+	tcp_segment_header segment(_CurrentFlags());
+	segment.urgent_offset = 0;
+	_PrepareSegment(segment);
+
+	uint32 segmentMaxSize = fSendMaxSegmentSize - tcp_options_length(segment);
+	if (length > segmentMaxSize)
+		length = segmentMaxSize;
+	if (sequence + length > fSendQueue.LastSequence())
+		length = (fSendQueue.LastSequence() - sequence).Number();
+
+	if (sequence + length == fSendQueue.LastSequence()
+		&& state_needs_finish(fState))
+		segment.flags |= TCP_FLAG_FINISH;
+
+	if (length == 0 && (segment.flags & TCP_FLAG_FINISH) == 0)
+		return B_BAD_VALUE;
+
+	net_buffer* buffer = gBufferModule->create(256);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = B_OK;
+	if (length > 0)
+		status = fSendQueue.Get(buffer, sequence, length);
+	if (status != B_OK) {
+		gBufferModule->free(buffer);
+		return status;
+	}
+
+	LocalAddress().CopyTo(buffer->source);
+	PeerAddress().CopyTo(buffer->destination);
+
+	segment.sequence = sequence.Number();
+
+	TRACE("_RetransmitSegment(): seq %lu, len %lu", segment.sequence, length);
+	T(Send(this, segment, buffer, fSendQueue.FirstSequence(),
+		fSendQueue.LastSequence()));
+
+	status = add_tcp_header(AddressModule(), segment, buffer);
+	if (status != B_OK) {
+		gBufferModule->free(buffer);
+		return status;
+	}
+
+	fReceiveMaxAdvertised = fReceiveNext
+		+ ((uint32)segment.advertised_window << fReceiveWindowShift);
+
+	status = next->module->send_routed_data(next, fRoute, buffer);
+	if (status != B_OK) {
+		gBufferModule->free(buffer);
+		return status;
+	}
+
+	if (segment.flags & TCP_FLAG_ACKNOWLEDGE)
+		fLastAcknowledgeSent = segment.acknowledge;
+
+	if (sequence == fSendUnacknowledged)
+		gStackModule->set_timer(&fRetransmitTimer, fRetransmitTimeout);
+
+	return B_OK;
+}
+
+
+/*!	Retransmits the data the SACK scoreboard considers lost, as long as the
+	congestion window allows for it (RFC 6675, section 5).
+*/
+void
+TCPEndpoint::_RetransmitLost()
+{
+	uint32 pipe = fSackScoreboard.Pipe(fSendUnacknowledged, fSendMax,
+		fHighRetransmit, fSendMaxSegmentSize);
+
+	while (pipe + fSendMaxSegmentSize <= fCongestion.window) {
+		tcp_sequence from = fHighRetransmit > fSendUnacknowledged
+			? fHighRetransmit : fSendUnacknowledged;
+		tcp_sequence start;
+		tcp_sequence end;
+		if (!fSackScoreboard.NextLost(from, fSendUnacknowledged,
+				fSendMaxSegmentSize, start, end))
+			break;
+
+		uint32 length = min_c((end - start).Number(), fSendMaxSegmentSize);
+		if (_RetransmitSegment(start, length) != B_OK || length == 0)
+			break;
+
+		fHighRetransmit = start + length;
+		pipe += length;
+	}
+}
+
+
 void
 TCPEndpoint::_UpdateRoundTripTime(int32 roundTripTime)
 {
@@ -2239,15 +2570,6 @@ TCPEndpoint::_UpdateRoundTripTime(int32 roundTripTime)
 }
 
 
-void
-TCPEndpoint::_ResetSlowStart()
-{
-	fSlowStartThreshold = max_c((fSendMax - fSendUnacknowledged).Number() / 2,
-		2 * fSendMaxSegmentSize);
-	fCongestionWindow = fSendMaxSegmentSize;
-}
-
-
 //	#pragma mark - timer
 
 
@@ -2373,7 +2695,15 @@ TCPEndpoint::Dump() const
 	kprintf("  round trip time: %" B_PRId32 " (deviation %" B_PRId32 ")\n",
 		fRoundTripTime, fRoundTripDeviation);
 	kprintf("  retransmit timeout: %" B_PRId64 "\n", fRetransmitTimeout);
-	kprintf("  congestion window: %" B_PRIu32 "\n", fCongestionWindow);
-	kprintf("  slow start threshold: %" B_PRIu32 "\n", fSlowStartThreshold);
+	kprintf("  congestion control: %s\n", fCongestionControl->Name());
+	fCongestionControl->Dump();
+	kprintf("  congestion window: %" B_PRIu32 "\n", fCongestion.window);
+	kprintf("  slow start threshold: %" B_PRIu32 "\n",
+		fCongestion.slow_start_threshold);
+	kprintf("  recovery point: %" B_PRIu32 " (%s)\n", fRecoveryPoint.Number(),
+		(fFlags & FLAG_RECOVERY) != 0 ? "in recovery" : "inactive");
+	kprintf("  high retransmit: %" B_PRIu32 "\n", fHighRetransmit.Number());
+	kprintf("  sack scoreboard:\n");
+	fSackScoreboard.Dump();
 }
 
@@ -12,7 +12,9 @@
 
 
 #include "BufferQueue.h"
+#include "CongestionControl.h"
 #include "EndpointManager.h"
+#include "SackScoreboard.h"
 #include "tcp.h"
 
 #include <ProtocolUtilities.h>
@@ -93,8 +95,12 @@ private:
 			bool		_ShouldSendSegment(tcp_segment_header& segment,
 							uint32 length, uint32 segmentMaxSize,
 							uint32 flightSize);
+			void		_PrepareSegment(tcp_segment_header& segment);
 			status_t	_SendQueued(bool force = false);
 			status_t	_SendQueued(bool force, uint32 sendWindow);
+			status_t	_RetransmitSegment(tcp_sequence sequence,
+							uint32& length);
+			void		_RetransmitLost();
 			int			_MaxSegmentSize(const struct sockaddr* address) const;
 			status_t	_Disconnect(bool closing);
 			ssize_t		_AvailableData() const;
@@ -123,8 +129,11 @@ private:
 			void		_Acknowledged(tcp_segment_header& segment);
 			void		_Retransmit();
 			void		_UpdateRoundTripTime(int32 roundTripTime);
-			void		_ResetSlowStart();
 			void		_DuplicateAcknowledge(tcp_segment_header& segment);
+			void		_EnterRecovery();
+			congestion_state& _CongestionState();
+			status_t	_SetCongestionControl(const char* name,
+							size_t length);
 
 	static	void		_TimeWaitTimer(net_timer* timer, void* _endpoint);
 	static	void		_RetransmitTimer(net_timer* timer, void* _endpoint);
@@ -160,6 +169,9 @@ private:
 	tcp_sequence	fLastAcknowledgeSent;
 	tcp_sequence	fInitialSendSequence;
 	uint32			fDuplicateAcknowledgeCount;
+	tcp_sequence	fRecoveryPoint;
+	tcp_sequence	fHighRetransmit;
+	SackScoreboard	fSackScoreboard;
 
 	net_route 		*fRoute;
 		// TODO: don't use a net_route, but a net_route_info!!!
@@ -173,6 +185,8 @@ private:
 	bool			fFinishReceived;
 	tcp_sequence	fFinishReceivedAt;
 	tcp_sequence	fInitialReceiveSequence;
+	tcp_sequence	fReceiveOutOfOrder;
+		// start of the most recent segment that arrived out of order
 
 	// round trip time and retransmit timeout computation
 	int32			fRoundTripTime;
@@ -181,8 +195,8 @@ private:
 
 	uint32			fReceivedTimestamp;
 
-	uint32			fCongestionWindow;
-	uint32			fSlowStartThreshold;
+	CongestionControl* fCongestionControl;
+	congestion_state fCongestion;
 
 	tcp_state		fState;
 	uint32			fFlags;
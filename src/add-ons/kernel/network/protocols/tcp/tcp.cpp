@@ -153,7 +153,11 @@ add_options(tcp_segment_header &segment, uint8 *buffer, size_t bufferSize)
 			bump_option(option, length);
 			option->kind = TCP_OPTION_SACK;
 			option->length = 2 + sackCount * sizeof(tcp_sack);
-			memcpy(option->sack, segment.sacks, sackCount * sizeof(tcp_sack));
+			for (int i = 0; i < sackCount; i++) {
+				option->sack[i].left_edge = htonl(segment.sacks[i].left_edge);
+				option->sack[i].right_edge
+					= htonl(segment.sacks[i].right_edge);
+			}
 			bump_option(option, length);
 		}
 	}
@@ -219,6 +223,22 @@ process_options(tcp_segment_header &segment, net_buffer *buffer, size_t size)
 				if (option->length == 2 && size >= 2)
 					segment.options |= TCP_SACK_PERMITTED;
 				break;
+			case TCP_OPTION_SACK:
+				if (option->length > 2 && option->length <= size
+					&& (option->length - 2) % sizeof(tcp_sack) == 0) {
+					// the options might be in a temporary buffer, so we need
+					// to copy the blocks
+					int count = min_c((option->length - 2) / sizeof(tcp_sack),
+						TCP_MAX_SACK_BLOCKS);
+					for (int i = 0; i < count; i++) {
+						segment.sacks[i].left_edge
+							= ntohl(option->sack[i].left_edge);
+						segment.sacks[i].right_edge
+							= ntohl(option->sack[i].right_edge);
+					}
+					segment.sack_count = count;
+				}
+				break;
 		}
 
 		if (length < 0) {
@@ -409,8 +429,14 @@ add_tcp_header(net_address_module_info* addressModule,
 		"win %u\n", buffer, segment.flags, segment.sequence,
 		segment.acknowledge, segment.urgent_offset, segment.advertised_window));
 
-	*TCPChecksumField(buffer) = Checksum::PseudoHeader(addressModule,
-		gBufferModule, buffer, IPPROTO_TCP);
+	if ((buffer->offload & NET_OFFLOAD_TCP_CHECKSUM) != 0) {
+		// the interface completes the checksum
+		*TCPChecksumField(buffer) = Checksum::PartialPseudoHeader(
+			addressModule, buffer, IPPROTO_TCP);
+	} else {
+		*TCPChecksumField(buffer) = Checksum::PseudoHeader(addressModule,
+			gBufferModule, buffer, IPPROTO_TCP);
+	}
 
 	return B_OK;
 }
@@ -656,8 +682,41 @@ tcp_get_mtu(net_protocol* protocol, const struct sockaddr* address)
 }
 
 
-status_t
-tcp_receive_data(net_buffer* buffer)
+/*!	Remembers the connection of the previous segment of a batch, so that the
+	following segments of an established connection don't have to look it up
+	again. It holds a reference to the socket of the endpoint.
+*/
+struct segment_cache {
+	segment_cache()
+		:
+		domain(NULL),
+		manager(NULL),
+		endpoint(NULL)
+	{
+	}
+
+	~segment_cache()
+	{
+		PutEndpoint();
+	}
+
+	void PutEndpoint()
+	{
+		if (endpoint != NULL)
+			gSocketModule->release_socket(endpoint->socket);
+		endpoint = NULL;
+	}
+
+	net_domain*			domain;
+	EndpointManager*	manager;
+	TCPEndpoint*		endpoint;
+	sockaddr_storage	source;
+	sockaddr_storage	destination;
+};
+
+
+static status_t
+receive_segment(net_buffer* buffer, segment_cache* cache)
 {
 	TRACE(("TCP: Received buffer %p\n", buffer));
 
@@ -701,7 +760,17 @@ tcp_receive_data(net_buffer* buffer)
 	bufferHeader.Remove(headerLength);
 		// we no longer need to keep the header around
 
-	EndpointManager* endpointManager = endpoint_manager_for(domain);
+	EndpointManager* endpointManager;
+	if (cache != NULL && cache->domain == domain)
+		endpointManager = cache->manager;
+	else {
+		endpointManager = endpoint_manager_for(domain);
+		if (cache != NULL) {
+			cache->PutEndpoint();
+			cache->domain = domain;
+			cache->manager = endpointManager;
+		}
+	}
 	if (endpointManager == NULL) {
 		TRACE(("  No endpoint manager!\n"));
 		return B_ERROR;
@@ -709,11 +778,40 @@ tcp_receive_data(net_buffer* buffer)
 
 	int32 segmentAction = DROP;
 
-	TCPEndpoint* endpoint = endpointManager->FindConnection(
-		buffer->destination, buffer->source);
+	// only plain segments of established connections may use the cache
+	bool cacheable = cache != NULL && (segment.flags
+		& (TCP_FLAG_SYNCHRONIZE | TCP_FLAG_FINISH | TCP_FLAG_RESET)) == 0;
+
+	TCPEndpoint* endpoint = NULL;
+	if (cacheable && cache->endpoint != NULL
+		&& addressModule->equal_addresses_and_ports(buffer->source,
+			(sockaddr*)&cache->source)
+		&& addressModule->equal_addresses_and_ports(buffer->destination,
+			(sockaddr*)&cache->destination)) {
+		endpoint = cache->endpoint;
+		cache->endpoint = NULL;
+	} else {
+		if (cache != NULL)
+			cache->PutEndpoint();
+
+		endpoint = endpointManager->FindConnection(buffer->destination,
+			buffer->source);
+	}
+
 	if (endpoint != NULL) {
+		if (cacheable) {
+			// the buffer might be gone after SegmentReceived()
+			memcpy(&cache->source, buffer->source, buffer->source->sa_len);
+			memcpy(&cache->destination, buffer->destination,
+				buffer->destination->sa_len);
+		}
+
 		segmentAction = endpoint->SegmentReceived(segment, buffer);
-		gSocketModule->release_socket(endpoint->socket);
+
+		if (cacheable && endpoint->State() == ESTABLISHED)
+			cache->endpoint = endpoint;
+		else
+			gSocketModule->release_socket(endpoint->socket);
 	} else if ((segment.flags & TCP_FLAG_RESET) == 0)
 		segmentAction = DROP | RESET;
 
@@ -728,6 +826,28 @@ tcp_receive_data(net_buffer* buffer)
 }
 
 
+status_t
+tcp_receive_data(net_buffer* buffer)
+{
+	return receive_segment(buffer, NULL);
+}
+
+
+/*!	Receives a batch of segments; consecutive segments of the same connection
+	only look up the endpoint once.
+*/
+void
+tcp_receive_data_batch(net_buffer** buffers, uint32 count)
+{
+	segment_cache cache;
+
+	for (uint32 i = 0; i < count; i++) {
+		if (receive_segment(buffers[i], &cache) != B_OK)
+			gBufferModule->free(buffers[i]);
+	}
+}
+
+
 status_t
 tcp_error_received(net_error error, net_buffer* data)
 {
@@ -868,7 +988,8 @@ net_protocol_module_info sTCPModule = {
 	NULL,		// process_ancillary_data()
 	NULL,		// process_ancillary_data_no_container()
 	NULL,		// send_data_no_buffer()
-	NULL		// read_data_no_buffer()
+	NULL,		// read_data_no_buffer()
+	tcp_receive_data_batch
 };
 
 module_dependency module_dependencies[] = {
@@ -218,6 +218,7 @@ enum tcp_option_kind {
 };
 
 #define TCP_MAX_WINDOW_SHIFT	14
+#define TCP_MAX_SACK_BLOCKS		4
 
 enum {
 	TCP_HAS_WINDOW_SCALE	= 1 << 0,
@@ -246,7 +247,8 @@ struct tcp_segment_header {
 	uint32	timestamp_value;
 	uint32	timestamp_reply;
 
-	tcp_sack	*sacks;
+	tcp_sack	sacks[TCP_MAX_SACK_BLOCKS];
+		// in host byte order
 	int			sack_count;
 
 	uint32	options;
@@ -172,6 +172,7 @@ public:
 	bool Put() { fEndpointCount--; return fEndpointCount == 0; }
 
 	status_t DemuxIncomingBuffer(net_buffer* buffer);
+	uint32 DemuxIncomingBuffers(net_buffer** buffers, uint32 count);
 	status_t DeliverError(status_t error, net_buffer* buffer);
 
 	status_t BindEndpoint(UdpEndpoint *endpoint, const sockaddr *address);
@@ -224,6 +225,8 @@ public:
 			status_t			InitCheck() const;
 
 			status_t			ReceiveData(net_buffer* buffer);
+			void				ReceiveData(net_buffer** buffers,
+									uint32 count);
 			status_t			ReceiveError(status_t error,
 									net_buffer* buffer);
 			status_t			Deframe(net_buffer* buffer);
@@ -238,6 +241,9 @@ private:
 			UdpDomainSupport*	_GetDomainSupport(net_domain* domain,
 									bool create);
 			UdpDomainSupport*	_GetDomainSupport(net_buffer* buffer);
+			void				_DemuxIncomingBuffers(
+									UdpDomainSupport* domainSupport,
+									net_buffer** buffers, uint32 count);
 
 			mutex				fLock;
 			status_t			fStatus;
@@ -296,6 +302,37 @@ UdpDomainSupport::DemuxIncomingBuffer(net_buffer *buffer)
 }
 
 
+/*!	Demultiplexes all \a buffers while holding the lock only once. The buffers
+	that could not be delivered are moved to the front of the array, and
+	their number is returned.
+*/
+uint32
+UdpDomainSupport::DemuxIncomingBuffers(net_buffer** buffers, uint32 count)
+{
+	MutexLocker _(fLock);
+
+	uint32 failed = 0;
+	for (uint32 i = 0; i < count; i++) {
+		net_buffer* buffer = buffers[i];
+
+		status_t status;
+		if ((buffer->flags & MSG_BCAST) != 0)
+			status = _DemuxBroadcast(buffer);
+		else if ((buffer->flags & MSG_MCAST) != 0)
+			status = B_ERROR;
+		else
+			status = _DemuxUnicast(buffer);
+
+		if (status != B_OK) {
+			buffers[i] = buffers[failed];
+			buffers[failed++] = buffer;
+		}
+	}
+
+	return failed;
+}
+
+
 status_t
 UdpDomainSupport::DeliverError(status_t error, net_buffer* buffer)
 {
@@ -721,6 +758,45 @@ UdpEndpointManager::ReceiveData(net_buffer *buffer)
 }
 
 
+/*!	Receives a batch of buffers; in contrast to the single buffer version,
+	all buffers are taken over. The domain support is only looked up when the
+	domain changes.
+*/
+void
+UdpEndpointManager::ReceiveData(net_buffer** buffers, uint32 count)
+{
+	net_domain* batchDomain = NULL;
+	UdpDomainSupport* batchSupport = NULL;
+	uint32 batchCount = 0;
+
+	for (uint32 i = 0; i < count; i++) {
+		net_buffer* buffer = buffers[i];
+
+		net_domain* domain = _GetDomain(buffer);
+		if (domain != batchDomain) {
+			if (batchCount > 0) {
+				_DemuxIncomingBuffers(batchSupport, buffers, batchCount);
+				batchCount = 0;
+			}
+
+			MutexLocker _(fLock);
+			batchSupport = _GetDomainSupport(domain, false);
+			batchDomain = domain;
+		}
+
+		if (batchSupport == NULL || Deframe(buffer) != B_OK) {
+			gBufferModule->free(buffer);
+			continue;
+		}
+
+		buffers[batchCount++] = buffer;
+	}
+
+	if (batchCount > 0)
+		_DemuxIncomingBuffers(batchSupport, buffers, batchCount);
+}
+
+
 status_t
 UdpEndpointManager::ReceiveError(status_t error, net_buffer* buffer)
 {
@@ -904,6 +980,24 @@ UdpEndpointManager::_GetDomainSupport(net_buffer* buffer)
 }
 
 
+void
+UdpEndpointManager::_DemuxIncomingBuffers(UdpDomainSupport* domainSupport,
+	net_buffer** buffers, uint32 count)
+{
+	uint32 failed = domainSupport->DemuxIncomingBuffers(buffers, count);
+
+	for (uint32 i = 0; i < count; i++) {
+		if (i < failed) {
+			// Send port unreachable error
+			domainSupport->Domain()->module->error_reply(NULL, buffers[i],
+				B_NET_ERROR_UNREACH_PORT, NULL);
+		}
+
+		gBufferModule->free(buffers[i]);
+	}
+}
+
+
 // #pragma mark -
 
 
@@ -1267,6 +1361,13 @@ udp_receive_data(net_buffer *buffer)
 }
 
 
+void
+udp_receive_data_batch(net_buffer **buffers, uint32 count)
+{
+	sUdpEndpointManager->ReceiveData(buffers, count);
+}
+
+
 status_t
 udp_deliver_data(net_protocol *protocol, net_buffer *buffer)
 {
@@ -1462,7 +1563,8 @@ net_protocol_module_info sUDPModule = {
 	NULL,		// process_ancillary_data()
 	udp_process_ancillary_data_no_container,
 	NULL,		// send_data_no_buffer()
-	NULL		// read_data_no_buffer()
+	NULL,		// read_data_no_buffer()
+	udp_receive_data_batch
 };
 
 module_dependency module_dependencies[] = {
@@ -114,6 +114,7 @@ option_to_string(int32 option)
 		CODE(B_SOCKET_SET_ALIAS)		/* set interface alias, ifaliasreq */
 		CODE(B_SOCKET_GET_ALIAS)		/* get interface alias, ifaliasreq */
 		CODE(B_SOCKET_COUNT_ALIASES)	/* count interface aliases */
+		CODE(B_SOCKET_GET_RECEIVE_QUEUES)	/* get receive queue stats */
 
 		default:
 			static char buffer[24];
@@ -370,8 +371,8 @@ datalink_send_routed_data(struct net_route* route, net_buffer* buffer)
 		set_interface_address(buffer->interface_address, address);
 
 		// this one goes back to the domain directly
-		return fifo_enqueue_buffer(
-			&interface->DeviceInterface()->receive_queue, buffer);
+		return device_interface_enqueue_buffer(interface->DeviceInterface(),
+			buffer);
 	}
 
 	if ((route->flags & RTF_GATEWAY) != 0) {
@@ -860,6 +861,20 @@ interface_protocol_control(net_datalink_protocol* _protocol, int32 option,
 				sizeof(struct ifreq_stats));
 		}
 
+		case B_SOCKET_GET_RECEIVE_QUEUES:
+		{
+			// get receive queue stats
+			if (length < sizeof(struct ifqueuesreq))
+				return B_BAD_VALUE;
+
+			ifreq_receive_queues queues;
+			get_device_interface_receive_queues(interface->DeviceInterface(),
+				&queues);
+
+			return user_memcpy(&((struct ifqueuesreq*)argument)->ifq_queues,
+				&queues, sizeof(ifreq_receive_queues));
+		}
+
 		case SIOCGIFTYPE:
 		{
 			// get type
@@ -22,6 +22,8 @@
 
 #include <net/if_dl.h>
 #include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
 #include <new>
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,14 +38,213 @@
 #endif
 
 
+static const size_t kReceiveQueueSize = 16 * 1024 * 1024;
+static const uint32 kReceiveBatchSize = 32;
+
 static mutex sLock;
 static DeviceInterfaceList sInterfaces;
 static uint32 sDeviceIndex;
 
 
+static inline uint32
+hash_flow(uint32 hash, const void* _data, size_t length)
+{
+	const uint8* data = (const uint8*)_data;
+
+	// Bob Jenkins' one-at-a-time hash
+	for (size_t i = 0; i < length; i++) {
+		hash += data[i];
+		hash += hash << 10;
+		hash ^= hash >> 6;
+	}
+	return hash;
+}
+
+
+/*!	Computes a hash over the addresses, the protocol, and the ports of the
+	buffer's flow, so that all packets of a connection end up in the same
+	receive queue, and are processed in order.
+	The buffer must start with its network header; packets of unknown
+	protocols all get the same hash.
+*/
+static uint32
+flow_hash(net_buffer* buffer)
+{
+	int family = AF_UNSPEC;
+	if (buffer->interface_address != NULL)
+		family = buffer->interface_address->domain->family;
+	else if (buffer->type == B_NET_FRAME_TYPE_IPV4)
+		family = AF_INET;
+	else if (buffer->type == B_NET_FRAME_TYPE_IPV6)
+		family = AF_INET6;
+
+	uint32 hash = 0;
+	size_t headerLength;
+	uint8 protocol;
+
+	if (family == AF_INET) {
+		ip header;
+		if (gNetBufferModule.read(buffer, 0, &header, sizeof(ip)) != B_OK)
+			return 0;
+
+		hash = hash_flow(hash, &header.ip_src, sizeof(in_addr));
+		hash = hash_flow(hash, &header.ip_dst, sizeof(in_addr));
+
+		// only the first fragment contains the ports
+		if ((ntohs(header.ip_off) & (IP_MF | IP_OFFMASK)) != 0)
+			return hash;
+
+		headerLength = header.ip_hl << 2;
+		protocol = header.ip_p;
+	} else if (family == AF_INET6) {
+		ip6_hdr header;
+		if (gNetBufferModule.read(buffer, 0, &header, sizeof(ip6_hdr))
+				!= B_OK)
+			return 0;
+
+		hash = hash_flow(hash, &header.ip6_src, sizeof(in6_addr));
+		hash = hash_flow(hash, &header.ip6_dst, sizeof(in6_addr));
+
+		// extension headers are not followed
+		headerLength = sizeof(ip6_hdr);
+		protocol = header.ip6_nxt;
+	} else
+		return 0;
+
+	if (protocol == IPPROTO_TCP || protocol == IPPROTO_UDP) {
+		// both start with the source and destination ports
+		uint16 ports[2];
+		if (gNetBufferModule.read(buffer, headerLength, ports, sizeof(ports))
+				== B_OK)
+			hash = hash_flow(hash, ports, sizeof(ports));
+	}
+
+	hash = hash_flow(hash, &protocol, sizeof(protocol));
+	hash += hash << 3;
+	hash ^= hash >> 11;
+	hash += hash << 15;
+	return hash;
+}
+
+
+/*!	Puts the buffer into the given receive queue, and accounts for it.
+	The buffer is not freed on failure.
+*/
+static status_t
+enqueue_receive_buffer(net_receive_queue* queue, net_buffer* buffer)
+{
+	status_t status = fifo_enqueue_buffer(&queue->fifo, buffer);
+	if (status != B_OK) {
+		atomic_add64(&queue->dropped, 1);
+		return status;
+	}
+
+	atomic_add64(&queue->packets, 1);
+	return B_OK;
+}
+
+
+/*!	Puts all \a buffers into the given receive queue at once, and accounts
+	for them. In contrast to enqueue_receive_buffer(), the buffers that don't
+	fit into the queue anymore are freed.
+*/
+static void
+enqueue_receive_buffers(net_receive_queue* queue, net_buffer** buffers,
+	uint32 count)
+{
+	if (count == 1) {
+		if (enqueue_receive_buffer(queue, buffers[0]) != B_OK)
+			gNetBufferModule.free(buffers[0]);
+		return;
+	}
+
+	uint32 added = fifo_enqueue_buffers(&queue->fifo, buffers, count);
+	for (uint32 i = added; i < count; i++)
+		gNetBufferModule.free(buffers[i]);
+
+	atomic_add64(&queue->packets, added);
+	if (added < count)
+		atomic_add64(&queue->dropped, count - added);
+}
+
+
+/*!	Spreads the (deframed) \a buffers over the receive queues of the
+	interface by their flow, so that every queue is only locked and woken up
+	once per batch.
+*/
+static void
+enqueue_receive_buffers(net_device_interface* interface, net_buffer** buffers,
+	uint32 count)
+{
+	if (interface->receive_queue_count == 1) {
+		enqueue_receive_buffers(&interface->receive_queues[0], buffers, count);
+		return;
+	}
+
+	uint32 queueIndices[kReceiveBatchSize];
+	for (uint32 i = 0; i < count; i++)
+		queueIndices[i] = flow_hash(buffers[i]) % interface->receive_queue_count;
+
+	for (uint32 i = 0; i < count; i++) {
+		if (buffers[i] == NULL)
+			continue;
+
+		uint32 index = queueIndices[i];
+		net_buffer* batch[kReceiveBatchSize];
+		uint32 batchCount = 0;
+
+		for (uint32 j = i; j < count; j++) {
+			if (buffers[j] != NULL && queueIndices[j] == index) {
+				batch[batchCount++] = buffers[j];
+				buffers[j] = NULL;
+			}
+		}
+
+		enqueue_receive_buffers(&interface->receive_queues[index], batch,
+			batchCount);
+	}
+}
+
+
+/*!	Deframes the \a buffers as they came from the device, and puts them into
+	\a queue, or if that is \c NULL, into the queues of their flows.
+*/
+static void
+device_interface_receive(net_device_interface* interface,
+	net_receive_queue* queue, net_buffer** buffers, uint32 count)
+{
+	uint32 deframed = 0;
+	for (uint32 i = 0; i < count; i++) {
+		net_buffer* buffer = buffers[i];
+
+		// feed device monitors
+		if (atomic_get(&interface->monitor_count) > 0)
+			device_interface_monitor_receive(interface, buffer);
+
+		ASSERT(buffer->interface_address == NULL);
+
+		if (interface->deframe_func(interface->device, buffer) != B_OK) {
+			gNetBufferModule.free(buffer);
+			continue;
+		}
+
+		buffers[deframed++] = buffer;
+	}
+
+	if (deframed == 0)
+		return;
+
+	if (queue != NULL)
+		enqueue_receive_buffers(queue, buffers, deframed);
+	else
+		enqueue_receive_buffers(interface, buffers, deframed);
+}
+
+
 /*!	A service thread for each device interface. It just reads as many packets
-	as availabe, deframes them, and puts them into the receive queue of the
-	device interface.
+	as availabe, deframes them, and puts them into the receive queues of the
+	device interface. If the device supports it, the packets are read in
+	batches.
 */
 static status_t
 device_reader_thread(void* _interface)
@@ -53,23 +254,52 @@ device_reader_thread(void* _interface)
 	status_t status = B_OK;
 
 	while ((device->flags & IFF_UP) != 0) {
-		net_buffer* buffer;
-		status = device->module->receive_data(device, &buffer);
+		net_buffer* buffers[kReceiveBatchSize];
+		uint32 count = 1;
+		if (device->module->receive_data_batch != NULL) {
+			count = kReceiveBatchSize;
+			status = device->module->receive_data_batch(device, buffers,
+				&count);
+		} else
+			status = device->module->receive_data(device, &buffers[0]);
+
 		if (status == B_OK) {
-			// feed device monitors
-			if (atomic_get(&interface->monitor_count) > 0)
-				device_interface_monitor_receive(interface, buffer);
+			device_interface_receive(interface, NULL, buffers, count);
+		} else if (status == B_DEVICE_NOT_FOUND) {
+				device_removed(device);
+		} else {
+			// In case of error, give the other threads some
+			// time to run since this is a high priority time thread.
+			snooze(10000);
+		}
+	}
+
+	return status;
+}
 
-			ASSERT(buffer->interface_address == NULL);
 
-			if (interface->deframe_func(interface->device, buffer) != B_OK) {
-				gNetBufferModule.free(buffer);
-				continue;
-			}
+/*!	Like device_reader_thread(), but for a single hardware receive queue of
+	a device; as the device already spread the flows over its queues, the
+	packets stay in the corresponding queue of the interface.
+*/
+static status_t
+device_queue_reader_thread(void* _queue)
+{
+	net_receive_queue* queue = (net_receive_queue*)_queue;
+	net_device_interface* interface = queue->interface;
+	net_device* device = interface->device;
+	status_t status = B_OK;
 
-			fifo_enqueue_buffer(&interface->receive_queue, buffer);
+	while ((device->flags & IFF_UP) != 0) {
+		net_buffer* buffer;
+		status = device->module->receive_queue_data(device, queue->index,
+			&buffer);
+		if (status == B_OK) {
+			device_interface_receive(interface, queue, &buffer, 1);
 		} else if (status == B_DEVICE_NOT_FOUND) {
+			if (queue->index == 0)
 				device_removed(device);
+			break;
 		} else {
 			// In case of error, give the other threads some
 			// time to run since this is a high priority time thread.
@@ -81,71 +311,232 @@ device_reader_thread(void* _interface)
 }
 
 
+/*!	The domain's device receive handler - this will inject the net_buffers into
+	the protocol layer (the domain's registered receive handler).
+*/
 static status_t
-device_consumer_thread(void* _interface)
+domain_receive_adapter(void* cookie, net_device* device, net_buffer* buffer)
 {
-	net_device_interface* interface = (net_device_interface*)_interface;
-	net_device* device = interface->device;
-	net_buffer* buffer;
+	net_domain_private* domain = (net_domain_private*)cookie;
 
-	while (true) {
-		ssize_t status = fifo_dequeue_buffer(&interface->receive_queue, 0,
-			B_INFINITE_TIMEOUT, &buffer);
-		if (status != B_OK) {
-			if (status == B_INTERRUPTED)
-				continue;
-			break;
+	return domain->module->receive_data(buffer);
+}
+
+
+/*!	Looks up the handlers that accept buffers of the given types, and
+	acquires a reference to each of them, so that they can be called without
+	holding the receive_lock; release them with put_device_handler().
+	Since there can only be a single handler per type, there are at most two.
+	The interface's receive_lock must be held.
+*/
+static uint32
+get_device_handlers(net_device_interface* interface, int32 genericType,
+	int32 specificType, net_device_handler** handlers)
+{
+	uint32 count = 0;
+
+	DeviceHandlerList::Iterator iterator
+		= interface->receive_funcs.GetIterator();
+	while (net_device_handler* handler = iterator.Next()) {
+		if (handler->type != genericType && handler->type != specificType)
+			continue;
+
+		atomic_add(&handler->ref_count, 1);
+		handlers[count++] = handler;
+	}
+
+	return count;
+}
+
+
+static void
+put_device_handler(net_device_interface* interface,
+	net_device_handler* handler)
+{
+	if (atomic_add(&handler->ref_count, -1) == 1) {
+		// the handler has been unregistered, and we were the last user
+		interface->receive_funcs_condition.NotifyAll();
+	}
+}
+
+
+/*!	Returns the protocol module of the domain behind \a handler, if it
+	accepts batches of buffers, or \c NULL if it does not.
+*/
+static net_protocol_module_info*
+batch_module(net_device_handler* handler)
+{
+	if (handler->func != &domain_receive_adapter)
+		return NULL;
+
+	net_domain_private* domain = (net_domain_private*)handler->cookie;
+	if (domain->module->receive_data_batch == NULL)
+		return NULL;
+
+	return domain->module;
+}
+
+
+/*!	Collects the buffers that go to the same protocol module, so that they
+	can be passed on in a single receive_data_batch() call.
+	If the buffers are delivered via a device handler, the batch owns the
+	reference to it until it is flushed.
+*/
+struct receive_batch {
+	receive_batch(net_device_interface* interface)
+		:
+		interface(interface),
+		module(NULL),
+		handler(NULL),
+		count(0)
+	{
+	}
+
+	void Add(net_protocol_module_info* newModule,
+		net_device_handler* newHandler, net_buffer* buffer)
+	{
+		if (newModule != module || newHandler != handler)
+			Flush();
+		else if (newHandler != NULL) {
+			// we already own a reference to this handler
+			put_device_handler(interface, newHandler);
 		}
 
-		if (buffer->interface_address != NULL) {
-			// If the interface is already specified, this buffer was
-			// delivered locally.
-			if (buffer->interface_address->domain->module->receive_data(buffer)
-					== B_OK)
-				buffer = NULL;
-		} else {
-			sockaddr_dl& linkAddress = *(sockaddr_dl*)buffer->source;
-			int32 genericType = buffer->type;
-			int32 specificType = B_NET_FRAME_TYPE(linkAddress.sdl_type,
-				ntohs(linkAddress.sdl_e_type));
+		module = newModule;
+		handler = newHandler;
+		buffers[count++] = buffer;
+	}
+
+	void Flush()
+	{
+		if (count > 0)
+			module->receive_data_batch(buffers, count);
+		if (handler != NULL)
+			put_device_handler(interface, handler);
+
+		module = NULL;
+		handler = NULL;
+		count = 0;
+	}
+
+	net_device_interface* interface;
+	net_protocol_module_info* module;
+	net_device_handler*	handler;
+	net_buffer*			buffers[kReceiveBatchSize];
+	uint32				count;
+};
+
+
+/*!	Passes the \a buffers from a receive queue on to their domains, or device
+	handlers. The handlers of all buffers are looked up at once, and are then
+	called without holding the interface's receive_lock, so that the consumer
+	threads of the receive queues do not serialize each other.
+	Like for single buffers, the matching handlers are offered a buffer in
+	turn, until one of them consumes it. Only if the last of them is a domain
+	that supports batches, the buffer is added to its batch instead, as the
+	domain then owns it, and no other handler could be offered it anymore.
+*/
+static void
+device_interface_deliver(net_device_interface* interface,
+	net_buffer** buffers, uint32 count)
+{
+	net_device* device = interface->device;
+	net_device_handler* handlers[kReceiveBatchSize][2];
+	uint32 handlerCounts[kReceiveBatchSize];
+
+	RecursiveLocker locker(interface->receive_lock);
+
+	for (uint32 i = 0; i < count; i++) {
+		net_buffer* buffer = buffers[i];
+		handlerCounts[i] = 0;
 
-			buffer->index = interface->device->index;
+		// If the interface is already specified, this buffer was
+		// delivered locally.
+		if (buffer->interface_address != NULL)
+			continue;
 
-			// Find handler for this packet
+		sockaddr_dl& linkAddress = *(sockaddr_dl*)buffer->source;
+		int32 genericType = buffer->type;
+		int32 specificType = B_NET_FRAME_TYPE(linkAddress.sdl_type,
+			ntohs(linkAddress.sdl_e_type));
+
+		buffer->index = device->index;
+		handlerCounts[i] = get_device_handlers(interface, genericType,
+			specificType, handlers[i]);
+	}
+
+	locker.Unlock();
 
-			RecursiveLocker locker(interface->receive_lock);
+	receive_batch batch(interface);
 
-			DeviceHandlerList::Iterator iterator
-				= interface->receive_funcs.GetIterator();
-			while (buffer != NULL && iterator.HasNext()) {
-				net_device_handler* handler = iterator.Next();
+	for (uint32 i = 0; i < count; i++) {
+		net_buffer* buffer = buffers[i];
+
+		if (buffer->interface_address != NULL) {
+			net_protocol_module_info* module
+				= buffer->interface_address->domain->module;
+			if (module->receive_data_batch != NULL) {
+				batch.Add(module, NULL, buffer);
+				continue;
+			}
+
+			// keep the order of the buffers
+			batch.Flush();
+			if (module->receive_data(buffer) != B_OK)
+				gNetBufferModule.free(buffer);
+			continue;
+		}
+
+		for (uint32 j = 0; j < handlerCounts[i]; j++) {
+			net_device_handler* handler = handlers[i][j];
+
+			if (buffer != NULL) {
+				net_protocol_module_info* module = batch_module(handler);
+				if (module != NULL && j + 1 == handlerCounts[i]) {
+					// the batch takes over our reference
+					batch.Add(module, handler, buffer);
+					buffer = NULL;
+					continue;
+				}
 
 				// If the handler returns B_OK, it consumed the buffer - first
 				// handler wins.
-				if ((handler->type == genericType
-						|| handler->type == specificType)
-					&& handler->func(handler->cookie, device, buffer) == B_OK)
+				batch.Flush();
+				if (handler->func(handler->cookie, device, buffer) == B_OK)
 					buffer = NULL;
 			}
+
+			put_device_handler(interface, handler);
 		}
 
 		if (buffer != NULL)
 			gNetBufferModule.free(buffer);
 	}
 
-	return B_OK;
+	batch.Flush();
 }
 
 
-/*!	The domain's device receive handler - this will inject the net_buffers into
-	the protocol layer (the domain's registered receive handler).
-*/
 static status_t
-domain_receive_adapter(void* cookie, net_device* device, net_buffer* buffer)
+device_consumer_thread(void* _queue)
 {
-	net_domain_private* domain = (net_domain_private*)cookie;
+	net_receive_queue* queue = (net_receive_queue*)_queue;
+	net_device_interface* interface = queue->interface;
 
-	return domain->module->receive_data(buffer);
+	while (true) {
+		net_buffer* buffers[kReceiveBatchSize];
+		ssize_t count = fifo_dequeue_buffers(&queue->fifo, 0,
+			B_INFINITE_TIMEOUT, buffers, kReceiveBatchSize);
+		if (count < 0) {
+			if (count == B_INTERRUPTED)
+				continue;
+			break;
+		}
+
+		device_interface_deliver(interface, buffers, count);
+	}
+
+	return B_OK;
 }
 
 
@@ -163,6 +554,96 @@ find_device_interface(const char* name)
 }
 
 
+/*!	Stops the consumer threads of the first \a count receive queues of the
+	interface, and frees them all.
+*/
+static void
+delete_receive_queues(net_device_interface* interface, uint32 count)
+{
+	for (uint32 i = 0; i < count; i++) {
+		net_receive_queue& queue = interface->receive_queues[i];
+
+		uninit_fifo(&queue.fifo);
+
+		status_t status;
+		wait_for_thread(queue.consumer_thread, &status);
+	}
+
+	free(interface->receive_queues);
+	interface->receive_queues = NULL;
+}
+
+
+/*!	Creates the receive queues, and starts their consumer threads. If the
+	device has hardware receive queues, there is one for each of them, and
+	otherwise, there is one per CPU, and the packets are spread over them by
+	their flow.
+*/
+static status_t
+create_receive_queues(net_device_interface* interface,
+	net_device_module_info* module)
+{
+	net_device* device = interface->device;
+
+	uint32 count = 0;
+	if (module->count_receive_queues != NULL
+		&& module->receive_queue_data != NULL)
+		count = module->count_receive_queues(device);
+
+	interface->hardware_queues = count > 1;
+	if (!interface->hardware_queues) {
+		system_info info;
+		get_system_info(&info);
+		count = info.cpu_count;
+	}
+
+	count = max_c(min_c(count, IF_MAX_RECEIVE_QUEUES), 1);
+
+	interface->receive_queues = (net_receive_queue*)malloc(
+		count * sizeof(net_receive_queue));
+	if (interface->receive_queues == NULL)
+		return B_NO_MEMORY;
+
+	for (uint32 i = 0; i < count; i++) {
+		net_receive_queue& queue = interface->receive_queues[i];
+		queue.interface = interface;
+		queue.index = i;
+		queue.reader_thread = -1;
+		queue.packets = 0;
+		queue.dropped = 0;
+
+		char name[128];
+		snprintf(name, sizeof(name), "%s receive queue %" B_PRIu32,
+			device->name, i);
+
+		status_t status = init_fifo(&queue.fifo, name, kReceiveQueueSize);
+		if (status == B_OK) {
+			if (count > 1) {
+				snprintf(name, sizeof(name), "%s consumer %" B_PRIu32,
+					device->name, i);
+			} else
+				snprintf(name, sizeof(name), "%s consumer", device->name);
+
+			queue.consumer_thread = spawn_kernel_thread(device_consumer_thread,
+				name, B_DISPLAY_PRIORITY, &queue);
+			if (queue.consumer_thread < B_OK) {
+				status = queue.consumer_thread;
+				uninit_fifo(&queue.fifo);
+			}
+		}
+		if (status != B_OK) {
+			delete_receive_queues(interface, i);
+			return status;
+		}
+
+		resume_thread(queue.consumer_thread);
+	}
+
+	interface->receive_queue_count = count;
+	return B_OK;
+}
+
+
 static net_device_interface*
 allocate_device_interface(net_device* device, net_device_module_info* module)
 {
@@ -171,29 +652,25 @@ allocate_device_interface(net_device* device, net_device_module_info* module)
 		return NULL;
 
 	recursive_lock_init(&interface->receive_lock, "device interface receive");
+	interface->receive_funcs_condition.Init(interface,
+		"device interface receive funcs");
 	mutex_init(&interface->monitor_lock, "device interface monitors");
 
-	char name[128];
-	snprintf(name, sizeof(name), "%s receive queue", device->name);
-
-	if (init_fifo(&interface->receive_queue, name, 16 * 1024 * 1024) < B_OK)
-		goto error1;
-
 	interface->device = device;
 	interface->up_count = 0;
 	interface->ref_count = 1;
 	interface->monitor_count = 0;
 	interface->deframe_func = NULL;
 	interface->deframe_ref_count = 0;
+	interface->reader_thread = -1;
 
-	snprintf(name, sizeof(name), "%s consumer", device->name);
+	if (create_receive_queues(interface, module) != B_OK) {
+		recursive_lock_destroy(&interface->receive_lock);
+		mutex_destroy(&interface->monitor_lock);
+		delete interface;
 
-	interface->reader_thread   = -1;
-	interface->consumer_thread = spawn_kernel_thread(device_consumer_thread,
-		name, B_DISPLAY_PRIORITY, interface);
-	if (interface->consumer_thread < B_OK)
-		goto error2;
-	resume_thread(interface->consumer_thread);
+		return NULL;
+	}
 
 	// TODO: proper interface index allocation
 	device->index = ++sDeviceIndex;
@@ -201,15 +678,6 @@ allocate_device_interface(net_device* device, net_device_module_info* module)
 
 	sInterfaces.Add(interface);
 	return interface;
-
-error2:
-	uninit_fifo(&interface->receive_queue);
-error1:
-	recursive_lock_destroy(&interface->receive_lock);
-	mutex_destroy(&interface->monitor_lock);
-	delete interface;
-
-	return NULL;
 }
 
 
@@ -247,7 +715,6 @@ dump_device_interface(int argc, char** argv)
 	kprintf("ref_count:         %" B_PRId32 "\n", interface->ref_count);
 	kprintf("deframe_func:      %p\n", interface->deframe_func);
 	kprintf("deframe_ref_count: %" B_PRId32 "\n", interface->ref_count);
-	kprintf("consumer_thread:   %" B_PRId32 "\n", interface->consumer_thread);
 
 	kprintf("monitor_count:     %" B_PRId32 "\n", interface->monitor_count);
 	kprintf("monitor_lock:      %p\n", &interface->monitor_lock);
@@ -258,7 +725,16 @@ dump_device_interface(int argc, char** argv)
 		kprintf("  %p\n", monitorIterator.Next());
 
 	kprintf("receive_lock:      %p\n", &interface->receive_lock);
-	kprintf("receive_queue:     %p\n", &interface->receive_queue);
+	kprintf("receive_queues:    %" B_PRIu32 "%s\n",
+		interface->receive_queue_count,
+		interface->hardware_queues ? " (hardware)" : "");
+	for (uint32 i = 0; i < interface->receive_queue_count; i++) {
+		net_receive_queue& queue = interface->receive_queues[i];
+		kprintf("  %p  reader %" B_PRId32 ", consumer %" B_PRId32 ", %"
+			B_PRId64 " packets, %" B_PRId64 " dropped\n", &queue.fifo,
+			queue.reader_thread, queue.consumer_thread, queue.packets,
+			queue.dropped);
+	}
 	kprintf("receive_funcs:\n");
 	DeviceHandlerList::Iterator handlerIterator
 		= interface->receive_funcs.GetIterator();
@@ -382,9 +858,7 @@ put_device_interface(struct net_device_interface* interface)
 	sInterfaces.Remove(interface);
 	locker.Unlock();
 
-	uninit_fifo(&interface->receive_queue);
-	status_t status;
-	wait_for_thread(interface->consumer_thread, &status);
+	delete_receive_queues(interface, interface->receive_queue_count);
 
 	net_device* device = interface->device;
 	const char* moduleName = device->module->info.name;
@@ -470,6 +944,38 @@ get_device_interface(const char* name, bool create)
 }
 
 
+/*!	Puts the \a buffer into the receive queue of its flow; the buffer must
+	already be deframed. It is not freed on failure.
+*/
+status_t
+device_interface_enqueue_buffer(net_device_interface* interface,
+	net_buffer* buffer)
+{
+	uint32 index = 0;
+	if (interface->receive_queue_count > 1)
+		index = flow_hash(buffer) % interface->receive_queue_count;
+
+	return enqueue_receive_buffer(&interface->receive_queues[index], buffer);
+}
+
+
+void
+get_device_interface_receive_queues(net_device_interface* interface,
+	ifreq_receive_queues* queues)
+{
+	memset(queues, 0, sizeof(ifreq_receive_queues));
+	queues->count = interface->receive_queue_count;
+	queues->hardware = interface->hardware_queues;
+
+	for (uint32 i = 0; i < interface->receive_queue_count; i++) {
+		queues->queues[i].packets
+			= atomic_get64(&interface->receive_queues[i].packets);
+		queues->queues[i].dropped
+			= atomic_get64(&interface->receive_queues[i].dropped);
+	}
+}
+
+
 /*!	Feeds the device monitors of the \a interface with the specified \a buffer.
 	You might want to check interface::monitor_count before calling this
 	function for optimization.
@@ -505,7 +1011,30 @@ up_device_interface(net_device_interface* interface)
 	if (status != B_OK)
 		return status;
 
-	if (device->module->receive_data != NULL) {
+	if (interface->hardware_queues) {
+		for (uint32 i = 0; i < interface->receive_queue_count; i++) {
+			net_receive_queue& queue = interface->receive_queues[i];
+
+			// give the thread a nice name
+			char name[B_OS_NAME_LENGTH];
+			snprintf(name, sizeof(name), "%s reader %" B_PRIu32, device->name,
+				i);
+
+			queue.reader_thread = spawn_kernel_thread(
+				device_queue_reader_thread, name,
+				B_REAL_TIME_DISPLAY_PRIORITY - 10, &queue);
+			if (queue.reader_thread < B_OK) {
+				status = queue.reader_thread;
+				for (uint32 j = 0; j < i; j++) {
+					kill_thread(interface->receive_queues[j].reader_thread);
+					interface->receive_queues[j].reader_thread = -1;
+				}
+				queue.reader_thread = -1;
+				device->module->down(device);
+				return status;
+			}
+		}
+	} else if (device->module->receive_data != NULL) {
 		// give the thread a nice name
 		char name[B_OS_NAME_LENGTH];
 		snprintf(name, sizeof(name), "%s reader", device->name);
@@ -518,7 +1047,10 @@ up_device_interface(net_device_interface* interface)
 
 	device->flags |= IFF_UP;
 
-	if (device->module->receive_data != NULL)
+	if (interface->hardware_queues) {
+		for (uint32 i = 0; i < interface->receive_queue_count; i++)
+			resume_thread(interface->receive_queues[i].reader_thread);
+	} else if (device->module->receive_data != NULL)
 		resume_thread(interface->reader_thread);
 
 	interface->up_count = 1;
@@ -549,7 +1081,16 @@ down_device_interface(net_device_interface* interface)
 
 	notify_device_monitors(interface, B_DEVICE_GOING_DOWN);
 
-	if (device->module->receive_data != NULL) {
+	if (interface->hardware_queues) {
+		// make sure the reader threads are gone before shutting down the
+		// interface
+		for (uint32 i = 0; i < interface->receive_queue_count; i++) {
+			status_t status;
+			wait_for_thread(interface->receive_queues[i].reader_thread,
+				&status);
+			interface->receive_queues[i].reader_thread = -1;
+		}
+	} else if (device->module->receive_data != NULL) {
 		thread_id readerThread = interface->reader_thread;
 
 		// make sure the reader thread is gone before shutting down the interface
@@ -657,12 +1198,17 @@ register_device_handler(struct net_device* device, int32 type,
 	handler->func = receiveFunc;
 	handler->type = type;
 	handler->cookie = cookie;
+	handler->ref_count = 1;
 	interface->receive_funcs.Add(handler);
 	return B_OK;
 }
 
 
-/*!	Unregisters a previously registered device handler. */
+/*!	Unregisters a previously registered device handler.
+	Since the receive threads call the handlers without holding any lock,
+	this waits until none of them is using the handler anymore; it must
+	therefore not be called from within the handler itself.
+*/
 status_t
 unregister_device_handler(struct net_device* device, int32 type)
 {
@@ -673,7 +1219,7 @@ unregister_device_handler(struct net_device* device, int32 type)
 	if (interface == NULL)
 		return B_DEVICE_NOT_FOUND;
 
-	RecursiveLocker _(interface->receive_lock);
+	RecursiveLocker receiveLocker(interface->receive_lock);
 
 	// search for the handler
 
@@ -683,6 +1229,20 @@ unregister_device_handler(struct net_device* device, int32 type)
 		if (handler->type == type) {
 			// found it
 			iterator.Remove();
+			receiveLocker.Unlock();
+
+			if (atomic_add(&handler->ref_count, -1) > 1) {
+				// Wait until the receive threads are done with it; since the
+				// entry is added before checking again, we cannot miss the
+				// notification of the last one
+				while (atomic_get(&handler->ref_count) > 0) {
+					ConditionVariableEntry entry;
+					interface->receive_funcs_condition.Add(&entry);
+					entry.Wait(atomic_get(&handler->ref_count) > 0
+						? 0 : B_RELATIVE_TIMEOUT);
+				}
+			}
+
 			delete handler;
 			return B_OK;
 		}
@@ -796,7 +1356,7 @@ device_enqueue_buffer(net_device* device, net_buffer* buffer)
 	if (interface == NULL)
 		return B_DEVICE_NOT_FOUND;
 
-	status_t status = fifo_enqueue_buffer(&interface->receive_queue, buffer);
+	status_t status = device_interface_enqueue_buffer(interface, buffer);
 
 	put_device_interface(interface);
 	return status;
@@ -12,6 +12,7 @@
 #include <net_datalink.h>
 #include <net_stack.h>
 
+#include <condition_variable.h>
 #include <util/DoublyLinkedList.h>
 
 
@@ -19,6 +20,9 @@ struct net_device_handler : DoublyLinkedListLinkImpl<net_device_handler> {
 	net_receive_func	func;
 	int32				type;
 	void*				cookie;
+	int32				ref_count;
+		// one for the receive_funcs list, and one for every receive thread
+		// that currently uses the handler
 };
 
 typedef DoublyLinkedList<net_device_handler> DeviceHandlerList;
@@ -26,6 +30,20 @@ typedef DoublyLinkedList<net_device_handler> DeviceHandlerList;
 typedef DoublyLinkedList<net_device_monitor,
 	DoublyLinkedListCLink<net_device_monitor> > DeviceMonitorList;
 
+struct net_device_interface;
+
+struct net_receive_queue {
+	net_device_interface* interface;
+	uint32				index;
+	thread_id			reader_thread;
+		// only used for hardware receive queues
+	thread_id			consumer_thread;
+	net_fifo			fifo;
+
+	int64				packets;
+	int64				dropped;
+};
+
 struct net_device_interface : DoublyLinkedListLinkImpl<net_device_interface> {
 	struct net_device*	device;
 	thread_id			reader_thread;
@@ -42,9 +60,14 @@ struct net_device_interface : DoublyLinkedListLinkImpl<net_device_interface> {
 
 	DeviceHandlerList	receive_funcs;
 	recursive_lock		receive_lock;
-
-	thread_id			consumer_thread;
-	net_fifo			receive_queue;
+	ConditionVariable	receive_funcs_condition;
+		// notified when an unregistered handler is no longer used
+
+	net_receive_queue*	receive_queues;
+	uint32				receive_queue_count;
+	bool				hardware_queues;
+		// if true, every receive queue is fed by its own device queue, and
+		// reader thread
 };
 
 typedef DoublyLinkedList<net_device_interface> DeviceInterfaceList;
@@ -62,6 +85,10 @@ struct net_device_interface* get_device_interface(const char* name,
 	bool create = true);
 void device_interface_monitor_receive(net_device_interface* interface,
 	net_buffer* buffer);
+status_t device_interface_enqueue_buffer(net_device_interface* interface,
+	net_buffer* buffer);
+void get_device_interface_receive_queues(net_device_interface* interface,
+	struct ifreq_receive_queues* queues);
 status_t up_device_interface(net_device_interface* interface);
 void down_device_interface(net_device_interface* interface);
 
@@ -460,6 +460,7 @@ Interface::Interface(const char* interfaceName,
 	type = 0;
 	mtu = deviceInterface->device->mtu;
 	metric = 0;
+	offload = 0;
 
 	fDeviceInterface = acquire_device_interface(deviceInterface);
 
@@ -1043,6 +1044,7 @@ Interface::Dump() const
 	kprintf("type:                %u\n", type);
 	kprintf("mtu:                 %" B_PRIu32 "\n", mtu);
 	kprintf("metric:              %" B_PRIu32 "\n", metric);
+	kprintf("offload:             %#" B_PRIx32 "\n", offload);
 	kprintf("ref count:           %" B_PRId32 "\n", CountReferences());
 
 	kprintf("datalink protocols:\n");
@@ -1080,6 +1082,9 @@ Interface::_SetUp()
 
 	RecursiveLocker locker(fLock);
 
+	offload = device->offload;
+		// the framing protocols may add to this in interface_up()
+
 	DatalinkTable::Iterator iterator = fDatalinkTable.GetIterator();
 	while (domain_datalink* datalink = iterator.Next()) {
 		status = datalink->first_info->interface_up(datalink->first_protocol);
@@ -19,6 +19,7 @@
 #include <debug.h>
 #include <kernel.h>
 #include <KernelExport.h>
+#include <Referenceable.h>
 #include <util/DoublyLinkedList.h>
 
 #include <algorithm>
@@ -70,6 +71,8 @@ struct data_header {
 	uint8*			data_end;
 	header_space	space;
 	uint16			tail_space;
+	BReferenceable*	external;
+		// owner of the data, if it is not stored in the header itself
 };
 
 struct data_node {
@@ -612,6 +615,10 @@ dump_buffer(net_buffer* _buffer)
 	dprintf("buffer %p, size %" B_PRIu32 ", flags %" B_PRIx32 ", stored header "
 		"%" B_PRIuSIZE ", interface address %p\n", buffer, buffer->size,
 		buffer->flags, buffer->stored_header_length, buffer->interface_address);
+	if (buffer->offload != 0) {
+		dprintf("  offload %#x, segment size %u\n", buffer->offload,
+			buffer->segment_size);
+	}
 
 	dump_address("source", buffer->source, buffer->interface_address);
 	dump_address("destination", buffer->destination, buffer->interface_address);
@@ -813,6 +820,7 @@ create_data_header(size_t headerSpace)
 	header->tail_space = (uint8*)header + BUFFER_SIZE - header->data_end
 		- headerSpace;
 	header->first_free = NULL;
+	header->external = NULL;
 
 	TRACE(("%ld:   create new data header %p\n", find_thread(NULL), header));
 	T2(CreateDataHeader(header));
@@ -829,6 +837,9 @@ release_data_header(data_header* header)
 		return;
 
 	TRACE(("%ld:   free header %p\n", find_thread(NULL), header));
+	if (header->external != NULL)
+		header->external->ReleaseReference();
+
 	free_data_header(header);
 }
 
@@ -1081,6 +1092,8 @@ copy_metadata(net_buffer* destination, const net_buffer* source)
 	destination->offset = source->offset;
 	destination->protocol = source->protocol;
 	destination->type = source->type;
+	destination->offload = source->offload;
+	destination->segment_size = source->segment_size;
 }
 
 
@@ -1128,6 +1141,8 @@ create_buffer(size_t headerSpace)
 	buffer->offset = 0;
 	buffer->flags = 0;
 	buffer->size = 0;
+	buffer->offload = 0;
+	buffer->segment_size = 0;
 
 	CHECK_BUFFER(buffer);
 	CREATE_PARANOIA_CHECK_SET(buffer, "net_buffer");
@@ -2008,6 +2023,73 @@ append_cloned_data(net_buffer* _buffer, net_buffer* _source, uint32 offset,
 }
 
 
+/*!	Appends \a bytes of \a data that is not owned by the buffer module, without
+	copying it. The data is only referenced, and must not change or go away as
+	long as \a reference is held; a reference to it is acquired, and released
+	again when the last buffer referring to the data is gone.
+	The data is added as read-only nodes, split at page boundaries, so it is
+	never written to by the stack.
+*/
+static status_t
+append_external(net_buffer* _buffer, const void* data, size_t bytes,
+	BReferenceable* reference)
+{
+	if (bytes == 0)
+		return B_OK;
+
+	net_buffer_private* buffer = (net_buffer_private*)_buffer;
+	TRACE(("%ld: append_external(buffer %p, data %p, bytes = %ld)\n",
+		find_thread(NULL), buffer, data, bytes));
+
+	ParanoiaChecker _(buffer);
+
+	// The header does not contain any data, it only ties the nodes to the
+	// reference.
+	data_header* header = create_data_header(0);
+	if (header == NULL)
+		return B_NO_MEMORY;
+
+	header->tail_space = 0;
+	header->external = reference;
+	reference->AcquireReference();
+
+	uint8* start = (uint8*)data;
+	size_t sizeAppended = 0;
+
+	while (sizeAppended < bytes) {
+		data_node* node = add_data_node(buffer, header);
+		if (node == NULL) {
+			remove_trailer(buffer, sizeAppended);
+			release_data_header(header);
+			return ENOBUFS;
+		}
+
+		size_t used = min_c(bytes - sizeAppended,
+			B_PAGE_SIZE - ((addr_t)start & (B_PAGE_SIZE - 1)));
+
+		node->offset = buffer->size;
+		node->start = start;
+		node->used = used;
+		node->flags = DATA_NODE_READ_ONLY;
+
+		list_add_item(&buffer->buffers, node);
+
+		start += used;
+		sizeAppended += used;
+		buffer->size += used;
+	}
+
+	// the nodes keep the header alive from now on
+	release_data_header(header);
+
+	CHECK_BUFFER(buffer);
+	SET_PARANOIA_CHECK(PARANOIA_SUSPICIOUS, buffer, &buffer->size,
+		sizeof(buffer->size));
+
+	return B_OK;
+}
+
+
 void
 set_ancillary_data(net_buffer* buffer, ancillary_data_container* container)
 {
@@ -2402,5 +2484,7 @@ net_buffer_module_info gNetBufferModule = {
 	swap_addresses,
 
 	dump_buffer,	// dump
+
+	append_external,
 };
 
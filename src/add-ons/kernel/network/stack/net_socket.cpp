@@ -1310,9 +1310,13 @@ socket_receive(net_socket* socket, msghdr* header, void* data, size_t length,
 }
 
 
-ssize_t
-socket_send(net_socket* socket, msghdr* header, const void* data, size_t length,
-	int flags)
+/*!	Sends the data, either from the user supplied \a header and \a data,
+	or, if \a external is not \c NULL, from kernel memory that is kept alive
+	by it, and that is referenced by the buffers instead of being copied.
+*/
+static ssize_t
+socket_send_etc(net_socket* socket, msghdr* header, const void* data,
+	size_t length, int flags, BReferenceable* external)
 {
 	const sockaddr* address = NULL;
 	socklen_t addressLength = 0;
@@ -1429,7 +1433,11 @@ socket_send(net_socket* socket, msghdr* header, const void* data, size_t length,
 			if (buffer->size + bytes > socket->send.buffer_size)
 				bytes = socket->send.buffer_size - buffer->size;
 
-			if (gNetBufferModule.append(buffer, data, bytes) < B_OK) {
+			status_t status = external != NULL
+				? gNetBufferModule.append_external(buffer, data, bytes,
+					external)
+				: gNetBufferModule.append(buffer, data, bytes);
+			if (status < B_OK) {
 				gNetBufferModule.free(buffer);
 				return ENOBUFS;
 			}
@@ -1487,6 +1495,27 @@ socket_send(net_socket* socket, msghdr* header, const void* data, size_t length,
 }
 
 
+ssize_t
+socket_send(net_socket* socket, msghdr* header, const void* data, size_t length,
+	int flags)
+{
+	return socket_send_etc(socket, header, data, length, flags, NULL);
+}
+
+
+/*!	Sends \a length bytes of kernel memory at \a data without copying it,
+	for protocols that work with net_buffers. The data must not change as
+	long as \a reference is held by the stack.
+	Protocols that use their own buffers copy the data as usual.
+*/
+ssize_t
+socket_send_external(net_socket* socket, const void* data, size_t length,
+	int flags, BReferenceable* reference)
+{
+	return socket_send_etc(socket, NULL, data, length, flags, reference);
+}
+
+
 status_t
 socket_set_option(net_socket* socket, int level, int option, const void* value,
 	int length)
@@ -1766,6 +1795,8 @@ net_socket_module_info gNetSocketModule = {
 	socket_send,
 	socket_setsockopt,
 	socket_shutdown,
-	socket_socketpair
+	socket_socketpair,
+
+	socket_send_external
 };
 
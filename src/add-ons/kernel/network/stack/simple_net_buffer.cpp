@@ -83,6 +83,8 @@ copy_metadata(net_buffer *destination, const net_buffer *source)
 	destination->size = source->size;
 	destination->protocol = source->protocol;
 	destination->type = source->type;
+	destination->offload = source->offload;
+	destination->segment_size = source->segment_size;
 }
 
 
@@ -111,6 +113,8 @@ create_buffer(size_t headerSpace)
 	buffer->offset = 0;
 	buffer->flags = 0;
 	buffer->size = 0;
+	buffer->offload = 0;
+	buffer->segment_size = 0;
 
 	buffer->type = -1;
 
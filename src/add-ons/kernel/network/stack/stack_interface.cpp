@@ -244,6 +244,15 @@ stack_interface_get_next_socket_stat(int family, uint32* cookie,
 }
 
 
+static ssize_t
+stack_interface_send_external(net_socket* socket, const void* data,
+	size_t length, int flags, BReferenceable* reference)
+{
+	return gNetSocketModule.send_external(socket, data, length, flags,
+		reference);
+}
+
+
 static status_t
 stack_interface_std_ops(int32 op, ...)
 {
@@ -298,5 +307,7 @@ net_stack_interface_module_info gNetStackInterfaceModule = {
 	&stack_interface_select,
 	&stack_interface_deselect,
 
-	&stack_interface_get_next_socket_stat
+	&stack_interface_get_next_socket_stat,
+
+	&stack_interface_send_external
 };
@@ -361,6 +361,33 @@ fifo_enqueue_buffer(net_fifo* fifo, net_buffer* buffer)
 }
 
 
+/*!	Appends as many of the \a buffers to the FIFO as fit, and wakes up a
+	single reader for all of them. Returns the number of buffers that were
+	added; the caller keeps the others.
+*/
+ssize_t
+fifo_enqueue_buffers(net_fifo* fifo, net_buffer** buffers, size_t count)
+{
+	MutexLocker locker(fifo->lock);
+
+	size_t added = 0;
+	for (; added < count; added++) {
+		net_buffer* buffer = buffers[added];
+		if (fifo->max_bytes > 0
+			&& fifo->current_bytes + buffer->size > fifo->max_bytes)
+			break;
+
+		list_add_item(&fifo->buffers, buffer);
+		fifo->current_bytes += buffer->size;
+	}
+
+	if (added > 0)
+		fifo_notify_one_reader(fifo->waiting, fifo->notify);
+
+	return added;
+}
+
+
 /*!	Gets the first buffer from the FIFO. If there is no buffer, it
 	will wait depending on the \a flags and \a timeout.
 	The following flags are supported (the rest is ignored):
@@ -425,6 +452,48 @@ fifo_dequeue_buffer(net_fifo* fifo, uint32 flags, bigtime_t timeout,
 }
 
 
+/*!	Like fifo_dequeue_buffer(), but removes up to \a count buffers at once,
+	and only waits if the FIFO is empty. MSG_PEEK is not supported.
+	Returns the number of buffers that were stored in \a buffers.
+*/
+ssize_t
+fifo_dequeue_buffers(net_fifo* fifo, uint32 flags, bigtime_t timeout,
+	net_buffer** buffers, size_t count)
+{
+	MutexLocker locker(fifo->lock);
+	bool dontWait = (flags & MSG_DONTWAIT) != 0 || timeout == 0;
+
+	while (list_is_empty(&fifo->buffers)) {
+		if (dontWait)
+			return B_WOULD_BLOCK;
+
+		fifo->waiting++;
+		locker.Unlock();
+
+		// we need to wait until a new buffer becomes available
+		status_t status = acquire_sem_etc(fifo->notify, 1,
+			B_CAN_INTERRUPT | B_RELATIVE_TIMEOUT, timeout);
+		if (status < B_OK)
+			return status;
+
+		locker.Lock();
+	}
+
+	size_t dequeued = 0;
+	while (dequeued < count) {
+		net_buffer* buffer
+			= (net_buffer*)list_remove_head_item(&fifo->buffers);
+		if (buffer == NULL)
+			break;
+
+		fifo->current_bytes -= buffer->size;
+		buffers[dequeued++] = buffer;
+	}
+
+	return dequeued;
+}
+
+
 status_t
 clear_fifo(net_fifo* fifo)
 {
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+//!	Defragments the files, directories, and indices of a mounted BFS volume
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fs_index.h>
+#include <fs_info.h>
+
+#include "bfs_control.h"
+
+
+extern "C" const char* __progname;
+static const char* kProgramName = __progname;
+
+
+struct defrag_stats {
+	uint64	nodes;
+	uint64	fragmented;
+	uint64	defragmented;
+	uint64	skipped;
+	uint64	fragments_before;
+	uint64	fragments_after;
+	uint64	blocks_moved;
+};
+
+static int sVolumeFD;
+static dev_t sDevice;
+static bool sDryRun;
+static bool sVerbose;
+static defrag_stats sStats;
+
+
+void
+usage(FILE* output)
+{
+	fprintf(output,
+		"Usage: %s <options> <volume>\n"
+		"\n"
+		"Moves the data of every fragmented file, directory, and index of the\n"
+		"mounted BFS volume into a single contiguous range.\n"
+		"\n"
+		"Options:\n"
+		"  -h, --help        - print this help text\n"
+		"  -n, --dry-run     - only report fragmentation, do not move anything\n"
+		"  -v, --verbose     - print every node that is fragmented\n",
+		kProgramName);
+}
+
+
+static void
+defragment_node(ino_t inode, const char* name)
+{
+	defragment_control control;
+	memset(&control, 0, sizeof(control));
+	control.magic = BFS_IOCTL_DEFRAGMENT_MAGIC;
+	control.flags = sDryRun ? BFS_DEFRAGMENT_DRY_RUN : 0;
+	control.inode = inode;
+
+	sStats.nodes++;
+
+	if (ioctl(sVolumeFD, BFS_IOCTL_DEFRAGMENT_NODE, &control,
+			sizeof(control)) != 0) {
+		fprintf(stderr, "%s: could not defragment \"%s\": %s\n", kProgramName,
+			name, strerror(errno));
+		sStats.skipped++;
+		return;
+	}
+
+	if (control.fragments_before <= 1)
+		return;
+
+	sStats.fragmented++;
+	sStats.fragments_before += control.fragments_before;
+
+	if (control.status != B_OK) {
+		sStats.fragments_after += control.fragments_before;
+		sStats.skipped++;
+		if (sVerbose) {
+			printf("%s: %" B_PRIu32 " fragments, skipped: %s\n", name,
+				control.fragments_before, strerror(control.status));
+		}
+		return;
+	}
+
+	sStats.fragments_after += control.fragments_after;
+	sStats.blocks_moved += control.blocks_moved;
+	if (control.fragments_after < control.fragments_before)
+		sStats.defragmented++;
+
+	if (sVerbose) {
+		printf("%s: %" B_PRIu32 " -> %" B_PRIu32 " fragments\n", name,
+			control.fragments_before, control.fragments_after);
+	}
+}
+
+
+static void
+defragment_directory(const char* path)
+{
+	DIR* dir = opendir(path);
+	if (dir == NULL) {
+		fprintf(stderr, "%s: could not open \"%s\": %s\n", kProgramName, path,
+			strerror(errno));
+		return;
+	}
+
+	while (struct dirent* entry = readdir(dir)) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+
+		char entryPath[B_PATH_NAME_LENGTH];
+		snprintf(entryPath, sizeof(entryPath), "%s/%s", path, entry->d_name);
+
+		struct stat st;
+		if (lstat(entryPath, &st) != 0 || st.st_dev != sDevice) {
+			// ignore everything that doesn't belong to this volume
+			continue;
+		}
+
+		defragment_node(st.st_ino, entryPath);
+
+		if (S_ISDIR(st.st_mode))
+			defragment_directory(entryPath);
+	}
+
+	closedir(dir);
+}
+
+
+static void
+defragment_indices()
+{
+	DIR* indices = fs_open_index_dir(sDevice);
+	if (indices == NULL)
+		return;
+
+	while (struct dirent* entry = fs_read_index_dir(indices)) {
+		char name[B_FILE_NAME_LENGTH + 16];
+		snprintf(name, sizeof(name), "index \"%s\"", entry->d_name);
+
+		defragment_node(entry->d_ino, name);
+	}
+
+	fs_close_index_dir(indices);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	const struct option kLongOptions[] = {
+		{ "help", 0, NULL, 'h' },
+		{ "dry-run", 0, NULL, 'n' },
+		{ "verbose", 0, NULL, 'v' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char* kShortOptions = "hnv";
+
+	while (true) {
+		int nextOption = getopt_long(argc, argv, kShortOptions, kLongOptions,
+			NULL);
+		if (nextOption == -1)
+			break;
+
+		switch (nextOption) {
+			case 'h':	// --help
+				usage(stdout);
+				return 0;
+			case 'n':	// --dry-run
+				sDryRun = true;
+				break;
+			case 'v':	// --verbose
+				sVerbose = true;
+				break;
+			default:	// everything else
+				usage(stderr);
+				return 1;
+		}
+	}
+
+	// the volume should be the only non-option element
+	if (optind != argc - 1) {
+		usage(stderr);
+		return 1;
+	}
+
+	const char* path = argv[optind];
+
+	sVolumeFD = open(path, O_RDONLY);
+	if (sVolumeFD < 0) {
+		fprintf(stderr, "%s: could not open \"%s\": %s\n", kProgramName, path,
+			strerror(errno));
+		return 1;
+	}
+
+	struct stat st;
+	fs_info info;
+	if (fstat(sVolumeFD, &st) != 0 || fs_stat_dev(st.st_dev, &info) != 0) {
+		fprintf(stderr, "%s: could not stat \"%s\": %s\n", kProgramName, path,
+			strerror(errno));
+		return 1;
+	}
+	if (strcmp(info.fsh_name, "bfs")) {
+		fprintf(stderr, "%s: \"%s\" is not on a BFS volume\n", kProgramName,
+			path);
+		return 1;
+	}
+	if (!sDryRun && (info.flags & B_FS_IS_READONLY) != 0) {
+		fprintf(stderr, "%s: \"%s\" is mounted read-only\n", kProgramName,
+			path);
+		return 1;
+	}
+
+	sDevice = st.st_dev;
+
+	defragment_node(info.root, path);
+	defragment_directory(path);
+	defragment_indices();
+
+	close(sVolumeFD);
+
+	printf("%" B_PRIu64 " nodes, %" B_PRIu64 " fragmented", sStats.nodes,
+		sStats.fragmented);
+	if (!sDryRun) {
+		printf(", %" B_PRIu64 " defragmented, %" B_PRIu64 " skipped\n",
+			sStats.defragmented, sStats.skipped);
+		printf("%" B_PRIu64 " fragments reduced to %" B_PRIu64 ", %" B_PRIu64
+			" blocks moved\n", sStats.fragments_before, sStats.fragments_after,
+			sStats.blocks_moved);
+	} else {
+		printf(" into %" B_PRIu64 " fragments\n", sStats.fragments_before);
+	}
+
+	return 0;
+}
@@ -221,10 +221,11 @@ do_scheduling_analysis(bigtime_t startTime, bigtime_t endTime,
 		printf("  run time:    %lld us (%lld runs)\n", thread->total_run_time,
 			thread->runs);
 		printf("  wait time:   %lld us\n", waitTime);
-		printf("  latencies:   %lld us (%lld)\n", thread->total_latency,
-			thread->latencies);
+		printf("  latencies:   %lld us (%lld, max %lld us)\n",
+			thread->total_latency, thread->latencies, thread->max_latency);
 		printf("  preemptions: %lld us (%lld)\n", thread->total_rerun_time,
 			thread->reruns);
+		printf("  migrations:  %lld\n", thread->migrations);
 		printf("  unspecified: %lld us\n", thread->unspecified_wait_time);
 
 		printf("  waited on:\n");
@@ -642,6 +642,17 @@ list_interface(const char* name)
 		printf("\tCollisions: %d\n", stats.collisions);
 	}
 
+	ifreq_receive_queues queues;
+	if (interface.GetReceiveQueues(queues) == B_OK && queues.count > 1) {
+		printf("\tReceive queues: %" B_PRIu32 " (%s)\n", queues.count,
+			queues.hardware ? "hardware" : "software");
+		for (uint32 i = 0; i < queues.count; i++) {
+			printf("\t\tqueue %" B_PRIu32 ": %" B_PRIu64 " packets, %" B_PRIu64
+				" dropped\n", i, queues.queues[i].packets,
+				queues.queues[i].dropped);
+		}
+	}
+
 	putchar('\n');
 	return true;
 }
@@ -21,11 +21,16 @@
 #include <Volume.h>
 #include <VolumeRoster.h>
 
+#include <errno.h>
+#include <fs_query.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <query_private.h>
+
 
 extern const char *__progname;
 static const char *kProgramName = __progname;
@@ -35,18 +40,21 @@ static bool sAllVolumes = false;		// Query all volumes?
 static bool sEscapeMetaChars = true;	// Escape metacharacters?
 static bool sFilesOnly = false;			// Show only files?
 static bool sLocalizedAppNames = false;	// match localized names
+static bool sExplain = false;			// Show the query plan instead?
 
 
 void
 usage(void)
 {
-	printf("usage: %s [ -ef ] [ -a || -v <path-to-volume> ] expression\n"
+	printf("usage: %s [ -efx ] [ -a || -v <path-to-volume> ] expression\n"
 		"  -e\t\tdon't escape meta-characters\n"
 		"  -f\t\tshow only files (ie. no directories or symbolic links)\n"
 		"  -l\t\tmatch expression with localized application names\n"
 		"  -a\t\tperform the query on all volumes\n"
 		"  -v <file>\tperform the query on just one volume; <file> can be any\n"
 		"\t\tfile on that volume. Defaults to the current volume.\n"
+		"  -x, --explain\tshow how the file system would run the query, and\n"
+		"\t\tits estimates, instead of running it\n"
 		"  Hint: '%s name=foo' will find files named \"foo\"\n",
 		kProgramName, kProgramName);
 	exit(0);
@@ -110,6 +118,56 @@ perform_query(BVolume &volume, const char *predicate)
 }
 
 
+void
+explain_query(BVolume &volume, const char *predicate)
+{
+	DIR *query = fs_open_query(volume.Device(), predicate, B_QUERY_EXPLAIN);
+	if (query == NULL && errno == B_BAD_VALUE) {
+		// the "name=" part may be omitted in our arguments
+		BString string = "name=";
+		string << predicate;
+
+		query = fs_open_query(volume.Device(), string.String(),
+			B_QUERY_EXPLAIN);
+	}
+	if (query == NULL) {
+		fprintf(stderr, "%s: bad query expression\n", kProgramName);
+		return;
+	}
+
+	char name[B_FILE_NAME_LENGTH];
+	if (volume.GetName(name) != B_OK)
+		strcpy(name, "unknown");
+
+	printf("%s:\n", name);
+
+	int count = 0;
+	while (struct dirent *dirent = fs_read_query(query)) {
+		if (dirent->d_ino != 0) {
+			// this is a real entry, the file system ignored the flag
+			count = 0;
+			break;
+		}
+		printf("  %s\n", dirent->d_name);
+		count++;
+	}
+	if (count == 0)
+		printf("  the file system cannot explain its queries\n");
+
+	fs_close_query(query);
+}
+
+
+void
+run_query(BVolume &volume, const char *predicate)
+{
+	if (sExplain)
+		explain_query(volume, predicate);
+	else
+		perform_query(volume, predicate);
+}
+
+
 int
 main(int argc, char **argv)
 {
@@ -123,8 +181,14 @@ main(int argc, char **argv)
 	strcpy(volumePath, ".");
 
 	// Parse command-line arguments.
+	const struct option kLongOptions[] = {
+		{ "explain", 0, NULL, 'x' },
+		{ NULL, 0, NULL, 0 }
+	};
+
 	int opt;
-	while ((opt = getopt(argc, argv, "efalv:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "efalv:x", kLongOptions, NULL))
+			!= -1) {
 		switch(opt) {
 			case 'e':
 				sEscapeMetaChars = false;
@@ -141,6 +205,9 @@ main(int argc, char **argv)
 			case 'v':
 				strlcpy(volumePath, optarg, B_FILE_NAME_LENGTH);
 				break;
+			case 'x':
+				sExplain = true;
+				break;
 
 			default:
 				usage();
@@ -168,7 +235,7 @@ main(int argc, char **argv)
 		if (!volume.KnowsQuery())
 			fprintf(stderr, "%s: volume containing %s is not query-enabled\n", kProgramName, volumePath);
 		else
-			perform_query(volume, argv[optind]);
+			run_query(volume, argv[optind]);
 	} else {
 		// Okay, we want to query all the disks -- so iterate over
 		// them, one by one, running the query.
@@ -177,7 +244,7 @@ main(int argc, char **argv)
 			// We don't print errors here -- this will catch /pipe and
 			// other filesystems we don't care about.
 			if (volume.KnowsQuery())
-				perform_query(volume, argv[optind]);
+				run_query(volume, argv[optind]);
 		}
 	}
 
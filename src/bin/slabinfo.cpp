@@ -0,0 +1,225 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include <object_cache_defs.h>
+#include <syscalls.h>
+
+
+static struct option const kLongOptions[] = {
+	{"rate", required_argument, 0, 'r'},
+	{"help", no_argument, 0, 'h'},
+	{NULL}
+};
+
+extern const char *__progname;
+static const char *kProgramName = __progname;
+
+
+struct cache_sample {
+	object_cache_info	info;
+	uint64				allocations;
+	uint64				misses;
+};
+
+
+void
+usage(int status)
+{
+	fprintf(stderr, "usage: %s [-r <time>]\n"
+		"Lists the kernel's object caches, sorted by their memory usage.\n"
+		" -r,--rate\tLists the allocations and depot misses per second,\n"
+		"\t\tmeasured over <time> milli seconds.\n", kProgramName);
+
+	exit(status);
+}
+
+
+static int
+compare_usage(const void* _a, const void* _b)
+{
+	const cache_sample* a = (const cache_sample*)_a;
+	const cache_sample* b = (const cache_sample*)_b;
+	size_t usageA = a->info.memory_usage + a->info.depot_memory_usage;
+	size_t usageB = b->info.memory_usage + b->info.depot_memory_usage;
+	if (usageA != usageB)
+		return usageA > usageB ? -1 : 1;
+	return strcmp(a->info.name, b->info.name);
+}
+
+
+static int
+compare_allocations(const void* _a, const void* _b)
+{
+	const cache_sample* a = (const cache_sample*)_a;
+	const cache_sample* b = (const cache_sample*)_b;
+	if (a->allocations != b->allocations)
+		return a->allocations > b->allocations ? -1 : 1;
+	return compare_usage(_a, _b);
+}
+
+
+static cache_sample*
+get_samples(int32& _count)
+{
+	int32 count = 0;
+	int32 size = 64;
+	cache_sample* samples = (cache_sample*)malloc(size * sizeof(cache_sample));
+
+	int32 cookie = 0;
+	object_cache_info info;
+	while (samples != NULL && _kern_get_next_object_cache_info(&cookie, &info,
+			sizeof(object_cache_info)) == B_OK) {
+		if (count == size) {
+			size *= 2;
+			cache_sample* newSamples = (cache_sample*)realloc(samples,
+				size * sizeof(cache_sample));
+			if (newSamples == NULL) {
+				free(samples);
+				samples = NULL;
+				break;
+			}
+			samples = newSamples;
+		}
+
+		samples[count].info = info;
+		samples[count].allocations = info.allocations;
+		samples[count].misses = info.depot_misses;
+		count++;
+	}
+
+	if (samples == NULL) {
+		fprintf(stderr, "%s: out of memory\n", kProgramName);
+		exit(1);
+	}
+
+	_count = count;
+	return samples;
+}
+
+
+static void
+list_caches()
+{
+	int32 count;
+	cache_sample* samples = get_samples(count);
+	qsort(samples, count, sizeof(cache_sample), &compare_usage);
+
+	printf("%-24s %7s %9s %9s %9s %12s %5s %10s %10s %4s\n", "name",
+		"objsize", "used", "total", "memory", "allocations", "hit%",
+		"exchanges", "contended", "mag");
+
+	for (int32 i = 0; i < count; i++) {
+		const object_cache_info& info = samples[i].info;
+		uint64 depotRequests = info.depot_hits + info.depot_misses;
+
+		printf("%-24s %7" B_PRIuSIZE " %9" B_PRIuSIZE " %9" B_PRIuSIZE
+			" %8" B_PRIuSIZE "K %12" B_PRIu64 " ", info.name,
+			info.object_size, info.used_objects, info.total_objects,
+			(info.memory_usage + info.depot_memory_usage) / 1024,
+			info.allocations);
+		if ((info.flags & B_OBJECT_CACHE_NO_DEPOT) != 0) {
+			printf("%5s %10s %10s %4s\n", "-", "-", "-", "-");
+			continue;
+		}
+
+		printf("%5" B_PRIu64 " %10" B_PRIu64 " %10" B_PRIu64 " %4" B_PRIu32
+			"\n",
+			depotRequests > 0 ? info.depot_hits * 100 / depotRequests : 0,
+			info.full_magazine_exchanges + info.empty_magazine_exchanges,
+			info.depot_contention, info.magazine_capacity);
+	}
+
+	free(samples);
+}
+
+
+static void
+list_rates(bigtime_t interval)
+{
+	int32 firstCount;
+	cache_sample* first = get_samples(firstCount);
+
+	snooze(interval);
+
+	int32 count;
+	cache_sample* samples = get_samples(count);
+
+	// turn the counters into the number of events per second
+	for (int32 i = 0; i < count; i++) {
+		cache_sample& sample = samples[i];
+		for (int32 j = 0; j < firstCount; j++) {
+			if (strcmp(first[j].info.name, sample.info.name) != 0
+				|| first[j].info.object_size != sample.info.object_size) {
+				continue;
+			}
+
+			sample.allocations -= first[j].allocations;
+			sample.misses -= first[j].misses;
+			break;
+		}
+
+		sample.allocations = sample.allocations * 1000000 / interval;
+		sample.misses = sample.misses * 1000000 / interval;
+	}
+
+	qsort(samples, count, sizeof(cache_sample), &compare_allocations);
+
+	printf("%-24s %9s %12s %12s\n", "name", "memory", "allocs/s",
+		"misses/s");
+	for (int32 i = 0; i < count; i++) {
+		const cache_sample& sample = samples[i];
+		printf("%-24s %8" B_PRIuSIZE "K %12" B_PRIu64 " %12" B_PRIu64 "\n",
+			sample.info.name,
+			(sample.info.memory_usage + sample.info.depot_memory_usage) / 1024,
+			sample.allocations, sample.misses);
+	}
+
+	free(first);
+	free(samples);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	bigtime_t rate = 0;
+
+	int c;
+	while ((c = getopt_long(argc, argv, "r:h", kLongOptions, NULL)) != -1) {
+		switch (c) {
+			case 0:
+				break;
+			case 'r':
+				rate = atoi(optarg) * 1000LL;
+				if (rate <= 0) {
+					fprintf(stderr, "%s: Invalid rate: %s\n",
+						kProgramName, optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				usage(0);
+				break;
+			default:
+				usage(1);
+				break;
+		}
+	}
+
+	if (rate > 0)
+		list_rates(rate);
+	else
+		list_caches();
+
+	return 0;
+}
@@ -7,6 +7,7 @@
 
 
 #include <OS.h>
+#include <scheduler.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -683,6 +684,16 @@ dump_cpus(system_info *info)
 }
 
 
+static void
+dump_scheduler()
+{
+	int32 mode = get_scheduler_mode();
+	printf("Scheduler mode: %s\n\n", mode == SCHEDULER_MODE_THROUGHPUT
+		? "throughput" : mode == SCHEDULER_MODE_LOW_LATENCY
+			? "low latency" : "unknown");
+}
+
+
 static void
 dump_mem(system_info *info)
 {
@@ -693,6 +704,8 @@ dump_mem(system_info *info)
 		B_PAGE_SIZE * (uint64)info->max_pages);
 	printf("                           (cached   %10" B_PRIu64 ")\n",
 		B_PAGE_SIZE * (uint64)info->cached_pages);
+	printf("                           (large pages %7" B_PRIu64 ")\n",
+		B_PAGE_SIZE * (uint64)info->large_pages);
 }
 
 
@@ -751,6 +764,7 @@ dump_system_info(system_info *info)
 {
 	dump_kinfo(info);
 	dump_cpus(info);
+	dump_scheduler();
 	dump_mem(info);
 	dump_sem(info);
 	dump_ports(info);
@@ -784,6 +798,8 @@ main(int argc, char *argv[])
 					info.id[1]);
 			} else if (strncmp(opt, "-cpu", strlen(opt)) == 0) {
 				dump_cpus(&info);
+			} else if (strncmp(opt, "-scheduler", strlen(opt)) == 0) {
+				dump_scheduler();
 			} else if (strncmp(opt, "-mem", strlen(opt)) == 0) {
 				dump_mem(&info);
 			} else if (strncmp(opt, "-semaphores", strlen(opt)) == 0) {
@@ -809,7 +825,7 @@ main(int argc, char *argv[])
 					name++;
 
 				fprintf(stderr, "Usage:\n");
-				fprintf(stderr, "  %s [-id|-cpu|-mem|-semaphore|-ports|-threads|-teams|-platform|-disable_cpu_sn|-kinfo]\n", name);
+				fprintf(stderr, "  %s [-id|-cpu|-scheduler|-mem|-semaphore|-ports|-threads|-teams|-platform|-disable_cpu_sn|-kinfo]\n", name);
 				return 0;
 			}
 		}
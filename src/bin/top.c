@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <OS.h>
+#include <scheduler.h>
 #include <termcap.h>
 #include <termios.h>
 
@@ -285,13 +286,15 @@ compare(
 		}
 	}
 	free_times(&times);
-	printf("------ %7.2f %7.2f %7.2f %4.1f%% TOTAL (%4.1f%% idle time, %4.1f%% unknown)", 
+	printf("------ %7.2f %7.2f %7.2f %4.1f%% TOTAL (%4.1f%% idle time, %4.1f%% unknown, %s)", 
 		   (double) (gtotal / 1000),
 		   (double) (utotal / 1000),
 		   (double) (ktotal / 1000),
 		   cpu_perc(gtotal, uinterval),
 		   cpu_perc(idletime, uinterval),
-		   cpu_perc(cpus * uinterval - (gtotal + idletime), uinterval));
+		   cpu_perc(cpus * uinterval - (gtotal + idletime), uinterval),
+		   get_scheduler_mode() == SCHEDULER_MODE_THROUGHPUT
+				? "throughput mode" : "low latency mode");
 	fflush(stdout);
 	if (!refresh) {
 		printf("\n\n");
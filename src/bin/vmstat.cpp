@@ -14,6 +14,7 @@
 
 static struct option const kLongOptions[] = {
 	{"periodic", no_argument, 0, 'p'},
+	{"numa", no_argument, 0, 'n'},
 	{"rate", required_argument, 0, 'r'},
 	{"help", no_argument, 0, 'h'},
 	{NULL}
@@ -26,29 +27,68 @@ static const char *kProgramName = __progname;
 void
 usage(int status)
 {
-	fprintf(stderr, "usage: %s [-p] [-r <time>]\n"
+	fprintf(stderr, "usage: %s [-p] [-r <time>] [-n]\n"
 		" -p,--periodic\tDumps changes periodically every second.\n"
-		" -r,--rate\tDumps changes periodically every <time> milli seconds.\n",
+		" -r,--rate\tDumps changes periodically every <time> milli seconds.\n"
+		" -n,--numa\tDumps the memory usage of the NUMA nodes.\n",
 		kProgramName);
 
 	exit(status);
 }
 
 
+static int
+dump_numa_info()
+{
+	system_numa_info info;
+	status_t status = __get_system_info_etc(B_NUMA_INFO, &info,
+		sizeof(system_numa_info));
+	if (status != B_OK) {
+		fprintf(stderr, "%s: cannot get NUMA info: %s\n", kProgramName,
+			strerror(status));
+		return 1;
+	}
+
+	system_info systemInfo;
+	get_system_info(&systemInfo);
+
+	puts("node  total memory   free memory  remote allocs  distances");
+	for (uint32 i = 0; i < info.node_count; i++) {
+		const system_numa_node_info& node = info.nodes[i];
+		printf("%4" B_PRIu32 "  %12" B_PRIu64 "  %12" B_PRIu64 "  %13" B_PRIu64
+			" ", i, node.total_memory, node.free_memory,
+			node.remote_allocations);
+		for (uint32 j = 0; j < info.node_count; j++)
+			printf(" %3u", node.distance[j]);
+		putchar('\n');
+	}
+
+	puts("\ncpu  node");
+	for (uint32 i = 0; i < systemInfo.cpu_count; i++)
+		printf("%3" B_PRIu32 "  %4" B_PRIu32 "\n", i, info.cpu_node[i]);
+
+	return 0;
+}
+
+
 int
 main(int argc, char** argv)
 {
 	bool periodically = false;
+	bool numa = false;
 	bigtime_t rate = 1000000LL;
 
 	int c;
-	while ((c = getopt_long(argc, argv, "pr:h", kLongOptions, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "pnr:h", kLongOptions, NULL)) != -1) {
 		switch (c) {
 			case 0:
 				break;
 			case 'p':
 				periodically = true;
 				break;
+			case 'n':
+				numa = true;
+				break;
 			case 'r':
 				rate = atoi(optarg) * 1000LL;
 				if (rate <= 0) {
@@ -66,6 +106,10 @@ main(int argc, char** argv)
 				break;
 		}
 	}
+
+	if (numa)
+		return dump_numa_info();
+
 	system_memory_info info;
 	status_t status = __get_system_info_etc(B_MEMORY_INFO, &info,
 		sizeof(system_memory_info));
@@ -323,6 +323,20 @@ BNetworkInterface::GetStats(ifreq_stats& stats)
 }
 
 
+status_t
+BNetworkInterface::GetReceiveQueues(ifreq_receive_queues& queues)
+{
+	ifqueuesreq request;
+	status_t status = do_request(AF_INET, request, Name(),
+		B_SOCKET_GET_RECEIVE_QUEUES);
+	if (status != B_OK)
+		return status;
+
+	memcpy(&queues, &request.ifq_queues, sizeof(ifreq_receive_queues));
+	return B_OK;
+}
+
+
 bool
 BNetworkInterface::HasLink() const
 {
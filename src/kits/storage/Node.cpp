@@ -265,6 +265,41 @@ BNode::GetAttrInfo(const char *name, struct attr_info *info) const
 }
 
 
+/*!	Reads several attributes with as few calls into the kernel as possible.
+	Attributes with a \c NULL buffer are only stat()ed. The outcome for each
+	attribute is stored in its attr_vec::result; returns the number of
+	attributes that could be read, or an error code.
+*/
+ssize_t
+BNode::ReadAttrs(struct attr_vec* vecs, size_t count) const
+{
+	if (fCStatus != B_OK)
+		return B_FILE_ERROR;
+	if (vecs == NULL && count > 0)
+		return B_BAD_VALUE;
+
+	ssize_t result = fs_read_attrs(fFd, vecs, count);
+	return result < 0 ? errno : result;
+}
+
+
+/*!	Replaces the contents of several attributes at once, with the type given
+	in each attr_vec::info. Returns the number of attributes that could be
+	written, or an error code.
+*/
+ssize_t
+BNode::WriteAttrs(struct attr_vec* vecs, size_t count)
+{
+	if (fCStatus != B_OK)
+		return B_FILE_ERROR;
+	if (vecs == NULL && count > 0)
+		return B_BAD_VALUE;
+
+	ssize_t result = fs_write_attrs(fFd, vecs, count);
+	return result < 0 ? errno : result;
+}
+
+
 status_t
 BNode::GetNextAttrName(char *buffer)
 {
@@ -319,6 +319,177 @@ smp_do_acpi_config(void)
 }
 
 
+static int32
+numa_node_for_domain(uint32* domains, uint32 domain)
+{
+	for (uint32 i = 0; i < gKernelArgs.num_numa_nodes; i++) {
+		if (domains[i] == domain)
+			return i;
+	}
+
+	if (gKernelArgs.num_numa_nodes == MAX_NUMA_NODES)
+		return -1;
+
+	domains[gKernelArgs.num_numa_nodes] = domain;
+	return gKernelArgs.num_numa_nodes++;
+}
+
+
+/*!	Reads the NUMA topology from the ACPI SRAT and SLIT tables. Proximity
+	domains are compacted into node numbers starting at 0. If the topology
+	cannot be represented, it is ignored and memory is treated as a single
+	node.
+*/
+static void
+smp_do_acpi_numa_config(void)
+{
+	gKernelArgs.num_numa_nodes = 0;
+	gKernelArgs.num_numa_memory_ranges = 0;
+
+	acpi_srat *srat = (acpi_srat *)acpi_find_table(ACPI_SRAT_SIGNATURE);
+	if (srat == NULL) {
+		TRACE(("smp: no SRAT, not a NUMA system\n"));
+		return;
+	}
+
+	uint32 domains[MAX_NUMA_NODES];
+	uint32 cpuDomainFound = 0;
+
+	acpi_apic *entry = (acpi_apic *)((uint8 *)srat + sizeof(acpi_srat));
+	acpi_apic *end = (acpi_apic *)((uint8 *)srat + srat->header.length);
+	while (entry < end && entry->length > 0) {
+		int32 node = -1;
+		switch (entry->type) {
+			case ACPI_SRAT_PROCESSOR_AFFINITY:
+			{
+				acpi_srat_processor_affinity *affinity
+					= (acpi_srat_processor_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_ENABLED) == 0)
+					break;
+
+				uint32 domain = affinity->proximity_domain_low
+					| (affinity->proximity_domain_high[0] << 8)
+					| (affinity->proximity_domain_high[1] << 16)
+					| (affinity->proximity_domain_high[2] << 24);
+				node = numa_node_for_domain(domains, domain);
+				if (node < 0)
+					goto invalid;
+
+				for (uint32 i = 0; i < gKernelArgs.num_cpus; i++) {
+					if (gKernelArgs.arch_args.cpu_apic_id[i]
+							== affinity->apic_id) {
+						gKernelArgs.cpu_numa_node[i] = node;
+						cpuDomainFound |= 1 << i;
+					}
+				}
+				break;
+			}
+
+			case ACPI_SRAT_X2_APIC_AFFINITY:
+			{
+				acpi_srat_x2_apic_affinity *affinity
+					= (acpi_srat_x2_apic_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_ENABLED) == 0)
+					break;
+
+				node = numa_node_for_domain(domains,
+					affinity->proximity_domain);
+				if (node < 0)
+					goto invalid;
+
+				for (uint32 i = 0; i < gKernelArgs.num_cpus; i++) {
+					if (gKernelArgs.arch_args.cpu_apic_id[i]
+							== affinity->x2apic_id) {
+						gKernelArgs.cpu_numa_node[i] = node;
+						cpuDomainFound |= 1 << i;
+					}
+				}
+				break;
+			}
+
+			case ACPI_SRAT_MEMORY_AFFINITY:
+			{
+				acpi_srat_memory_affinity *affinity
+					= (acpi_srat_memory_affinity *)entry;
+				if ((affinity->flags & ACPI_SRAT_ENABLED) == 0
+					|| affinity->length_in_bytes == 0) {
+					break;
+				}
+
+				node = numa_node_for_domain(domains,
+					affinity->proximity_domain);
+				if (node < 0)
+					goto invalid;
+				if (gKernelArgs.num_numa_memory_ranges
+						== MAX_NUMA_MEMORY_RANGES) {
+					TRACE(("smp: too many SRAT memory ranges\n"));
+					goto invalid;
+				}
+
+				numa_addr_range &range = gKernelArgs.numa_memory_range[
+					gKernelArgs.num_numa_memory_ranges++];
+				range.start = affinity->base_address;
+				range.size = affinity->length_in_bytes;
+				range.node = node;
+				TRACE(("smp: memory 0x%Lx - 0x%Lx on node %ld\n",
+					range.start, range.start + range.size, node));
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		entry = (acpi_apic *)((uint8 *)entry + entry->length);
+	}
+
+	if (gKernelArgs.num_numa_nodes <= 1
+		|| gKernelArgs.num_numa_memory_ranges == 0) {
+		// nothing to gain from a single node
+		goto invalid;
+	}
+
+	for (uint32 i = 0; i < gKernelArgs.num_cpus; i++) {
+		if ((cpuDomainFound & (1 << i)) == 0) {
+			TRACE(("smp: CPU %ld is not in the SRAT\n", i));
+			gKernelArgs.cpu_numa_node[i] = 0;
+		}
+	}
+
+	// relative distances between the nodes, 10 means local
+	for (uint32 i = 0; i < gKernelArgs.num_numa_nodes; i++) {
+		for (uint32 j = 0; j < gKernelArgs.num_numa_nodes; j++)
+			gKernelArgs.numa_distance[i][j] = i == j ? 10 : 20;
+	}
+
+	{
+		acpi_slit *slit = (acpi_slit *)acpi_find_table(ACPI_SLIT_SIGNATURE);
+		if (slit != NULL) {
+			uint64 count = slit->locality_count;
+			for (uint32 i = 0; i < gKernelArgs.num_numa_nodes; i++) {
+				for (uint32 j = 0; j < gKernelArgs.num_numa_nodes; j++) {
+					if (domains[i] >= count || domains[j] >= count)
+						continue;
+
+					uint8 distance = slit->entry[domains[i] * count
+						+ domains[j]];
+					if (distance != 0xff)
+						gKernelArgs.numa_distance[i][j] = distance;
+				}
+			}
+		}
+	}
+
+	dprintf("smp: found %lu NUMA nodes\n", gKernelArgs.num_numa_nodes);
+	return;
+
+invalid:
+	gKernelArgs.num_numa_nodes = 0;
+	gKernelArgs.num_numa_memory_ranges = 0;
+	memset(gKernelArgs.cpu_numa_node, 0, sizeof(gKernelArgs.cpu_numa_node));
+}
+
+
 static void
 calculate_apic_timer_conversion_factor(void)
 {
@@ -614,8 +785,10 @@ smp_init(void)
 	// first try to find ACPI tables to get MP configuration as it handles
 	// physical as well as logical MP configurations as in multiple cpus,
 	// multiple cores or hyper threading.
-	if (smp_do_acpi_config() == B_OK)
+	if (smp_do_acpi_config() == B_OK) {
+		smp_do_acpi_numa_config();
 		return;
+	}
 
 	// then try to find MPS tables and do configuration based on them
 	for (int32 i = 0; smp_scan_spots[i].length > 0; i++) {
@@ -506,6 +506,75 @@ dump_feature_string(int currentCPU, cpu_ent* cpu)
 #endif	// DUMP_FEATURE_STRING
 
 
+static uint32
+topology_field_width(uint32 count)
+{
+	uint32 width = 0;
+	while ((1U << width) < count)
+		width++;
+	return width;
+}
+
+
+/*!	Splits the initial APIC ID of the current CPU into package, core, and SMT
+	IDs, using the number of logical CPUs and cores per package CPUID reports.
+*/
+static void
+detect_cpu_topology(int currentCPU, cpu_ent* cpu, uint32 maxBasicLeaf,
+	uint32 maxExtendedLeaf)
+{
+	cpuid_info cpuid;
+	get_current_cpuid(&cpuid, 1);
+	uint32 apicID = cpuid.eax_1.apic_id;
+
+	uint32 logicalCPUs = 1;
+	if ((cpu->arch.feature[FEATURE_COMMON] & IA32_FEATURE_HTT) != 0
+		&& cpuid.eax_1.logical_cpus > 1) {
+		logicalCPUs = cpuid.eax_1.logical_cpus;
+	}
+
+	uint32 cores = 1;
+	if (cpu->arch.vendor == VENDOR_INTEL && maxBasicLeaf >= 4) {
+		get_current_cpuid(&cpuid, 4);
+		cores = (cpuid.regs.eax >> 26) + 1;
+	} else if (cpu->arch.vendor == VENDOR_AMD
+		&& maxExtendedLeaf >= 0x80000008) {
+		// ECX[7:0] is the number of logical CPUs per package minus one, not
+		// the number of cores. The threads per core are only known with the
+		// topology extensions (leaf 0x8000001e, EBX[15:8]).
+		get_current_cpuid(&cpuid, 0x80000008);
+		uint32 threads = (cpuid.regs.ecx & 0xff) + 1;
+
+		uint32 threadsPerCore = 1;
+		if (maxExtendedLeaf >= 0x8000001e) {
+			get_current_cpuid(&cpuid, 0x80000001);
+			if ((cpuid.regs.ecx & (1 << 22)) != 0) {
+				get_current_cpuid(&cpuid, 0x8000001e);
+				threadsPerCore = ((cpuid.regs.ebx >> 8) & 0xff) + 1;
+			}
+		}
+
+		if (threads > logicalCPUs)
+			logicalCPUs = threads;
+		cores = threads / threadsPerCore;
+		if (cores == 0)
+			cores = 1;
+	}
+	if (cores > logicalCPUs)
+		cores = logicalCPUs;
+
+	uint32 smtWidth = topology_field_width(logicalCPUs / cores);
+	uint32 coreWidth = topology_field_width(cores);
+
+	cpu->smt_id = apicID & ((1U << smtWidth) - 1);
+	cpu->core_id = (apicID >> smtWidth) & ((1U << coreWidth) - 1);
+	cpu->package_id = apicID >> (smtWidth + coreWidth);
+
+	dprintf("CPU %d: package %" B_PRId32 ", core %" B_PRId32 ", smt %" B_PRId32
+		"\n", currentCPU, cpu->package_id, cpu->core_id, cpu->smt_id);
+}
+
+
 static void
 detect_cpu(int currentCPU)
 {
@@ -621,6 +690,8 @@ detect_cpu(int currentCPU)
 		cpu->arch.feature[FEATURE_6_ECX] = cpuid.regs.ecx;
 	}
 
+	detect_cpu_topology(currentCPU, cpu, maxBasicLeaf, maxExtendedLeaf);
+
 #if DUMP_FEATURE_STRING
 	dump_feature_string(currentCPU, cpu);
 #endif
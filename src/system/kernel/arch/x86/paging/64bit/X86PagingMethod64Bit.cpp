@@ -333,10 +333,11 @@ X86PagingMethod64Bit::PageTableForAddress(uint64* virtualPML4,
 		mapCount++;
 	}
 
-	// No proper large page support at the moment, but they are used for the
-	// physical map area. Ensure that nothing tries to treat that as normal
-	// address space.
-	ASSERT(!(*pde & X86_64_PDE_LARGE_PAGE));
+	// Large pages don't have a page table. The translation map's range
+	// operations deal with them explicitly, anything else treats them as not
+	// mapped.
+	if ((*pde & X86_64_PDE_LARGE_PAGE) != 0)
+		return NULL;
 
 	return (uint64*)pageMapper->GetPageTableAt(*pde & X86_64_PDE_ADDRESS_MASK);
 }
@@ -384,3 +385,27 @@ X86PagingMethod64Bit::PutPageTableEntryInTable(uint64* entry,
 	SetTableEntry(entry, page);
 }
 
+
+/*static*/ void
+X86PagingMethod64Bit::PutLargePageEntryInDirectory(uint64* entry,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	bool globalPage)
+{
+	uint64 page = (physicalAddress & X86_64_PDE_ADDRESS_MASK)
+		| X86_64_PDE_PRESENT | X86_64_PDE_LARGE_PAGE
+		| (globalPage ? X86_64_PDE_GLOBAL : 0)
+		| MemoryTypeToPageTableEntryFlags(memoryType);
+
+	if ((attributes & B_USER_PROTECTION) != 0) {
+		page |= X86_64_PDE_USER;
+		if ((attributes & B_WRITE_AREA) != 0)
+			page |= X86_64_PDE_WRITABLE;
+		if ((attributes & B_EXECUTE_AREA) == 0
+			&& x86_check_feature(IA32_FEATURE_AMD_EXT_NX, FEATURE_EXT_AMD)) {
+			page |= X86_64_PDE_NOT_EXECUTABLE;
+		}
+	} else if ((attributes & B_KERNEL_WRITE_AREA) != 0)
+		page |= X86_64_PDE_WRITABLE;
+
+	SetTableEntry(entry, page);
+}
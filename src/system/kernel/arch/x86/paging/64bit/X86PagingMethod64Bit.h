@@ -84,6 +84,10 @@ public:
 									uint64* entry, phys_addr_t physicalAddress,
 									uint32 attributes, uint32 memoryType,
 									bool globalPage);
+	static	void				PutLargePageEntryInDirectory(
+									uint64* entry, phys_addr_t physicalAddress,
+									uint32 attributes, uint32 memoryType,
+									bool globalPage);
 	static	uint64				SetTableEntry(uint64* entry, uint64 newEntry);
 	static	uint64				SetTableEntryFlags(uint64* entry, uint64 flags);
 	static	uint64				TestAndSetTableEntry(uint64* entry,
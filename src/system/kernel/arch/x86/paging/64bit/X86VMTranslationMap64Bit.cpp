@@ -32,6 +32,62 @@
 #endif
 
 
+/*!	Does the bookkeeping for a page of \a area that has been unmapped: the
+	accessed and modified flags are transferred to the page and the area's
+	mapping object is removed (and added to \a mappings to be freed by the
+	caller) or the page's wired count is decremented.
+	The caller must hold the translation map lock.
+*/
+static void
+page_unmapped(VMArea* area, page_num_t pageNumber, bool accessed,
+	bool modified, bool updatePageQueue, VMAreaMappings& mappings)
+{
+	// get the page
+	vm_page* page = vm_lookup_page(pageNumber);
+	ASSERT(page != NULL);
+
+	DEBUG_PAGE_ACCESS_START(page);
+
+	// transfer the accessed/dirty flags to the page
+	if (accessed)
+		page->accessed = true;
+	if (modified)
+		page->modified = true;
+
+	// remove the mapping object/decrement the wired_count of the page
+	if (area->wiring == B_NO_LOCK) {
+		vm_page_mapping* mapping = NULL;
+		vm_page_mappings::Iterator iterator = page->mappings.GetIterator();
+		while ((mapping = iterator.Next()) != NULL) {
+			if (mapping->area == area)
+				break;
+		}
+
+		ASSERT(mapping != NULL);
+
+		area->mappings.Remove(mapping);
+		page->mappings.Remove(mapping);
+		mappings.Add(mapping);
+	} else
+		page->DecrementWiredCount();
+
+	if (!page->IsMapped()) {
+		atomic_add(&gMappedPagesCount, -1);
+
+		if (updatePageQueue) {
+			if (page->Cache()->temporary)
+				vm_page_set_state(page, PAGE_STATE_INACTIVE);
+			else if (page->modified)
+				vm_page_set_state(page, PAGE_STATE_MODIFIED);
+			else
+				vm_page_set_state(page, PAGE_STATE_CACHED);
+		}
+	}
+
+	DEBUG_PAGE_ACCESS_END(page);
+}
+
+
 // #pragma mark - X86VMTranslationMap64Bit
 
 
@@ -68,8 +124,10 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 				uint64* virtualPageDir = (uint64*)fPageMapper->GetPageTableAt(
 					virtualPDPT[j] & X86_64_PDPTE_ADDRESS_MASK);
 				for (uint32 k = 0; k < 512; k++) {
-					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0)
+					if ((virtualPageDir[k] & X86_64_PDE_PRESENT) == 0
+						|| (virtualPageDir[k] & X86_64_PDE_LARGE_PAGE) != 0) {
 						continue;
+					}
 
 					address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
 					page = vm_lookup_page(address / B_PAGE_SIZE);
@@ -222,6 +280,75 @@ X86VMTranslationMap64Bit::Map(addr_t virtualAddress, phys_addr_t physicalAddress
 }
 
 
+size_t
+X86VMTranslationMap64Bit::LargePageSize() const
+{
+	return k64BitPageTableRange;
+}
+
+
+status_t
+X86VMTranslationMap64Bit::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	TRACE("X86VMTranslationMap64Bit::MapLargePage(%#" B_PRIxADDR ", %#"
+		B_PRIxPHYSADDR ")\n", virtualAddress, physicalAddress);
+
+	ASSERT(virtualAddress % k64BitPageTableRange == 0);
+	ASSERT(physicalAddress % k64BitPageTableRange == 0);
+
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	// Look up the page directory entry for the virtual address, allocating
+	// the PDPT and page directory if required. Shouldn't fail.
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), virtualAddress, fIsKernelMap,
+		true, reservation, fPageMapper, fMapCount);
+	ASSERT(pde != NULL);
+
+	if ((*pde & X86_64_PDE_PRESENT) != 0) {
+		if ((*pde & X86_64_PDE_LARGE_PAGE) != 0)
+			return B_BUSY;
+
+		// There is a page table left over from an earlier use of the range.
+		// We can only replace it, if it doesn't map anything anymore.
+		phys_addr_t physicalPageTable = *pde & X86_64_PDE_ADDRESS_MASK;
+		uint64* pageTable
+			= (uint64*)fPageMapper->GetPageTableAt(physicalPageTable);
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+			if ((pageTable[i] & X86_64_PTE_PRESENT) != 0)
+				return B_BUSY;
+		}
+
+		X86PagingMethod64Bit::ClearTableEntry(pde);
+
+		// The page table may still be cached in the paging structure caches.
+		InvalidatePage(virtualAddress);
+		Flush();
+
+		vm_page* page = vm_lookup_page(physicalPageTable / B_PAGE_SIZE);
+		if (page == NULL) {
+			panic("page table for va %#" B_PRIxADDR " on invalid page %#"
+				B_PRIxPHYSADDR "\n", virtualAddress, physicalPageTable);
+		}
+
+		DEBUG_PAGE_ACCESS_START(page);
+		vm_page_set_state(page, PAGE_STATE_FREE);
+
+		fMapCount--;
+	}
+
+	X86PagingMethod64Bit::PutLargePageEntryInDirectory(pde, physicalAddress,
+		attributes, memoryType, fIsKernelMap);
+
+	fMapCount += k64BitTableEntryCount;
+	atomic_add(&gLargeMappedPagesCount, k64BitTableEntryCount);
+
+	return B_OK;
+}
+
+
 status_t
 X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 {
@@ -235,6 +362,23 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
+		uint64* pde;
+		status_t error = _LargePageForRange(start, end, pde);
+		if (error != B_OK)
+			return error;
+
+		if (pde != NULL) {
+			uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(pde);
+			fMapCount -= k64BitTableEntryCount;
+			atomic_add(&gLargeMappedPagesCount, -(int32)k64BitTableEntryCount);
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			start += k64BitPageTableRange;
+			continue;
+		}
+
 		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
 			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
 			NULL, fPageMapper, fMapCount);
@@ -402,6 +546,41 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
+		uint64* pde;
+		if (_LargePageForRange(start, end, pde) != B_OK) {
+			// We can't fail here, so we unmap the whole large page instead.
+			// The pages outside of the range remain in the area's cache and
+			// are mapped again when they are accessed next time.
+			pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+				fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
+				NULL, fPageMapper, fMapCount);
+			start = ROUNDDOWN(start, k64BitPageTableRange);
+		}
+
+		if (pde != NULL) {
+			uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(pde);
+			fMapCount -= k64BitTableEntryCount;
+			atomic_add(&gLargeMappedPagesCount, -(int32)k64BitTableEntryCount);
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			if (area->cache_type != CACHE_TYPE_DEVICE) {
+				page_num_t pageNumber = (oldEntry & X86_64_PDE_ADDRESS_MASK
+					& ~(k64BitPageTableRange - 1)) / B_PAGE_SIZE;
+				for (uint32 i = 0; i < k64BitTableEntryCount; i++) {
+					page_unmapped(area, pageNumber + i,
+						(oldEntry & X86_64_PDE_ACCESSED) != 0,
+						(oldEntry & X86_64_PDE_DIRTY) != 0, updatePageQueue,
+						queue);
+				}
+			}
+
+			start += k64BitPageTableRange;
+			Flush();
+			continue;
+		}
+
 		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
 			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
 			NULL, fPageMapper, fMapCount);
@@ -429,52 +608,10 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 			}
 
 			if (area->cache_type != CACHE_TYPE_DEVICE) {
-				// get the page
-				vm_page* page = vm_lookup_page(
-					(oldEntry & X86_64_PTE_ADDRESS_MASK) / B_PAGE_SIZE);
-				ASSERT(page != NULL);
-
-				DEBUG_PAGE_ACCESS_START(page);
-
-				// transfer the accessed/dirty flags to the page
-				if ((oldEntry & X86_64_PTE_ACCESSED) != 0)
-					page->accessed = true;
-				if ((oldEntry & X86_64_PTE_DIRTY) != 0)
-					page->modified = true;
-
-				// remove the mapping object/decrement the wired_count of the
-				// page
-				if (area->wiring == B_NO_LOCK) {
-					vm_page_mapping* mapping = NULL;
-					vm_page_mappings::Iterator iterator
-						= page->mappings.GetIterator();
-					while ((mapping = iterator.Next()) != NULL) {
-						if (mapping->area == area)
-							break;
-					}
-
-					ASSERT(mapping != NULL);
-
-					area->mappings.Remove(mapping);
-					page->mappings.Remove(mapping);
-					queue.Add(mapping);
-				} else
-					page->DecrementWiredCount();
-
-				if (!page->IsMapped()) {
-					atomic_add(&gMappedPagesCount, -1);
-
-					if (updatePageQueue) {
-						if (page->Cache()->temporary)
-							vm_page_set_state(page, PAGE_STATE_INACTIVE);
-						else if (page->modified)
-							vm_page_set_state(page, PAGE_STATE_MODIFIED);
-						else
-							vm_page_set_state(page, PAGE_STATE_CACHED);
-					}
-				}
-
-				DEBUG_PAGE_ACCESS_END(page);
+				page_unmapped(area,
+					(oldEntry & X86_64_PTE_ADDRESS_MASK) / B_PAGE_SIZE,
+					(oldEntry & X86_64_PTE_ACCESSED) != 0,
+					(oldEntry & X86_64_PTE_DIRTY) != 0, updatePageQueue, queue);
 			}
 		}
 
@@ -680,9 +817,40 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 	} else if ((attributes & B_KERNEL_WRITE_AREA) != 0)
 		newProtectionFlags = X86_64_PTE_WRITABLE;
 
+	uint64 newFlags = newProtectionFlags
+		| X86PagingMethod64Bit::MemoryTypeToPageTableEntryFlags(memoryType);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
+		uint64* pde;
+		status_t error = _LargePageForRange(start, end, pde);
+		if (error != B_OK)
+			return error;
+
+		if (pde != NULL) {
+			// The protection and memory type bits of large page entries are
+			// the same as those of page table entries.
+			uint64 entry = *pde;
+			uint64 oldEntry;
+			while (true) {
+				oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+					(entry & ~(X86_64_PTE_PROTECTION_MASK
+							| X86_64_PTE_MEMORY_TYPE_MASK))
+						| newFlags,
+					entry);
+				if (oldEntry == entry)
+					break;
+				entry = oldEntry;
+			}
+
+			if ((oldEntry & X86_64_PDE_ACCESSED) != 0)
+				InvalidatePage(start);
+
+			start += k64BitPageTableRange;
+			continue;
+		}
+
 		uint64* pageTable = X86PagingMethod64Bit::PageTableForAddress(
 			fPagingStructures->VirtualPML4(), start, fIsKernelMap, false,
 			NULL, fPageMapper, fMapCount);
@@ -710,9 +878,7 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 					&pageTable[index],
 					(entry & ~(X86_64_PTE_PROTECTION_MASK
 							| X86_64_PTE_MEMORY_TYPE_MASK))
-						| newProtectionFlags
-						| X86PagingMethod64Bit::MemoryTypeToPageTableEntryFlags(
-							memoryType),
+						| newFlags,
 					entry);
 				if (oldEntry == entry)
 					break;
@@ -843,3 +1009,103 @@ X86VMTranslationMap64Bit::PagingStructures() const
 {
 	return fPagingStructures;
 }
+
+
+/*!	Checks whether \a start is mapped by a large page. If the range up to
+	(and including) \a end covers the large page entirely, its page directory
+	entry is returned in \a _pde. Otherwise the large page is split, so that
+	the range can be handled page by page, and \a _pde is set to \c NULL, as
+	it is when \a start isn't mapped by a large page at all.
+	The caller must have pinned the thread.
+	\return \c B_OK, or \c B_NO_MEMORY, if the large page would have to be
+		split, but no page table could be allocated for it.
+*/
+status_t
+X86VMTranslationMap64Bit::_LargePageForRange(addr_t start, addr_t end,
+	uint64*& _pde)
+{
+	_pde = NULL;
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPML4(), start, fIsKernelMap, false, NULL,
+		fPageMapper, fMapCount);
+	if (pde == NULL || (*pde & X86_64_PDE_PRESENT) == 0
+		|| (*pde & X86_64_PDE_LARGE_PAGE) == 0) {
+		return B_OK;
+	}
+
+	addr_t base = ROUNDDOWN(start, k64BitPageTableRange);
+	if (start == base && end - base >= k64BitPageTableRange - 1) {
+		_pde = pde;
+		return B_OK;
+	}
+
+	return _SplitLargePage(pde, base);
+}
+
+
+/*!	Replaces the large page mapping of \a pde by a page table mapping the same
+	pages with the same flags.
+	The caller must have pinned the thread.
+	\return \c B_OK, or \c B_NO_MEMORY, if no page could be allocated for
+		the page table.
+*/
+status_t
+X86VMTranslationMap64Bit::_SplitLargePage(uint64* pde, addr_t address)
+{
+	TRACE("X86VMTranslationMap64Bit::_SplitLargePage(%#" B_PRIxADDR ")\n",
+		address);
+
+	// We may be called with all kinds of locks held, so we must not wait for
+	// a page.
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, 1, VM_PRIORITY_VIP))
+		return B_NO_MEMORY;
+
+	vm_page* page = vm_page_allocate_page(&reservation,
+		PAGE_STATE_WIRED | VM_PAGE_ALLOC_CLEAR);
+	vm_page_unreserve_pages(&reservation);
+	if (page == NULL)
+		return B_NO_MEMORY;
+
+	DEBUG_PAGE_ACCESS_END(page);
+
+	phys_addr_t physicalPageTable
+		= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+	uint64* pageTable
+		= (uint64*)fPageMapper->GetPageTableAt(physicalPageTable);
+
+	uint64 entry = *pde;
+	while (true) {
+		// Apart from the large page and PAT bits (which we don't use) the
+		// flags of large page and page table entries are the same.
+		phys_addr_t physicalAddress
+			= entry & X86_64_PDE_ADDRESS_MASK & ~(k64BitPageTableRange - 1);
+		uint64 flags = entry & ~(X86_64_PDE_ADDRESS_MASK
+			| X86_64_PDE_LARGE_PAGE);
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+			pageTable[i] = (physicalAddress + i * B_PAGE_SIZE) | flags;
+
+		// The page table entries determine the effective protection, but a
+		// kernel large page must not become accessible from userland.
+		uint64 oldEntry = X86PagingMethod64Bit::TestAndSetTableEntry(pde,
+			(physicalPageTable & X86_64_PDE_ADDRESS_MASK)
+				| X86_64_PDE_PRESENT
+				| X86_64_PDE_WRITABLE
+				| (entry & X86_64_PDE_USER),
+			entry);
+		if (oldEntry == entry)
+			break;
+
+		// the accessed/dirty flags changed in the meantime -- try again
+		entry = oldEntry;
+	}
+
+	fMapCount++;
+	atomic_add(&gLargeMappedPagesCount, -(int32)k64BitTableEntryCount);
+
+	// invalidating any address within the large page flushes it from the TLB
+	InvalidatePage(address);
+
+	return B_OK;
+}
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/uio.h>
 
 #include <KernelExport.h>
 #include <fs_cache.h>
@@ -29,8 +30,8 @@
 
 
 // TODO: this is a naive but growing implementation to test the API:
-//	block reading/writing is not at all optimized for speed, it will
-//	just read and write single blocks.
+//	block reading is not at all optimized for speed, it will just read
+//	single blocks.
 // TODO: the retrieval/copy of the original data could be delayed until the
 //		new data must be written, ie. in low memory situations.
 
@@ -47,6 +48,17 @@
 
 static const bigtime_t kTransactionIdleTime = 2000000LL;
 	// a transaction is considered idle after 2 seconds of inactivity
+static const uint32 kBlockShardCount = 16;
+	// number of independently locked parts of the block hash
+static const int32 kWritebackThreadCount = 4;
+static const int32 kMaxPendingWriteRuns = 8;
+	// maximum number of I/Os a single BlockWriter has in flight
+static const size_t kMaxWriteRunSize = 256 * 1024;
+	// adjacent blocks are combined into writes of up to this size
+static const uint32 kMinDirtyBlockLimit = 1024;
+	// dirtiers are never throttled below this number of dirty blocks
+static const size_t kThrottleWriteBlocks = 256;
+	// blocks written back at once by a throttled dirtier
 
 
 struct cache_transaction;
@@ -58,6 +70,7 @@ struct cached_block {
 	cached_block*	next;			// next in hash
 	cached_block*	transaction_next;
 	block_link		link;
+	block_link		clock_link;		// link in the cache's block list
 	off_t			block_number;
 	void*			current_data;
 		// The data that is seen by everyone using the API; this one is always
@@ -77,14 +90,16 @@ struct cached_block {
 	void*			compare;
 #endif
 	int32			ref_count;
+		// protected by the lock of the hash shard the block is in
 	int32			last_accessed;
+	bool			accessed;
+		// set on every access, cleared by the CLOCK hand
 	bool			busy_reading : 1;
 	bool			busy_writing : 1;
 	bool			is_writing : 1;
 		// Block has been checked out for writing without transactions, and
 		// cannot be written back if set
 	bool			is_dirty : 1;
-	bool			unused : 1;
 	bool			discard : 1;
 	bool			busy_reading_waiters : 1;
 	bool			busy_writing_waiters : 1;
@@ -102,6 +117,11 @@ struct cached_block {
 		// transaction.
 
 	bool CanBeWritten() const;
+	bool IsUnused() const
+		{ return ref_count == 0 && transaction == NULL
+			&& previous_transaction == NULL; }
+	void Touch()
+		{ last_accessed = system_time() / 1000000L; accessed = true; }
 	int32 LastAccess() const
 		{ return system_time() / 1000000L - last_accessed; }
 
@@ -112,6 +132,9 @@ struct cached_block {
 typedef DoublyLinkedList<cached_block,
 	DoublyLinkedListMemberGetLink<cached_block,
 		&cached_block::link> > block_list;
+typedef DoublyLinkedList<cached_block,
+	DoublyLinkedListMemberGetLink<cached_block,
+		&cached_block::clock_link> > block_clock_list;
 
 struct cache_notification : DoublyLinkedListLinkImpl<cache_notification> {
 	int32			transaction_id;
@@ -124,9 +147,21 @@ struct cache_notification : DoublyLinkedListLinkImpl<cache_notification> {
 
 typedef DoublyLinkedList<cache_notification> NotificationList;
 
-struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
+/*!	A part of the block hash, with its own lock. Looking up a block, and
+	acquiring or releasing a reference to it only needs the lock of the shard
+	the block is in, so that accesses to distinct blocks don't contend.
+	Inserting into or removing from the hash requires the cache lock as well,
+	and therefore, the hash can also be searched with only the cache lock held.
+*/
+struct block_shard {
+	mutex			lock;
 	hash_table*		hash;
+};
+
+struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
+	block_shard		shards[kBlockShardCount];
 	mutex			lock;
+		// protects the transactions, the block list, and the block states
 	int				fd;
 	off_t			max_blocks;
 	size_t			block_size;
@@ -135,8 +170,10 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	hash_table*		transaction_hash;
 
 	object_cache*	buffer_cache;
-	block_list		unused_blocks;
-	uint32			unused_block_count;
+	block_clock_list blocks;
+		// all blocks, in CLOCK order; unused blocks are those without any
+		// reference that are not part of a transaction
+	uint32			block_count;
 
 	ConditionVariable busy_reading_condition;
 	uint32			busy_reading_count;
@@ -149,6 +186,13 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	uint32			num_dirty_blocks;
 	bool			read_only;
 
+	// writeback statistics
+	uint64			written_blocks;
+	uint64			write_ios;
+	uint32			largest_write;
+	bigtime_t		write_time;
+	uint32			throttled;
+
 	NotificationList pending_notifications;
 	ConditionVariable condition_variable;
 
@@ -164,13 +208,25 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	cached_block*	NewBlock(off_t blockNumber);
 	void			FreeBlockParentData(cached_block* block);
 
+	block_shard&	Shard(off_t blockNumber)
+						{ return shards[blockNumber % kBlockShardCount]; }
+	cached_block*	Lookup(off_t blockNumber);
+	void			InsertBlock(cached_block* block);
+	cached_block*	AcquireCachedBlock(off_t blockNumber);
+	bool			ReleaseCachedBlock(off_t blockNumber);
+
+	uint32			DirtyBlockLimit() const;
+
 	void			RemoveUnusedBlocks(int32 count, int32 minSecondsOld = 0);
 	void			RemoveBlock(cached_block* block);
+	void			RemoveUnhashedBlock(cached_block* block);
+	bool			RemoveIfUnused(cached_block* block);
 	void			DiscardBlock(cached_block* block);
 
 private:
 	static void		_LowMemoryHandler(void* data, uint32 resources,
 						int32 level);
+	cached_block*	_AdvanceClock(int32 minSecondsOld);
 	cached_block*	_GetUnusedBlock();
 };
 
@@ -204,6 +260,21 @@ struct cache_transaction {
 };
 
 
+class BlockWriter;
+
+/*!	A range of adjacent blocks that is written back with a single I/O. */
+struct write_run : DoublyLinkedListLinkImpl<write_run> {
+	BlockWriter*	writer;
+	off_t			offset;
+	iovec*			vecs;
+	uint32			first;
+	uint32			count;
+	status_t		status;
+};
+
+typedef DoublyLinkedList<write_run> WriteRunList;
+
+
 class BlockWriter {
 public:
 								BlockWriter(block_cache* cache,
@@ -225,9 +296,15 @@ public:
 	static	status_t			WriteBlock(block_cache* cache,
 									cached_block* block);
 
+	static	status_t			WritebackThread(void* /*data*/);
+
 private:
 			void*				_Data(cached_block* block) const;
 			status_t			_WriteBlock(cached_block* block);
+			uint32				_WriteRuns(uint32& largestRun);
+			void				_SubmitRun(write_run* run);
+			void				_WaitForRuns(int32 maxPending);
+			void				_WriteRun(write_run* run);
 			void				_BlockDone(cached_block* block,
 									hash_iterator* iterator);
 			void				_UnmarkWriting(cached_block* block);
@@ -247,6 +324,8 @@ private:
 			size_t				fMax;
 			status_t			fStatus;
 			bool				fDeletedTransaction;
+			int32				fPendingRuns;
+			ConditionVariable	fRunsCondition;
 };
 
 
@@ -696,6 +775,10 @@ static thread_id sNotifierWriterThread;
 static DoublyLinkedListLink<block_cache> sMarkCache;
 	// TODO: this only works if the link is the first entry of block_cache
 static object_cache* sBlockCache;
+static mutex sWritebackLock = MUTEX_INITIALIZER("block cache writeback");
+static ConditionVariable sWritebackCondition;
+static WriteRunList sWritebackQueue;
+static int32 sWritebackThreadCount;
 
 
 //	#pragma mark - notifications/listener
@@ -1056,8 +1139,10 @@ BlockWriter::BlockWriter(block_cache* cache, size_t max)
 	fCapacity(kBufferSize),
 	fMax(max),
 	fStatus(B_OK),
-	fDeletedTransaction(false)
+	fDeletedTransaction(false),
+	fPendingRuns(0)
 {
+	fRunsCondition.Init(this, "block writer runs");
 }
 
 
@@ -1161,28 +1246,25 @@ BlockWriter::Write(hash_iterator* iterator, bool canUnlock)
 	if (canUnlock)
 		mutex_unlock(&fCache->lock);
 
-	// Sort blocks in their on-disk order
-	// TODO: ideally, this should be handled by the I/O scheduler
-
+	// Sort blocks in their on-disk order, so that adjacent blocks can be
+	// written back together
 	qsort(fBlocks, fCount, sizeof(void*), &_CompareBlocks);
 	fDeletedTransaction = false;
 
-	for (uint32 i = 0; i < fCount; i++) {
-		status_t status = _WriteBlock(fBlocks[i]);
-		if (status != B_OK) {
-			// propagate to global error handling
-			if (fStatus == B_OK)
-				fStatus = status;
-
-			_UnmarkWriting(fBlocks[i]);
-			fBlocks[i] = NULL;
-				// This block will not be marked clean
-		}
-	}
+	bigtime_t startTime = system_time();
+	uint32 largestRun;
+	uint32 runCount = _WriteRuns(largestRun);
+	bigtime_t writeTime = system_time() - startTime;
 
 	if (canUnlock)
 		mutex_lock(&fCache->lock);
 
+	fCache->written_blocks += fCount;
+	fCache->write_ios += runCount;
+	fCache->write_time += writeTime;
+	if (largestRun > fCache->largest_write)
+		fCache->largest_write = largestRun;
+
 	for (uint32 i = 0; i < fCount; i++)
 		_BlockDone(fBlocks[i], iterator);
 
@@ -1207,6 +1289,40 @@ BlockWriter::WriteBlock(block_cache* cache, cached_block* block)
 }
 
 
+/*!	Writes back the runs that are handed over to it by _SubmitRun(). There
+	are kWritebackThreadCount of these threads, so that writeback can keep a
+	couple of I/Os in flight even for a single BlockWriter.
+*/
+/*static*/ status_t
+BlockWriter::WritebackThread(void* /*data*/)
+{
+	while (true) {
+		MutexLocker locker(sWritebackLock);
+
+		write_run* run;
+		while ((run = sWritebackQueue.RemoveHead()) == NULL) {
+			ConditionVariableEntry entry;
+			sWritebackCondition.Add(&entry);
+
+			locker.Unlock();
+			entry.Wait();
+			locker.Lock();
+		}
+
+		locker.Unlock();
+
+		BlockWriter* writer = run->writer;
+		writer->_WriteRun(run);
+
+		locker.Lock();
+		writer->fPendingRuns--;
+		writer->fRunsCondition.NotifyAll();
+	}
+
+	return B_OK;
+}
+
+
 void*
 BlockWriter::_Data(cached_block* block) const
 {
@@ -1244,6 +1360,159 @@ BlockWriter::_WriteBlock(cached_block* block)
 }
 
 
+/*!	Writes back all blocks, and combines adjacent blocks into a single
+	vectored write each. The writes are submitted to the writeback threads,
+	and this method waits until all of them are done. Blocks that could not
+	be written are removed from the array.
+	Returns the number of I/Os that were needed, and the number of blocks in
+	the largest one in \a largestRun.
+*/
+uint32
+BlockWriter::_WriteRuns(uint32& largestRun)
+{
+	size_t blockSize = fCache->block_size;
+	uint32 maxRunBlocks = max_c(kMaxWriteRunSize / blockSize, 1);
+
+	iovec* vecs = (iovec*)malloc(fCount * sizeof(iovec));
+	write_run* runs = new(std::nothrow) write_run[fCount];
+	if (vecs == NULL || runs == NULL) {
+		free(vecs);
+		delete[] runs;
+
+		// write back the blocks one by one
+		for (uint32 i = 0; i < fCount; i++) {
+			status_t status = _WriteBlock(fBlocks[i]);
+			if (status != B_OK) {
+				// propagate to global error handling
+				if (fStatus == B_OK)
+					fStatus = status;
+
+				_UnmarkWriting(fBlocks[i]);
+				fBlocks[i] = NULL;
+					// This block will not be marked clean
+			}
+		}
+
+		largestRun = 1;
+		return fCount;
+	}
+
+	uint32 runCount = 0;
+	largestRun = 0;
+	for (uint32 i = 0; i < fCount;) {
+		write_run& run = runs[runCount++];
+		run.writer = this;
+		run.offset = fBlocks[i]->block_number * blockSize;
+		run.vecs = &vecs[i];
+		run.first = i;
+		run.count = 0;
+
+		do {
+			TB(Write(fCache, fBlocks[i]));
+			TB2(BlockData(fCache, fBlocks[i], "before write"));
+
+			vecs[i].iov_base = _Data(fBlocks[i]);
+			vecs[i].iov_len = blockSize;
+			run.count++;
+			i++;
+		} while (i < fCount && run.count < maxRunBlocks
+			&& fBlocks[i]->block_number == fBlocks[i - 1]->block_number + 1);
+
+		if (run.count > largestRun)
+			largestRun = run.count;
+
+		_SubmitRun(&run);
+	}
+
+	MutexLocker locker(sWritebackLock);
+	_WaitForRuns(0);
+	locker.Unlock();
+
+	for (uint32 i = 0; i < runCount; i++) {
+		write_run& run = runs[i];
+		if (run.status == B_OK)
+			continue;
+
+		// Retry the blocks of the failed run one by one, so that we know
+		// which of them could not be written
+		for (uint32 j = run.first; j < run.first + run.count; j++) {
+			status_t status = _WriteBlock(fBlocks[j]);
+			if (status != B_OK) {
+				// propagate to global error handling
+				if (fStatus == B_OK)
+					fStatus = status;
+
+				_UnmarkWriting(fBlocks[j]);
+				fBlocks[j] = NULL;
+					// This block will not be marked clean
+			}
+		}
+	}
+
+	free(vecs);
+	delete[] runs;
+	return runCount;
+}
+
+
+/*!	Queues the \a run for the writeback threads, after waiting until less
+	than kMaxPendingWriteRuns runs of this writer are still in flight.
+*/
+void
+BlockWriter::_SubmitRun(write_run* run)
+{
+	if (sWritebackThreadCount == 0) {
+		_WriteRun(run);
+		return;
+	}
+
+	MutexLocker locker(sWritebackLock);
+	_WaitForRuns(kMaxPendingWriteRuns - 1);
+
+	fPendingRuns++;
+	sWritebackQueue.Add(run);
+	sWritebackCondition.NotifyOne();
+}
+
+
+/*!	Waits until no more than \a maxPending runs of this writer are in flight.
+	The writeback lock must be held.
+*/
+void
+BlockWriter::_WaitForRuns(int32 maxPending)
+{
+	while (fPendingRuns > maxPending) {
+		ConditionVariableEntry entry;
+		fRunsCondition.Add(&entry);
+
+		mutex_unlock(&sWritebackLock);
+		entry.Wait();
+		mutex_lock(&sWritebackLock);
+	}
+}
+
+
+void
+BlockWriter::_WriteRun(write_run* run)
+{
+	size_t size = run->count * fCache->block_size;
+
+	ssize_t written;
+	if (run->count == 1)
+		written = write_pos(fCache->fd, run->offset, run->vecs[0].iov_base, size);
+	else
+		written = writev_pos(fCache->fd, run->offset, run->vecs, run->count);
+
+	if (written == (ssize_t)size)
+		run->status = B_OK;
+	else {
+		TB(Error(fCache, run->offset / fCache->block_size, "write run failed",
+			written));
+		run->status = written < 0 ? errno : B_IO_ERROR;
+	}
+}
+
+
 void
 BlockWriter::_BlockDone(cached_block* block, hash_iterator* iterator)
 {
@@ -1289,14 +1558,6 @@ BlockWriter::_BlockDone(cached_block* block, hash_iterator* iterator)
 			fDeletedTransaction = true;
 		}
 	}
-	if (block->transaction == NULL && block->ref_count == 0 && !block->unused) {
-		// the block is no longer used
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = true;
-		fCache->unused_blocks.Add(block);
-		fCache->unused_block_count++;
-	}
-
 	TB2(BlockData(fCache, block, "after write"));
 }
 
@@ -1338,7 +1599,6 @@ BlockWriter::_CompareBlocks(const void* _blockA, const void* _blockB)
 block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 		bool readOnly)
 	:
-	hash(NULL),
 	fd(_fd),
 	max_blocks(numBlocks),
 	block_size(blockSize),
@@ -1346,13 +1606,18 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	last_transaction(NULL),
 	transaction_hash(NULL),
 	buffer_cache(NULL),
-	unused_block_count(0),
+	block_count(0),
 	busy_reading_count(0),
 	busy_reading_waiters(false),
 	busy_writing_count(0),
 	busy_writing_waiters(0),
 	num_dirty_blocks(0),
-	read_only(readOnly)
+	read_only(readOnly),
+	written_blocks(0),
+	write_ios(0),
+	largest_write(0),
+	write_time(0),
+	throttled(0)
 {
 }
 
@@ -1363,7 +1628,12 @@ block_cache::~block_cache()
 	unregister_low_resource_handler(&_LowMemoryHandler, this);
 
 	hash_uninit(transaction_hash);
-	hash_uninit(hash);
+
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		if (shards[i].hash != NULL)
+			hash_uninit(shards[i].hash);
+		mutex_destroy(&shards[i].lock);
+	}
 
 	delete_object_cache(buffer_cache);
 
@@ -1379,17 +1649,20 @@ block_cache::Init()
 	condition_variable.Init(this, "cache transaction sync");
 	mutex_init(&lock, "block cache");
 
+	cached_block dummyBlock;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		mutex_init(&shards[i].lock, "block cache shard");
+		shards[i].hash = hash_init(64, offset_of_member(dummyBlock, next),
+			&cached_block::Compare, &cached_block::Hash);
+		if (shards[i].hash == NULL)
+			return B_NO_MEMORY;
+	}
+
 	buffer_cache = create_object_cache_etc("block cache buffers", block_size,
 		8, 0, 0, 0, CACHE_LARGE_SLAB, NULL, NULL, NULL, NULL);
 	if (buffer_cache == NULL)
 		return B_NO_MEMORY;
 
-	cached_block dummyBlock;
-	hash = hash_init(1024, offset_of_member(dummyBlock, next),
-		&cached_block::Compare, &cached_block::Hash);
-	if (hash == NULL)
-		return B_NO_MEMORY;
-
 	cache_transaction dummyTransaction;
 	transaction_hash = hash_init(16, offset_of_member(dummyTransaction, next),
 		&transaction_compare, &::transaction_hash);
@@ -1463,8 +1736,8 @@ block_cache::NewBlock(off_t blockNumber)
 			}
 		} else {
 			TB(Error(this, blockNumber, "allocation failed"));
-			dprintf("block allocation failed, unused list is %sempty.\n",
-				unused_blocks.IsEmpty() ? "" : "not ");
+			dprintf("block allocation failed, cache has %" B_PRIu32 " blocks.\n",
+				block_count);
 
 			// allocation failed, try to reuse an unused block
 			block = _GetUnusedBlock();
@@ -1479,6 +1752,7 @@ block_cache::NewBlock(off_t blockNumber)
 	block->block_number = blockNumber;
 	block->ref_count = 0;
 	block->last_accessed = 0;
+	block->accessed = false;
 	block->transaction_next = NULL;
 	block->transaction = block->previous_transaction = NULL;
 	block->original_data = NULL;
@@ -1487,7 +1761,6 @@ block_cache::NewBlock(off_t blockNumber)
 	block->busy_writing = false;
 	block->is_writing = false;
 	block->is_dirty = false;
-	block->unused = false;
 	block->discard = false;
 	block->busy_reading_waiters = false;
 	block->busy_writing_waiters = false;
@@ -1509,51 +1782,158 @@ block_cache::FreeBlockParentData(cached_block* block)
 }
 
 
+/*!	Returns the number of dirty blocks, including those of transactions that
+	still need to be written back, above which dirtiers are throttled.
+*/
+uint32
+block_cache::DirtyBlockLimit() const
+{
+	// allow dirty blocks to use up to 1/32 of the memory
+	uint64 limit = (uint64)vm_page_num_pages() / 32 * B_PAGE_SIZE
+		/ block_size;
+	return max_c(limit, kMinDirtyBlockLimit);
+}
+
+
+/*!	Returns the block \a blockNumber, if it's in the cache.
+	Either the cache, or the lock of the block's shard must be held.
+*/
+cached_block*
+block_cache::Lookup(off_t blockNumber)
+{
+	return (cached_block*)hash_lookup(Shard(blockNumber).hash, &blockNumber);
+}
+
+
+/*!	Adds a new block to the hash and the block list.
+	The cache must be locked.
+*/
+void
+block_cache::InsertBlock(cached_block* block)
+{
+	block_shard& shard = Shard(block->block_number);
+	mutex_lock(&shard.lock);
+	hash_insert_grow(shard.hash, block);
+	mutex_unlock(&shard.lock);
+
+	blocks.Add(block);
+	block_count++;
+}
+
+
+/*!	Returns the block \a blockNumber with an additional reference, if it is
+	in the cache and ready to be used. This only needs the lock of the block's
+	shard, and not the cache lock.
+	If \c NULL is returned, the caller has to use get_cached_block() instead.
+*/
+cached_block*
+block_cache::AcquireCachedBlock(off_t blockNumber)
+{
+	block_shard& shard = Shard(blockNumber);
+	MutexLocker locker(shard.lock);
+
+	cached_block* block = (cached_block*)hash_lookup(shard.hash, &blockNumber);
+	if (block == NULL || block->busy_reading)
+		return NULL;
+
+	block->ref_count++;
+	block->Touch();
+
+	return block;
+}
+
+
+/*!	Releases a reference to the block \a blockNumber, unless it's the last
+	reference to a block that needs more work than that; that is, it has to
+	be discarded, or is no longer being written to outside of a transaction.
+	Like AcquireCachedBlock(), this only needs the lock of the block's shard.
+	If \c false is returned, the caller has to use put_cached_block() instead.
+*/
+bool
+block_cache::ReleaseCachedBlock(off_t blockNumber)
+{
+	block_shard& shard = Shard(blockNumber);
+	MutexLocker locker(shard.lock);
+
+	cached_block* block = (cached_block*)hash_lookup(shard.hash, &blockNumber);
+	if (block == NULL || block->ref_count < 1
+		|| (block->ref_count == 1 && (block->is_writing || block->discard))) {
+		return false;
+	}
+
+	TB(Put(this, block));
+	block->ref_count--;
+	return true;
+}
+
+
 void
 block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 {
 	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		if (minSecondsOld >= block->LastAccess()) {
-			// The list is sorted by last access
-			break;
-		}
-		if (block->busy_reading || block->busy_writing)
+	for (uint32 scanned = block_count; count > 0 && scanned > 0; scanned--) {
+		cached_block* block = _AdvanceClock(minSecondsOld);
+		if (block == NULL)
 			continue;
 
-		TB(Flush(this, block));
 		TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32 "\n",
 			block->block_number, block->last_accessed));
 
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->discard) {
-			if (block->busy_writing)
-				continue;
+		FreeBlock(block);
+		count--;
+	}
+}
 
-			BlockWriter::WriteBlock(this, block);
-		}
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		RemoveBlock(block);
+void
+block_cache::RemoveBlock(cached_block* block)
+{
+	block_shard& shard = Shard(block->block_number);
+	mutex_lock(&shard.lock);
+	hash_remove(shard.hash, block);
+	mutex_unlock(&shard.lock);
 
-		if (--count <= 0)
-			break;
-	}
+	RemoveUnhashedBlock(block);
 }
 
 
+/*!	Removes a block that has already been removed from the hash from the
+	block list, and frees it.
+*/
 void
-block_cache::RemoveBlock(cached_block* block)
+block_cache::RemoveUnhashedBlock(cached_block* block)
 {
-	hash_remove(hash, block);
+	blocks.Remove(block);
+	block_count--;
 	FreeBlock(block);
 }
 
 
+/*!	Removes the block from the cache if it's unused. Since a reference to the
+	block may be acquired without holding the cache lock, this must be checked
+	with the shard lock held.
+	The cache must be locked.
+*/
+bool
+block_cache::RemoveIfUnused(cached_block* block)
+{
+	block_shard& shard = Shard(block->block_number);
+	mutex_lock(&shard.lock);
+
+	if (!block->IsUnused() || block->busy_reading || block->busy_writing) {
+		mutex_unlock(&shard.lock);
+		return false;
+	}
+
+	hash_remove(shard.hash, block);
+	mutex_unlock(&shard.lock);
+
+	RemoveUnhashedBlock(block);
+	return true;
+}
+
+
 /*!	Discards the block from a transaction (this method must not be called
 	for blocks not part of a transaction).
 */
@@ -1590,15 +1970,15 @@ block_cache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
 		case B_NO_LOW_RESOURCE:
 			return;
 		case B_LOW_RESOURCE_NOTE:
-			free = cache->unused_block_count / 8;
+			free = cache->block_count / 8;
 			secondsOld = 120;
 			break;
 		case B_LOW_RESOURCE_WARNING:
-			free = cache->unused_block_count / 4;
+			free = cache->block_count / 4;
 			secondsOld = 10;
 			break;
 		case B_LOW_RESOURCE_CRITICAL:
-			free = cache->unused_block_count / 2;
+			free = cache->block_count / 2;
 			secondsOld = 0;
 			break;
 	}
@@ -1613,35 +1993,80 @@ block_cache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
 	}
 
 #ifdef TRACE_BLOCK_CACHE
-	uint32 oldUnused = cache->unused_block_count;
+	uint32 oldCount = cache->block_count;
 #endif
 
 	cache->RemoveUnusedBlocks(free, secondsOld);
 
-	TRACE(("block_cache::_LowMemoryHandler(): %p: unused: %" B_PRIu32 " -> %" B_PRIu32 "\n",
-		cache, oldUnused, cache->unused_block_count));
+	TRACE(("block_cache::_LowMemoryHandler(): %p: blocks: %" B_PRIu32 " -> %" B_PRIu32 "\n",
+		cache, oldCount, cache->block_count));
 }
 
 
+/*!	Moves the CLOCK hand over the next block in the list. If that block is
+	unused, has not been accessed since the hand last passed it, and not
+	within the last \a minSecondsOld seconds, it is written back if needed,
+	removed from the hash and the block list, and returned.
+	The cache must be locked; it might be unlocked temporarily in order to
+	write back the block.
+*/
 cached_block*
-block_cache::_GetUnusedBlock()
+block_cache::_AdvanceClock(int32 minSecondsOld)
 {
-	TRACE(("block_cache: get unused block\n"));
+	cached_block* block = blocks.RemoveHead();
+	if (block == NULL)
+		return NULL;
+	blocks.Add(block);
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		TB(Flush(this, block, true));
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->busy_writing && !block->discard)
-			BlockWriter::WriteBlock(this, block);
+	if (!block->IsUnused() || block->busy_reading || block->busy_writing)
+		return NULL;
 
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		hash_remove(hash, block);
+	if (block->accessed) {
+		// give it another chance
+		block->accessed = false;
+		return NULL;
+	}
+	if (block->LastAccess() < minSecondsOld)
+		return NULL;
+
+	TB(Flush(this, block));
+
+	// this can only happen if no transactions are used
+	if (block->is_dirty && !block->discard) {
+		BlockWriter::WriteBlock(this, block);
+		if (block->is_dirty)
+			return NULL;
+	}
+
+	block_shard& shard = Shard(block->block_number);
+	MutexLocker shardLocker(shard.lock);
 
-		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = false;
+	if (!block->IsUnused() || block->busy_reading || block->busy_writing) {
+		// someone got hold of the block while it was written back
+		return NULL;
+	}
+
+	hash_remove(shard.hash, block);
+	shardLocker.Unlock();
+
+	blocks.Remove(block);
+	block_count--;
+
+	ASSERT(block->original_data == NULL && block->parent_data == NULL);
+	return block;
+}
+
+
+cached_block*
+block_cache::_GetUnusedBlock()
+{
+	TRACE(("block_cache: get unused block\n"));
+
+	// The first round of the CLOCK hand might only clear the accessed flags
+	for (uint32 scanned = 2 * block_count; scanned > 0; scanned--) {
+		cached_block* block = _AdvanceClock(0);
+		if (block == NULL)
+			continue;
 
 		// TODO: see if compare data is handled correctly here!
 #if BLOCK_CACHE_DEBUG_CHANGED
@@ -1663,6 +2088,7 @@ block_cache::_GetUnusedBlock()
 static void
 mark_block_busy_reading(block_cache* cache, cached_block* block)
 {
+	MutexLocker _(cache->Shard(block->block_number).lock);
 	block->busy_reading = true;
 	cache->busy_reading_count++;
 }
@@ -1673,7 +2099,10 @@ mark_block_busy_reading(block_cache* cache, cached_block* block)
 static void
 mark_block_unbusy_reading(block_cache* cache, cached_block* block)
 {
+	mutex_lock(&cache->Shard(block->block_number).lock);
 	block->busy_reading = false;
+	mutex_unlock(&cache->Shard(block->block_number).lock);
+
 	cache->busy_reading_count--;
 
 	if ((cache->busy_reading_waiters && cache->busy_reading_count == 0)
@@ -1766,9 +2195,9 @@ wait_for_busy_writing_blocks(block_cache* cache)
 
 
 /*!	Removes a reference from the specified \a block. If this was the last
-	reference, the block is moved into the unused list.
-	In low memory situations, it will also free some blocks from that list,
-	but not necessarily the \a block it just released.
+	reference, and the block is not part of any transaction, it becomes
+	unused, and may be reclaimed by the CLOCK hand from now on.
+	The cache must be locked.
 */
 static void
 put_cached_block(block_cache* cache, cached_block* block)
@@ -1789,6 +2218,9 @@ put_cached_block(block_cache* cache, cached_block* block)
 #endif
 	TB(Put(cache, block));
 
+	block_shard& shard = cache->Shard(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
 	if (block->ref_count < 1) {
 		panic("Invalid ref_count for block %p, cache %p\n", block, cache);
 		return;
@@ -1800,16 +2232,12 @@ put_cached_block(block_cache* cache, cached_block* block)
 		block->is_writing = false;
 
 		if (block->discard) {
-			cache->RemoveBlock(block);
-		} else {
-			// put this block in the list of unused blocks
-			ASSERT(!block->unused);
-			block->unused = true;
+			hash_remove(shard.hash, block);
+			shardLocker.Unlock();
 
+			cache->RemoveUnhashedBlock(block);
+		} else
 			ASSERT(block->original_data == NULL && block->parent_data == NULL);
-			cache->unused_blocks.Add(block);
-			cache->unused_block_count++;
-		}
 	}
 }
 
@@ -1822,7 +2250,7 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 			blockNumber, cache->max_blocks - 1);
 	}
 
-	cached_block* block = (cached_block*)hash_lookup(cache->hash, &blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block != NULL)
 		put_cached_block(cache, block);
 	else {
@@ -1838,8 +2266,8 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 	\param _allocated tells you whether or not a new block has been allocated
 		to satisfy your request.
 	\param readBlock if \c false, the block will not be read in case it was
-		not already in the cache. The block you retrieve may contain random
-		data. If \c true, the cache will be temporarily unlocked while the
+		not already in the cache. A newly allocated block will be cleared
+		instead. If \c true, the cache will be temporarily unlocked while the
 		block is read in.
 */
 static cached_block*
@@ -1855,8 +2283,7 @@ get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
 	}
 
 retry:
-	cached_block* block = (cached_block*)hash_lookup(cache->hash,
-		&blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	*_allocated = false;
 
 	if (block == NULL) {
@@ -1865,7 +2292,14 @@ retry:
 		if (block == NULL)
 			return NULL;
 
-		hash_insert_grow(cache->hash, block);
+		// The block must not be visible to AcquireCachedBlock() before its
+		// contents are valid
+		if (readBlock)
+			mark_block_busy_reading(cache, block);
+		else
+			memset(block->current_data, 0, cache->block_size);
+
+		cache->InsertBlock(block);
 		*_allocated = true;
 	} else if (block->busy_reading) {
 		// The block is currently busy_reading - wait and try again later
@@ -1873,18 +2307,10 @@ retry:
 		goto retry;
 	}
 
-	if (block->unused) {
-		//TRACE(("remove block %" B_PRIdOFF " from unused\n", blockNumber));
-		block->unused = false;
-		cache->unused_blocks.Remove(block);
-		cache->unused_block_count--;
-	}
-
 	if (*_allocated && readBlock) {
 		// read block into cache
 		int32 blockSize = cache->block_size;
 
-		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		ssize_t bytesRead = read_pos(cache->fd, blockNumber * blockSize,
@@ -1904,13 +2330,84 @@ retry:
 		mark_block_unbusy_reading(cache, block);
 	}
 
+	MutexLocker _(cache->Shard(blockNumber).lock);
 	block->ref_count++;
-	block->last_accessed = system_time() / 1000000L;
+	block->Touch();
 
 	return block;
 }
 
 
+/*!	Returns the number of blocks that are part of closed transactions, and
+	still have to be written back.
+	The cache must be locked.
+*/
+static uint32
+pending_transaction_blocks(block_cache* cache)
+{
+	uint32 count = 0;
+
+	hash_iterator iterator;
+	hash_open(cache->transaction_hash, &iterator);
+
+	cache_transaction* transaction;
+	while ((transaction = (cache_transaction*)hash_next(
+			cache->transaction_hash, &iterator)) != NULL) {
+		if (!transaction->open)
+			count += transaction->num_blocks;
+	}
+
+	hash_close(cache->transaction_hash, &iterator, false);
+	return count;
+}
+
+
+/*!	Lets the caller write back dirty blocks when writeback has fallen behind,
+	that is, when there are more dirty blocks than DirtyBlockLimit() allows.
+	This must be called before blocks are dirtied.
+	The cache must be locked, but it will be unlocked while the blocks are
+	written back.
+*/
+static void
+throttle_dirtier(block_cache* cache)
+{
+	if (cache->num_dirty_blocks + pending_transaction_blocks(cache)
+			<= cache->DirtyBlockLimit()) {
+		return;
+	}
+
+	cache->throttled++;
+
+	BlockWriter writer(cache, kThrottleWriteBlocks);
+
+	if (cache->num_dirty_blocks > 0) {
+		block_clock_list::Iterator iterator = cache->blocks.GetIterator();
+		while (cached_block* block = iterator.Next()) {
+			if (block->CanBeWritten() && !writer.Add(block))
+				break;
+		}
+	} else {
+		hash_iterator iterator;
+		hash_open(cache->transaction_hash, &iterator);
+
+		cache_transaction* transaction;
+		while ((transaction = (cache_transaction*)hash_next(
+				cache->transaction_hash, &iterator)) != NULL) {
+			if (transaction->open)
+				continue;
+
+			bool hasLeftOvers;
+			if (!writer.Add(transaction, &iterator, hasLeftOvers))
+				break;
+		}
+
+		hash_close(cache->transaction_hash, &iterator, false);
+	}
+
+	writer.Write();
+}
+
+
 /*!	Returns the writable block data for the requested blockNumber.
 	If \a cleared is true, the block is not read from disk; an empty block
 	is returned.
@@ -1930,6 +2427,9 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 			blockNumber, cache->max_blocks - 1);
 	}
 
+	if (transactionID == -1)
+		throttle_dirtier(cache);
+
 	bool allocated;
 	cached_block* block = get_cached_block(cache, blockNumber, &allocated,
 		!cleared);
@@ -1943,7 +2443,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 
 	// if there is no transaction support, we just return the current block
 	if (transactionID == -1) {
-		if (cleared) {
+		if (cleared && !allocated) {
 			mark_block_busy_reading(cache, block);
 			mutex_unlock(&cache->lock);
 
@@ -2046,7 +2546,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber, off_t base,
 		&& block->parent_data == NULL && wasUnchanged)
 		transaction->sub_num_blocks++;
 
-	if (cleared) {
+	if (cleared && !allocated) {
 		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
@@ -2077,7 +2577,7 @@ dump_block(cached_block* block)
 		(addr_t)block->parent_data, block->ref_count, block->LastAccess(),
 		block->busy_reading ? 'r' : '-', block->busy_writing ? 'w' : '-',
 		block->is_writing ? 'W' : '-', block->is_dirty ? 'D' : '-',
-		block->unused ? 'U' : '-', block->discard ? 'D' : '-',
+		block->IsUnused() ? 'U' : '-', block->discard ? 'D' : '-',
 		(addr_t)block->transaction,
 		(addr_t)block->previous_transaction);
 }
@@ -2104,7 +2604,7 @@ dump_block_long(cached_block* block)
 		kprintf(" is-writing");
 	if (block->is_dirty)
 		kprintf(" is-dirty");
-	if (block->unused)
+	if (block->IsUnused())
 		kprintf(" unused");
 	if (block->discard)
 		kprintf(" discard");
@@ -2179,8 +2679,7 @@ dump_cache(int argc, char** argv)
 	off_t blockNumber = -1;
 	if (i + 1 < argc) {
 		blockNumber = parse_expression(argv[i + 1]);
-		cached_block* block = (cached_block*)hash_lookup(cache->hash,
-			&blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL)
 			dump_block_long(block);
 		else
@@ -2199,6 +2698,14 @@ dump_cache(int argc, char** argv)
 		cache->busy_reading_waiters ? "has" : "no");
 	kprintf(" busy_writing: %" B_PRIu32 ", %s waiters\n", cache->busy_writing_count,
 		cache->busy_writing_waiters ? "has" : "no");
+	kprintf(" written:      %" B_PRIu64 " blocks in %" B_PRIu64 " I/Os, "
+		"%" B_PRIu64 " blocks/I/O, largest %" B_PRIu32 "\n",
+		cache->written_blocks, cache->write_ios,
+		cache->write_ios > 0 ? cache->written_blocks / cache->write_ios : 0,
+		cache->largest_write);
+	kprintf(" throughput:   %" B_PRIu64 " KB/s, throttled %" B_PRIu32 " times\n",
+		cache->write_time > 0 ? cache->written_blocks * cache->block_size
+			* 1000000 / cache->write_time / 1024 : 0, cache->throttled);
 
 	if (!cache->pending_notifications.IsEmpty()) {
 		kprintf(" pending notifications:\n");
@@ -2241,10 +2748,9 @@ dump_cache(int argc, char** argv)
 	uint32 count = 0;
 	uint32 dirty = 0;
 	uint32 discarded = 0;
-	hash_iterator iterator;
-	hash_open(cache->hash, &iterator);
-	cached_block* block;
-	while ((block = (cached_block*)hash_next(cache->hash, &iterator)) != NULL) {
+	uint32 unused = 0;
+	block_clock_list::Iterator iterator = cache->blocks.GetIterator();
+	while (cached_block* block = iterator.Next()) {
 		if (showBlocks)
 			dump_block(block);
 
@@ -2254,15 +2760,16 @@ dump_cache(int argc, char** argv)
 			discarded++;
 		if (block->ref_count)
 			referenced++;
+		if (block->IsUnused())
+			unused++;
 		count++;
 	}
 
 	kprintf(" %" B_PRIu32 " blocks total, %" B_PRIu32 " dirty, %" B_PRIu32 " discarded"
 		", %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRIu32 " in unused.\n",
 		count, dirty, discarded, referenced, cache->busy_reading_count,
-		cache->unused_block_count);
+		unused);
 
-	hash_close(cache->hash, &iterator, false);
 	return 0;
 }
 
@@ -2498,7 +3005,8 @@ get_next_locked_block_cache(block_cache* last)
 
 /*!	Background thread that continuously checks for pending notifications of
 	all caches.
-	Every two seconds, it will also write back up to 64 blocks per cache.
+	Every two seconds, it will also write back up to 64 blocks per cache, or
+	more if the cache has more than half of its dirty block limit pending.
 */
 static status_t
 block_notifier_and_writer(void* /*data*/)
@@ -2518,14 +3026,16 @@ block_notifier_and_writer(void* /*data*/)
 		}
 
 		// write 64 blocks of each block_cache every two seconds
-		// TODO: change this once we have an I/O scheduler
 		timeout = kTimeout;
 		size_t usedMemory;
 		object_cache_get_usage(sBlockCache, &usedMemory);
 
 		block_cache* cache = NULL;
 		while ((cache = get_next_locked_block_cache(cache)) != NULL) {
-			BlockWriter writer(cache, 64);
+			uint32 pending = cache->num_dirty_blocks
+				+ pending_transaction_blocks(cache);
+			BlockWriter writer(cache, pending > cache->DirtyBlockLimit() / 2
+				? pending : 64);
 
 			size_t cacheUsedMemory;
 			object_cache_get_usage(cache->buffer_cache, &cacheUsedMemory);
@@ -2534,17 +3044,12 @@ block_notifier_and_writer(void* /*data*/)
 			if (cache->num_dirty_blocks) {
 				// This cache is not using transactions, we'll scan the blocks
 				// directly
-				hash_iterator iterator;
-				hash_open(cache->hash, &iterator);
-
-				cached_block* block;
-				while ((block = (cached_block*)hash_next(cache->hash, &iterator))
-						!= NULL) {
+				block_clock_list::Iterator iterator
+					= cache->blocks.GetIterator();
+				while (cached_block* block = iterator.Next()) {
 					if (block->CanBeWritten() && !writer.Add(block))
 						break;
 				}
-
-				hash_close(cache->hash, &iterator, false);
 			} else {
 				hash_iterator iterator;
 				hash_open(cache->transaction_hash, &iterator);
@@ -2658,7 +3163,19 @@ block_cache_init(void)
 		return B_NO_MEMORY;
 
 	new (&sCaches) DoublyLinkedList<block_cache>;
-		// manually call constructor
+	new (&sWritebackQueue) WriteRunList;
+		// manually call constructors
+
+	sWritebackCondition.Init(&sWritebackQueue, "block cache writeback");
+	for (int32 i = 0; i < kWritebackThreadCount; i++) {
+		thread_id thread = spawn_kernel_thread(&BlockWriter::WritebackThread,
+			"block writeback", B_NORMAL_PRIORITY, NULL);
+		if (thread < B_OK)
+			break;
+
+		resume_thread(thread);
+		sWritebackThreadCount++;
+	}
 
 	sEventSemaphore = create_sem(0, "block cache event");
 	if (sEventSemaphore < B_OK)
@@ -2724,6 +3241,8 @@ cache_start_transaction(void* _cache)
 			cache->last_transaction->id);
 	}
 
+	throttle_dirtier(cache);
+
 	cache_transaction* transaction = new(std::nothrow) cache_transaction;
 	if (transaction == NULL)
 		return B_NO_MEMORY;
@@ -3067,13 +3586,6 @@ cache_abort_sub_transaction(void* _cache, int32 id)
 				cache->Free(block->original_data);
 				block->original_data = NULL;
 				block->is_dirty = false;
-
-				if (block->ref_count == 0) {
-					// Move the block into the unused list if possible
-					block->unused = true;
-					cache->unused_blocks.Add(block);
-					cache->unused_block_count++;
-				}
 			}
 		} else {
 			if (block->parent_data != block->current_data) {
@@ -3326,16 +3838,12 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	// free all blocks
 
-	uint32 cookie = 0;
-	cached_block* block;
-	while ((block = (cached_block*)hash_remove_first(cache->hash,
-			&cookie)) != NULL) {
-		cache->FreeBlock(block);
-	}
+	while (cached_block* block = cache->blocks.Head())
+		cache->RemoveBlock(block);
 
 	// free all transactions (they will all be aborted)
 
-	cookie = 0;
+	uint32 cookie = 0;
 	cache_transaction* transaction;
 	while ((transaction = (cache_transaction*)hash_remove_first(
 			cache->transaction_hash, &cookie)) != NULL) {
@@ -3377,17 +3885,12 @@ block_cache_sync(void* _cache)
 	MutexLocker locker(&cache->lock);
 
 	BlockWriter writer(cache);
-	hash_iterator iterator;
-	hash_open(cache->hash, &iterator);
-
-	cached_block* block;
-	while ((block = (cached_block*)hash_next(cache->hash, &iterator)) != NULL) {
+	block_clock_list::Iterator iterator = cache->blocks.GetIterator();
+	while (cached_block* block = iterator.Next()) {
 		if (block->CanBeWritten())
 			writer.Add(block);
 	}
 
-	hash_close(cache->hash, &iterator, false);
-
 	status_t status = writer.Write();
 
 	locker.Unlock();
@@ -3417,8 +3920,7 @@ block_cache_sync_etc(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (; numBlocks > 0; numBlocks--, blockNumber++) {
-		cached_block* block = (cached_block*)hash_lookup(cache->hash,
-			&blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
@@ -3452,8 +3954,7 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = (cached_block*)hash_lookup(cache->hash,
-			&blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block != NULL && block->previous_transaction != NULL)
 			writer.Add(block);
 	}
@@ -3465,25 +3966,22 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 		// reset blockNumber to its original value
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = (cached_block*)hash_lookup(cache->hash,
-			&blockNumber);
+		cached_block* block = cache->Lookup(blockNumber);
 		if (block == NULL)
 			continue;
 
 		ASSERT(block->previous_transaction == NULL);
 
-		if (block->unused) {
-			cache->unused_blocks.Remove(block);
-			cache->unused_block_count--;
-			cache->RemoveBlock(block);
-		} else {
+		if (!cache->RemoveIfUnused(block)) {
 			if (block->transaction != NULL && block->parent_data != NULL
 				&& block->parent_data != block->current_data) {
 				panic("Discarded block %" B_PRIdOFF " has already been changed in this "
 					"transaction!", blockNumber);
 			}
 
-			// mark it as discarded (in the current transaction only, if any)
+			// mark it as discarded (in the current transaction only, if any);
+			// ReleaseCachedBlock() must see this with the shard lock held
+			MutexLocker _(cache->Shard(blockNumber).lock);
 			block->discard = true;
 		}
 	}
@@ -3558,6 +4056,15 @@ const void*
 block_cache_get_etc(void* _cache, off_t blockNumber, off_t base, off_t length)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	cached_block* cachedBlock = cache->AcquireCachedBlock(blockNumber);
+	if (cachedBlock != NULL) {
+		TB(Get(cache, cachedBlock));
+		return cachedBlock->current_data;
+	}
+#endif
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
@@ -3598,8 +4105,7 @@ block_cache_set_dirty(void* _cache, off_t blockNumber, bool dirty,
 	block_cache* cache = (block_cache*)_cache;
 	MutexLocker locker(&cache->lock);
 
-	cached_block* block = (cached_block*)hash_lookup(cache->hash,
-		&blockNumber);
+	cached_block* block = cache->Lookup(blockNumber);
 	if (block == NULL)
 		return B_BAD_VALUE;
 	if (block->is_dirty == dirty) {
@@ -3619,6 +4125,12 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	if (cache->ReleaseCachedBlock(blockNumber))
+		return;
+#endif
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
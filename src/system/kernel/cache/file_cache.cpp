@@ -42,6 +42,12 @@
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
 
+// The readahead window is started with MIN_READAHEAD when a file is read
+// sequentially, and doubled up to MAX_READAHEAD every time the reader has
+// consumed half of it. Random access halves the window.
+#define MIN_READAHEAD		(64 * 1024)
+#define MAX_READAHEAD		(1024 * 1024)
+
 struct file_cache_ref {
 	VMCache			*cache;
 	struct vnode	*vnode;
@@ -51,6 +57,12 @@ struct file_cache_ref {
 		//	write vs. read)
 	int32			last_access_index;
 	uint16			disabled_count;
+	off_t			readahead_next;
+		// offset at which the next sequential read is expected
+	off_t			readahead_end;
+		// end of the range that has been read ahead
+	size_t			readahead_size;
+		// current size of the readahead window, 0 if disabled
 
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
@@ -107,6 +119,13 @@ static void add_to_iovec(generic_io_vec* vecs, uint32 &index, uint32 max,
 
 static struct cache_module_info* sCacheModule;
 
+static struct {
+	vint64	hits;
+	vint64	misses;
+	vint64	readahead_pages;
+	vint64	readahead_wasted;
+} sCacheStats;
+
 
 static const uint32 kZeroVecCount = 32;
 static const size_t kZeroVecSize = kZeroVecCount * B_PAGE_SIZE;
@@ -407,6 +426,8 @@ read_into_cache(file_cache_ref* ref, void* cookie, off_t offset,
 	cache->Unlock();
 	vm_page_unreserve_pages(reservation);
 
+	atomic_add64(&sCacheStats.misses, pageIndex);
+
 	// read file into reserved pages
 	status_t status = read_pages_and_clear_partial(ref, cookie, offset, vecs,
 		vecCount, B_PHYSICAL_IO_REQUEST, &numBytes);
@@ -475,6 +496,9 @@ read_from_file(file_cache_ref* ref, void* cookie, off_t offset,
 	ref->cache->Unlock();
 	vm_page_unreserve_pages(reservation);
 
+	atomic_add64(&sCacheStats.misses,
+		(pageOffset + bufferSize + B_PAGE_SIZE - 1) / B_PAGE_SIZE);
+
 	generic_size_t toRead = bufferSize;
 	status_t status = vfs_read_pages(ref->vnode, cookie, offset + pageOffset,
 		&vec, 1, 0, &toRead);
@@ -745,6 +769,7 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 		+ B_PAGE_SIZE - 1) >> PAGE_SHIFT);
 	size_t reservePages = 0;
 	size_t pagesProcessed = 0;
+	size_t cachedPages = 0;
 	cache_func function = NULL;
 
 	vm_page_reservation reservation;
@@ -795,6 +820,9 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 			"= %lu\n", offset, page, bytesLeft, pageOffset));
 
 		if (page != NULL) {
+			if (!doWrite)
+				cachedPages++;
+
 			if (doWrite || useBuffer) {
 				// Since the following user_mem{cpy,set}() might cause a page
 				// fault, which in turn might cause pages to be reserved, we
@@ -849,6 +877,7 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 				// we've read the last page, so we're done!
 				locker.Unlock();
 				vm_page_unreserve_pages(&reservation);
+				atomic_add64(&sCacheStats.hits, cachedPages);
 				return B_OK;
 			}
 
@@ -880,11 +909,137 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 
 	// fill the last remaining bytes of the request (either write or read)
 
+	atomic_add64(&sCacheStats.hits, cachedPages);
+
 	return function(ref, cookie, lastOffset, lastPageOffset, lastBuffer,
 		lastLeft, useBuffer, &reservation, 0);
 }
 
 
+/*!	Starts asynchronous reads for all pages in the given range that are not
+	in the cache yet. \a offset and \a size must be page aligned, and the
+	pages needed must have been reserved.
+	The cache must be locked; it is temporarily unlocked while the I/O
+	requests are scheduled.
+	\return The number of pages that are read.
+*/
+static size_t
+read_ahead_range(file_cache_ref* ref, off_t offset, size_t size,
+	vm_page_reservation* reservation)
+{
+	VMCache* cache = ref->cache;
+	size_t bytesToRead = 0;
+	size_t pagesRead = 0;
+	off_t lastOffset = offset;
+
+	while (true) {
+		// check if this page is already in memory
+		if (size > 0) {
+			vm_page* page = cache->LookupPage(offset);
+
+			offset += B_PAGE_SIZE;
+			size -= B_PAGE_SIZE;
+
+			if (page == NULL) {
+				bytesToRead += B_PAGE_SIZE;
+				continue;
+			}
+		}
+		if (bytesToRead != 0) {
+			// read the part before the current page (or the end of the request)
+			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
+				bytesToRead);
+			if (io == NULL || io->Prepare(reservation) != B_OK) {
+				delete io;
+				break;
+			}
+
+			// we must not have the cache locked during I/O
+			cache->Unlock();
+			io->ReadAsync();
+			cache->Lock();
+
+			pagesRead += bytesToRead / B_PAGE_SIZE;
+			bytesToRead = 0;
+		}
+
+		if (size == 0) {
+			// we have reached the end of the request
+			break;
+		}
+
+		lastOffset = offset;
+	}
+
+	return pagesRead;
+}
+
+
+/*!	Adapts the readahead window of the file to a read of \a size bytes at
+	\a offset, and asynchronously reads ahead of the reader, if it has
+	come close enough to the end of the range read ahead so far.
+*/
+static void
+read_ahead(file_cache_ref* ref, off_t offset, size_t size)
+{
+	VMCache* cache = ref->cache;
+	AutoLocker<VMCache> locker(cache);
+
+	off_t expected = ref->readahead_next;
+	off_t end = offset + size;
+	ref->readahead_next = end;
+
+	bool sequential = (offset >> PAGE_SHIFT) == (expected >> PAGE_SHIFT)
+		|| (offset > expected && offset < ref->readahead_end);
+	if (!sequential) {
+		// Random access: everything we've read ahead of the old position is
+		// likely not going to be used.
+		if (ref->readahead_end > expected) {
+			atomic_add64(&sCacheStats.readahead_wasted,
+				(ref->readahead_end - expected) >> PAGE_SHIFT);
+		}
+
+		ref->readahead_size /= 2;
+		if (ref->readahead_size < MIN_READAHEAD)
+			ref->readahead_size = 0;
+		ref->readahead_end = 0;
+		return;
+	}
+
+	// wait until the reader has consumed half of the window
+	if (ref->readahead_end - end > (off_t)ref->readahead_size / 2)
+		return;
+
+	if (ref->disabled_count > 0
+		|| low_resource_state(B_KERNEL_RESOURCE_PAGES) != B_NO_LOW_RESOURCE) {
+		return;
+	}
+
+	ref->readahead_size = ref->readahead_size == 0
+		? MIN_READAHEAD : min_c(ref->readahead_size * 2, MAX_READAHEAD);
+
+	off_t start = max_c(PAGE_ALIGN(end), ref->readahead_end);
+	off_t readAheadEnd = min_c(PAGE_ALIGN(end + ref->readahead_size),
+		PAGE_ALIGN(cache->virtual_end));
+	if (start >= readAheadEnd)
+		return;
+
+	size_t pageCount = (readAheadEnd - start) >> PAGE_SHIFT;
+	vm_page_reservation reservation;
+	if (!vm_page_try_reserve_pages(&reservation, pageCount, VM_PRIORITY_USER))
+		return;
+
+	ref->readahead_end = readAheadEnd;
+
+	size_t pagesRead = read_ahead_range(ref, start, readAheadEnd - start,
+		&reservation);
+	atomic_add64(&sCacheStats.readahead_pages, pagesRead);
+
+	locker.Unlock();
+	vm_page_unreserve_pages(&reservation);
+}
+
+
 static status_t
 file_cache_control(const char* subsystem, uint32 function, void* buffer,
 	size_t bufferSize)
@@ -929,6 +1084,22 @@ file_cache_control(const char* subsystem, uint32 function, void* buffer,
 
 			return status;
 		}
+
+		case CACHE_GET_STATS:
+		{
+			if (bufferSize != sizeof(file_cache_stats))
+				return B_BAD_VALUE;
+			if (!IS_USER_ADDRESS(buffer))
+				return B_BAD_ADDRESS;
+
+			file_cache_stats stats;
+			stats.hits = sCacheStats.hits;
+			stats.misses = sCacheStats.misses;
+			stats.readahead_pages = sCacheStats.readahead_pages;
+			stats.readahead_wasted = sCacheStats.readahead_wasted;
+
+			return user_memcpy(buffer, &stats, sizeof(file_cache_stats));
+		}
 	}
 
 	return B_BAD_HANDLER;
@@ -968,51 +1139,12 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 		return;
 	}
 
-	size_t bytesToRead = 0;
-	off_t lastOffset = offset;
-
 	vm_page_reservation reservation;
 	vm_page_reserve_pages(&reservation, reservePages, VM_PRIORITY_USER);
 
 	cache->Lock();
 
-	while (true) {
-		// check if this page is already in memory
-		if (size > 0) {
-			vm_page* page = cache->LookupPage(offset);
-
-			offset += B_PAGE_SIZE;
-			size -= B_PAGE_SIZE;
-
-			if (page == NULL) {
-				bytesToRead += B_PAGE_SIZE;
-				continue;
-			}
-		}
-		if (bytesToRead != 0) {
-			// read the part before the current page (or the end of the request)
-			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
-				bytesToRead);
-			if (io == NULL || io->Prepare(&reservation) != B_OK) {
-				delete io;
-				break;
-			}
-
-			// we must not have the cache locked during I/O
-			cache->Unlock();
-			io->ReadAsync();
-			cache->Lock();
-
-			bytesToRead = 0;
-		}
-
-		if (size == 0) {
-			// we have reached the end of the request
-			break;
-		}
-
-		lastOffset = offset;
-	}
+	read_ahead_range(ref, offset, size, &reservation);
 
 	cache->ReleaseRefAndUnlock();
 	vm_page_unreserve_pages(&reservation);
@@ -1022,8 +1154,6 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 extern "C" void
 cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
 {
-	// ToDo: schedule prefetch
-
 	TRACE(("cache_prefetch(vnode %ld:%Ld)\n", mountID, vnodeID));
 
 	// get the vnode for the object, this also grabs a ref to it
@@ -1132,6 +1262,9 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 	memset(ref->last_access, 0, sizeof(ref->last_access));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
+	ref->readahead_next = 0;
+	ref->readahead_end = 0;
+	ref->readahead_size = 0;
 
 	// TODO: delay VMCache creation until data is
 	//	requested/written for the first time? Listing lots of
@@ -1172,6 +1305,11 @@ file_cache_delete(void* _cacheRef)
 
 	TRACE(("file_cache_delete(ref = %p)\n", ref));
 
+	if (ref->readahead_end > ref->readahead_next) {
+		atomic_add64(&sCacheStats.readahead_wasted,
+			(ref->readahead_end - ref->readahead_next) >> PAGE_SHIFT);
+	}
+
 	ref->cache->ReleaseRef();
 	delete ref;
 }
@@ -1298,7 +1436,12 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
-	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
+	status_t status = cache_io(ref, cookie, offset, (addr_t)buffer, _size,
+		false);
+	if (status == B_OK && *_size > 0)
+		read_ahead(ref, offset, *_size);
+
+	return status;
 }
 
 
@@ -61,6 +61,9 @@ cpu_preboot_init_percpu(kernel_args *args, int curr_cpu)
 	memset(&gCPU[curr_cpu], 0, sizeof(gCPU[curr_cpu]));
 	gCPU[curr_cpu].cpu_num = curr_cpu;
 
+	// unless the architecture knows better, every CPU is a core of its own
+	gCPU[curr_cpu].core_id = curr_cpu;
+
 	return arch_cpu_preboot_init_percpu(args, curr_cpu);
 }
 
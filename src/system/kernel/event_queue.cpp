@@ -0,0 +1,737 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Event queues: persistent, kernel-resident sets of selected objects.
+
+	In contrast to select(), poll(), and wait_for_objects(), which select and
+	deselect all objects on every call, the objects of an event queue stay
+	selected until they are removed from the queue. Every object gets a
+	select_info/select_sync pair of its own, so that the existing select()
+	hooks of FDs, semaphores, ports, and threads can be used unchanged. When an
+	object notifies an event, its entry is appended to the queue's ready list,
+	so waiting for events only costs time proportional to the number of
+	objects that actually reported something.
+*/
+
+
+#include <event_queue.h>
+
+#include <new>
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include <AutoDeleter.h>
+#include <Referenceable.h>
+
+#include <fs/fd.h>
+#include <sem.h>
+#include <syscall_restart.h>
+#include <syscalls.h>
+#include <team.h>
+#include <util/AutoLock.h>
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+
+
+//#define TRACE_EVENT_QUEUE
+#ifdef TRACE_EVENT_QUEUE
+#	define TRACE(x) dprintf x
+#else
+#	define TRACE(x) ;
+#endif
+
+
+#define MAX_EVENT_QUEUE_WAIT_INFOS	1024
+
+
+static const uint16 kAlwaysSelectedEvents
+	= B_EVENT_INVALID | B_EVENT_ERROR | B_EVENT_DISCONNECTED;
+
+
+struct select_event;
+
+
+struct select_event_key {
+	int32	object;
+	uint16	type;
+};
+
+
+// A single object in an event queue. The info must be the first member, as
+// event_queue_notify() casts the select_info back to the select_event.
+struct select_event {
+	select_info			info;
+	select_sync			sync;
+	DoublyLinkedListLink<select_event> link;
+	select_event*		hash_link;
+	int32				object;
+	uint16				type;
+	uint16				behavior;
+	uint16				requested_events;
+	bool				queued;
+		// in the queue's ready list
+	bool				removed;
+		// no longer part of the queue, don't queue it again
+	void*				user_data;
+};
+
+typedef DoublyLinkedList<select_event,
+	DoublyLinkedListMemberGetLink<select_event, &select_event::link> >
+		SelectEventList;
+
+
+struct SelectEventHashDefinition {
+	typedef select_event_key	KeyType;
+	typedef select_event		ValueType;
+
+	size_t HashKey(const select_event_key& key) const
+	{
+		return (size_t)key.object * 17 + key.type;
+	}
+
+	size_t Hash(select_event* value) const
+	{
+		return (size_t)value->object * 17 + value->type;
+	}
+
+	bool Compare(const select_event_key& key, select_event* value) const
+	{
+		return value->object == key.object && value->type == key.type;
+	}
+
+	select_event*& GetLink(select_event* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+typedef BOpenHashTable<SelectEventHashDefinition> SelectEventTable;
+
+
+// Locking:
+// * fLock: Protects fEvents and serializes selecting and deselecting the
+//   queue's objects.
+// * fReadyLock: Protects fReadyEvents, fClosed, and select_event::queued and
+//   ::removed. It is a spinlock, since the objects may notify events in any
+//   context, including with interrupts disabled.
+//
+// Every select_event holds a reference to its queue, and the queue holds a
+// reference to each select_event's sync as long as the event is in fEvents.
+// The objects acquire additional sync references as needed, so that an event
+// remains valid while any of them might still notify it.
+struct EventQueue : BReferenceable {
+public:
+								EventQueue(bool kernel);
+	virtual						~EventQueue();
+
+			status_t			Init();
+
+			void				Close();
+
+			status_t			Select(int32 object, uint16 type,
+									uint16 events, uint16 behavior,
+									void* userData);
+			ssize_t				Wait(event_wait_info* infos, int numInfos,
+									uint32 flags, bigtime_t timeout);
+
+			void				Notify(select_event* event, uint16 events);
+
+private:
+			select_event*		_CreateEvent(int32 object, uint16 type);
+			status_t			_SelectEvent(select_event* event);
+			void				_DeselectEvent(select_event* event);
+			void				_RemoveEvent(select_event* event,
+									bool deselect);
+			int					_DequeueEvents(event_wait_info* infos,
+									int numInfos);
+
+private:
+			mutex				fLock;
+			spinlock			fReadyLock;
+			SelectEventTable	fEvents;
+			SelectEventList		fReadyEvents;
+			sem_id				fSem;
+			bool				fKernel;
+			bool				fClosed;
+};
+
+
+EventQueue::EventQueue(bool kernel)
+	:
+	fSem(-1),
+	fKernel(kernel),
+	fClosed(false)
+{
+	mutex_init(&fLock, "event queue");
+	B_INITIALIZE_SPINLOCK(&fReadyLock);
+}
+
+
+EventQueue::~EventQueue()
+{
+	delete_sem(fSem);
+	mutex_destroy(&fLock);
+}
+
+
+status_t
+EventQueue::Init()
+{
+	// The semaphore must not go away with the team that created the queue.
+	fSem = create_sem_etc(0, "event queue", team_get_kernel_team_id());
+	if (fSem < 0)
+		return fSem;
+
+	return fEvents.Init();
+}
+
+
+void
+EventQueue::Close()
+{
+	MutexLocker locker(fLock);
+
+	{
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		fClosed = true;
+	}
+
+	select_event* event = fEvents.Clear(true);
+	while (event != NULL) {
+		select_event* next = event->hash_link;
+		_RemoveEvent(event, (event->info.events & B_EVENT_INVALID) == 0);
+		event = next;
+	}
+
+	// wake up all waiting threads
+	release_sem_etc(fSem, 1, B_RELEASE_ALL);
+}
+
+
+status_t
+EventQueue::Select(int32 object, uint16 type, uint16 events, uint16 behavior,
+	void* userData)
+{
+	MutexLocker locker(fLock);
+
+	if (fClosed)
+		return B_FILE_ERROR;
+
+	select_event_key key = { object, type };
+	select_event* event = fEvents.Lookup(key);
+
+	if (events == 0) {
+		// remove the object
+		if (event == NULL)
+			return B_ENTRY_NOT_FOUND;
+
+		fEvents.Remove(event);
+		_RemoveEvent(event, (event->info.events & B_EVENT_INVALID) == 0);
+		return B_OK;
+	}
+
+	if (event != NULL) {
+		// modify an existing entry
+		_DeselectEvent(event);
+	} else {
+		event = _CreateEvent(object, type);
+		if (event == NULL)
+			return B_NO_MEMORY;
+
+		fEvents.Insert(event);
+	}
+
+	event->requested_events = events;
+	event->behavior = behavior;
+	event->user_data = userData;
+
+	status_t status = _SelectEvent(event);
+	if (status != B_OK) {
+		fEvents.Remove(event);
+		_RemoveEvent(event, false);
+		return status;
+	}
+
+	return B_OK;
+}
+
+
+ssize_t
+EventQueue::Wait(event_wait_info* infos, int numInfos, uint32 flags,
+	bigtime_t timeout)
+{
+	if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout != B_INFINITE_TIMEOUT
+		&& timeout > 0) {
+		// We might have to wait more than once, so make the timeout absolute
+		flags = (flags & ~B_RELATIVE_TIMEOUT) | B_ABSOLUTE_TIMEOUT;
+		timeout += system_time();
+	}
+
+	while (true) {
+		int count = _DequeueEvents(infos, numInfos);
+		if (count != 0)
+			return count;
+
+		{
+			InterruptsSpinLocker readyLocker(fReadyLock);
+			if (fClosed)
+				return B_FILE_ERROR;
+		}
+
+		// The semaphore count can be higher than the number of queued events,
+		// so we might just loop another time.
+		status_t status = acquire_sem_etc(fSem, 1, B_CAN_INTERRUPT | flags,
+			timeout);
+		if (status != B_OK)
+			return status;
+	}
+}
+
+
+void
+EventQueue::Notify(select_event* event, uint16 events)
+{
+	if ((event->info.selected_events & events) == 0)
+		return;
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+
+	if (event->queued || event->removed || fClosed)
+		return;
+
+	fReadyEvents.Add(event);
+	event->queued = true;
+
+	readyLocker.Unlock();
+
+	// Release the semaphore once per queued event, so that every waiter gets
+	// woken up, even if the list was not empty before.
+	release_sem_etc(fSem, 1, B_DO_NOT_RESCHEDULE);
+}
+
+
+select_event*
+EventQueue::_CreateEvent(int32 object, uint16 type)
+{
+	select_event* event = new(std::nothrow) select_event;
+	if (event == NULL)
+		return NULL;
+
+	event->object = object;
+	event->type = type;
+	event->queued = false;
+	event->removed = false;
+
+	event->info.next = NULL;
+	event->info.sync = &event->sync;
+	event->info.events = 0;
+	event->info.selected_events = 0;
+
+	event->sync.ref_count = 1;
+	event->sync.sem = fSem;
+	event->sync.count = 1;
+	event->sync.set = &event->info;
+	event->sync.queue = this;
+
+	AcquireReference();
+	return event;
+}
+
+
+/*!	Selects the event's object. fLock must be held.
+*/
+status_t
+EventQueue::_SelectEvent(select_event* event)
+{
+	event->info.selected_events = event->requested_events
+		| kAlwaysSelectedEvents;
+	event->info.events = 0;
+
+	return select_object(event->type, event->object, &event->info, fKernel);
+}
+
+
+/*!	Deselects the event's object and removes the event from the ready list.
+	fLock must be held.
+*/
+void
+EventQueue::_DeselectEvent(select_event* event)
+{
+	deselect_object(event->type, event->object, &event->info, fKernel);
+
+	InterruptsSpinLocker readyLocker(fReadyLock);
+	if (event->queued) {
+		fReadyEvents.Remove(event);
+		event->queued = false;
+	}
+}
+
+
+/*!	Releases the queue's reference to an event that has already been removed
+	from fEvents. fLock must be held.
+*/
+void
+EventQueue::_RemoveEvent(select_event* event, bool deselect)
+{
+	if (deselect)
+		deselect_object(event->type, event->object, &event->info, fKernel);
+
+	{
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		if (event->queued) {
+			fReadyEvents.Remove(event);
+			event->queued = false;
+		}
+		event->removed = true;
+	}
+
+	put_select_sync(&event->sync);
+}
+
+
+int
+EventQueue::_DequeueEvents(event_wait_info* infos, int numInfos)
+{
+	MutexLocker locker(fLock);
+
+	// Level-triggered events that have been reported are collected and
+	// selected again only after the loop, so that we don't report them more
+	// than once in the same call.
+	SelectEventList rearmEvents;
+
+	int count = 0;
+	while (count < numInfos) {
+		InterruptsSpinLocker readyLocker(fReadyLock);
+		select_event* event = fReadyEvents.RemoveHead();
+		if (event == NULL)
+			break;
+		event->queued = false;
+
+		uint16 events = atomic_and(&event->info.events, 0)
+			& event->info.selected_events;
+		readyLocker.Unlock();
+
+		if (events == 0)
+			continue;
+
+		event_wait_info& info = infos[count++];
+		info.object = event->object;
+		info.type = event->type;
+		info.behavior = event->behavior;
+		info.events = events;
+		info.user_data = event->user_data;
+
+		if ((events & B_EVENT_INVALID) != 0) {
+			// the object is gone and has already dropped the event
+			fEvents.Remove(event);
+			_RemoveEvent(event, false);
+		} else if ((event->behavior & B_EVENT_ONE_SHOT) != 0) {
+			fEvents.Remove(event);
+			_RemoveEvent(event, true);
+		} else if ((event->behavior & B_EVENT_EDGE_TRIGGERED) == 0)
+			rearmEvents.Add(event);
+	}
+
+	// Selecting the object again makes it notify us right away, if the
+	// condition still holds.
+	while (select_event* event = rearmEvents.RemoveHead()) {
+		_DeselectEvent(event);
+		if (_SelectEvent(event) != B_OK) {
+			// report the object as invalid with the next call
+			event->info.selected_events = B_EVENT_INVALID;
+			atomic_or(&event->info.events, B_EVENT_INVALID);
+			Notify(event, B_EVENT_INVALID);
+		}
+	}
+
+	return count;
+}
+
+
+// #pragma mark - file descriptor ops
+
+
+static status_t
+event_queue_close(file_descriptor* descriptor)
+{
+	EventQueue* queue = (EventQueue*)descriptor->cookie;
+	queue->Close();
+	return B_OK;
+}
+
+
+static void
+event_queue_free(file_descriptor* descriptor)
+{
+	EventQueue* queue = (EventQueue*)descriptor->cookie;
+	queue->ReleaseReference();
+}
+
+
+static struct fd_ops sEventQueueFDOps = {
+	NULL,	// fd_read
+	NULL,	// fd_write
+	NULL,	// fd_seek
+	NULL,	// fd_ioctl
+	NULL,	// fd_set_flags
+	NULL,	// fd_select
+	NULL,	// fd_deselect
+	NULL,	// fd_read_dir
+	NULL,	// fd_rewind_dir
+	NULL,	// fd_read_stat
+	NULL,	// fd_write_stat
+	&event_queue_close,
+	&event_queue_free
+};
+
+
+static status_t
+get_event_queue(int fd, bool kernel, file_descriptor*& _descriptor,
+	EventQueue*& _queue)
+{
+	file_descriptor* descriptor = get_fd(get_current_io_context(kernel), fd);
+	if (descriptor == NULL)
+		return B_FILE_ERROR;
+
+	if (descriptor->type != FDTYPE_EVENT_QUEUE) {
+		put_fd(descriptor);
+		return B_BAD_VALUE;
+	}
+
+	_descriptor = descriptor;
+	_queue = (EventQueue*)descriptor->cookie;
+	return B_OK;
+}
+
+
+static int
+common_event_queue_create(int openFlags, bool kernel)
+{
+	EventQueue* queue = new(std::nothrow) EventQueue(kernel);
+	if (queue == NULL)
+		return B_NO_MEMORY;
+
+	status_t status = queue->Init();
+	if (status != B_OK) {
+		queue->ReleaseReference();
+		return status;
+	}
+
+	file_descriptor* descriptor = alloc_fd();
+	if (descriptor == NULL) {
+		queue->ReleaseReference();
+		return B_NO_MEMORY;
+	}
+
+	descriptor->type = FDTYPE_EVENT_QUEUE;
+	descriptor->ops = &sEventQueueFDOps;
+	descriptor->cookie = queue;
+	descriptor->open_mode = O_RDWR;
+
+	io_context* context = get_current_io_context(kernel);
+	int fd = new_fd(context, descriptor);
+	if (fd < 0) {
+		free(descriptor);
+		queue->ReleaseReference();
+		return B_NO_MORE_FDS;
+	}
+
+	mutex_lock(&context->io_mutex);
+	fd_set_close_on_exec(context, fd, (openFlags & O_CLOEXEC) != 0);
+	mutex_unlock(&context->io_mutex);
+
+	return fd;
+}
+
+
+static status_t
+common_event_queue_select(int fd, event_wait_info* infos, int numInfos,
+	bool kernel)
+{
+	file_descriptor* descriptor;
+	EventQueue* queue;
+	status_t status = get_event_queue(fd, kernel, descriptor, queue);
+	if (status != B_OK)
+		return status;
+
+	// Objects that couldn't be added, modified, or removed are flagged
+	// with B_EVENT_INVALID.
+	for (int i = 0; i < numInfos; i++) {
+		status_t error = queue->Select(infos[i].object, infos[i].type,
+			infos[i].events, infos[i].behavior, infos[i].user_data);
+		if (error != B_OK) {
+			infos[i].events = B_EVENT_INVALID;
+			status = error;
+		}
+	}
+
+	put_fd(descriptor);
+	return status;
+}
+
+
+static ssize_t
+common_event_queue_wait(int fd, event_wait_info* infos, int numInfos,
+	uint32 flags, bigtime_t timeout, bool kernel)
+{
+	file_descriptor* descriptor;
+	EventQueue* queue;
+	status_t status = get_event_queue(fd, kernel, descriptor, queue);
+	if (status != B_OK)
+		return status;
+
+	ssize_t count = queue->Wait(infos, numInfos, flags, timeout);
+
+	put_fd(descriptor);
+	return count;
+}
+
+
+// #pragma mark - kernel private
+
+
+/*!	Called by notify_select_events() for select_infos belonging to an event
+	queue. May be called in any context.
+*/
+status_t
+event_queue_notify(select_info* info, uint16 events)
+{
+	select_event* event = (select_event*)info;
+
+	atomic_or(&info->events, events);
+	info->sync->queue->Notify(event, events);
+	return B_OK;
+}
+
+
+/*!	Called by put_select_sync() when the last reference to the sync of an
+	event queue entry has been released.
+*/
+void
+event_queue_put_select_sync(select_sync* sync)
+{
+	select_event* event = (select_event*)((uint8*)sync
+		- offsetof(select_event, sync));
+	EventQueue* queue = sync->queue;
+
+	TRACE(("event_queue_put_select_sync(): deleting event %p of queue %p\n",
+		event, queue));
+
+	delete event;
+	queue->ReleaseReference();
+}
+
+
+// #pragma mark - kernel API
+
+
+int
+_kern_event_queue_create(int openFlags)
+{
+	return common_event_queue_create(openFlags, true);
+}
+
+
+status_t
+_kern_event_queue_select(int queue, event_wait_info* infos, int numInfos)
+{
+	if (numInfos < 0 || (infos == NULL && numInfos > 0))
+		return B_BAD_VALUE;
+
+	return common_event_queue_select(queue, infos, numInfos, true);
+}
+
+
+ssize_t
+_kern_event_queue_wait(int queue, event_wait_info* infos, int numInfos,
+	uint32 flags, bigtime_t timeout)
+{
+	if (numInfos <= 0 || infos == NULL)
+		return B_BAD_VALUE;
+
+	return common_event_queue_wait(queue, infos, numInfos, flags, timeout,
+		true);
+}
+
+
+// #pragma mark - syscalls
+
+
+int
+_user_event_queue_create(int openFlags)
+{
+	return common_event_queue_create(openFlags, false);
+}
+
+
+status_t
+_user_event_queue_select(int queue, event_wait_info* userInfos, int numInfos)
+{
+	if (numInfos < 0 || numInfos > MAX_EVENT_QUEUE_WAIT_INFOS)
+		return B_BAD_VALUE;
+	if (numInfos == 0)
+		return B_OK;
+
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	size_t bytes = sizeof(event_wait_info) * numInfos;
+	event_wait_info* infos = (event_wait_info*)malloc(bytes);
+	if (infos == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter infosDeleter(infos);
+
+	if (user_memcpy(infos, userInfos, bytes) != B_OK)
+		return B_BAD_ADDRESS;
+
+	status_t status = common_event_queue_select(queue, infos, numInfos, false);
+
+	// copy back the per-object results
+	if (status != B_OK && user_memcpy(userInfos, infos, bytes) != B_OK)
+		return B_BAD_ADDRESS;
+
+	return status;
+}
+
+
+ssize_t
+_user_event_queue_wait(int queue, event_wait_info* userInfos, int numInfos,
+	uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (numInfos <= 0)
+		return B_BAD_VALUE;
+	if (numInfos > MAX_EVENT_QUEUE_WAIT_INFOS)
+		numInfos = MAX_EVENT_QUEUE_WAIT_INFOS;
+
+	if (userInfos == NULL || !IS_USER_ADDRESS(userInfos))
+		return B_BAD_ADDRESS;
+
+	size_t bytes = sizeof(event_wait_info) * numInfos;
+	event_wait_info* infos = (event_wait_info*)malloc(bytes);
+	if (infos == NULL)
+		return B_NO_MEMORY;
+	MemoryDeleter infosDeleter(infos);
+
+	ssize_t result = common_event_queue_wait(queue, infos, numInfos, flags,
+		timeout, false);
+
+	if (result > 0) {
+		if (user_memcpy(userInfos, infos, sizeof(event_wait_info) * result)
+				!= B_OK) {
+			return B_BAD_ADDRESS;
+		}
+		return result;
+	}
+
+	return syscall_restart_handle_timeout_post(result, timeout);
+}
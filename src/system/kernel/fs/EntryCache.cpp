@@ -8,8 +8,12 @@
 
 #include <new>
 
+#include <debug.h>
+#include <low_resource_manager.h>
+#include <smp.h>
 
-static const int32 kEntriesPerGeneration = 1024;
+
+static const int32 kInitialEntriesPerGeneration = 1024;
 
 static const int32 kEntryNotInArray = -1;
 static const int32 kEntryRemoved = -2;
@@ -28,19 +32,43 @@ EntryCacheGeneration::EntryCacheGeneration()
 
 EntryCacheGeneration::~EntryCacheGeneration()
 {
-	delete[] entries;
+	free(entries);
 }
 
 
 status_t
-EntryCacheGeneration::Init()
+EntryCacheGeneration::Init(int32 capacity)
 {
-	entries = new(std::nothrow) EntryCacheEntry*[kEntriesPerGeneration];
+	entries = (EntryCacheEntry**)calloc(capacity, sizeof(EntryCacheEntry*));
 	if (entries == NULL)
 		return B_NO_MEMORY;
 
-	memset(entries, 0, sizeof(EntryCacheEntry*) * kEntriesPerGeneration);
+	return B_OK;
+}
+
+
+/*!	Changes the size of the entries array. When shrinking, the caller must
+	already have removed all entries beyond the new \a capacity.
+*/
+status_t
+EntryCacheGeneration::Resize(int32 oldCapacity, int32 capacity)
+{
+	if (next_index > capacity)
+		next_index = capacity;
+
+	EntryCacheEntry** newEntries = (EntryCacheEntry**)realloc(entries,
+		sizeof(EntryCacheEntry*) * capacity);
+	if (newEntries == NULL) {
+		// when shrinking, we can just continue to use the old array
+		return capacity < oldCapacity ? B_OK : B_NO_MEMORY;
+	}
+
+	if (capacity > oldCapacity) {
+		memset(newEntries + oldCapacity, 0,
+			sizeof(EntryCacheEntry*) * (capacity - oldCapacity));
+	}
 
+	entries = newEntries;
 	return B_OK;
 }
 
@@ -50,7 +78,11 @@ EntryCacheGeneration::Init()
 
 EntryCache::EntryCache()
 	:
-	fCurrentGeneration(0)
+	fCurrentGeneration(0),
+	fGenerationCapacity(kInitialEntriesPerGeneration),
+	fLowResourceHandlerRegistered(false),
+	fStats(NULL),
+	fEvictions(0)
 {
 	rw_lock_init(&fLock, "entry cache");
 
@@ -60,6 +92,9 @@ EntryCache::EntryCache()
 
 EntryCache::~EntryCache()
 {
+	if (fLowResourceHandlerRegistered)
+		unregister_low_resource_handler(&_LowMemoryHandler, this);
+
 	// delete entries
 	EntryCacheEntry* entry = fEntries.Clear(true);
 	while (entry != NULL) {
@@ -68,6 +103,8 @@ EntryCache::~EntryCache()
 		entry = next;
 	}
 
+	free(fStats);
+
 	rw_lock_destroy(&fLock);
 }
 
@@ -79,18 +116,35 @@ EntryCache::Init()
 	if (error != B_OK)
 		return error;
 
+	fStats = (EntryCacheStats*)calloc(smp_get_num_cpus(),
+		sizeof(EntryCacheStats));
+	if (fStats == NULL)
+		return B_NO_MEMORY;
+
 	for (int32 i = 0; i < kGenerationCount; i++) {
-		error = fGenerations[i].Init();
+		error = fGenerations[i].Init(fGenerationCapacity);
 		if (error != B_OK)
 			return error;
 	}
 
+	error = register_low_resource_handler(&_LowMemoryHandler, this,
+		B_KERNEL_RESOURCE_MEMORY, 0);
+	if (error != B_OK)
+		return error;
+
+	fLowResourceHandlerRegistered = true;
 	return B_OK;
 }
 
 
+/*!	Adds an entry to the cache, or updates an existing one. If \a missing is
+	\c true, the entry is a negative one: it records that \a name does not
+	exist in the directory, and \a nodeID is ignored.
+	A file system must only add negative entries if it makes sure to add or
+	remove the entry again whenever the name is created.
+*/
 status_t
-EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
+EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 {
 	EntryCacheKey key(dirID, name);
 
@@ -99,6 +153,7 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry != NULL) {
 		entry->node_id = nodeID;
+		entry->missing = missing;
 		if (entry->generation != fCurrentGeneration) {
 			if (entry->index >= 0) {
 				fGenerations[entry->generation].entries[entry->index] = NULL;
@@ -116,6 +171,7 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID)
 	entry->dir_id = dirID;
 	entry->generation = fCurrentGeneration;
 	entry->index = kEntryNotInArray;
+	entry->missing = missing;
 	strcpy(entry->name, name);
 
 	fEntries.Insert(entry);
@@ -137,39 +193,73 @@ EntryCache::Remove(ino_t dirID, const char* name)
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	fEntries.Remove(entry);
+	_RemoveEntry(entry);
+	return B_OK;
+}
 
-	if (entry->index >= 0) {
-		// remove the entry from its generation and delete it
-		fGenerations[entry->generation].entries[entry->index] = NULL;
-		free(entry);
-	} else {
-		// We can't free it, since another thread is about to try to move it
-		// to another generation. We mark it removed and the other thread will
-		// take care of deleting it.
-		entry->index = kEntryRemoved;
-	}
 
-	return B_OK;
+/*!	Removes the entry, but only if it is a negative one. */
+void
+EntryCache::RemoveMissing(ino_t dirID, const char* name)
+{
+	EntryCacheKey key(dirID, name);
+
+	ReadLocker readLocker(fLock);
+
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	if (entry == NULL || !entry->missing)
+		return;
+
+	readLocker.Unlock();
+	WriteLocker writeLocker(fLock);
+
+	entry = fEntries.Lookup(key);
+	if (entry != NULL && entry->missing)
+		_RemoveEntry(entry);
 }
 
 
+/*!	Looks up the entry \a name in directory \a dirID. Returns \c true, if
+	the cache knows about the entry; if it is a negative entry, \a _missing
+	is set to \c true and \a _nodeID is left untouched.
+*/
 bool
-EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
+EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
+	bool& _missing)
 {
 	EntryCacheKey key(dirID, name);
 
 	ReadLocker readLocker(fLock);
 
+	// The statistics are only approximate, since we might get migrated to
+	// another CPU while updating them.
+	EntryCacheStats& stats = fStats[smp_get_current_cpu()];
+
 	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry == NULL)
+	if (entry == NULL) {
+		stats.misses++;
 		return false;
+	}
+
+	if (entry->missing)
+		stats.negative_hits++;
+	else
+		stats.hits++;
+
+	if (entry->generation == fCurrentGeneration) {
+		// Don't write to the entry at all in the common case, so that
+		// frequently used entries don't bounce between CPUs.
+		_nodeID = entry->node_id;
+		_missing = entry->missing;
+		return true;
+	}
 
 	int32 oldGeneration = atomic_set(&entry->generation, fCurrentGeneration);
 	if (oldGeneration == fCurrentGeneration || entry->index < 0) {
 		// The entry is already in the current generation or is being moved to
 		// it by another thread.
 		_nodeID = entry->node_id;
+		_missing = entry->missing;
 		return true;
 	}
 
@@ -178,11 +268,12 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
 	entry->index = kEntryNotInArray;
 
 	// add to the current generation
-	int32 index = atomic_add(&fGenerations[oldGeneration].next_index, 1);
-	if (index < kEntriesPerGeneration) {
+	int32 index = atomic_add(&fGenerations[fCurrentGeneration].next_index, 1);
+	if (index < fGenerationCapacity) {
 		fGenerations[fCurrentGeneration].entries[index] = entry;
 		entry->index = index;
 		_nodeID = entry->node_id;
+		_missing = entry->missing;
 		return true;
 	}
 
@@ -200,6 +291,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID)
 	_AddEntryToCurrentGeneration(entry);
 
 	_nodeID = entry->node_id;
+	_missing = entry->missing;
 	return true;
 }
 
@@ -209,7 +301,8 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 {
 	for (EntryTable::Iterator it = fEntries.GetIterator();
 			EntryCacheEntry* entry = it.Next();) {
-		if (nodeID == entry->node_id && strcmp(entry->name, ".") != 0
+		if (nodeID == entry->node_id && !entry->missing
+				&& strcmp(entry->name, ".") != 0
 				&& strcmp(entry->name, "..") != 0) {
 			_dirID = entry->dir_id;
 			return entry->name;
@@ -220,12 +313,61 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 }
 
 
+void
+EntryCache::DebugDumpStats()
+{
+	kprintf(" entry cache:   %" B_PRIuSIZE " entries, %" B_PRId32
+		" per generation\n", fEntries.CountElements(), fGenerationCapacity);
+	EntryCacheStats total = {};
+	for (int32 i = 0; fStats != NULL && i < smp_get_num_cpus(); i++) {
+		total.hits += fStats[i].hits;
+		total.negative_hits += fStats[i].negative_hits;
+		total.misses += fStats[i].misses;
+	}
+
+	kprintf("  hits:          %" B_PRId64 " (%" B_PRId64 " negative)\n",
+		total.hits + total.negative_hits, total.negative_hits);
+	kprintf("  misses:        %" B_PRId64 "\n", total.misses);
+	kprintf("  evictions:     %" B_PRId64 "\n", fEvictions);
+}
+
+
+void
+EntryCache::_RemoveEntry(EntryCacheEntry* entry)
+{
+	fEntries.Remove(entry);
+
+	if (entry->index >= 0) {
+		// remove the entry from its generation and delete it
+		fGenerations[entry->generation].entries[entry->index] = NULL;
+		free(entry);
+	} else {
+		// We can't free it, since another thread is about to try to move it
+		// to another generation. We mark it removed and the other thread will
+		// take care of deleting it.
+		entry->index = kEntryRemoved;
+	}
+}
+
+
 void
 EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 {
 	// the generation might not be full yet
 	int32 index = fGenerations[fCurrentGeneration].next_index++;
-	if (index < kEntriesPerGeneration) {
+	if (index < fGenerationCapacity) {
+		fGenerations[fCurrentGeneration].entries[index] = entry;
+		entry->generation = fCurrentGeneration;
+		entry->index = index;
+		return;
+	}
+
+	// As long as memory is not getting tight, we grow the generations
+	// instead of throwing away the oldest one.
+	if (fGenerationCapacity < kMaxEntriesPerGeneration
+		&& low_resource_state(B_KERNEL_RESOURCE_MEMORY) == B_NO_LOW_RESOURCE
+		&& _SetGenerationCapacity(fGenerationCapacity * 2) == B_OK) {
+		index = fGenerations[fCurrentGeneration].next_index++;
 		fGenerations[fCurrentGeneration].entries[index] = entry;
 		entry->generation = fCurrentGeneration;
 		entry->index = index;
@@ -234,15 +376,7 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 
 	// we have to clear the oldest generation
 	int32 newGeneration = (fCurrentGeneration + 1) % kGenerationCount;
-	for (int32 i = 0; i < kEntriesPerGeneration; i++) {
-		EntryCacheEntry* otherEntry = fGenerations[newGeneration].entries[i];
-		if (otherEntry == NULL)
-			continue;
-
-		fGenerations[newGeneration].entries[i] = NULL;
-		fEntries.Remove(otherEntry);
-		free(otherEntry);
-	}
+	_ClearGeneration(newGeneration);
 
 	// set the new generation and add the entry
 	fCurrentGeneration = newGeneration;
@@ -251,3 +385,104 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+void
+EntryCache::_ClearGeneration(int32 generation)
+{
+	for (int32 i = 0; i < fGenerationCapacity; i++) {
+		EntryCacheEntry* entry = fGenerations[generation].entries[i];
+		if (entry == NULL)
+			continue;
+
+		fGenerations[generation].entries[i] = NULL;
+		fEntries.Remove(entry);
+		free(entry);
+		fEvictions++;
+	}
+
+	fGenerations[generation].next_index = 0;
+}
+
+
+/*!	Changes the number of entries each generation can hold. When shrinking,
+	the entries that no longer fit are evicted.
+	The write lock must be held.
+*/
+status_t
+EntryCache::_SetGenerationCapacity(int32 capacity)
+{
+	int32 oldCapacity = fGenerationCapacity;
+	if (capacity == oldCapacity)
+		return B_OK;
+
+	if (capacity < oldCapacity) {
+		for (int32 i = 0; i < kGenerationCount; i++) {
+			EntryCacheGeneration& generation = fGenerations[i];
+			for (int32 index = capacity; index < oldCapacity; index++) {
+				EntryCacheEntry* entry = generation.entries[index];
+				if (entry == NULL)
+					continue;
+
+				generation.entries[index] = NULL;
+				fEntries.Remove(entry);
+				free(entry);
+				fEvictions++;
+			}
+
+			generation.Resize(oldCapacity, capacity);
+		}
+
+		fGenerationCapacity = capacity;
+		return B_OK;
+	}
+
+	for (int32 i = 0; i < kGenerationCount; i++) {
+		status_t status = fGenerations[i].Resize(oldCapacity, capacity);
+		if (status != B_OK) {
+			// the generations that could already be resized just keep their
+			// larger arrays
+			return status;
+		}
+	}
+
+	fGenerationCapacity = capacity;
+	return B_OK;
+}
+
+
+/*static*/ void
+EntryCache::_LowMemoryHandler(void* data, uint32 resources, int32 level)
+{
+	EntryCache* cache = (EntryCache*)data;
+
+	int32 generationsToClear;
+	int32 capacity;
+	switch (level) {
+		case B_NO_LOW_RESOURCE:
+			return;
+		case B_LOW_RESOURCE_NOTE:
+			generationsToClear = 1;
+			capacity = cache->fGenerationCapacity * 3 / 4;
+			break;
+		case B_LOW_RESOURCE_WARNING:
+			generationsToClear = kGenerationCount / 2;
+			capacity = cache->fGenerationCapacity / 2;
+			break;
+		case B_LOW_RESOURCE_CRITICAL:
+		default:
+			generationsToClear = kGenerationCount - 1;
+			capacity = kMinEntriesPerGeneration;
+			break;
+	}
+
+	WriteLocker locker(cache->fLock);
+
+	// clear the oldest generations, the current one is always kept
+	for (int32 i = 1; i <= generationsToClear; i++) {
+		cache->_ClearGeneration(
+			(cache->fCurrentGeneration + i) % kGenerationCount);
+	}
+
+	cache->_SetGenerationCapacity(max_c(capacity, kMinEntriesPerGeneration));
+}
@@ -36,6 +36,7 @@ struct EntryCacheEntry {
 			ino_t				dir_id;
 			vint32				generation;
 			vint32				index;
+			bool				missing;
 			char				name[1];
 };
 
@@ -47,7 +48,15 @@ struct EntryCacheGeneration {
 								EntryCacheGeneration();
 								~EntryCacheGeneration();
 
-			status_t			Init();
+			status_t			Init(int32 capacity);
+			status_t			Resize(int32 oldCapacity, int32 capacity);
+};
+
+
+struct EntryCacheStats {
+			int64				hits;
+			int64				negative_hits;
+			int64				misses;
 };
 
 
@@ -87,17 +96,21 @@ public:
 			status_t			Init();
 
 			status_t			Add(ino_t dirID, const char* name,
-									ino_t nodeID);
+									ino_t nodeID, bool missing = false);
 
 			status_t			Remove(ino_t dirID, const char* name);
+			void				RemoveMissing(ino_t dirID, const char* name);
 
 			bool				Lookup(ino_t dirID, const char* name,
-									ino_t& nodeID);
+									ino_t& nodeID, bool& missing);
 
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
+			void				DebugDumpStats();
 
 private:
 	static	const int32			kGenerationCount = 8;
+	static	const int32			kMinEntriesPerGeneration = 128;
+	static	const int32			kMaxEntriesPerGeneration = 8192;
 
 			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
 			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
@@ -105,12 +118,23 @@ private:
 private:
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
+			void				_RemoveEntry(EntryCacheEntry* entry);
+			void				_ClearGeneration(int32 generation);
+			status_t			_SetGenerationCapacity(int32 capacity);
+
+	static	void				_LowMemoryHandler(void* data,
+									uint32 resources, int32 level);
 
 private:
 			rw_lock				fLock;
 			EntryTable			fEntries;
 			EntryCacheGeneration fGenerations[kGenerationCount];
 			int32				fCurrentGeneration;
+			int32				fGenerationCapacity;
+			bool				fLowResourceHandlerRegistered;
+			EntryCacheStats*	fStats;
+				// per CPU, so that lookups don't contend on them
+			int64				fEvictions;
 };
 
 
@@ -8,12 +8,16 @@
 
 #include <sys/socket.h>
 
+#include <sys/stat.h>
+
 #include <errno.h>
 #include <limits.h>
+#include <new>
 
 #include <module.h>
 
 #include <AutoDeleter.h>
+#include <Referenceable.h>
 
 #include <syscall_utils.h>
 
@@ -23,6 +27,8 @@
 #include <syscall_restart.h>
 #include <util/AutoLock.h>
 #include <vfs.h>
+#include <vm/vm.h>
+#include <vm/VMAddressSpace.h>
 
 #include <net_stack_interface.h>
 #include <net_stat.h>
@@ -31,6 +37,7 @@
 #define MAX_SOCKET_ADDRESS_LENGTH	(sizeof(sockaddr_storage))
 #define MAX_SOCKET_OPTION_LENGTH	128
 #define MAX_ANCILLARY_DATA_LENGTH	1024
+#define MAX_SENDFILE_CHUNK_SIZE		(256 * 1024)
 
 #define GET_SOCKET_FD_OR_RETURN(fd, kernel, descriptor)	\
 	do {												\
@@ -61,6 +68,67 @@ struct FDPutter {
 };
 
 
+/*!	A part of a file that sendfile() maps and wires into the kernel address
+	space, so that the networking stack can refer to the pages of the file
+	cache directly. It is unmapped again when the last buffer referring to it
+	is freed.
+*/
+class SendFileChunk : public BReferenceable {
+public:
+	SendFileChunk()
+		:
+		fArea(-1),
+		fData(NULL),
+		fSize(0)
+	{
+	}
+
+	virtual ~SendFileChunk()
+	{
+		if (fData != NULL) {
+			unlock_memory_etc(VMAddressSpace::KernelID(), fData, fSize,
+				B_READ_DEVICE);
+		}
+		if (fArea >= 0)
+			delete_area(fArea);
+	}
+
+	status_t Map(int fd, off_t offset, size_t size)
+	{
+		off_t mapOffset = ROUNDDOWN(offset, B_PAGE_SIZE);
+		size_t pageOffset = offset - mapOffset;
+
+		void* address;
+		fArea = vm_map_user_file_into_kernel("sendfile chunk", &address,
+			PAGE_ALIGN(pageOffset + size), fd, mapOffset);
+		if (fArea < 0)
+			return fArea;
+
+		// Wire the pages, so that they stay in the cache, and accessing them
+		// cannot fault while the stack is using them.
+		uint8* data = (uint8*)address + pageOffset;
+		status_t status = lock_memory_etc(VMAddressSpace::KernelID(), data,
+			size, B_READ_DEVICE);
+		if (status != B_OK)
+			return status;
+
+		fData = data;
+		fSize = size;
+		return B_OK;
+	}
+
+	const void* Data() const
+	{
+		return fData;
+	}
+
+private:
+	area_id		fArea;
+	void*		fData;
+	size_t		fSize;
+};
+
+
 static net_stack_interface_module_info*
 get_stack_interface_module()
 {
@@ -542,6 +610,86 @@ common_sendmsg(int fd, const struct msghdr *message, int flags, bool kernel)
 }
 
 
+/*!	Sends \a count bytes of the file \a fd from \a _offset, or from its
+	current position if \a _offset is \c NULL, over \a socket. The file
+	data is not copied; its cache pages are mapped into the kernel, and
+	attached to the network buffers as they are.
+	Only works for userland file descriptors of regular files.
+*/
+static ssize_t
+common_sendfile(int socket, int fd, off_t* _offset, size_t count)
+{
+	file_descriptor* descriptor;
+	GET_SOCKET_FD_OR_RETURN(socket, false, descriptor);
+	FDPutter _(descriptor);
+
+	file_descriptor* fileDescriptor = get_fd(get_current_io_context(false),
+		fd);
+	if (fileDescriptor == NULL)
+		return EBADF;
+	FDPutter fileDescriptorPutter(fileDescriptor);
+
+	if (fileDescriptor->type != FDTYPE_FILE
+		|| fileDescriptor->ops->fd_read_stat == NULL) {
+		return B_BAD_VALUE;
+	}
+	if ((fileDescriptor->open_mode & O_RWMASK) == O_WRONLY)
+		return B_FILE_ERROR;
+
+	struct stat stat;
+	status_t status = fileDescriptor->ops->fd_read_stat(fileDescriptor, &stat);
+	if (status != B_OK)
+		return status;
+	if (!S_ISREG(stat.st_mode))
+		return B_BAD_VALUE;
+
+	off_t offset = _offset != NULL ? *_offset : fileDescriptor->pos;
+	if (offset >= stat.st_size)
+		return 0;
+	if ((off_t)count > stat.st_size - offset)
+		count = stat.st_size - offset;
+	if (count > SSIZE_MAX)
+		count = SSIZE_MAX;
+
+	size_t bytesSent = 0;
+	while (bytesSent < count) {
+		size_t chunkSize = min_c(count - bytesSent, MAX_SENDFILE_CHUNK_SIZE);
+
+		SendFileChunk* chunk = new(std::nothrow) SendFileChunk;
+		if (chunk == NULL) {
+			status = B_NO_MEMORY;
+			break;
+		}
+		BReference<SendFileChunk> chunkReference(chunk, true);
+
+		status = chunk->Map(fd, offset + bytesSent, chunkSize);
+		if (status != B_OK)
+			break;
+
+		ssize_t sent = sStackInterface->send_external(descriptor->u.socket,
+			chunk->Data(), chunkSize, 0, chunk);
+		if (sent < 0) {
+			status = sent;
+			break;
+		}
+
+		bytesSent += sent;
+		if ((size_t)sent < chunkSize)
+			break;
+	}
+
+	if (bytesSent == 0)
+		return status;
+
+	if (_offset != NULL)
+		*_offset = offset + bytesSent;
+	else
+		fileDescriptor->pos = offset + bytesSent;
+
+	return bytesSent;
+}
+
+
 static status_t
 common_getsockopt(int fd, int level, int option, void *value,
 	socklen_t *_length, bool kernel)
@@ -1104,6 +1252,32 @@ _user_sendmsg(int socket, const struct msghdr *userMessage, int flags)
 }
 
 
+ssize_t
+_user_sendfile(int socket, int fd, off_t *userOffset, size_t count)
+{
+	off_t offset = 0;
+	if (userOffset != NULL) {
+		if (!IS_USER_ADDRESS(userOffset)
+			|| user_memcpy(&offset, userOffset, sizeof(off_t)) != B_OK) {
+			return B_BAD_ADDRESS;
+		}
+		if (offset < 0)
+			return B_BAD_VALUE;
+	}
+
+	SyscallRestartWrapper<ssize_t> result;
+	result = common_sendfile(socket, fd, userOffset != NULL ? &offset : NULL,
+		count);
+
+	if (result >= 0 && userOffset != NULL
+		&& user_memcpy(userOffset, &offset, sizeof(off_t)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return result;
+}
+
+
 status_t
 _user_getsockopt(int socket, int level, int option, void *userValue,
 	socklen_t *_length)
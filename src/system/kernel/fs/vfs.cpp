@@ -1024,6 +1024,18 @@ free_vnode(struct vnode* vnode, bool reenter)
 static status_t
 dec_vnode_ref_count(struct vnode* vnode, bool alwaysFree, bool reenter)
 {
+	// As long as this isn't the last reference, there is nothing else to do
+	// but decrementing the count, and we don't need to lock anything for that.
+	int32 refCount = vnode->ref_count;
+	while (refCount > 1) {
+		int32 oldRefCount = atomic_test_and_set(&vnode->ref_count,
+			refCount - 1, refCount);
+		if (oldRefCount == refCount)
+			return B_OK;
+
+		refCount = oldRefCount;
+	}
+
 	ReadLocker locker(sVnodeLock);
 	AutoLocker<Vnode> nodeLocker(vnode);
 
@@ -1229,6 +1241,41 @@ restart:
 }
 
 
+/*!	Tries to get a reference to the vnode with the given mount and node ID
+	without locking the vnode. This only works for a vnode that is in use
+	already, since only the 0 -> 1 transition of the reference count requires
+	the vnode to be locked.
+
+	The caller must not hold the sVnodeLock.
+
+	\return The referenced vnode, or \c NULL, if the vnode isn't known, is
+		busy, or is currently unused. get_vnode() must be used in this case.
+*/
+static struct vnode*
+get_used_vnode(dev_t mountID, ino_t vnodeID)
+{
+	// Holding the read lock keeps the vnode from being freed; free_vnode()
+	// needs the write lock to remove it from the hash table.
+	ReadLocker locker(sVnodeLock);
+
+	struct vnode* vnode = lookup_vnode(mountID, vnodeID);
+	if (vnode == NULL || vnode->IsBusy() || vnode->IsUnpublished())
+		return NULL;
+
+	int32 refCount = vnode->ref_count;
+	while (refCount > 0) {
+		int32 oldRefCount = atomic_test_and_set(&vnode->ref_count,
+			refCount + 1, refCount);
+		if (oldRefCount == refCount)
+			return vnode;
+
+		refCount = oldRefCount;
+	}
+
+	return NULL;
+}
+
+
 /*!	\brief Decrements the reference counter of the given vnode and deletes it,
 	if the counter dropped to 0.
 
@@ -2085,9 +2132,14 @@ static status_t
 lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 {
 	ino_t id;
+	bool missing;
+
+	if (dir->mount->entry_cache.Lookup(dir->id, name, id, missing)) {
+		if (missing)
+			return B_ENTRY_NOT_FOUND;
 
-	if (dir->mount->entry_cache.Lookup(dir->id, name, id))
 		return get_vnode(dir->device, id, _vnode, true, false);
+	}
 
 	status_t status = FS_CALL(dir, lookup, name, &id);
 	if (status != B_OK)
@@ -2113,6 +2165,77 @@ lookup_dir_entry(struct vnode* dir, const char* name, struct vnode** _vnode)
 }
 
 
+/*!	Optimistically resolves the leading components of \a path that are found
+	in the entry cache and whose vnodes are in use already, without locking
+	any of the vnodes.
+	The walk stops at the first component that needs more care -- an entry
+	cache miss, "..", a symbolic link to be resolved, a mount point, or a
+	permission error -- and leaves it to the locked walk in
+	vnode_path_to_vnode(). \a _vnode, \a _path, and \a _lastParentID are
+	updated to reflect the components that could be resolved; the reference
+	to the original \a _vnode is transferred to the returned one.
+*/
+static void
+walk_cached_path(struct vnode*& _vnode, char*& _path, bool traverseLeafLink,
+	ino_t& _lastParentID)
+{
+	struct vnode* vnode = _vnode;
+	char* path = _path;
+
+	while (path[0] != '\0') {
+		char* end = path + 1;
+		while (*end != '\0' && *end != '/')
+			end++;
+
+		char* nextPath = end;
+		while (*nextPath == '/')
+			nextPath++;
+
+		// ".." might need to leave a mount or the I/O context's root
+		if (end - path == 2 && path[0] == '.' && path[1] == '.')
+			break;
+
+		if (!S_ISDIR(vnode->Type())
+			|| (HAS_FS_CALL(vnode, access)
+				&& FS_CALL(vnode, access, X_OK) != B_OK)) {
+			break;
+		}
+
+		char separator = *end;
+		*end = '\0';
+
+		struct vnode* nextVnode = NULL;
+		ino_t id;
+		bool missing;
+		if (vnode->mount->entry_cache.Lookup(vnode->id, path, id, missing)
+			&& !missing) {
+			nextVnode = get_used_vnode(vnode->device, id);
+		}
+
+		if (nextVnode != NULL && (nextVnode->IsCovered()
+				|| (S_ISLNK(nextVnode->Type())
+					&& (traverseLeafLink || nextPath[0] != '\0')))) {
+			put_vnode(nextVnode);
+			nextVnode = NULL;
+		}
+
+		if (nextVnode == NULL) {
+			*end = separator;
+			break;
+		}
+
+		_lastParentID = vnode->id;
+		put_vnode(vnode);
+
+		vnode = nextVnode;
+		path = nextPath;
+	}
+
+	_vnode = vnode;
+	_path = path;
+}
+
+
 /*!	Returns the vnode for the relative path starting at the specified \a vnode.
 	\a path must not be NULL.
 	If it returns successfully, \a path contains the name of the last path
@@ -2141,6 +2264,8 @@ vnode_path_to_vnode(struct vnode* vnode, char* path, bool traverseLeafLink,
 		return B_ENTRY_NOT_FOUND;
 	}
 
+	walk_cached_path(vnode, path, traverseLeafLink, lastParentID);
+
 	while (true) {
 		struct vnode* nextVnode;
 		char* nextPath;
@@ -3004,6 +3129,8 @@ _dump_mount(struct fs_mount* mount)
 		volume = volume->super_volume;
 	}
 
+	mount->entry_cache.DebugDumpStats();
+
 	set_debug_variable("_volume", (addr_t)mount->volume->private_volume);
 	set_debug_variable("_root", (addr_t)mount->root_vnode);
 	set_debug_variable("_covers", (addr_t)mount->root_vnode->covers);
@@ -3998,6 +4125,21 @@ entry_cache_add(dev_t mountID, ino_t dirID, const char* name, ino_t nodeID)
 }
 
 
+extern "C" status_t
+entry_cache_add_missing(dev_t mountID, ino_t dirID, const char* name)
+{
+	// lookup mount -- the caller is required to make sure that the mount
+	// won't go away
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return B_BAD_VALUE;
+	locker.Unlock();
+
+	return mount->entry_cache.Add(dirID, name, -1, true);
+}
+
+
 extern "C" status_t
 entry_cache_remove(dev_t mountID, ino_t dirID, const char* name)
 {
@@ -4508,6 +4650,24 @@ vfs_free_unused_vnodes(int32 level)
 }
 
 
+/*!	Drops a negative entry cache entry for \a name in directory \a dirID,
+	if there is one. This is called by the node monitor whenever an entry has
+	been created, so that a file system that failed to update the cache does
+	not leave a stale negative entry behind.
+*/
+extern "C" void
+vfs_entry_cache_remove_missing(dev_t mountID, ino_t dirID, const char* name)
+{
+	MutexLocker locker(sMountMutex);
+	struct fs_mount* mount = find_mount(mountID);
+	if (mount == NULL)
+		return;
+	locker.Unlock();
+
+	mount->entry_cache.RemoveMissing(dirID, name);
+}
+
+
 extern "C" bool
 vfs_can_page(struct vnode* vnode, void* cookie)
 {
@@ -6831,6 +6991,198 @@ err:
 }
 
 
+/*!	Reads the attribute described by \a vec through the regular attribute
+	hooks, for file systems that don't implement read_attrs().
+*/
+static void
+read_attr_vec(struct vnode* vnode, attr_vec& vec)
+{
+	if (!HAS_FS_CALL(vnode, open_attr) || !HAS_FS_CALL(vnode, read_attr_stat)) {
+		vec.result = B_UNSUPPORTED;
+		return;
+	}
+
+	void* cookie;
+	status_t status = FS_CALL(vnode, open_attr, vec.name, O_RDONLY, &cookie);
+	if (status != B_OK) {
+		vec.result = status;
+		return;
+	}
+
+	struct stat stat;
+	status = FS_CALL(vnode, read_attr_stat, cookie, &stat);
+	if (status == B_OK) {
+		vec.info.type = stat.st_type;
+		vec.info.size = stat.st_size;
+	}
+
+	size_t length = 0;
+	if (status == B_OK && vec.buffer != NULL && vec.buffer_size > 0) {
+		length = vec.buffer_size;
+		if (HAS_FS_CALL(vnode, read_attr))
+			status = FS_CALL(vnode, read_attr, cookie, 0, vec.buffer, &length);
+		else
+			status = B_UNSUPPORTED;
+	}
+
+	vec.result = status == B_OK ? (ssize_t)length : status;
+
+	if (HAS_FS_CALL(vnode, close_attr))
+		FS_CALL(vnode, close_attr, cookie);
+	FS_CALL(vnode, free_attr_cookie, cookie);
+}
+
+
+/*!	Replaces the contents of the attribute described by \a vec, the same way
+	_user_write_attr() does when writing at position 0.
+*/
+static void
+write_attr_vec(struct vnode* vnode, attr_vec& vec)
+{
+	if (!HAS_FS_CALL(vnode, create_attr) || !HAS_FS_CALL(vnode, write_attr)) {
+		vec.result = B_READ_ONLY_DEVICE;
+		return;
+	}
+	if (vec.buffer == NULL && vec.buffer_size > 0) {
+		vec.result = B_BAD_VALUE;
+		return;
+	}
+
+	void* cookie;
+	status_t status = FS_CALL(vnode, create_attr, vec.name, vec.info.type,
+		O_CREAT | O_WRONLY | O_TRUNC, &cookie);
+	if (status != B_OK) {
+		vec.result = status;
+		return;
+	}
+
+	size_t length = vec.buffer_size;
+	status = FS_CALL(vnode, write_attr, cookie, 0, vec.buffer, &length);
+	vec.result = status == B_OK ? (ssize_t)length : status;
+
+	if (HAS_FS_CALL(vnode, close_attr))
+		FS_CALL(vnode, close_attr, cookie);
+	FS_CALL(vnode, free_attr_cookie, cookie);
+}
+
+
+/*!	Reads all attributes in \a vecs from the given \a vnode, preferably
+	with a single call into the file system.
+	The result of each attribute is stored in the attr_vec, an error is only
+	returned if the node itself could not be accessed.
+*/
+static status_t
+read_attrs_vnode(struct vnode* vnode, attr_vec* vecs, size_t count)
+{
+	if (HAS_FS_CALL(vnode, read_attrs))
+		return FS_CALL(vnode, read_attrs, vecs, count);
+
+	for (size_t i = 0; i < count; i++)
+		read_attr_vec(vnode, vecs[i]);
+
+	return B_OK;
+}
+
+
+/*!	Copies an attr_vec array and the attribute names it refers to from
+	userland, and the results back again.
+*/
+class UserAttributeVecs {
+public:
+	UserAttributeVecs()
+		:
+		fUserVecs(NULL),
+		fVecs(NULL),
+		fNames(NULL),
+		fCount(0)
+	{
+	}
+
+	~UserAttributeVecs()
+	{
+		free(fVecs);
+		free(fNames);
+	}
+
+	status_t SetTo(attr_vec* userVecs, size_t count)
+	{
+		if (count > MAX_ATTR_VECS)
+			return B_BAD_VALUE;
+		if (userVecs == NULL || !IS_USER_ADDRESS(userVecs))
+			return B_BAD_ADDRESS;
+
+		fVecs = (attr_vec*)malloc(count * sizeof(attr_vec));
+		fNames = (char*)malloc(count * B_ATTR_NAME_LENGTH);
+		if (fVecs == NULL || fNames == NULL)
+			return B_NO_MEMORY;
+
+		if (user_memcpy(fVecs, userVecs, count * sizeof(attr_vec)) != B_OK)
+			return B_BAD_ADDRESS;
+
+		for (size_t i = 0; i < count; i++) {
+			attr_vec& vec = fVecs[i];
+			char* name = fNames + i * B_ATTR_NAME_LENGTH;
+
+			if (vec.name == NULL || !IS_USER_ADDRESS(vec.name)
+				|| (vec.buffer != NULL && !IS_USER_ADDRESS(vec.buffer)))
+				return B_BAD_ADDRESS;
+
+			ssize_t length = user_strlcpy(name, vec.name, B_ATTR_NAME_LENGTH);
+			if (length < 0)
+				return B_BAD_ADDRESS;
+			if (length >= B_ATTR_NAME_LENGTH)
+				return B_NAME_TOO_LONG;
+			if (length == 0)
+				return B_BAD_VALUE;
+
+			vec.name = name;
+			vec.result = B_ERROR;
+		}
+
+		fUserVecs = userVecs;
+		fCount = count;
+		return B_OK;
+	}
+
+	attr_vec* Vecs() const
+	{
+		return fVecs;
+	}
+
+	status_t CopyBack() const
+	{
+		// only the info and the result are copied back
+		size_t offset = offsetof(attr_vec, info);
+
+		for (size_t i = 0; i < fCount; i++) {
+			if (user_memcpy((uint8*)&fUserVecs[i] + offset,
+					(uint8*)&fVecs[i] + offset,
+					sizeof(attr_vec) - offset) != B_OK)
+				return B_BAD_ADDRESS;
+		}
+
+		return B_OK;
+	}
+
+	ssize_t CountSucceeded() const
+	{
+		ssize_t count = 0;
+		for (size_t i = 0; i < fCount; i++) {
+			if (fVecs[i].result >= 0)
+				count++;
+		}
+
+		return count;
+	}
+
+private:
+	attr_vec*	fUserVecs;
+	attr_vec*	fVecs;
+	char*		fNames;
+	size_t		fCount;
+};
+
+
 static int
 index_dir_open(dev_t mountID, bool kernel)
 {
@@ -9528,6 +9880,116 @@ _user_stat_attr(int fd, const char* attribute, struct attr_info* userAttrInfo)
 }
 
 
+ssize_t
+_user_read_attrs(int fd, attr_vec* userVecs, size_t count)
+{
+	if (count == 0)
+		return 0;
+
+	UserAttributeVecs vecs;
+	status_t status = vecs.SetTo(userVecs, count);
+	if (status != B_OK)
+		return status;
+
+	struct vnode* vnode;
+	status = fd_and_path_to_vnode(fd, NULL, true, &vnode, NULL, false);
+	if (status != B_OK)
+		return status;
+
+	status = read_attrs_vnode(vnode, vecs.Vecs(), count);
+	put_vnode(vnode);
+
+	if (status == B_OK)
+		status = vecs.CopyBack();
+	if (status != B_OK)
+		return status;
+
+	return vecs.CountSucceeded();
+}
+
+
+ssize_t
+_user_write_attrs(int fd, attr_vec* userVecs, size_t count)
+{
+	if (count == 0)
+		return 0;
+
+	UserAttributeVecs vecs;
+	status_t status = vecs.SetTo(userVecs, count);
+	if (status != B_OK)
+		return status;
+
+	struct vnode* vnode;
+	status = fd_and_path_to_vnode(fd, NULL, true, &vnode, NULL, false);
+	if (status != B_OK)
+		return status;
+
+	for (size_t i = 0; i < count; i++)
+		write_attr_vec(vnode, vecs.Vecs()[i]);
+
+	put_vnode(vnode);
+
+	status = vecs.CopyBack();
+	if (status != B_OK)
+		return status;
+
+	return vecs.CountSucceeded();
+}
+
+
+/*!	Reads the same set of attributes from several nodes of one volume.
+	\a userVecs contains \a count attr_vecs for every node, in the order of
+	\a userNodes.
+*/
+ssize_t
+_user_read_node_attrs(dev_t device, const ino_t* userNodes, size_t nodeCount,
+	attr_vec* userVecs, size_t count)
+{
+	if (nodeCount == 0 || count == 0)
+		return 0;
+	if (nodeCount > MAX_ATTR_VECS / count)
+		return B_BAD_VALUE;
+	if (userNodes == NULL || !IS_USER_ADDRESS(userNodes))
+		return B_BAD_ADDRESS;
+
+	ino_t* nodes = (ino_t*)malloc(nodeCount * sizeof(ino_t));
+	if (nodes == NULL)
+		return B_NO_MEMORY;
+
+	MemoryDeleter nodesDeleter(nodes);
+
+	if (user_memcpy(nodes, userNodes, nodeCount * sizeof(ino_t)) != B_OK)
+		return B_BAD_ADDRESS;
+
+	UserAttributeVecs vecs;
+	status_t status = vecs.SetTo(userVecs, nodeCount * count);
+	if (status != B_OK)
+		return status;
+
+	for (size_t i = 0; i < nodeCount; i++) {
+		attr_vec* nodeVecs = vecs.Vecs() + i * count;
+
+		struct vnode* vnode;
+		status = get_vnode(device, nodes[i], &vnode, true, false);
+		if (status == B_OK) {
+			status = read_attrs_vnode(vnode, nodeVecs, count);
+			put_vnode(vnode);
+		}
+
+		if (status != B_OK) {
+			for (size_t j = 0; j < count; j++)
+				nodeVecs[j].result = status;
+		}
+	}
+
+	status = vecs.CopyBack();
+	if (status != B_OK)
+		return status;
+
+	return vecs.CountSucceeded();
+}
+
+
 int
 _user_open_attr(int fd, const char* userPath, const char* userName,
 	uint32 type, int openMode)
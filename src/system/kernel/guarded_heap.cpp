@@ -954,6 +954,14 @@ object_cache_get_usage(object_cache* cache, size_t* _allocatedMemory)
 }
 
 
+status_t
+_user_get_next_object_cache_info(int32* _cookie,
+	struct object_cache_info* info, size_t size)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
 void
 slab_init(kernel_args* args)
 {
@@ -31,6 +31,7 @@
 #include <team.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
+#include <util/khash.h>
 #include <util/list.h>
 #include <vm/vm.h>
 #include <wait_for_objects.h>
@@ -45,19 +46,25 @@
 
 
 // Locking:
-// * sPortsLock: Protects the sPorts hash table, Team::port_list, and
-//   Port::owner.
-// * Port::lock: Protects all Port members save team_link, hash_link, and lock.
-//   id is immutable.
+// * sPortsLock: Protects the sPortsByName hash table, Team::port_list,
+//   Port::owner, sUsedPorts, and sNextPortID. Lookups by ID don't need it.
+// * PortHashShard::lock: Protects the shard's hash table. The ports are
+//   distributed over kPortHashShardCount shards by their ID, so that
+//   operations on different ports usually don't contend for the same lock.
+// * Port::lock: Protects all Port members save team_link, hash_link,
+//   name_hash_link, and lock. id is immutable, and so is the port's name
+//   (lock.name) once the port has been added to the hash tables.
+// * sTotalAreaSpaceInUse is only changed atomically.
 // * sPortQuotaLock: Protects sTotalSpaceInUse, sAreaChangeCounter,
 //   sWaitingForSpace and the critical section of creating/adding areas for the
 //   port heap in the grow case. It also has to be held when reading
 //   sWaitingForSpace to determine whether or not to notify the
 //   sNoSpaceCondition condition variable.
 //
-// The locking order is sPortsLock -> Port::lock. A port must be looked up
-// in sPorts and locked with sPortsLock held. Afterwards sPortsLock can be
-// dropped, unless any field guarded by sPortsLock is accessed.
+// The locking order is sPortsLock -> PortHashShard::lock -> Port::lock. A
+// port must be looked up in its shard and locked with the shard's lock held.
+// Afterwards the shard lock can be dropped. sPortsLock is only needed when
+// any field guarded by it is accessed.
 
 
 struct port_message;
@@ -72,6 +79,10 @@ struct port_message : DoublyLinkedListLinkImpl<port_message> {
 	uid_t				sender;
 	gid_t				sender_group;
 	team_id				sender_team;
+	area_id				area;
+		// area carried along with the message, owned by the kernel team
+	uint32				area_protection;
+	size_t				area_size;
 	char				buffer[0];
 };
 
@@ -81,6 +92,7 @@ typedef DoublyLinkedList<port_message> MessageList;
 struct Port {
 	struct list_link	team_link;
 	Port*				hash_link;
+	Port*				name_hash_link;
 	port_id				id;
 	team_id				owner;
 	int32		 		capacity;
@@ -121,13 +133,19 @@ struct Port {
 };
 
 
+static const int32 kPortHashShardCount = 32;
+	// must be a power of two
+
+
 struct PortHashDefinition {
 	typedef port_id		KeyType;
 	typedef	Port		ValueType;
 
 	size_t HashKey(port_id key) const
 	{
-		return key;
+		// the lower bits select the shard and are the same for all ports in
+		// a table
+		return (uint32)key / kPortHashShardCount;
 	}
 
 	size_t Hash(Port* value) const
@@ -149,6 +167,44 @@ struct PortHashDefinition {
 typedef BOpenHashTable<PortHashDefinition> PortHashTable;
 
 
+struct PortHashShard {
+	mutex				lock;
+	PortHashTable		table;
+};
+
+
+/*!	Secondary index of the ports keyed by name. Port names don't need to be
+	unique, so several ports may share a key; find_port() resolves those
+	deterministically by picking the one with the lowest ID.
+*/
+struct PortNameHashDefinition {
+	typedef const char*	KeyType;
+	typedef	Port		ValueType;
+
+	size_t HashKey(const char* key) const
+	{
+		return hash_hash_string(key);
+	}
+
+	size_t Hash(Port* value) const
+	{
+		return HashKey(value->lock.name);
+	}
+
+	bool Compare(const char* key, Port* value) const
+	{
+		return strcmp(value->lock.name, key) == 0;
+	}
+
+	Port*& GetLink(Port* value) const
+	{
+		return value->name_hash_link;
+	}
+};
+
+typedef BOpenHashTable<PortNameHashDefinition> PortNameHashTable;
+
+
 class PortNotificationService : public DefaultNotificationService {
 public:
 							PortNotificationService();
@@ -333,6 +389,7 @@ static const size_t kInitialPortBufferSize = 4 * 1024 * 1024;
 static const size_t kTotalSpaceLimit = 64 * 1024 * 1024;
 static const size_t kTeamSpaceLimit = 8 * 1024 * 1024;
 static const size_t kBufferGrowRate = kInitialPortBufferSize;
+static const size_t kTotalAreaSpaceLimit = 128 * 1024 * 1024;
 
 #define MAX_QUEUE_LENGTH 4096
 #define PORT_MAX_MESSAGE_SIZE (256 * 1024)
@@ -340,15 +397,17 @@ static const size_t kBufferGrowRate = kInitialPortBufferSize;
 static int32 sMaxPorts = 4096;
 static int32 sUsedPorts = 0;
 
-static PortHashTable sPorts;
+static PortHashShard sPortShards[kPortHashShardCount];
+static PortNameHashTable sPortsByName;
 static heap_allocator* sPortAllocator;
 static ConditionVariable sNoSpaceCondition;
 static int32 sTotalSpaceInUse;
+static int32 sTotalAreaSpaceInUse;
 static int32 sAreaChangeCounter;
 static int32 sWaitingForSpace;
 static port_id sNextPortID = 1;
 static bool sPortsActive = false;
-static mutex sPortsLock = MUTEX_INITIALIZER("ports list");
+static rw_lock sPortsLock = RW_LOCK_INITIALIZER("ports list");
 static mutex sPortQuotaLock = MUTEX_INITIALIZER("port quota");
 
 static PortNotificationService sNotificationService;
@@ -380,6 +439,47 @@ PortNotificationService::Notify(uint32 opcode, port_id port)
 //	#pragma mark -
 
 
+static inline PortHashShard&
+port_hash_shard(port_id id)
+{
+	return sPortShards[(uint32)id & (kPortHashShardCount - 1)];
+}
+
+
+/*!	Returns the port with the given ID, or \c NULL.
+	Doesn't do any locking, the caller must hold the shard lock or be in the
+	kernel debugger.
+*/
+static inline Port*
+lookup_port(port_id id)
+{
+	return port_hash_shard(id).table.Lookup(id);
+}
+
+
+/*!	Returns the port with the given name. If several ports share the name, the
+	one with the lowest ID is returned.
+	sPortsLock must be held.
+*/
+static Port*
+lookup_port_by_name(const char* name)
+{
+	Port* port = sPortsByName.Lookup(name);
+	if (port == NULL)
+		return NULL;
+
+	// The remaining ports with the same name (if any) follow in the same
+	// bucket chain.
+	for (Port* other = port->name_hash_link; other != NULL;
+			other = other->name_hash_link) {
+		if (other->id < port->id && strcmp(other->lock.name, name) == 0)
+			port = other;
+	}
+
+	return port;
+}
+
+
 static int
 dump_port_list(int argc, char** argv)
 {
@@ -397,16 +497,18 @@ dump_port_list(int argc, char** argv)
 	kprintf("port             id  cap  read-cnt  write-cnt   total   team  "
 		"name\n");
 
-	for (PortHashTable::Iterator it = sPorts.GetIterator();
-		Port* port = it.Next();) {
-		if ((owner != -1 && port->owner != owner)
-			|| (name != NULL && strstr(port->lock.name, name) == NULL))
-			continue;
-
-		kprintf("%p %8" B_PRId32 " %4" B_PRId32 " %9" B_PRIu32 " %9" B_PRId32
-			" %8" B_PRId32 " %6" B_PRId32 "  %s\n", port, port->id,
-			port->capacity, port->read_count, port->write_count,
-			port->total_count, port->owner, port->lock.name);
+	for (int32 i = 0; i < kPortHashShardCount; i++) {
+		for (PortHashTable::Iterator it = sPortShards[i].table.GetIterator();
+			Port* port = it.Next();) {
+			if ((owner != -1 && port->owner != owner)
+				|| (name != NULL && strstr(port->lock.name, name) == NULL))
+				continue;
+
+			kprintf("%p %8" B_PRId32 " %4" B_PRId32 " %9" B_PRIu32 " %9"
+				B_PRId32 " %8" B_PRId32 " %6" B_PRId32 "  %s\n", port,
+				port->id, port->capacity, port->read_count, port->write_count,
+				port->total_count, port->owner, port->lock.name);
+		}
 	}
 
 	return 0;
@@ -430,7 +532,13 @@ _dump_port_info(Port* port)
 
 		MessageList::Iterator iterator = port->messages.GetIterator();
 		while (port_message* message = iterator.Next()) {
-			kprintf(" %p  %08" B_PRIx32 "  %ld\n", message, message->code, message->size);
+			kprintf(" %p  %08" B_PRIx32 "  %ld", message, message->code,
+				message->size);
+			if (message->area >= 0) {
+				kprintf("  area %" B_PRId32 " (%ld bytes)", message->area,
+					message->area_size);
+			}
+			kprintf("\n");
 		}
 	}
 
@@ -462,7 +570,7 @@ dump_port_info(int argc, char** argv)
 	} else if (parse_expression(argv[1]) > 0) {
 		// if the argument looks like a number, treat it as such
 		int32 num = parse_expression(argv[1]);
-		Port* port = sPorts.Lookup(num);
+		Port* port = lookup_port(num);
 		if (port == NULL) {
 			kprintf("port %" B_PRId32 " (%#" B_PRIx32 ") doesn't exist!\n",
 				num, num);
@@ -473,15 +581,22 @@ dump_port_info(int argc, char** argv)
 	} else
 		name = argv[1];
 
-	// walk through the ports list, trying to match name
-	for (PortHashTable::Iterator it = sPorts.GetIterator();
-		Port* port = it.Next();) {
-		if ((name != NULL && port->lock.name != NULL
-				&& !strcmp(name, port->lock.name))
-			|| (condition != NULL && (&port->read_condition == condition
-				|| &port->write_condition == condition))) {
+	if (name != NULL) {
+		Port* port = lookup_port_by_name(name);
+		if (port != NULL)
 			_dump_port_info(port);
-			return 0;
+		return 0;
+	}
+
+	// walk through the ports list, trying to match the condition
+	for (int32 i = 0; i < kPortHashShardCount; i++) {
+		for (PortHashTable::Iterator it = sPortShards[i].table.GetIterator();
+			Port* port = it.Next();) {
+			if (&port->read_condition == condition
+				|| &port->write_condition == condition) {
+				_dump_port_info(port);
+				return 0;
+			}
 		}
 	}
 
@@ -503,9 +618,10 @@ notify_port_select_events(Port* port, uint16 events)
 static Port*
 get_locked_port(port_id id)
 {
-	MutexLocker portsLocker(sPortsLock);
+	PortHashShard& shard = port_hash_shard(id);
+	MutexLocker shardLocker(shard.lock);
 
-	Port* port = sPorts.Lookup(id);
+	Port* port = shard.table.Lookup(id);
 	if (port != NULL)
 		mutex_lock(&port->lock);
 	return port;
@@ -520,9 +636,56 @@ is_port_closed(Port* port)
 }
 
 
+/*!	Transfers the area \a id to the team \a target.
+	Unlike transfer_area() this doesn't require the area to belong to the
+	calling team, so the caller must have checked the permissions already.
+*/
+static area_id
+transfer_port_message_area(area_id id, team_id target, uint32 protection)
+{
+	area_info info;
+	status_t status = get_area_info(id, &info);
+	if (status != B_OK)
+		return status;
+
+	void* address = NULL;
+	area_id clonedArea = vm_clone_area(target, info.name, &address,
+		target == team_get_kernel_team_id()
+			? B_ANY_KERNEL_ADDRESS : B_ANY_ADDRESS,
+		protection, REGION_NO_PRIVATE_MAP, id, true);
+	if (clonedArea < 0)
+		return clonedArea;
+
+	status = vm_delete_area(info.team, id, true);
+	if (status != B_OK) {
+		vm_delete_area(target, clonedArea, true);
+		return status;
+	}
+
+	return clonedArea;
+}
+
+
+/*!	Deletes the area still attached to \a message, if any.
+	Must not be called with any port lock held.
+*/
+static void
+delete_port_message_area(port_message* message)
+{
+	if (message->area < 0)
+		return;
+
+	vm_delete_area(team_get_kernel_team_id(), message->area, true);
+	atomic_add(&sTotalAreaSpaceInUse, -(int32)message->area_size);
+	message->area = -1;
+}
+
+
 static void
 put_port_message(port_message* message)
 {
+	delete_port_message_area(message);
+
 	size_t size = sizeof(port_message) + message->size;
 	heap_free(sPortAllocator, message);
 
@@ -593,6 +756,8 @@ get_port_message(int32 code, size_t bufferSize, uint32 flags, bigtime_t timeout,
 		if (message != NULL) {
 			message->code = code;
 			message->size = bufferSize;
+			message->area = -1;
+			message->area_size = 0;
 
 			*_message = message;
 			return B_OK;
@@ -700,7 +865,7 @@ delete_owned_ports(Team* team)
 {
 	TRACE(("delete_owned_ports(owner = %ld)\n", team->id));
 
-	MutexLocker portsLocker(sPortsLock);
+	WriteLocker portsLocker(sPortsLock);
 
 	// move the ports from the team's port list to a local list
 	struct list queue;
@@ -710,8 +875,13 @@ delete_owned_ports(Team* team)
 	// uninitialize them
 	Port* port = (Port*)list_get_first_item(&queue);
 	while (port != NULL) {
+		PortHashShard& shard = port_hash_shard(port->id);
+		MutexLocker shardLocker(shard.lock);
+		shard.table.Remove(port);
 		MutexLocker locker(port->lock);
-		sPorts.Remove(port);
+		shardLocker.Unlock();
+
+		sPortsByName.Remove(port);
 		uninit_port_locked(port);
 		sUsedPorts--;
 
@@ -743,10 +913,20 @@ port_used_ports(void)
 status_t
 port_init(kernel_args *args)
 {
-	// initialize ports table
-	new(&sPorts) PortHashTable;
-	if (sPorts.Init() != B_OK) {
-		panic("Failed to init port hash table!");
+	// initialize ports tables
+	for (int32 i = 0; i < kPortHashShardCount; i++) {
+		PortHashShard& shard = sPortShards[i];
+		mutex_init(&shard.lock, "port hash shard");
+		new(&shard.table) PortHashTable;
+		if (shard.table.Init() != B_OK) {
+			panic("Failed to init port hash table!");
+			return B_NO_MEMORY;
+		}
+	}
+
+	new(&sPortsByName) PortNameHashTable;
+	if (sPortsByName.Init() != B_OK) {
+		panic("Failed to init port name hash table!");
 		return B_NO_MEMORY;
 	}
 
@@ -772,7 +952,7 @@ port_init(kernel_args *args)
 		return B_NO_MEMORY;
 	}
 
-	sNoSpaceCondition.Init(&sPorts, "port space");
+	sNoSpaceCondition.Init(&sPortShards, "port space");
 
 	// add debugger commands
 	add_debugger_command_etc("ports", &dump_port_list,
@@ -832,7 +1012,7 @@ create_port(int32 queueLength, const char* name)
 	}
 	ObjectDeleter<Port> portDeleter(port);
 
-	MutexLocker locker(sPortsLock);
+	WriteLocker locker(sPortsLock);
 
 	// check the ports limit
 	if (sUsedPorts >= sMaxPorts)
@@ -840,17 +1020,24 @@ create_port(int32 queueLength, const char* name)
 
 	sUsedPorts++;
 
-	// allocate a port ID
-	do {
+	// allocate a port ID and insert the port into its shard
+	while (true) {
 		port->id = sNextPortID++;
 
 		// handle integer overflow
 		if (sNextPortID < 0)
 			sNextPortID = 1;
-	} while (sPorts.Lookup(port->id) != NULL);
 
-	// insert port in table and team list
-	sPorts.Insert(port);
+		PortHashShard& shard = port_hash_shard(port->id);
+		MutexLocker shardLocker(shard.lock);
+		if (shard.table.Lookup(port->id) == NULL) {
+			shard.table.Insert(port);
+			break;
+		}
+	}
+
+	// insert port in the name table and team list
+	sPortsByName.Insert(port);
 	list_add_item(&team->port_list, &port->team_link);
 	portDeleter.Detach();
 
@@ -910,21 +1097,26 @@ delete_port(port_id id)
 	Port* port;
 	MutexLocker locker;
 	{
-		MutexLocker portsLocker(sPortsLock);
+		WriteLocker portsLocker(sPortsLock);
 
-		port = sPorts.Lookup(id);
+		PortHashShard& shard = port_hash_shard(id);
+		MutexLocker shardLocker(shard.lock);
+
+		port = shard.table.Lookup(id);
 		if (port == NULL) {
 			TRACE(("delete_port: invalid port_id %ld\n", id));
 			return B_BAD_PORT_ID;
 		}
 
-		sPorts.Remove(port);
+		shard.table.Remove(port);
+		locker.SetTo(port->lock, false);
+		shardLocker.Unlock();
+
+		sPortsByName.Remove(port);
 		list_remove_link(&port->team_link);
 
 		sUsedPorts--;
 
-		locker.SetTo(port->lock, false);
-
 		uninit_port_locked(port);
 	}
 
@@ -1022,15 +1214,13 @@ find_port(const char* name)
 	if (name == NULL)
 		return B_BAD_VALUE;
 
-	MutexLocker portsLocker(sPortsLock);
+	ReadLocker portsLocker(sPortsLock);
 
-	for (PortHashTable::Iterator it = sPorts.GetIterator();
-		Port* port = it.Next();) {
-		if (!strcmp(name, port->lock.name))
-			return port->id;
-	}
+	Port* port = lookup_port_by_name(name);
+	if (port == NULL)
+		return B_NAME_NOT_FOUND;
 
-	return B_NAME_NOT_FOUND;
+	return port->id;
 }
 
 
@@ -1077,7 +1267,7 @@ _get_next_port_info(team_id teamID, int32* _cookie, struct port_info* info,
 	BReference<Team> teamReference(team, true);
 
 	// iterate through the team's port list
-	MutexLocker portsLocker(sPortsLock);
+	ReadLocker portsLocker(sPortsLock);
 
 	int32 stopIndex = *_cookie;
 	int32 index = 0;
@@ -1230,12 +1420,29 @@ read_port(port_id port, int32* msgCode, void* buffer, size_t bufferSize)
 ssize_t
 read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 	uint32 flags, bigtime_t timeout)
+{
+	return read_port_area_etc(id, _code, buffer, bufferSize, NULL, flags,
+		timeout);
+}
+
+
+/*!	Like read_port_etc(), but if the message carries an area (cf.
+	write_port_area_etc()), the area is transferred to the calling team and
+	returned in \a _area. Otherwise \a _area is set to -1.
+	If \a _area is \c NULL, an area attached to the message is deleted.
+*/
+ssize_t
+read_port_area_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
+	area_id* _area, uint32 flags, bigtime_t timeout)
 {
 	if (!sPortsActive || id < 0)
 		return B_BAD_PORT_ID;
 	if ((buffer == NULL && bufferSize > 0) || timeout < 0)
 		return B_BAD_VALUE;
 
+	if (_area != NULL)
+		*_area = -1;
+
 	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) != 0;
 	bool peekOnly = !userCopy && (flags & B_PEEK_PORT_MESSAGE) != 0;
 		// TODO: we could allow peeking for user apps now
@@ -1308,22 +1515,77 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 	}
 
 	port->messages.RemoveHead();
-	port->total_count++;
-	port->write_count++;
 	port->read_count--;
 
-	notify_port_select_events(port, B_EVENT_WRITE);
-	port->write_condition.NotifyOne();
-		// make one spot in queue available again for write
+	area_id area = -1;
+	bool portDeleted = false;
+	if (_area != NULL && message->area >= 0) {
+		// Transfer the area without holding the port lock, as that has to go
+		// through the VM. The message is detached from the queue meanwhile,
+		// but its slot is only given up once the transfer succeeded.
+		locker.Unlock();
 
-	T(Read(id, port->read_count, port->write_count, message->code,
-		min_c(bufferSize, message->size)));
+		area = transfer_port_message_area(message->area,
+			team_get_current_team_id(), userCopy
+				? message->area_protection
+				: B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+		if (area >= 0) {
+			atomic_add(&sTotalAreaSpaceInUse, -(int32)message->area_size);
+			message->area = -1;
+		}
 
-	locker.Unlock();
+		// re-lock
+		Port* newPort = get_locked_port(id);
+		if (newPort != NULL)
+			locker.SetTo(newPort->lock, true);
+
+		if (newPort != port) {
+			// the port is no longer there, the message is ours alone now
+			locker.Unlock();
+			portDeleted = true;
+
+			if (area < 0) {
+				T(Read(id, 0, 0, 0, B_BAD_PORT_ID));
+				put_port_message(message);
+				return B_BAD_PORT_ID;
+			}
+		} else if (area < 0) {
+			// put the message back, so that it stays queued with its area
+			port->messages.Add(message, false);
+			port->read_count++;
+
+			T(Read(port, message->code, area));
+			port->read_condition.NotifyOne();
+			return area;
+		}
+	}
+
+	if (!portDeleted) {
+		port->total_count++;
+		port->write_count++;
+
+		notify_port_select_events(port, B_EVENT_WRITE);
+		port->write_condition.NotifyOne();
+			// make one spot in queue available again for write
+
+		T(Read(id, port->read_count, port->write_count, message->code,
+			min_c(bufferSize, message->size)));
 
-	size_t size = copy_port_message(message, _code, buffer, bufferSize,
+		locker.Unlock();
+	}
+
+	ssize_t size = copy_port_message(message, _code, buffer, bufferSize,
 		userCopy);
 
+	if (area >= 0) {
+		if (size >= 0)
+			*_area = area;
+		else {
+			// the message is lost, and so is its area
+			vm_delete_area(team_get_current_team_id(), area, true);
+		}
+	}
+
 	put_port_message(message);
 	return size;
 }
@@ -1348,9 +1610,17 @@ write_port_etc(port_id id, int32 msgCode, const void* buffer,
 }
 
 
-status_t
-writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
-	size_t vecCount, size_t bufferSize, uint32 flags, bigtime_t timeout)
+/*!	Writes a message to the port. If \a area is valid, it must belong to the
+	calling team (cf. write_port_area_etc()). It is transferred to the kernel
+	team and attached to the message only when nothing else can fail anymore,
+	so that the caller still owns it if the call fails. The transfer is done
+	without holding the port lock; if the port is closed or deleted in the
+	meantime, the area is deleted along with the message.
+*/
+static status_t
+writev_port_message(port_id id, int32 msgCode, const iovec* msgVecs,
+	size_t vecCount, size_t bufferSize, area_id area, uint32 areaProtection,
+	size_t areaSize, uint32 flags, bigtime_t timeout)
 {
 	if (!sPortsActive || id < 0)
 		return B_BAD_PORT_ID;
@@ -1461,6 +1731,47 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 		}
 	}
 
+	if (area >= 0) {
+		// Transfer the area without holding the port lock, as that has to go
+		// through the VM; our slot in the queue stays reserved meanwhile.
+		locker.Unlock();
+
+		area_id transferredArea = transfer_port_message_area(area,
+			team_get_kernel_team_id(),
+			B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA);
+
+		// re-lock
+		Port* newPort = get_locked_port(id);
+		if (newPort != NULL)
+			locker.SetTo(newPort->lock, true);
+
+		if (newPort != port || is_port_closed(port)) {
+			// the port is no longer there, and the area is lost with the
+			// message, as if the port had been deleted after the write
+			locker.Unlock();
+			if (transferredArea >= 0) {
+				vm_delete_area(team_get_kernel_team_id(), transferredArea,
+					true);
+			}
+			put_port_message(message);
+
+			T(Write(id, 0, 0, 0, 0, B_BAD_PORT_ID));
+			return B_BAD_PORT_ID;
+		}
+
+		if (transferredArea < 0) {
+			status = transferredArea;
+			put_port_message(message);
+			goto error;
+		}
+
+		area = transferredArea;
+	}
+
+	message->area = area;
+	message->area_protection = areaProtection;
+	message->area_size = areaSize;
+
 	port->messages.Add(message);
 	port->read_count++;
 
@@ -1483,6 +1794,60 @@ error:
 }
 
 
+status_t
+writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
+	size_t vecCount, size_t bufferSize, uint32 flags, bigtime_t timeout)
+{
+	return writev_port_message(id, msgCode, msgVecs, vecCount, bufferSize, -1,
+		0, 0, flags, timeout);
+}
+
+
+/*!	Writes a message to the port and passes the area \a areaID along with it.
+	Instead of copying the area's contents into the port buffer, the area
+	itself is handed over to the kernel and later transferred to the team
+	reading the message with read_port_area_etc(). That way large messages can
+	be passed without copying their contents at all.
+	The area must belong to the calling team. On success, the caller loses
+	access to it; on error, it is left untouched, unless the port went away
+	while the area was being transferred.
+*/
+status_t
+write_port_area_etc(port_id id, int32 msgCode, const void* buffer,
+	size_t bufferSize, area_id areaID, uint32 flags, bigtime_t timeout)
+{
+	if (!sPortsActive || id < 0)
+		return B_BAD_PORT_ID;
+
+	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) != 0;
+
+	area_info info;
+	status_t status = get_area_info(areaID, &info);
+	if (status != B_OK)
+		return status;
+
+	team_id team = team_get_current_team_id();
+	if (info.team != team
+		|| (userCopy && (info.protection & B_KERNEL_AREA) != 0)) {
+		return B_NOT_ALLOWED;
+	}
+
+	int32 areaSpaceInUse = atomic_add(&sTotalAreaSpaceInUse, (int32)info.size);
+	if ((size_t)areaSpaceInUse + info.size > kTotalAreaSpaceLimit) {
+		atomic_add(&sTotalAreaSpaceInUse, -(int32)info.size);
+		return B_NO_MEMORY;
+	}
+
+	iovec vec = { (void*)buffer, bufferSize };
+	status = writev_port_message(id, msgCode, &vec, 1, bufferSize, areaID,
+		info.protection, info.size, flags, timeout);
+	if (status != B_OK)
+		atomic_add(&sTotalAreaSpaceInUse, -(int32)info.size);
+
+	return status;
+}
+
+
 status_t
 set_port_owner(port_id id, team_id newTeamID)
 {
@@ -1498,13 +1863,13 @@ set_port_owner(port_id id, team_id newTeamID)
 	BReference<Team> teamReference(team, true);
 
 	// get the port
-	MutexLocker portsLocker(sPortsLock);
-	Port* port = sPorts.Lookup(id);
+	WriteLocker portsLocker(sPortsLock);
+	Port* port = get_locked_port(id);
 	if (port == NULL) {
 		TRACE(("set_port_owner: invalid port_id %ld\n", id));
 		return B_BAD_PORT_ID;
 	}
-	MutexLocker locker(port->lock);
+	MutexLocker locker(port->lock, true);
 
 	// transfer ownership to other team
 	if (team->id != port->owner) {
@@ -1739,3 +2104,56 @@ _user_get_port_message_info_etc(port_id port, port_message_info *userInfo,
 
 	return syscall_restart_handle_timeout_post(error, timeout);
 }
+
+
+ssize_t
+_user_read_port_area_etc(port_id port, int32 *userCode, void *userBuffer,
+	size_t bufferSize, area_id *userArea, uint32 flags, bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if ((userBuffer == NULL && bufferSize != 0) || userArea == NULL)
+		return B_BAD_VALUE;
+	if ((userCode != NULL && !IS_USER_ADDRESS(userCode))
+		|| (userBuffer != NULL && !IS_USER_ADDRESS(userBuffer))
+		|| !IS_USER_ADDRESS(userArea))
+		return B_BAD_ADDRESS;
+
+	int32 messageCode;
+	area_id area;
+	ssize_t bytesRead = read_port_area_etc(port, &messageCode, userBuffer,
+		bufferSize, &area, flags | PORT_FLAG_USE_USER_MEMCPY | B_CAN_INTERRUPT,
+		timeout);
+
+	if (bytesRead >= 0) {
+		if ((userCode != NULL
+				&& user_memcpy(userCode, &messageCode, sizeof(int32)) < B_OK)
+			|| user_memcpy(userArea, &area, sizeof(area_id)) < B_OK) {
+			if (area >= 0)
+				vm_delete_area(team_get_current_team_id(), area, false);
+			return B_BAD_ADDRESS;
+		}
+	}
+
+	return syscall_restart_handle_timeout_post(bytesRead, timeout);
+}
+
+
+status_t
+_user_write_port_area_etc(port_id port, int32 messageCode,
+	const void *userBuffer, size_t bufferSize, area_id area, uint32 flags,
+	bigtime_t timeout)
+{
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	if (userBuffer == NULL && bufferSize != 0)
+		return B_BAD_VALUE;
+	if (userBuffer != NULL && !IS_USER_ADDRESS(userBuffer))
+		return B_BAD_ADDRESS;
+
+	status_t status = write_port_area_etc(port, messageCode, userBuffer,
+		bufferSize, area, flags | PORT_FLAG_USE_USER_MEMCPY | B_CAN_INTERRUPT,
+		timeout);
+
+	return syscall_restart_handle_timeout_post(status, timeout);
+}
@@ -6,6 +6,9 @@
 
 
 #include <kscheduler.h>
+
+#include <unistd.h>
+
 #include <listeners.h>
 #include <smp.h>
 
@@ -20,6 +23,7 @@ spinlock gSchedulerLock = B_SPINLOCK_INITIALIZER;
 SchedulerListenerList gSchedulerListeners;
 
 static void (*sRescheduleFunction)(void);
+static int32 sSchedulerMode = SCHEDULER_MODE_LOW_LATENCY;
 
 
 static void
@@ -80,6 +84,8 @@ scheduler_init(void)
 		scheduler_simple_init();
 	}
 
+	gScheduler->set_operation_mode(sSchedulerMode);
+
 	// Disable rescheduling until the basic kernel initialization is done and
 	// CPUs are ready to enable interrupts.
 	sRescheduleFunction = gScheduler->reschedule;
@@ -126,3 +132,37 @@ _user_estimate_max_scheduling_latency(thread_id id)
 	InterruptsSpinLocker locker(gSchedulerLock);
 	return gScheduler->estimate_max_scheduling_latency(thread);
 }
+
+
+status_t
+_user_set_scheduler_mode(int32 mode)
+{
+	if (mode != SCHEDULER_MODE_LOW_LATENCY
+		&& mode != SCHEDULER_MODE_THROUGHPUT) {
+		return B_BAD_VALUE;
+	}
+
+	if (geteuid() != 0)
+		return B_NOT_ALLOWED;
+
+	InterruptsSpinLocker locker(gSchedulerLock);
+
+	if (mode == sSchedulerMode)
+		return B_OK;
+
+	gScheduler->set_operation_mode(mode);
+	sSchedulerMode = mode;
+
+	locker.Unlock();
+
+	dprintf("scheduler: switched to %s mode\n",
+		mode == SCHEDULER_MODE_THROUGHPUT ? "throughput" : "low latency");
+	return B_OK;
+}
+
+
+int32
+_user_get_scheduler_mode(void)
+{
+	return sSchedulerMode;
+}
@@ -38,19 +38,27 @@
 #	define TRACE(x) ;
 #endif
 
-// The run queues. Holds the threads ready to run ordered by priority.
-// One queue per schedulable target (CPU, core, etc.).
-// TODO: consolidate this such that HT/SMT entities on the same physical core
-// share a queue, once we have the necessary API for retrieving the topology
-// information
-static Thread* sRunQueue[B_MAX_CPU_COUNT];
-static int32 sRunQueueSize[B_MAX_CPU_COUNT];
-static Thread* sIdleThreads;
-
 const int32 kMaxTrackingQuantums = 5;
-const bigtime_t kMinThreadQuantum = 3000;
+const bigtime_t kLowLatencyMinThreadQuantum = 2000;
+const bigtime_t kThroughputMinThreadQuantum = 3000;
 const bigtime_t kMaxThreadQuantum = 10000;
 
+const int32 kPriorityCount = B_REAL_TIME_PRIORITY + 1;
+const int32 kPriorityBitmapWords = (kPriorityCount + 31) / 32;
+
+// load is measured in threads per CPU, scaled by kLoadScale
+const int32 kLoadScale = 256;
+
+// the interval in which a busy CPU tries to pull work from busier queues, and
+// the time after which a thread that ran is no longer considered cache-hot
+const bigtime_t kBalanceInterval = 20000;
+const bigtime_t kCacheHotTime = 500;
+const int32 kMaxBalanceMigrations = 2;
+const int32 kMaxBalanceScan = 8;
+
+
+struct RunQueue;
+
 
 struct scheduler_thread_data {
 	scheduler_thread_data(void)
@@ -63,7 +71,10 @@ struct scheduler_thread_data {
 	{
 		fQuantumAverage = 0;
 		fLastQuantumSlot = 0;
-		fLastQueue = -1;
+		fRunQueue = NULL;
+		fQueuePriority = 0;
+		fEnqueueTime = 0;
+		fLastRunTime = 0;
 		memset(fLastThreadQuantums, 0, sizeof(fLastThreadQuantums));
 	}
 
@@ -83,48 +94,368 @@ struct scheduler_thread_data {
 		return fQuantumAverage / kMaxTrackingQuantums;
 	}
 
+	inline bool IsCacheHot(bigtime_t now) const
+	{
+		return now - fLastRunTime < kCacheHotTime;
+	}
+
 	int32 fQuantumAverage;
 	int32 fLastThreadQuantums[kMaxTrackingQuantums];
 	int16 fLastQuantumSlot;
-	int32 fLastQueue;
+	int16 fQueuePriority;
+	RunQueue* fRunQueue;
+	bigtime_t fEnqueueTime;
+	bigtime_t fLastRunTime;
 };
 
 
+static inline int32
+highest_bit(uint32 value)
+{
+	int32 bit = 0;
+	if (value >= 1U << 16) {
+		value >>= 16;
+		bit += 16;
+	}
+	if (value >= 1U << 8) {
+		value >>= 8;
+		bit += 8;
+	}
+	if (value >= 1U << 4) {
+		value >>= 4;
+		bit += 4;
+	}
+	if (value >= 1U << 2) {
+		value >>= 2;
+		bit += 2;
+	}
+	if (value >= 1U << 1)
+		bit += 1;
+	return bit;
+}
+
+
+/*!	A run queue keeps one FIFO list of ready threads per priority, and a
+	bitmap of the non-empty lists, so that both enqueuing and finding the
+	next thread to run take constant time.
+	There is one such queue per physical core, shared by its SMT siblings, and
+	one private queue per CPU for the threads pinned to it.
+*/
+struct RunQueue {
+	void Init(int32 packageID, int32 coreID)
+	{
+		memset(this, 0, sizeof(*this));
+		fPackageID = packageID;
+		fCoreID = coreID;
+	}
+
+	inline int32 Count() const
+	{
+		return fCount;
+	}
+
+	/*!	Returns the number of threads (ready and running) per CPU of the
+		queue, scaled by kLoadScale.
+	*/
+	inline int32 Load() const
+	{
+		return (fCount + fActiveCPUCount) * kLoadScale / fCPUCount;
+	}
+
+	/*!	Returns the number of ready threads none of the queue's CPUs is
+		going to pick up soon.
+	*/
+	inline int32 Surplus() const
+	{
+		return fCount - (fCPUCount - fActiveCPUCount);
+	}
+
+	/*!	Returns the highest priority with ready threads below \a below, or -1,
+		if there are none.
+	*/
+	int32 HighestPriority(int32 below = kPriorityCount) const
+	{
+		if (below <= 0)
+			return -1;
+
+		int32 index = (below - 1) / 32;
+		uint32 bits = fBitmap[index] & (0xffffffff >> (31 - (below - 1) % 32));
+		while (bits == 0) {
+			if (--index < 0)
+				return -1;
+			bits = fBitmap[index];
+		}
+
+		return index * 32 + highest_bit(bits);
+	}
+
+	inline Thread* Head(int32 priority) const
+	{
+		return fHeads[priority];
+	}
+
+	inline Thread* Tail(int32 priority) const
+	{
+		return fTails[priority];
+	}
+
+	void Add(Thread* thread, int32 priority)
+	{
+		thread->queue_next = NULL;
+		if (fTails[priority] != NULL)
+			fTails[priority]->queue_next = thread;
+		else {
+			fHeads[priority] = thread;
+			fBitmap[priority / 32] |= 1U << (priority % 32);
+		}
+		fTails[priority] = thread;
+		fCount++;
+
+		thread->scheduler_data->fRunQueue = this;
+		thread->scheduler_data->fQueuePriority = priority;
+	}
+
+	/*!	Removes \a thread, which must follow \a previous (or be the list's
+		head, if \a previous is \c NULL) in the list of its priority.
+	*/
+	void Remove(Thread* thread, Thread* previous)
+	{
+		int32 priority = thread->scheduler_data->fQueuePriority;
+
+		if (previous != NULL)
+			previous->queue_next = thread->queue_next;
+		else
+			fHeads[priority] = thread->queue_next;
+
+		if (fTails[priority] == thread)
+			fTails[priority] = previous;
+		if (fHeads[priority] == NULL)
+			fBitmap[priority / 32] &= ~(1U << (priority % 32));
+
+		thread->queue_next = NULL;
+		thread->scheduler_data->fRunQueue = NULL;
+		fCount--;
+	}
+
+	void Remove(Thread* thread)
+	{
+		Thread* previous = NULL;
+		Thread* item = fHeads[thread->scheduler_data->fQueuePriority];
+		while (item != thread) {
+			previous = item;
+			item = item->queue_next;
+		}
+
+		ASSERT(item == thread);
+		Remove(thread, previous);
+	}
+
+	inline Thread* RemoveHead(int32 priority)
+	{
+		Thread* thread = fHeads[priority];
+		Remove(thread, NULL);
+		return thread;
+	}
+
+	void AddLatency(bigtime_t latency)
+	{
+		fLatencies++;
+		fTotalLatency += latency;
+		if (latency > fMaxLatency)
+			fMaxLatency = latency;
+	}
+
+	void Dump() const;
+
+	Thread*		fHeads[kPriorityCount];
+	Thread*		fTails[kPriorityCount];
+	uint32		fBitmap[kPriorityBitmapWords];
+	int32		fCount;
+
+	int32		fPackageID;
+	int32		fCoreID;
+	int32		fCPUCount;
+	int32		fActiveCPUCount;
+	bigtime_t	fLastBalance;
+
+	// statistics
+	int64		fMigrations;
+	int64		fSteals;
+	int64		fBalanceRuns;
+	int64		fLatencies;
+	bigtime_t	fTotalLatency;
+	bigtime_t	fMaxLatency;
+};
+
+
+// The shared run queues, one per physical core, and the mapping of CPUs to
+// them. A CPU is assigned its queue when it starts scheduling, since that's
+// when its topology information becomes available.
+static RunQueue sRunQueues[B_MAX_CPU_COUNT];
+static int32 sRunQueueCount;
+static RunQueue* sCPURunQueue[B_MAX_CPU_COUNT];
+
+// threads pinned to a CPU are kept out of the shared queues
+static RunQueue sPinnedRunQueue[B_MAX_CPU_COUNT];
+
+static Thread* sIdleThreads;
+
+static int32 sMode = SCHEDULER_MODE_LOW_LATENCY;
+static bigtime_t sMinThreadQuantum = kLowLatencyMinThreadQuantum;
+
+
+void
+RunQueue::Dump() const
+{
+	if (fCount == 0)
+		return;
+
+	kprintf("thread      id      priority  avg. quantum  name\n");
+	for (int32 priority = HighestPriority(); priority >= 0;
+			priority = HighestPriority(priority)) {
+		for (Thread* thread = fHeads[priority]; thread != NULL;
+				thread = thread->queue_next) {
+			kprintf("%p  %-7" B_PRId32 " %-8" B_PRId32 "  %-12" B_PRId32
+				"  %s\n", thread, thread->id, thread->priority,
+				thread->scheduler_data->GetAverageQuantumUsage(),
+				thread->name);
+		}
+	}
+}
+
+
 static int
 dump_run_queue(int argc, char **argv)
 {
-	Thread *thread = NULL;
+	for (int32 i = 0; i < sRunQueueCount; i++) {
+		RunQueue& queue = sRunQueues[i];
+
+		kprintf("Run queue %" B_PRId32 " (package %" B_PRId32 ", core %"
+			B_PRId32 ", cpus:", i, queue.fPackageID, queue.fCoreID);
+		for (int32 cpu = 0; cpu < smp_get_num_cpus(); cpu++) {
+			if (sCPURunQueue[cpu] == &queue)
+				kprintf(" %" B_PRId32, cpu);
+		}
+		kprintf(") %" B_PRId32 " threads, load %" B_PRId32 "/%" B_PRId32 "\n",
+			queue.fCount, queue.Load(), kLoadScale);
+		kprintf("  migrations in: %" B_PRId64 " (%" B_PRId64 " stolen, %"
+			B_PRId64 " balance runs)\n", queue.fMigrations, queue.fSteals,
+			queue.fBalanceRuns);
+		kprintf("  latency: avg %" B_PRId64 " us, max %" B_PRId64 " us (%"
+			B_PRId64 " samples)\n", queue.fLatencies > 0
+				? queue.fTotalLatency / queue.fLatencies : 0,
+			queue.fMaxLatency, queue.fLatencies);
+		queue.Dump();
+	}
 
 	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
-		thread = sRunQueue[i];
-		kprintf("Run queue for cpu %" B_PRId32 " (%" B_PRId32 " threads)\n", i,
-			sRunQueueSize[i]);
-		if (sRunQueueSize[i] > 0) {
-			kprintf("thread      id      priority  avg. quantum  name\n");
-			while (thread) {
-				kprintf("%p  %-7" B_PRId32 " %-8" B_PRId32 "  %-12" B_PRId32
-					"  %s\n", thread, thread->id, thread->priority,
-					thread->scheduler_data->GetAverageQuantumUsage(),
-					thread->name);
-				thread = thread->queue_next;
-			}
-		}
+		if (sPinnedRunQueue[i].Count() == 0)
+			continue;
+
+		kprintf("Pinned threads of cpu %" B_PRId32 " (%" B_PRId32
+			" threads)\n", i, sPinnedRunQueue[i].Count());
+		sPinnedRunQueue[i].Dump();
 	}
 	return 0;
 }
 
 
-/*!	Returns the most idle CPU based on the active time counters.
+/*!	Assigns the given CPU the run queue of its physical core, creating the
+	queue, if it is the first CPU of that core.
+	Note: thread lock must be held when entering this function
+*/
+static void
+affine_attach_cpu(int32 cpu)
+{
+	cpu_ent* entry = &gCPU[cpu];
+
+	RunQueue* queue = NULL;
+	for (int32 i = 0; i < sRunQueueCount; i++) {
+		if (sRunQueues[i].fPackageID == entry->package_id
+			&& sRunQueues[i].fCoreID == entry->core_id) {
+			queue = &sRunQueues[i];
+			break;
+		}
+	}
+
+	if (queue == NULL) {
+		queue = &sRunQueues[sRunQueueCount++];
+		queue->Init(entry->package_id, entry->core_id);
+	}
+
+	queue->fCPUCount++;
+	sCPURunQueue[cpu] = queue;
+}
+
+
+/*!	Returns the least loaded run queue that has an enabled CPU, preferring
+	the queues in the given package, if \a packageID is not negative.
+	Note: thread lock must be held when entering this function
+*/
+static RunQueue*
+affine_get_most_idle_queue(int32 packageID)
+{
+	RunQueue* target = NULL;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		RunQueue* queue = sCPURunQueue[i];
+		if (queue == NULL || gCPU[i].disabled)
+			continue;
+		if (packageID >= 0 && queue->fPackageID != packageID)
+			continue;
+		if (target == NULL || queue->Load() < target->Load())
+			target = queue;
+	}
+
+	if (target == NULL && packageID >= 0)
+		return affine_get_most_idle_queue(-1);
+	return target;
+}
+
+
+/*!	Returns the most loaded run queue that still has a CPU that isn't going to
+	be busy, so that threads get packed onto as few cores as possible. Falls
+	back to the least loaded queue, if all are busy.
+	Note: thread lock must be held when entering this function
+*/
+static RunQueue*
+affine_get_packing_queue()
+{
+	RunQueue* target = NULL;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		RunQueue* queue = sCPURunQueue[i];
+		if (queue == NULL || gCPU[i].disabled || queue->Surplus() >= 0)
+			continue;
+		if (target == NULL || queue->Load() > target->Load())
+			target = queue;
+	}
+
+	if (target == NULL)
+		return affine_get_most_idle_queue(-1);
+	return target;
+}
+
+
+/*!	Returns the CPU serving \a queue that should be preempted to run
+	\a thread, that is, the one running the thread with the lowest priority.
 	Note: thread lock must be held when entering this function
 */
 static int32
-affine_get_most_idle_cpu()
+affine_get_cpu_to_preempt(RunQueue* queue, Thread* thread)
 {
 	int32 targetCPU = -1;
 	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
-		if (gCPU[i].disabled)
+		if (sCPURunQueue[i] != queue || gCPU[i].disabled)
+			continue;
+
+		if (targetCPU < 0) {
+			targetCPU = i;
 			continue;
-		if (targetCPU < 0 || sRunQueueSize[i] < sRunQueueSize[targetCPU])
+		}
+
+		int32 priority = gCPU[i].running_thread->priority;
+		int32 targetPriority = gCPU[targetCPU].running_thread->priority;
+		if (priority < targetPriority
+			|| (priority == targetPriority && &gCPU[i] == thread->previous_cpu))
 			targetCPU = i;
 	}
 
@@ -138,39 +469,44 @@ affine_get_most_idle_cpu()
 static void
 affine_enqueue_in_run_queue(Thread *thread)
 {
-	int32 targetCPU = -1;
-	if (thread->pinned_to_cpu > 0)
-		targetCPU = thread->previous_cpu->cpu_num;
-	else if (thread->previous_cpu == NULL || thread->previous_cpu->disabled)
-		targetCPU = affine_get_most_idle_cpu();
-	else
-		targetCPU = thread->previous_cpu->cpu_num;
-
 	thread->state = thread->next_state = B_THREAD_READY;
 
+	int32 targetCPU = -1;
+	RunQueue* queue = NULL;
+
 	if (thread->priority == B_IDLE_PRIORITY) {
 		thread->queue_next = sIdleThreads;
 		sIdleThreads = thread;
 	} else {
-		Thread *curr, *prev;
-		for (curr = sRunQueue[targetCPU], prev = NULL; curr
-			&& curr->priority >= thread->next_priority;
-			curr = curr->queue_next) {
-			if (prev)
-				prev = prev->queue_next;
-			else
-				prev = sRunQueue[targetCPU];
+		if (thread->pinned_to_cpu > 0) {
+			targetCPU = thread->previous_cpu->cpu_num;
+			queue = &sPinnedRunQueue[targetCPU];
+		} else if (thread->previous_cpu == NULL
+			|| thread->previous_cpu->disabled) {
+			queue = sMode == SCHEDULER_MODE_THROUGHPUT
+				? affine_get_packing_queue() : affine_get_most_idle_queue(-1);
+		} else {
+			// Stay on the previous core, where the thread's data is likely
+			// still cached. If none of the core's CPUs is going to be free,
+			// move to an idle core of the same package instead, since it at
+			// least shares the last level cache -- unless we're optimizing
+			// for throughput, where the thread rather waits for its cache.
+			queue = sCPURunQueue[thread->previous_cpu->cpu_num];
+			if (sMode == SCHEDULER_MODE_LOW_LATENCY
+				&& queue->Surplus() >= 0) {
+				RunQueue* idleQueue
+					= affine_get_most_idle_queue(queue->fPackageID);
+				if (idleQueue != NULL && idleQueue != queue
+					&& idleQueue->Surplus() < 0) {
+					queue = idleQueue;
+					queue->fMigrations++;
+				}
+			}
 		}
 
-		T(EnqueueThread(thread, prev, curr));
-		sRunQueueSize[targetCPU]++;
-		thread->queue_next = curr;
-		if (prev)
-			prev->queue_next = thread;
-		else
-			sRunQueue[targetCPU] = thread;
-
-		thread->scheduler_data->fLastQueue = targetCPU;
+		T(EnqueueThread(thread, queue->Tail(thread->next_priority), NULL));
+		queue->Add(thread, thread->next_priority);
+		thread->scheduler_data->fEnqueueTime = system_time();
 	}
 
 	thread->next_priority = thread->priority;
@@ -179,7 +515,14 @@ affine_enqueue_in_run_queue(Thread *thread)
 	NotifySchedulerListeners(&SchedulerListener::ThreadEnqueuedInRunQueue,
 		thread);
 
-	if (thread->priority > gCPU[targetCPU].running_thread->priority) {
+	if (queue == NULL)
+		return;
+
+	if (targetCPU < 0)
+		targetCPU = affine_get_cpu_to_preempt(queue, thread);
+
+	if (targetCPU >= 0
+		&& thread->priority > gCPU[targetCPU].running_thread->priority) {
 		if (targetCPU == smp_get_current_cpu()) {
 			gCPU[targetCPU].invoke_scheduler = true;
 			gCPU[targetCPU].invoke_scheduler_if_idle = false;
@@ -191,73 +534,133 @@ affine_enqueue_in_run_queue(Thread *thread)
 }
 
 
-/*!	Dequeues the thread after the given \a prevThread from the run queue.
-*/
-static inline Thread *
-dequeue_from_run_queue(Thread *prevThread, int32 currentCPU)
+static bool
+affine_has_enabled_cpu(RunQueue* queue)
 {
-	Thread *resultThread = NULL;
-	if (prevThread != NULL) {
-		resultThread = prevThread->queue_next;
-		prevThread->queue_next = resultThread->queue_next;
-	} else {
-		resultThread = sRunQueue[currentCPU];
-		sRunQueue[currentCPU] = resultThread->queue_next;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		if (sCPURunQueue[i] == queue && !gCPU[i].disabled)
+			return true;
 	}
-	sRunQueueSize[currentCPU]--;
-	resultThread->scheduler_data->fLastQueue = -1;
 
-	return resultThread;
+	return false;
 }
 
 
-/*!	Looks for a possible thread to grab/run from another CPU.
+/*!	Returns the run queue with the most threads none of its CPUs is going to
+	pick up, or \c NULL, if there is none. Queues of the given package are
+	preferred, if \a packageID is not negative.
 	Note: thread lock must be held when entering this function
 */
-static Thread *
-steal_thread_from_other_cpus(int32 currentCPU)
+static RunQueue*
+affine_get_busiest_queue(RunQueue* currentQueue, int32 packageID)
 {
-	// look through the active CPUs - find the one
-	// that has a) threads available to steal, and
-	// b) out of those, the one that's the most CPU-bound
-	// TODO: make this more intelligent along with enqueue
-	// - we need to try and maintain a reasonable balance
-	// in run queue sizes across CPUs, and also try to maintain
-	// an even distribution of cpu bound / interactive threads
-	int32 targetCPU = -1;
-	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
-		// skip CPUs that have either no or only one thread
-		if (i == currentCPU || sRunQueueSize[i] < 2)
+	RunQueue* target = NULL;
+	for (int32 i = 0; i < sRunQueueCount; i++) {
+		RunQueue* queue = &sRunQueues[i];
+		if (queue == currentQueue || queue->Count() == 0)
+			continue;
+		if (queue->Surplus() <= 0 && affine_has_enabled_cpu(queue))
+			continue;
+		if (packageID >= 0 && queue->fPackageID != packageID)
 			continue;
 
-		// out of the CPUs with threads available to steal,
+		// out of the queues with threads available to steal,
 		// pick whichever one is generally the most CPU bound.
-		if (targetCPU < 0
-			|| sRunQueue[i]->priority > sRunQueue[targetCPU]->priority
-			|| (sRunQueue[i]->priority == sRunQueue[targetCPU]->priority
-				&& sRunQueueSize[i] > sRunQueueSize[targetCPU]))
-			targetCPU = i;
+		if (target == NULL
+			|| queue->HighestPriority() > target->HighestPriority()
+			|| (queue->HighestPriority() == target->HighestPriority()
+				&& queue->Surplus() > target->Surplus()))
+			target = queue;
 	}
 
-	if (targetCPU < 0)
+	if (target == NULL && packageID >= 0)
+		return affine_get_busiest_queue(currentQueue, -1);
+	return target;
+}
+
+
+/*!	Looks for a possible thread to grab/run from another CPU's run queue,
+	preferring the ones sharing the last level cache with the current CPU.
+	Note: thread lock must be held when entering this function
+*/
+static Thread *
+steal_thread_from_other_cpus(RunQueue* currentQueue)
+{
+	RunQueue* queue = affine_get_busiest_queue(currentQueue,
+		currentQueue->fPackageID);
+	if (queue == NULL)
 		return NULL;
 
-	Thread* nextThread = sRunQueue[targetCPU];
-	Thread* prevThread = NULL;
+	currentQueue->fSteals++;
+	currentQueue->fMigrations++;
 
-	while (nextThread != NULL) {
-		// grab the highest priority non-pinned thread
-		// out of this CPU's queue, dequeue and return it
-		if (nextThread->pinned_to_cpu <= 0) {
-			dequeue_from_run_queue(prevThread, targetCPU);
-			return nextThread;
-		}
+	return queue->RemoveHead(queue->HighestPriority());
+}
+
+
+/*!	Pulls threads from a busier queue into \a currentQueue, if the load
+	difference is more than one thread per CPU (or two, for queues in another
+	package). Threads that ran recently are left alone, as migrating them
+	would throw away their cache footprint.
+	Note: thread lock must be held when entering this function
+*/
+static void
+affine_balance(RunQueue* currentQueue, bigtime_t now)
+{
+	currentQueue->fLastBalance = now;
+	currentQueue->fBalanceRuns++;
+
+	RunQueue* source = NULL;
+	int32 threshold = kLoadScale;
+	for (int32 i = 0; i < sRunQueueCount; i++) {
+		RunQueue* queue = &sRunQueues[i];
+		if (queue == currentQueue || queue->Count() == 0)
+			continue;
 
-		prevThread = nextThread;
-		nextThread = nextThread->queue_next;
+		int32 queueThreshold
+			= queue->fPackageID == currentQueue->fPackageID
+				? kLoadScale : 2 * kLoadScale;
+		if (queue->Load() - currentQueue->Load() <= queueThreshold)
+			continue;
+
+		if (source == NULL || queue->Load() - queueThreshold
+				> source->Load() - threshold) {
+			source = queue;
+			threshold = queueThreshold;
+		}
 	}
 
-	return NULL;
+	if (source == NULL)
+		return;
+
+	int32 migrated = 0;
+	int32 scanned = 0;
+	for (int32 priority = source->HighestPriority(); priority >= 0
+			&& scanned < kMaxBalanceScan
+			&& migrated < kMaxBalanceMigrations;
+			priority = source->HighestPriority(priority)) {
+		Thread* previous = NULL;
+		Thread* thread = source->Head(priority);
+		while (thread != NULL && scanned < kMaxBalanceScan
+			&& migrated < kMaxBalanceMigrations
+			&& source->Load() - currentQueue->Load() > threshold) {
+			scanned++;
+			Thread* next = thread->queue_next;
+
+			if (thread->scheduler_data->IsCacheHot(now)) {
+				previous = thread;
+				thread = next;
+				continue;
+			}
+
+			source->Remove(thread, previous);
+			currentQueue->Add(thread, priority);
+			currentQueue->fMigrations++;
+			migrated++;
+
+			thread = next;
+		}
+	}
 }
 
 
@@ -267,8 +670,6 @@ steal_thread_from_other_cpus(int32 currentCPU)
 static void
 affine_set_thread_priority(Thread *thread, int32 priority)
 {
-	int32 targetCPU = -1;
-
 	if (priority == thread->priority)
 		return;
 
@@ -286,22 +687,8 @@ affine_set_thread_priority(Thread *thread, int32 priority)
 	NotifySchedulerListeners(&SchedulerListener::ThreadRemovedFromRunQueue,
 		thread);
 
-	// search run queues for the thread
-	Thread *item = NULL, *prev = NULL;
-	targetCPU = thread->scheduler_data->fLastQueue;
-
-	for (item = sRunQueue[targetCPU], prev = NULL; item && item != thread;
-			item = item->queue_next) {
-		if (prev)
-			prev = prev->queue_next;
-		else
-			prev = item;
-	}
-
-	ASSERT(item == thread);
-
 	// remove the thread
-	thread = dequeue_from_run_queue(prev, targetCPU);
+	thread->scheduler_data->fRunQueue->Remove(thread);
 
 	// set priority and re-insert
 	thread->priority = thread->next_priority = priority;
@@ -317,13 +704,13 @@ affine_estimate_max_scheduling_latency(Thread* thread)
 	// per thread priority, though.
 
 	if (thread->priority >= B_REAL_TIME_DISPLAY_PRIORITY)
-		return kMinThreadQuantum / 4;
+		return sMinThreadQuantum / 4;
 	if (thread->priority >= B_DISPLAY_PRIORITY)
-		return kMinThreadQuantum;
+		return sMinThreadQuantum;
 	if (thread->priority < B_NORMAL_PRIORITY)
 		return 2 * kMaxThreadQuantum;
 
-	return 2 * kMinThreadQuantum;
+	return 2 * sMinThreadQuantum;
 }
 
 
@@ -359,10 +746,18 @@ affine_reschedule(void)
 		}
 	}
 
-	Thread *nextThread, *prevThread;
+	Thread *nextThread = NULL;
+	RunQueue* queue = sCPURunQueue[currentCPU];
+	RunQueue* pinnedQueue = &sPinnedRunQueue[currentCPU];
+	bigtime_t now = system_time();
 
 	TRACE(("reschedule(): cpu %ld, cur_thread = %ld\n", currentCPU, oldThread->id));
 
+	if (!thread_is_idle_thread(oldThread)) {
+		oldThread->scheduler_data->fLastRunTime = now;
+		queue->fActiveCPUCount--;
+	}
+
 	oldThread->state = oldThread->next_state;
 	switch (oldThread->next_state) {
 		case B_THREAD_RUNNING:
@@ -380,31 +775,28 @@ affine_reschedule(void)
 			break;
 	}
 
-	nextThread = sRunQueue[currentCPU];
-	prevThread = NULL;
+	bool enabled = !gCPU[currentCPU].disabled;
+	if (enabled && now - queue->fLastBalance >= kBalanceInterval)
+		affine_balance(queue, now);
 
-	if (sRunQueue[currentCPU] != NULL) {
+	int32 priority = enabled ? queue->HighestPriority() : -1;
+	int32 pinnedPriority = pinnedQueue->HighestPriority();
+
+	if (pinnedPriority >= 0 && pinnedPriority >= priority) {
+		TRACE(("dequeueing pinned thread from cpu %ld\n", currentCPU));
+		nextThread = pinnedQueue->RemoveHead(pinnedPriority);
+		pinnedQueue->AddLatency(now - nextThread->scheduler_data->fEnqueueTime);
+	} else if (priority >= 0) {
 		TRACE(("dequeueing next thread from cpu %ld\n", currentCPU));
 		// select next thread from the run queue
-		while (nextThread->queue_next) {
-			// always extract real time threads
-			if (nextThread->priority >= B_FIRST_REAL_TIME_PRIORITY)
-				break;
-
+		// always extract real time threads
+		while (priority < B_FIRST_REAL_TIME_PRIORITY) {
 			// find next thread with lower priority
-			Thread *lowerNextThread = nextThread->queue_next;
-			Thread *lowerPrevThread = nextThread;
-			int32 priority = nextThread->priority;
-
-			while (lowerNextThread != NULL
-				&& priority == lowerNextThread->priority) {
-				lowerPrevThread = lowerNextThread;
-				lowerNextThread = lowerNextThread->queue_next;
-			}
-			if (lowerNextThread == NULL)
+			int32 lowerPriority = queue->HighestPriority(priority);
+			if (lowerPriority < 0)
 				break;
 
-			int32 priorityDiff = priority - lowerNextThread->priority;
+			int32 priorityDiff = priority - lowerPriority;
 			if (priorityDiff > 15)
 				break;
 
@@ -413,20 +805,24 @@ affine_reschedule(void)
 			if ((fast_random_value() >> (15 - priorityDiff)) != 0)
 				break;
 
-			nextThread = lowerNextThread;
-			prevThread = lowerPrevThread;
+			priority = lowerPriority;
 		}
 
-		TRACE(("dequeuing thread %ld from cpu %ld\n", nextThread->id,
-			currentCPU));
 		// extract selected thread from the run queue
-		dequeue_from_run_queue(prevThread, currentCPU);
+		nextThread = queue->RemoveHead(priority);
+		queue->AddLatency(now - nextThread->scheduler_data->fEnqueueTime);
+
+		TRACE(("dequeued thread %ld from cpu %ld\n", nextThread->id,
+			currentCPU));
 	} else {
-		if (!gCPU[currentCPU].disabled) {
+		if (enabled) {
 			TRACE(("CPU %ld stealing thread from other CPUs\n", currentCPU));
-			nextThread = steal_thread_from_other_cpus(currentCPU);
-		} else
-			nextThread = NULL;
+			nextThread = steal_thread_from_other_cpus(queue);
+			if (nextThread != NULL) {
+				queue->AddLatency(
+					now - nextThread->scheduler_data->fEnqueueTime);
+			}
+		}
 
 		if (nextThread == NULL) {
 			TRACE(("No threads to steal, grabbing from idle pool\n"));
@@ -438,6 +834,9 @@ affine_reschedule(void)
 		}
 	}
 
+	if (nextThread != NULL && !thread_is_idle_thread(nextThread))
+		queue->fActiveCPUCount++;
+
 	if (!nextThread)
 		panic("reschedule(): run queue is empty!\n");
 
@@ -479,13 +878,16 @@ affine_reschedule(void)
 		// preempted most of the time and would likely get the longer quantum
 		// over time, indeed we use a smaller quantum to avoid running idle too
 		// long
-		bigtime_t quantum = kMinThreadQuantum;
+		bigtime_t quantum = sMinThreadQuantum;
 		// give CPU-bound background threads a larger quantum size
-		// to minimize unnecessary context switches if the system is idle
+		// to minimize unnecessary context switches if the system is idle;
+		// in throughput mode all CPU-bound non-display threads get it
+		int32 longQuantumPriority = sMode == SCHEDULER_MODE_THROUGHPUT
+			? B_DISPLAY_PRIORITY : B_NORMAL_PRIORITY;
 		if (nextThread->priority != B_IDLE_PRIORITY
 			&& nextThread->scheduler_data->GetAverageQuantumUsage()
-			> (kMinThreadQuantum >> 1)
-			&& nextThread->priority < B_NORMAL_PRIORITY)
+			> (sMinThreadQuantum >> 1)
+			&& nextThread->priority < longQuantumPriority)
 			quantum = kMaxThreadQuantum;
 
 		if (!thread_is_idle_thread(nextThread)) {
@@ -537,10 +939,23 @@ affine_start(void)
 {
 	SpinLocker schedulerLocker(gSchedulerLock);
 
+	int32 cpu = smp_get_current_cpu();
+	if (sCPURunQueue[cpu] == NULL)
+		affine_attach_cpu(cpu);
+
 	affine_reschedule();
 }
 
 
+static void
+affine_set_operation_mode(int32 mode)
+{
+	sMode = mode;
+	sMinThreadQuantum = mode == SCHEDULER_MODE_THROUGHPUT
+		? kThroughputMinThreadQuantum : kLowLatencyMinThreadQuantum;
+}
+
+
 static scheduler_ops kAffineOps = {
 	affine_enqueue_in_run_queue,
 	affine_reschedule,
@@ -549,7 +964,8 @@ static scheduler_ops kAffineOps = {
 	affine_on_thread_create,
 	affine_on_thread_init,
 	affine_on_thread_destroy,
-	affine_start
+	affine_start,
+	affine_set_operation_mode
 };
 
 
@@ -560,8 +976,15 @@ void
 scheduler_affine_init()
 {
 	gScheduler = &kAffineOps;
-	memset(sRunQueue, 0, sizeof(sRunQueue));
-	memset(sRunQueueSize, 0, sizeof(sRunQueueSize));
+	memset(sCPURunQueue, 0, sizeof(sCPURunQueue));
+	sRunQueueCount = 0;
+	for (int32 i = 0; i < B_MAX_CPU_COUNT; i++)
+		sPinnedRunQueue[i].Init(-1, -1);
+
+	// The boot CPU knows its topology already, and threads are enqueued
+	// before it starts scheduling. The other CPUs attach in affine_start().
+	affine_attach_cpu(smp_get_current_cpu());
+
 	add_debugger_command_etc("run_queue", &dump_run_queue,
 		"List threads in run queue", "\nLists threads in run queue", 0);
 }
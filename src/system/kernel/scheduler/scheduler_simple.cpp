@@ -37,7 +37,11 @@
 #endif
 
 
-const bigtime_t kThreadQuantum = 3000;
+const bigtime_t kLowLatencyThreadQuantum = 2000;
+	// shorter than the 3 ms this scheduler used before it had modes
+const bigtime_t kThroughputThreadQuantum = 10000;
+
+static bigtime_t sThreadQuantum = kLowLatencyThreadQuantum;
 
 
 // The run queue. Holds the threads ready to run ordered by priority.
@@ -159,11 +163,11 @@ simple_estimate_max_scheduling_latency(Thread* thread)
 	// per thread priority, though.
 
 	if (thread->priority >= B_REAL_TIME_DISPLAY_PRIORITY)
-		return kThreadQuantum / 4;
+		return sThreadQuantum / 4;
 	if (thread->priority >= B_DISPLAY_PRIORITY)
-		return kThreadQuantum;
+		return sThreadQuantum;
 
-	return 2 * kThreadQuantum;
+	return 2 * sThreadQuantum;
 }
 
 
@@ -305,7 +309,7 @@ simple_reschedule(void)
 	}
 
 	if (nextThread != oldThread || oldThread->cpu->preempted) {
-		bigtime_t quantum = kThreadQuantum;	// TODO: calculate quantum?
+		bigtime_t quantum = sThreadQuantum;	// TODO: calculate quantum?
 		timer* quantumTimer = &oldThread->cpu->quantum_timer;
 
 		if (!oldThread->cpu->preempted)
@@ -357,6 +361,15 @@ simple_start(void)
 }
 
 
+static void
+simple_set_operation_mode(int32 mode)
+{
+	// with a single CPU the modes only differ in the quantum length
+	sThreadQuantum = mode == SCHEDULER_MODE_THROUGHPUT
+		? kThroughputThreadQuantum : kLowLatencyThreadQuantum;
+}
+
+
 static scheduler_ops kSimpleOps = {
 	simple_enqueue_in_run_queue,
 	simple_reschedule,
@@ -365,7 +378,8 @@ static scheduler_ops kSimpleOps = {
 	simple_on_thread_create,
 	simple_on_thread_init,
 	simple_on_thread_destroy,
-	simple_start
+	simple_start,
+	simple_set_operation_mode
 };
 
 
@@ -38,13 +38,17 @@
 #endif
 
 
-const bigtime_t kThreadQuantum = 3000;
+const bigtime_t kLowLatencyThreadQuantum = 2000;
+	// shorter than the 3 ms this scheduler used before it had modes
+const bigtime_t kThroughputThreadQuantum = 10000;
 
 
 // The run queue. Holds the threads ready to run ordered by priority.
 static Thread *sRunQueue = NULL;
 static int32 sCPUCount = 1;
 static int32 sNextCPUForSelection = 0;
+static int32 sMode = SCHEDULER_MODE_LOW_LATENCY;
+static bigtime_t sThreadQuantum = kLowLatencyThreadQuantum;
 
 
 static int
@@ -68,6 +72,51 @@ dump_run_queue(int argc, char **argv)
 }
 
 
+static inline bool
+is_cpu_idle(int32 cpu)
+{
+	return gCPU[cpu].running_thread == NULL
+		|| gCPU[cpu].running_thread->priority == B_IDLE_PRIORITY;
+}
+
+
+/*!	Chooses the idle CPU that keeps the running threads packed onto as few
+	cores and packages as possible: an idle SMT sibling of a busy core is
+	preferred over an idle CPU in a busy package, which in turn is preferred
+	over any other idle CPU. Ties go to the lowest numbered CPU, so that the
+	higher numbered ones stay idle.
+	Returns -1 if there is no idle CPU.
+*/
+static int32
+select_packed_idle_cpu()
+{
+	int32 bestCPU = -1;
+	int32 bestScore = -1;
+
+	for (int32 cpu = 0; cpu < sCPUCount; cpu++) {
+		if (gCPU[cpu].disabled || !is_cpu_idle(cpu))
+			continue;
+
+		int32 score = 0;
+		for (int32 other = 0; other < sCPUCount && score < 2; other++) {
+			if (other == cpu || gCPU[other].disabled || is_cpu_idle(other)
+				|| gCPU[other].package_id != gCPU[cpu].package_id) {
+				continue;
+			}
+
+			score = gCPU[other].core_id == gCPU[cpu].core_id ? 2 : 1;
+		}
+
+		if (score > bestScore) {
+			bestCPU = cpu;
+			bestScore = score;
+		}
+	}
+
+	return bestCPU;
+}
+
+
 static int32
 select_cpu(int32 currentCPU, Thread* thread, int32& targetPriority)
 {
@@ -78,6 +127,27 @@ select_cpu(int32 currentCPU, Thread* thread, int32& targetPriority)
 		return targetCPU;
 	}
 
+	if (sMode == SCHEDULER_MODE_THROUGHPUT && thread->previous_cpu != NULL
+		&& !thread->previous_cpu->disabled) {
+		// Keep the thread on the CPU it ran on last, where its data is likely
+		// still cached, as long as it gets to preempt the thread running
+		// there.
+		int32 targetCPU = thread->previous_cpu->cpu_num;
+		targetPriority = gCPU[targetCPU].running_thread->priority;
+		if (targetPriority < thread->priority)
+			return targetCPU;
+	}
+
+	if (sMode == SCHEDULER_MODE_THROUGHPUT) {
+		// Wake up an idle CPU next to the ones that are already busy, rather
+		// than spreading the threads over all cores.
+		int32 targetCPU = select_packed_idle_cpu();
+		if (targetCPU >= 0) {
+			targetPriority = B_IDLE_PRIORITY;
+			return targetCPU;
+		}
+	}
+
 	// Choose the CPU running the lowest priority thread. Favor the current CPU
 	// as it doesn't require ICI to be notified.
 	int32 targetCPU = currentCPU;
@@ -224,11 +294,11 @@ estimate_max_scheduling_latency(Thread* thread)
 	// per thread priority, though.
 
 	if (thread->priority >= B_REAL_TIME_DISPLAY_PRIORITY)
-		return kThreadQuantum / 4;
+		return sThreadQuantum / 4;
 	if (thread->priority >= B_DISPLAY_PRIORITY)
-		return kThreadQuantum;
+		return sThreadQuantum;
 
-	return 2 * kThreadQuantum;
+	return 2 * sThreadQuantum;
 }
 
 
@@ -404,7 +474,7 @@ reschedule(void)
 	}
 
 	if (nextThread != oldThread || oldThread->cpu->preempted) {
-		bigtime_t quantum = kThreadQuantum;	// TODO: calculate quantum?
+		bigtime_t quantum = sThreadQuantum;	// TODO: calculate quantum?
 		timer* quantumTimer = &oldThread->cpu->quantum_timer;
 
 		if (!oldThread->cpu->preempted)
@@ -456,6 +526,15 @@ start(void)
 }
 
 
+static void
+set_operation_mode(int32 mode)
+{
+	sMode = mode;
+	sThreadQuantum = mode == SCHEDULER_MODE_THROUGHPUT
+		? kThroughputThreadQuantum : kLowLatencyThreadQuantum;
+}
+
+
 static scheduler_ops kSimpleSMPOps = {
 	enqueue_in_run_queue,
 	reschedule,
@@ -464,7 +543,8 @@ static scheduler_ops kSimpleSMPOps = {
 	on_thread_create,
 	on_thread_init,
 	on_thread_destroy,
-	start
+	start,
+	set_operation_mode
 };
 
 
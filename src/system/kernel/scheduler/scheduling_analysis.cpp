@@ -67,6 +67,7 @@ struct ThreadKey : HashObjectKey {
 struct Thread : HashObject, scheduling_analysis_thread {
 	ScheduleState state;
 	bigtime_t lastTime;
+	int32 lastCPU;
 
 	ThreadWaitObject* waitObject;
 
@@ -74,6 +75,7 @@ struct Thread : HashObject, scheduling_analysis_thread {
 		:
 		state(UNKNOWN),
 		lastTime(0),
+		lastCPU(-1),
 
 		waitObject(NULL)
 	{
@@ -98,6 +100,7 @@ struct Thread : HashObject, scheduling_analysis_thread {
 		unspecified_wait_time = 0;
 
 		preemptions = 0;
+		migrations = 0;
 
 		wait_objects = NULL;
 	}
@@ -670,6 +673,11 @@ analyze_scheduling(bigtime_t from, bigtime_t until,
 				thread->state = RUNNING;
 			}
 
+			// count the thread being moved to another CPU
+			if (thread->lastCPU >= 0 && thread->lastCPU != entry->CPU())
+				thread->migrations++;
+			thread->lastCPU = entry->CPU();
+
 			if (thread->state != RUNNING) {
 				thread->lastTime = entry->Time();
 				thread->state = RUNNING;
@@ -71,6 +71,8 @@ ObjectCache::Init(const char* name, size_t objectSize, size_t alignment,
 	empty_count = 0;
 	pressure = 0;
 	min_object_reserve = 0;
+	allocations = 0;
+	frees = 0;
 
 	maintenance_pending = false;
 	maintenance_in_progress = false;
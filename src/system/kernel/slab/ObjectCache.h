@@ -59,6 +59,10 @@ struct ObjectCache : DoublyLinkedListLinkImpl<ObjectCache> {
 			size_t				pressure;
 			size_t				min_object_reserve;
 									// minimum number of free objects
+			uint64				allocations;
+			uint64				frees;
+									// allocations and frees that didn't
+									// go through the depot
 
 			size_t				slab_size;
 			size_t				usage;
@@ -42,9 +42,24 @@ public:
 struct depot_cpu_store {
 	DepotMagazine*	loaded;
 	DepotMagazine*	previous;
+
+	// statistics, only changed by the owning CPU with interrupts disabled
+	uint64			hits;
+	uint64			misses;
+	uint64			stores;
 };
 
 
+// The magazine capacity grows when the depot's inner lock is contended, i.e.
+// when the CPUs exchange magazines with the depot too often. Every
+// kResizeInterval exchanges, the capacity is doubled, if more than
+// kResizeContentionThreshold of them had to wait for the lock. Magazines
+// of the old capacity are still used until the depot is emptied.
+static const uint32 kResizeInterval = 256;
+static const uint32 kResizeContentionThreshold = 16;
+static const size_t kMaxMagazineCapacityFactor = 4;
+
+
 RANGE_MARKER_FUNCTION_BEGIN(SlabObjectDepot)
 
 
@@ -102,13 +117,16 @@ DepotMagazine::ContainsObject(void* object) const
 static DepotMagazine*
 alloc_magazine(object_depot* depot, uint32 flags)
 {
+	size_t capacity = depot->magazine_capacity;
 	DepotMagazine* magazine = (DepotMagazine*)slab_internal_alloc(
-		sizeof(DepotMagazine) + depot->magazine_capacity * sizeof(void*),
-		flags);
+		sizeof(DepotMagazine) + capacity * sizeof(void*), flags);
 	if (magazine) {
 		magazine->next = NULL;
 		magazine->current_round = 0;
-		magazine->round_count = depot->magazine_capacity;
+		magazine->round_count = capacity;
+
+		atomic_add(&depot->magazine_count, 1);
+		atomic_add(&depot->magazine_rounds, capacity);
 	}
 
 	return magazine;
@@ -116,8 +134,11 @@ alloc_magazine(object_depot* depot, uint32 flags)
 
 
 static void
-free_magazine(DepotMagazine* magazine, uint32 flags)
+free_magazine(object_depot* depot, DepotMagazine* magazine, uint32 flags)
 {
+	atomic_add(&depot->magazine_count, -1);
+	atomic_add(&depot->magazine_rounds, -(int32)magazine->round_count);
+
 	slab_internal_free(magazine, flags);
 }
 
@@ -127,7 +148,43 @@ empty_magazine(object_depot* depot, DepotMagazine* magazine, uint32 flags)
 {
 	for (uint16 i = 0; i < magazine->current_round; i++)
 		depot->return_object(depot, depot->cookie, magazine->rounds[i], flags);
-	free_magazine(magazine, flags);
+	free_magazine(depot, magazine, flags);
+}
+
+
+/*!	Acquires the depot's inner lock, counting whether it had to wait for it.
+*/
+static inline void
+lock_depot(object_depot* depot)
+{
+	if (try_acquire_spinlock(&depot->inner_lock))
+		return;
+
+	acquire_spinlock(&depot->inner_lock);
+	depot->contention++;
+	depot->recent_contention++;
+}
+
+
+/*!	Accounts for an exchange of a magazine with the depot and grows the
+	magazine capacity, if the depot has been contended recently.
+	The caller must hold the depot's inner lock.
+*/
+static void
+update_magazine_capacity(object_depot* depot)
+{
+	if (++depot->recent_exchanges < kResizeInterval)
+		return;
+
+	if (depot->recent_contention > kResizeContentionThreshold
+		&& depot->magazine_capacity < depot->max_magazine_capacity) {
+		depot->magazine_capacity = std::min(depot->magazine_capacity * 2,
+			depot->max_magazine_capacity);
+		depot->resize_count++;
+	}
+
+	depot->recent_exchanges = 0;
+	depot->recent_contention = 0;
 }
 
 
@@ -136,13 +193,16 @@ exchange_with_full(object_depot* depot, DepotMagazine*& magazine)
 {
 	ASSERT(magazine->IsEmpty());
 
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
+	SpinLocker _(depot->inner_lock, true);
 
 	if (depot->full == NULL)
 		return false;
 
 	depot->full_count--;
 	depot->empty_count++;
+	depot->full_exchanges++;
+	update_magazine_capacity(depot);
 
 	_push(depot->empty, magazine);
 	magazine = _pop(depot->full);
@@ -156,12 +216,15 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 {
 	ASSERT(magazine == NULL || magazine->IsFull());
 
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
+	SpinLocker _(depot->inner_lock, true);
 
 	if (depot->empty == NULL)
 		return false;
 
 	depot->empty_count--;
+	depot->empty_exchanges++;
+	update_magazine_capacity(depot);
 
 	if (magazine != NULL) {
 		if (depot->full_count < depot->max_count) {
@@ -180,7 +243,8 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 static void
 push_empty_magazine(object_depot* depot, DepotMagazine* magazine)
 {
-	SpinLocker _(depot->inner_lock);
+	lock_depot(depot);
+	SpinLocker _(depot->inner_lock, true);
 
 	_push(depot->empty, magazine);
 	depot->empty_count++;
@@ -207,6 +271,18 @@ object_depot_init(object_depot* depot, size_t capacity, size_t maxCount,
 	depot->full_count = depot->empty_count = 0;
 	depot->max_count = maxCount;
 	depot->magazine_capacity = capacity;
+	depot->min_magazine_capacity = capacity;
+	depot->max_magazine_capacity = std::min(
+		capacity * kMaxMagazineCapacityFactor, (size_t)UINT16_MAX);
+
+	depot->magazine_count = 0;
+	depot->magazine_rounds = 0;
+	depot->recent_exchanges = 0;
+	depot->recent_contention = 0;
+	depot->full_exchanges = 0;
+	depot->empty_exchanges = 0;
+	depot->contention = 0;
+	depot->resize_count = 0;
 
 	rw_lock_init(&depot->outer_lock, "object depot");
 	B_INITIALIZE_SPINLOCK(&depot->inner_lock);
@@ -222,6 +298,9 @@ object_depot_init(object_depot* depot, size_t capacity, size_t maxCount,
 	for (int i = 0; i < cpuCount; i++) {
 		depot->stores[i].loaded = NULL;
 		depot->stores[i].previous = NULL;
+		depot->stores[i].hits = 0;
+		depot->stores[i].misses = 0;
+		depot->stores[i].stores = 0;
 	}
 
 	depot->cookie = cookie;
@@ -257,19 +336,25 @@ object_depot_obtain(object_depot* depot)
 	// if it's not empty, or from the previous magazine if it's full
 	// and finally from the Slab if the magazine depot has no full magazines.
 
-	if (store->loaded == NULL)
+	if (store->loaded == NULL) {
+		store->misses++;
 		return NULL;
+	}
 
 	while (true) {
-		if (!store->loaded->IsEmpty())
+		if (!store->loaded->IsEmpty()) {
+			store->hits++;
 			return store->loaded->Pop();
+		}
 
 		if (store->previous
 			&& (store->previous->IsFull()
 				|| exchange_with_full(depot, store->previous))) {
 			std::swap(store->previous, store->loaded);
-		} else
+		} else {
+			store->misses++;
 			return NULL;
+		}
 	}
 }
 
@@ -281,6 +366,7 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 	InterruptsLocker interruptsLocker;
 
 	depot_cpu_store* store = object_depot_cpu(depot);
+	store->stores++;
 
 	// We try to add the object to the loaded magazine if we have one
 	// and it's not full, or to the previous one if it is empty. If
@@ -361,6 +447,13 @@ object_depot_make_empty(object_depot* depot, uint32 flags)
 	DepotMagazine* emptyMagazines = depot->empty;
 	depot->empty = NULL;
 
+	depot->full_count = 0;
+	depot->empty_count = 0;
+
+	// start over with the initial capacity, the caches are likely to be
+	// emptied due to memory shortage
+	depot->magazine_capacity = depot->min_magazine_capacity;
+
 	writeLocker.Unlock();
 
 	// free all magazines
@@ -372,7 +465,37 @@ object_depot_make_empty(object_depot* depot, uint32 flags)
 		empty_magazine(depot, _pop(fullMagazines), flags);
 
 	while (emptyMagazines)
-		free_magazine(_pop(emptyMagazines), flags);
+		free_magazine(depot, _pop(emptyMagazines), flags);
+}
+
+
+/*!	Collects the depot's statistics. No locks are acquired, so the values
+	may be slightly inconsistent. The function can be called from the kernel
+	debugger.
+*/
+void
+object_depot_get_stats(object_depot* depot, object_depot_stats* stats)
+{
+	stats->hits = 0;
+	stats->misses = 0;
+	stats->stores = 0;
+
+	int cpuCount = smp_get_num_cpus();
+	for (int i = 0; i < cpuCount; i++) {
+		stats->hits += depot->stores[i].hits;
+		stats->misses += depot->stores[i].misses;
+		stats->stores += depot->stores[i].stores;
+	}
+
+	stats->full_exchanges = depot->full_exchanges;
+	stats->empty_exchanges = depot->empty_exchanges;
+	stats->contention = depot->contention;
+	stats->magazine_capacity = depot->magazine_capacity;
+	stats->magazine_count = depot->magazine_count;
+	stats->memory_usage = depot->magazine_count * sizeof(DepotMagazine)
+		+ depot->magazine_rounds * sizeof(void*)
+		+ cpuCount * sizeof(depot_cpu_store);
+	stats->resize_count = depot->resize_count;
 }
 
 
@@ -419,7 +542,13 @@ dump_object_depot(object_depot* depot)
 	kprintf("  full:     %p, count %lu\n", depot->full, depot->full_count);
 	kprintf("  empty:    %p, count %lu\n", depot->empty, depot->empty_count);
 	kprintf("  max full: %lu\n", depot->max_count);
-	kprintf("  capacity: %lu\n", depot->magazine_capacity);
+	kprintf("  capacity: %lu (%lu - %lu, %" B_PRIu32 " resizes)\n",
+		depot->magazine_capacity, depot->min_magazine_capacity,
+		depot->max_magazine_capacity, depot->resize_count);
+	kprintf("  magazines: %" B_PRId32 "\n", depot->magazine_count);
+	kprintf("  exchanges: %" B_PRIu64 " full, %" B_PRIu64 " empty\n",
+		depot->full_exchanges, depot->empty_exchanges);
+	kprintf("  contention: %" B_PRIu64 "\n", depot->contention);
 	kprintf("  stores:\n");
 
 	int cpuCount = smp_get_num_cpus();
@@ -427,6 +556,9 @@ dump_object_depot(object_depot* depot)
 	for (int i = 0; i < cpuCount; i++) {
 		kprintf("  [%d] loaded:   %p\n", i, depot->stores[i].loaded);
 		kprintf("      previous: %p\n", depot->stores[i].previous);
+		kprintf("      hits: %" B_PRIu64 ", misses: %" B_PRIu64 ", stores: %"
+			B_PRIu64 "\n", depot->stores[i].hits, depot->stores[i].misses,
+			depot->stores[i].stores);
 	}
 }
 
@@ -20,6 +20,7 @@
 #include <elf.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <object_cache_defs.h>
 #include <slab/ObjectDepot.h>
 #include <smp.h>
 #include <tracing.h>
@@ -277,6 +278,72 @@ dump_slabs(int argc, char* argv[])
 }
 
 
+/*!	Fills in \a info for the given cache. No locks are acquired, so the
+	values may be slightly inconsistent. Can be called from the kernel
+	debugger.
+*/
+static void
+get_object_cache_info(ObjectCache* cache, object_cache_info& info)
+{
+	memset(&info, 0, sizeof(object_cache_info));
+
+	strlcpy(info.name, cache->name, sizeof(info.name));
+	info.object_size = cache->object_size;
+	info.used_objects = cache->used_count;
+	info.total_objects = cache->total_objects;
+	info.memory_usage = cache->usage;
+	info.allocations = cache->allocations;
+	info.frees = cache->frees;
+
+	if ((cache->flags & CACHE_NO_DEPOT) != 0) {
+		info.flags |= B_OBJECT_CACHE_NO_DEPOT;
+		return;
+	}
+
+	object_depot_stats stats;
+	object_depot_get_stats(&cache->depot, &stats);
+
+	info.depot_memory_usage = stats.memory_usage;
+	info.allocations += stats.hits;
+	info.frees += stats.stores;
+	info.depot_hits = stats.hits;
+	info.depot_misses = stats.misses;
+	info.full_magazine_exchanges = stats.full_exchanges;
+	info.empty_magazine_exchanges = stats.empty_exchanges;
+	info.depot_contention = stats.contention;
+	info.magazine_capacity = stats.magazine_capacity;
+	info.magazine_count = stats.magazine_count;
+	info.magazine_resizes = stats.resize_count;
+}
+
+
+static int
+dump_slab_info(int argc, char* argv[])
+{
+	kprintf("%22s %7s %9s %9s %11s %5s %9s %9s %9s %4s\n", "name", "objsize",
+		"usage", "depot", "allocs", "hit%", "misses", "exchanges", "contended",
+		"mag");
+
+	ObjectCacheList::Iterator it = sObjectCaches.GetIterator();
+	while (ObjectCache* cache = it.Next()) {
+		object_cache_info info;
+		get_object_cache_info(cache, info);
+
+		uint64 depotRequests = info.depot_hits + info.depot_misses;
+		kprintf("%22s %7" B_PRIuSIZE " %9" B_PRIuSIZE " %9" B_PRIuSIZE
+			" %11" B_PRIu64 " %5" B_PRIu64 " %9" B_PRIu64 " %9" B_PRIu64
+			" %9" B_PRIu64 " %4" B_PRIu32 "\n", info.name, info.object_size,
+			info.memory_usage, info.depot_memory_usage, info.allocations,
+			depotRequests > 0 ? info.depot_hits * 100 / depotRequests : 0,
+			info.depot_misses,
+			info.full_magazine_exchanges + info.empty_magazine_exchanges,
+			info.depot_contention, info.magazine_capacity);
+	}
+
+	return 0;
+}
+
+
 static int
 dump_cache_info(int argc, char* argv[])
 {
@@ -1255,6 +1322,7 @@ object_cache_alloc(object_cache* cache, uint32 flags)
 	object_link* link = _pop(source->free);
 	source->count--;
 	cache->used_count++;
+	cache->allocations++;
 
 	if (cache->total_objects - cache->used_count < cache->min_object_reserve)
 		increase_object_reserve(cache);
@@ -1315,6 +1383,7 @@ object_cache_free(object_cache* cache, void* object, uint32 flags)
 	}
 
 	MutexLocker _(cache->lock);
+	cache->frees++;
 	cache->ReturnObjectToSlab(cache->ObjectSlab(object), object, flags);
 }
 
@@ -1340,6 +1409,51 @@ object_cache_get_usage(object_cache* cache, size_t* _allocatedMemory)
 }
 
 
+// #pragma mark - syscalls
+
+
+status_t
+_user_get_next_object_cache_info(int32* _cookie, object_cache_info* userInfo,
+	size_t size)
+{
+	if (size != sizeof(object_cache_info))
+		return B_BAD_VALUE;
+	if (_cookie == NULL || userInfo == NULL || !IS_USER_ADDRESS(_cookie)
+		|| !IS_USER_ADDRESS(userInfo)) {
+		return B_BAD_ADDRESS;
+	}
+
+	int32 cookie;
+	if (user_memcpy(&cookie, _cookie, sizeof(int32)) != B_OK)
+		return B_BAD_ADDRESS;
+	if (cookie < 0)
+		return B_BAD_VALUE;
+
+	// The cache's lock isn't acquired, since it may be held while waiting
+	// for memory, which in turn may require the cache list lock.
+	object_cache_info info;
+	MutexLocker cacheListLocker(sObjectCacheListLock);
+
+	ObjectCacheList::Iterator it = sObjectCaches.GetIterator();
+	ObjectCache* cache = it.Next();
+	for (int32 i = 0; cache != NULL && i < cookie; i++)
+		cache = it.Next();
+	if (cache == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	get_object_cache_info(cache, info);
+	cacheListLocker.Unlock();
+
+	cookie++;
+	if (user_memcpy(userInfo, &info, sizeof(object_cache_info)) != B_OK
+		|| user_memcpy(_cookie, &cookie, sizeof(int32)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	return B_OK;
+}
+
+
 void
 slab_init(kernel_args* args)
 {
@@ -1357,6 +1471,8 @@ slab_init_post_area()
 	MemoryManager::InitPostArea();
 
 	add_debugger_command("slabs", dump_slabs, "list all object caches");
+	add_debugger_command("slabinfo", dump_slab_info,
+		"list allocation and depot statistics of all object caches");
 	add_debugger_command("slab_cache", dump_cache_info,
 		"dump information about a specific object cache");
 	add_debugger_command("slab_depot", dump_object_depot,
@@ -23,6 +23,7 @@
 #include <debug.h>
 #include <disk_device_manager/ddm_userland_interface.h>
 #include <elf.h>
+#include <event_queue.h>
 #include <frame_buffer_console.h>
 #include <fs/fd.h>
 #include <fs/node_monitor.h>
@@ -41,6 +42,7 @@
 #include <real_time_clock.h>
 #include <safemode.h>
 #include <sem.h>
+#include <slab/Slab.h>
 #include <sys/resource.h>
 #include <system_profiler.h>
 #include <thread.h>
@@ -509,6 +509,17 @@ _user_get_system_info_etc(int32 id, void* userInfo, size_t size)
 			return user_memcpy(userInfo, &info, sizeof(system_memory_info));
 		}
 
+		case B_NUMA_INFO:
+		{
+			if (size < sizeof(system_numa_info))
+				return B_BAD_VALUE;
+
+			system_numa_info info;
+			vm_page_get_numa_info(&info);
+
+			return user_memcpy(userInfo, &info, sizeof(system_numa_info));
+		}
+
 		default:
 			return B_BAD_VALUE;
 	}
@@ -31,6 +31,32 @@ VMTranslationMap::~VMTranslationMap()
 }
 
 
+/*!	Returns the size of the large pages supported by the translation map, or
+	0, if it doesn't support large pages.
+*/
+size_t
+VMTranslationMap::LargePageSize() const
+{
+	return 0;
+}
+
+
+/*!	Maps a physically contiguous range of LargePageSize() bytes with a single
+	large page. Both addresses must be aligned to the large page size.
+	The default implementation doesn't support large pages.
+	\return \c B_OK, if the range has been mapped, an error code otherwise. The
+		caller is expected to fall back to mapping the range page by page in
+		this case.
+*/
+status_t
+VMTranslationMap::MapLargePage(addr_t virtualAddress,
+	phys_addr_t physicalAddress, uint32 attributes, uint32 memoryType,
+	vm_page_reservation* reservation)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
 status_t
 VMTranslationMap::DebugMarkRangePresent(addr_t start, addr_t end,
 	bool markPresent)
@@ -56,6 +56,7 @@
 #include "VMAddressSpaceLocking.h"
 #include "VMAnonymousCache.h"
 #include "VMAnonymousNoSwapCache.h"
+#include "VMPageQueue.h"
 #include "IORequest.h"
 
 
@@ -582,6 +583,84 @@ map_page(VMArea* area, vm_page* page, addr_t address, uint32 protection,
 }
 
 
+/*!	Maps the \a pageCount physically contiguous pages starting with \a page
+	into the wired \a area and inserts them into the area's cache at
+	\a offset. If \a useLargePages is \c true, suitably aligned parts of the
+	run are mapped with large pages, if the translation map supports them.
+	The caller must have reserved enough pages the translation map
+	implementation might need to map the run.
+	The area's cache must be locked.
+*/
+static void
+map_wired_page_run(VMArea* area, vm_page* page, page_num_t pageCount,
+	off_t offset, uint32 protection, bool useLargePages,
+	vm_page_reservation* reservation)
+{
+	VMCache* cache = area->cache;
+	VMTranslationMap* map = area->address_space->TranslationMap();
+	size_t largePageSize = useLargePages ? map->LargePageSize() : 0;
+	page_num_t pagesPerLargePage = largePageSize / B_PAGE_SIZE;
+
+	phys_addr_t physicalAddress
+		= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
+	addr_t virtualAddress = area->Base() + (offset - area->cache_offset);
+
+	map->Lock();
+
+	while (pageCount > 0) {
+		page_num_t count = 1;
+		if (largePageSize != 0 && pageCount >= pagesPerLargePage
+			&& virtualAddress % largePageSize == 0
+			&& physicalAddress % largePageSize == 0
+			&& map->MapLargePage(virtualAddress, physicalAddress, protection,
+				area->MemoryType(), reservation) == B_OK) {
+			count = pagesPerLargePage;
+		} else if (map->Map(virtualAddress, physicalAddress, protection,
+				area->MemoryType(), reservation) != B_OK) {
+			panic("couldn't map physical page in page run\n");
+		}
+
+		for (page_num_t i = 0; i < count; i++) {
+			page = vm_lookup_page(physicalAddress / B_PAGE_SIZE + i);
+			if (page == NULL)
+				panic("couldn't lookup physical page just allocated\n");
+
+			cache->InsertPage(page, offset);
+			increment_page_wired_count(page);
+
+			DEBUG_PAGE_ACCESS_END(page);
+
+			offset += B_PAGE_SIZE;
+		}
+
+		virtualAddress += count * B_PAGE_SIZE;
+		physicalAddress += count * B_PAGE_SIZE;
+		pageCount -= count;
+	}
+
+	map->Unlock();
+}
+
+
+/*!	Frees the physical page runs of \a pagesPerRun pages each, whose first
+	pages are in \a runs.
+*/
+static void
+free_page_runs(VMPageQueue::PageList& runs, page_num_t pagesPerRun)
+{
+	while (vm_page* page = runs.RemoveHead()) {
+		page_num_t pageNumber = page->physical_page_number;
+		for (page_num_t i = 0; i < pagesPerRun; i++, pageNumber++) {
+			page = vm_lookup_page(pageNumber);
+			if (page == NULL)
+				panic("couldn't lookup physical page just allocated\n");
+
+			vm_page_set_state(page, PAGE_STATE_FREE);
+		}
+	}
+}
+
+
 /*!	If \a preserveModified is \c true, the caller must hold the lock of the
 	page's cache.
 */
@@ -1218,6 +1297,14 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 		isStack = true;
 #endif
 
+	// Fully locked and contiguous areas use large pages where possible anyway.
+	// Since large pages can't be faulted in on demand, explicitly requesting
+	// them makes the area fully locked.
+	bool wantLargePages = (protection & B_LARGE_PAGES) != 0 && !isStack;
+	protection &= ~B_LARGE_PAGES;
+	if (wantLargePages && (wiring == B_NO_LOCK || wiring == B_LAZY_LOCK))
+		wiring = B_FULL_LOCK;
+
 	// check parameters
 	switch (virtualAddressRestrictions->address_specification) {
 		case B_ANY_ADDRESS:
@@ -1296,6 +1383,7 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	// For full lock or contiguous areas we're also going to map the pages and
 	// thus need to reserve pages for the mapping backend upfront.
 	addr_t reservedMapPages = 0;
+	size_t largePageSize = 0;
 	if (wiring == B_FULL_LOCK || wiring == B_CONTIGUOUS) {
 		AddressSpaceWriteLocker locker;
 		status_t status = locker.SetTo(team);
@@ -1304,6 +1392,39 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 
 		VMTranslationMap* map = locker.AddressSpace()->TranslationMap();
 		reservedMapPages = map->MaxPagesNeededToMap(0, size - 1);
+
+		if (!isStack && map->LargePageSize() != 0
+			&& size >= map->LargePageSize()) {
+			largePageSize = map->LargePageSize();
+		}
+	}
+
+	// If the area can use large pages, make sure it is suitably aligned.
+	virtual_address_restrictions largePageAddressRestrictions;
+	if (largePageSize != 0) {
+		if (virtualAddressRestrictions->address_specification
+				== B_EXACT_ADDRESS) {
+			if ((addr_t)virtualAddressRestrictions->address % largePageSize
+					!= 0) {
+				largePageSize = 0;
+			}
+		} else if (virtualAddressRestrictions->alignment < largePageSize) {
+			largePageAddressRestrictions = *virtualAddressRestrictions;
+			largePageAddressRestrictions.alignment = largePageSize;
+			virtualAddressRestrictions = &largePageAddressRestrictions;
+		}
+	}
+
+	// When large pages have been asked for explicitly, also align contiguous
+	// runs accordingly. Otherwise we only use them if the run happens to be
+	// aligned.
+	physical_address_restrictions largePagePhysicalRestrictions;
+	if (largePageSize != 0 && wantLargePages && wiring == B_CONTIGUOUS
+		&& physicalAddressRestrictions->alignment < largePageSize
+		&& physicalAddressRestrictions->boundary == 0) {
+		largePagePhysicalRestrictions = *physicalAddressRestrictions;
+		largePagePhysicalRestrictions.alignment = largePageSize;
+		physicalAddressRestrictions = &largePagePhysicalRestrictions;
 	}
 
 	int priority;
@@ -1335,12 +1456,37 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 	VMAddressSpace* addressSpace;
 	status_t status;
 
+	// For full lock areas that can use large pages, try to allocate suitably
+	// aligned page runs for them upfront. Whatever isn't covered by those
+	// is backed by single pages as usual.
+	VMPageQueue::PageList largePageRuns;
+	page_num_t pagesPerLargePage = largePageSize / B_PAGE_SIZE;
+	page_num_t largePageRunCount = 0;
+	if (wiring == B_FULL_LOCK && largePageSize != 0
+		&& (flags & CREATE_AREA_DONT_WAIT) == 0) {
+		physical_address_restrictions runRestrictions = {};
+		runRestrictions.alignment = largePageSize;
+
+		for (size_t i = size / largePageSize; i > 0; i--) {
+			vm_page* run = vm_page_allocate_page_run(
+				PAGE_STATE_WIRED | pageAllocFlags, pagesPerLargePage,
+				&runRestrictions, priority);
+			if (run == NULL)
+				break;
+
+			largePageRuns.Add(run);
+			largePageRunCount++;
+		}
+	}
+
 	// For full lock areas reserve the pages before locking the address
 	// space. E.g. block caches can't release their memory while we hold the
 	// address space lock.
 	page_num_t reservedPages = reservedMapPages;
-	if (wiring == B_FULL_LOCK)
-		reservedPages += size / B_PAGE_SIZE;
+	if (wiring == B_FULL_LOCK) {
+		reservedPages += size / B_PAGE_SIZE
+			- largePageRunCount * pagesPerLargePage;
+	}
 
 	vm_page_reservation reservation;
 	if (reservedPages > 0) {
@@ -1422,6 +1568,19 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 			for (addr_t address = area->Base();
 					address < area->Base() + (area->Size() - 1);
 					address += B_PAGE_SIZE, offset += B_PAGE_SIZE) {
+				// Use up the page runs we have allocated first. They are mapped
+				// with large pages, if the area is suitably aligned.
+				if (!largePageRuns.IsEmpty()
+					&& area->Base() + (area->Size() - 1) - address
+						>= largePageSize - 1) {
+					map_wired_page_run(area, largePageRuns.RemoveHead(),
+						pagesPerLargePage, offset, protection, true,
+						&reservation);
+					address += largePageSize - B_PAGE_SIZE;
+					offset += largePageSize - B_PAGE_SIZE;
+					continue;
+				}
+
 #ifdef DEBUG_KERNEL_STACKS
 #	ifdef STACK_GROWS_DOWNWARDS
 				if (isStack && address < area->Base()
@@ -1490,33 +1649,8 @@ vm_create_anonymous_area(team_id team, const char *name, addr_t size,
 		{
 			// We have already allocated our continuous pages run, so we can now
 			// just map them in the address space
-			VMTranslationMap* map = addressSpace->TranslationMap();
-			phys_addr_t physicalAddress
-				= (phys_addr_t)page->physical_page_number * B_PAGE_SIZE;
-			addr_t virtualAddress = area->Base();
-			off_t offset = 0;
-
-			map->Lock();
-
-			for (virtualAddress = area->Base(); virtualAddress < area->Base()
-					+ (area->Size() - 1); virtualAddress += B_PAGE_SIZE,
-					offset += B_PAGE_SIZE, physicalAddress += B_PAGE_SIZE) {
-				page = vm_lookup_page(physicalAddress / B_PAGE_SIZE);
-				if (page == NULL)
-					panic("couldn't lookup physical page just allocated\n");
-
-				status = map->Map(virtualAddress, physicalAddress, protection,
-					area->MemoryType(), &reservation);
-				if (status < B_OK)
-					panic("couldn't map physical page in page run\n");
-
-				cache->InsertPage(page, offset);
-				increment_page_wired_count(page);
-
-				DEBUG_PAGE_ACCESS_END(page);
-			}
-
-			map->Unlock();
+			map_wired_page_run(area, page, size / B_PAGE_SIZE, 0, protection,
+				largePageSize != 0, &reservation);
 			break;
 		}
 
@@ -1549,6 +1683,7 @@ err1:
 	}
 
 err0:
+	free_page_runs(largePageRuns, pagesPerLargePage);
 	if (reservedPages > 0)
 		vm_page_unreserve_pages(&reservation);
 	if (reservedMemory > 0)
@@ -2015,6 +2150,22 @@ vm_map_file(team_id aid, const char* name, void** address, uint32 addressSpec,
 }
 
 
+/*!	Maps the file specified by the userland \a fd of the current team
+	read-only into the kernel address space. The area shares the pages of the
+	file's cache, it does not contain a copy of them.
+	\a offset and \a size have to be page aligned.
+*/
+area_id
+vm_map_user_file_into_kernel(const char* name, void** _address, addr_t size,
+	int fd, off_t offset)
+{
+	*_address = NULL;
+	return _vm_map_file(VMAddressSpace::KernelID(), name, _address,
+		B_ANY_KERNEL_ADDRESS, size, B_KERNEL_READ_AREA, REGION_NO_PRIVATE_MAP,
+		false, fd, offset, false);
+}
+
+
 VMCache*
 vm_area_get_locked_cache(VMArea* area)
 {
@@ -6131,7 +6282,8 @@ _user_create_area(const char* userName, void** userAddress, uint32 addressSpec,
 		case B_ANY_KERNEL_BLOCK_ADDRESS:
 			return B_BAD_VALUE;
 	}
-	if ((protection & ~B_USER_AREA_FLAGS) != 0)
+	// B_LARGE_PAGES is only meaningful for anonymous areas
+	if ((protection & ~(B_USER_AREA_FLAGS | B_LARGE_PAGES)) != 0)
 		return B_BAD_VALUE;
 
 	if (!IS_USER_ADDRESS(userName)
@@ -8,6 +8,7 @@
  */
 
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -27,6 +28,8 @@
 #include <heap.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <smp.h>
+#include <system_info.h>
 #include <thread.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -101,11 +104,11 @@ static const int32 kPageUsageAdvance = 3;
 static const int32 kPageUsageDecline = 1;
 
 int32 gMappedPagesCount;
+int32 gLargeMappedPagesCount;
+	// number of pages mapped via large pages
 
 static VMPageQueue sPageQueues[PAGE_STATE_COUNT];
 
-static VMPageQueue& sFreePageQueue = sPageQueues[PAGE_STATE_FREE];
-static VMPageQueue& sClearPageQueue = sPageQueues[PAGE_STATE_CLEAR];
 static VMPageQueue& sModifiedPageQueue = sPageQueues[PAGE_STATE_MODIFIED];
 static VMPageQueue& sInactivePageQueue = sPageQueues[PAGE_STATE_INACTIVE];
 static VMPageQueue& sActivePageQueue = sPageQueues[PAGE_STATE_ACTIVE];
@@ -133,6 +136,152 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+// Free and clear pages are kept in per NUMA node queues, so that allocations
+// can be satisfied from memory local to the allocating CPU. Without topology
+// information from the boot loader there is a single node containing all
+// pages. The node queues are protected by sFreePageQueuesLock.
+struct page_node {
+	VMPageQueue		free_queue;
+	VMPageQueue		clear_queue;
+	page_num_t		total_pages;
+	uint8			distance[MAX_NUMA_NODES];
+	uint32			fallback[MAX_NUMA_NODES];
+		// all nodes ordered by their distance from this one, starting with
+		// this node itself
+	char			free_queue_name[32];
+	char			clear_queue_name[32];
+
+	// statistics
+	vint64			remote_allocations;
+		// pages allocated for CPUs of this node from other nodes
+};
+
+struct page_node_range {
+	page_num_t		start;
+	page_num_t		end;
+	uint32			node;
+};
+
+static page_node sPageNodes[MAX_NUMA_NODES];
+static uint32 sPageNodeCount = 1;
+static page_node_range sPageNodeRanges[MAX_NUMA_MEMORY_RANGES];
+static uint32 sPageNodeRangeCount;
+static uint32 sCPUPageNode[B_MAX_CPU_COUNT];
+
+// Per-CPU caches of free and clear pages, and of page reservations. Pages and
+// reservations are moved between a CPU's cache and the global queues/counter
+// in batches, so that most allocations and frees don't have to touch the
+// global state. The pages in a cache keep their free/clear state.
+// A CPU's page lists may only be accessed with a read lock on
+// sFreePageQueuesLock and interrupts disabled; with the write lock all CPUs'
+// lists may be accessed. The reservation counts are only changed atomically.
+static const uint32 kPageCPUCacheSize = 64;
+static const uint32 kPageCPUCacheBatch = 16;
+static const int32 kReservationCPUCacheSize = 64;
+static const int32 kReservationCPUCacheBatch = 16;
+
+struct page_cpu_cache {
+	VMPageQueue::PageList	free_pages;
+	VMPageQueue::PageList	clear_pages;
+	uint32					free_count;
+	uint32					clear_count;
+	vint32					reserved;
+	uint32					node;
+		// the NUMA node of the CPU; only pages of that node are cached
+
+	// statistics
+	uint32					hits;
+	uint32					misses;
+} __attribute__((aligned(64)));
+
+static page_cpu_cache sPageCPUCaches[B_MAX_CPU_COUNT];
+
+
+/*!	Returns the number of page reservations held by the CPU caches.
+*/
+static int32
+cached_page_reservations()
+{
+	int32 count = 0;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++)
+		count += sPageCPUCaches[i].reserved;
+	return count;
+}
+
+
+/*!	Returns the number of free and clear pages held by the CPU caches.
+*/
+static uint32
+cached_free_pages()
+{
+	uint32 count = 0;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++)
+		count += sPageCPUCaches[i].free_count + sPageCPUCaches[i].clear_count;
+	return count;
+}
+
+
+/*!	Returns the NUMA node the given page's memory belongs to.
+*/
+static inline uint32
+page_node_index(vm_page* page)
+{
+	return page->numa_node;
+}
+
+
+/*!	Looks up the NUMA node of the given physical page in the memory ranges
+	of the nodes. Only used to initialize vm_page::numa_node.
+*/
+static uint32
+find_page_node(page_num_t pageNumber)
+{
+	for (uint32 i = 0; i < sPageNodeRangeCount; i++) {
+		if (pageNumber >= sPageNodeRanges[i].start
+			&& pageNumber < sPageNodeRanges[i].end) {
+			return sPageNodeRanges[i].node;
+		}
+	}
+
+	return 0;
+}
+
+
+/*!	Returns the free or clear queue of the node the given page belongs to.
+*/
+static inline VMPageQueue&
+free_queue_for_page(vm_page* page, bool clear)
+{
+	page_node& node = sPageNodes[page_node_index(page)];
+	return clear ? node.clear_queue : node.free_queue;
+}
+
+
+/*!	Returns the NUMA node of the current CPU. Unless the thread is pinned or
+	interrupts are disabled, the result is only a hint.
+*/
+static inline uint32
+current_page_node()
+{
+	return sCPUPageNode[smp_get_current_cpu()];
+}
+
+
+/*!	Returns the number of pages in the free or clear queues of all nodes.
+*/
+static page_num_t
+queued_free_pages(bool clear)
+{
+	page_num_t count = 0;
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		count += clear
+			? sPageNodes[i].clear_queue.Count()
+			: sPageNodes[i].free_queue.Count();
+	}
+	return count;
+}
+
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -772,8 +921,6 @@ find_page(int argc, char **argv)
 		const char*	name;
 		VMPageQueue*	queue;
 	} pageQueueInfos[] = {
-		{ "free",		&sFreePageQueue },
-		{ "clear",		&sClearPageQueue },
 		{ "modified",	&sModifiedPageQueue },
 		{ "active",		&sActivePageQueue },
 		{ "inactive",	&sInactivePageQueue },
@@ -792,6 +939,21 @@ find_page(int argc, char **argv)
 	address = strtoul(argv[index], NULL, 0);
 	page = (vm_page*)address;
 
+	for (uint32 node = 0; node < sPageNodeCount; node++) {
+		for (i = 0; i < 2; i++) {
+			VMPageQueue* queue = i == 0
+				? &sPageNodes[node].free_queue : &sPageNodes[node].clear_queue;
+			VMPageQueue::Iterator it = queue->GetIterator();
+			while (vm_page* p = it.Next()) {
+				if (p == page) {
+					kprintf("found page %p in queue %p (%s, node %" B_PRIu32
+						")\n", page, queue, i == 0 ? "free" : "clear", node);
+					return 0;
+				}
+			}
+		}
+	}
+
 	for (i = 0; pageQueueInfos[i].name; i++) {
 		VMPageQueue::Iterator it = pageQueueInfos[i].queue->GetIterator();
 		while (vm_page* p = it.Next()) {
@@ -978,9 +1140,9 @@ dump_page_queue(int argc, char **argv)
 	if (strlen(argv[1]) >= 2 && argv[1][0] == '0' && argv[1][1] == 'x')
 		queue = (VMPageQueue*)strtoul(argv[1], NULL, 16);
 	if (!strcmp(argv[1], "free"))
-		queue = &sFreePageQueue;
+		queue = &sPageNodes[0].free_queue;
 	else if (!strcmp(argv[1], "clear"))
-		queue = &sClearPageQueue;
+		queue = &sPageNodes[0].clear_queue;
 	else if (!strcmp(argv[1], "modified"))
 		queue = &sModifiedPageQueue;
 	else if (!strcmp(argv[1], "active"))
@@ -1117,7 +1279,11 @@ dump_page_stats(int argc, char **argv)
 	kprintf("unreserved free pages: %" B_PRId32 "\n", sUnreservedFreePages);
 	kprintf("unsatisfied page reservations: %" B_PRId32 "\n",
 		sUnsatisfiedPageReservations);
+	kprintf("cached page reservations: %" B_PRId32 "\n",
+		cached_page_reservations());
 	kprintf("mapped pages: %" B_PRId32 "\n", gMappedPagesCount);
+	kprintf("pages mapped via large pages: %" B_PRId32 "\n",
+		gLargeMappedPagesCount);
 	kprintf("longest free pages run: %" B_PRIuPHYSADDR " pages (at %"
 		B_PRIuPHYSADDR ")\n", longestFreeRun.Length(),
 		sPages[longestFreeRun.start].physical_page_number);
@@ -1134,10 +1300,28 @@ dump_page_stats(int argc, char **argv)
 			waiter->missing, waiter->dontTouch);
 	}
 
-	kprintf("\nfree queue: %p, count = %" B_PRIuPHYSADDR "\n", &sFreePageQueue,
-		sFreePageQueue.Count());
-	kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n", &sClearPageQueue,
-		sClearPageQueue.Count());
+	kprintf("per-CPU page caches:\n");
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+		kprintf("  %3" B_PRId32 ": free: %3" B_PRIu32 ", clear: %3" B_PRIu32
+			", reserved: %3" B_PRId32 ", hits: %" B_PRIu32 ", misses: %"
+			B_PRIu32 "\n", i, cache.free_count, cache.clear_count,
+			cache.reserved, cache.hits, cache.misses);
+	}
+
+	kprintf("\n");
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		page_node& node = sPageNodes[i];
+		if (sPageNodeCount > 1) {
+			kprintf("node %" B_PRIu32 ": %" B_PRIuPHYSADDR " pages, remote "
+				"allocations: %" B_PRId64 "\n", i, node.total_pages,
+				node.remote_allocations);
+		}
+		kprintf("free queue: %p, count = %" B_PRIuPHYSADDR "\n",
+			&node.free_queue, node.free_queue.Count());
+		kprintf("clear queue: %p, count = %" B_PRIuPHYSADDR "\n",
+			&node.clear_queue, node.clear_queue.Count());
+	}
 	kprintf("modified queue: %p, count = %" B_PRIuPHYSADDR " (%" B_PRId32
 		" temporary, %" B_PRIuPHYSADDR " swappable, " "inactive: %"
 		B_PRIuPHYSADDR ")\n", &sModifiedPageQueue, sModifiedPageQueue.Count(),
@@ -1403,7 +1587,8 @@ vm_page::SetState(uint8 newState)
 static void
 get_page_stats(page_stats& _pageStats)
 {
-	_pageStats.totalFreePages = sUnreservedFreePages;
+	_pageStats.totalFreePages = sUnreservedFreePages
+		+ cached_page_reservations();
 	_pageStats.cachedPages = sCachedPageQueue.Count();
 	_pageStats.unsatisfiedReservations = sUnsatisfiedPageReservations;
 	// TODO: We don't get an actual snapshot here!
@@ -1475,7 +1660,7 @@ wake_up_page_reservation_waiters()
 
 
 static inline void
-unreserve_pages(uint32 count)
+unreserve_pages_global(uint32 count)
 {
 	atomic_add(&sUnreservedFreePages, count);
 	if (sUnsatisfiedPageReservations != 0)
@@ -1483,6 +1668,230 @@ unreserve_pages(uint32 count)
 }
 
 
+static inline void
+unreserve_pages(uint32 count)
+{
+	if (sUnsatisfiedPageReservations == 0
+		&& count <= (uint32)kReservationCPUCacheBatch) {
+		// keep the reservations in the current CPU's cache
+		page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+		if (cache.reserved + (int32)count <= kReservationCPUCacheSize) {
+			atomic_add(&cache.reserved, count);
+
+			// If someone started waiting for pages in the meantime, they
+			// might have flushed the caches before we added to ours.
+			if (sUnsatisfiedPageReservations == 0)
+				return;
+			count = atomic_set(&cache.reserved, 0);
+		}
+	}
+
+	unreserve_pages_global(count);
+}
+
+
+/*!	Moves the page reservations held by the CPU caches back to
+	\c sUnreservedFreePages. Doesn't wake up any waiters.
+	\return The number of reservations moved.
+*/
+static int32
+flush_cached_page_reservations()
+{
+	int32 count = 0;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++)
+		count += atomic_set(&sPageCPUCaches[i].reserved, 0);
+
+	if (count > 0)
+		atomic_add(&sUnreservedFreePages, count);
+	return count;
+}
+
+
+/*!	Tries to satisfy a reservation of \a count pages from the current CPU's
+	reservation cache. If the cache doesn't hold enough, it is refilled with
+	a batch from \c sUnreservedFreePages, as long as that doesn't bring the
+	free pages below the page daemon's target.
+	\return \c true, if the pages have been reserved.
+*/
+static bool
+reserve_pages_from_cpu_cache(uint32 count, uint32 dontTouch)
+{
+	if (count > (uint32)kReservationCPUCacheBatch)
+		return false;
+
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+	while (true) {
+		int32 cached = cache.reserved;
+		if (cached < (int32)count)
+			break;
+		if (atomic_test_and_set(&cache.reserved, cached - count, cached)
+				== cached) {
+			return true;
+		}
+	}
+
+	uint32 toReserve = count + kReservationCPUCacheBatch;
+	uint32 reserved = reserve_some_pages(toReserve,
+		std::max(dontTouch, sFreePagesTarget));
+	if (reserved < toReserve) {
+		if (reserved > 0)
+			unreserve_pages_global(reserved);
+		return false;
+	}
+
+	atomic_add(&cache.reserved, kReservationCPUCacheBatch);
+	return true;
+}
+
+
+/*!	Moves up to \a count pages from the tail of one of \a cache's page lists
+	to the respective queue of the cache's node.
+	The caller must hold a read lock on \c sFreePageQueuesLock and have
+	interrupts disabled, if \a cache is the current CPU's cache, or hold the
+	write lock otherwise.
+*/
+static void
+drain_page_cpu_cache(page_cpu_cache& cache, bool clear, uint32 count)
+{
+	page_node& node = sPageNodes[cache.node];
+	VMPageQueue& queue = clear ? node.clear_queue : node.free_queue;
+	VMPageQueue::PageList& pages = clear ? cache.clear_pages : cache.free_pages;
+	uint32& cachedCount = clear ? cache.clear_count : cache.free_count;
+
+	InterruptsSpinLocker locker(queue.GetLock());
+
+	while (count-- > 0) {
+		vm_page* page = pages.RemoveTail();
+		if (page == NULL)
+			break;
+
+		queue.Append(page);
+		cachedCount--;
+	}
+}
+
+
+/*!	Moves all pages in the CPU caches back to the free and clear queues.
+	The caller must hold the write lock on \c sFreePageQueuesLock.
+*/
+static void
+drain_page_cpu_caches()
+{
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		page_cpu_cache& cache = sPageCPUCaches[i];
+		drain_page_cpu_cache(cache, false, cache.free_count);
+		drain_page_cpu_cache(cache, true, cache.clear_count);
+	}
+}
+
+
+/*!	Refills one of \a cache's page lists with a batch of pages from the
+	respective queue of the cache's node. Takes no more than a fair share of
+	the queue, so that the other CPUs don't run dry.
+	The caller must hold a read lock on \c sFreePageQueuesLock and have
+	interrupts disabled.
+*/
+static void
+refill_page_cpu_cache(page_cpu_cache& cache, bool clear)
+{
+	page_node& node = sPageNodes[cache.node];
+	VMPageQueue& queue = clear ? node.clear_queue : node.free_queue;
+	VMPageQueue::PageList& pages = clear ? cache.clear_pages : cache.free_pages;
+	uint32& cachedCount = clear ? cache.clear_count : cache.free_count;
+
+	uint32 count = std::min((phys_addr_t)kPageCPUCacheBatch,
+		queue.Count() / (2 * smp_get_num_cpus()));
+	if (count == 0)
+		count = 1;
+
+	SpinLocker locker(queue.GetLock());
+
+	while (count-- > 0) {
+		vm_page* page = queue.RemoveHead();
+		if (page == NULL)
+			break;
+
+		pages.Add(page);
+		cachedCount++;
+	}
+}
+
+
+/*!	Takes a free or clear page out of the current CPU's cache, refilling it
+	from the queues of the CPU's node, if necessary. If the node has no pages
+	left, the other nodes are tried in the order of their distance. Pages of
+	the kind specified by \a clear are preferred.
+	The caller must hold a read lock on \c sFreePageQueuesLock and have
+	interrupts disabled.
+	\return The page, or \c NULL, if neither the cache nor the queues had
+		one.
+*/
+static vm_page*
+allocate_page_from_cpu_cache(bool clear)
+{
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+
+	for (int32 i = 0; i < 2; i++, clear = !clear) {
+		VMPageQueue::PageList& pages
+			= clear ? cache.clear_pages : cache.free_pages;
+		uint32& cachedCount = clear ? cache.clear_count : cache.free_count;
+
+		if (cachedCount == 0)
+			refill_page_cpu_cache(cache, clear);
+		else
+			cache.hits++;
+
+		if (vm_page* page = pages.RemoveHead()) {
+			cachedCount--;
+			return page;
+		}
+	}
+
+	cache.misses++;
+
+	page_node& localNode = sPageNodes[cache.node];
+	for (uint32 i = 1; i < sPageNodeCount; i++) {
+		page_node& node = sPageNodes[localNode.fallback[i]];
+		vm_page* page = (clear ? node.clear_queue : node.free_queue)
+			.RemoveHeadUnlocked();
+		if (page == NULL) {
+			page = (clear ? node.free_queue : node.clear_queue)
+				.RemoveHeadUnlocked();
+		}
+		if (page != NULL) {
+			atomic_add64(&localNode.remote_allocations, 1);
+			return page;
+		}
+	}
+
+	return NULL;
+}
+
+
+/*!	Puts a free or clear page into the current CPU's cache, moving a batch of
+	pages to the node's queue, if the cache is full. Pages of other nodes are
+	put directly into their node's queue.
+	The caller must hold a read lock on \c sFreePageQueuesLock and have
+	interrupts disabled.
+*/
+static void
+free_page_to_cpu_cache(vm_page* page, bool clear)
+{
+	page_cpu_cache& cache = sPageCPUCaches[smp_get_current_cpu()];
+	if (sPageNodeCount > 1 && page_node_index(page) != cache.node) {
+		free_queue_for_page(page, clear).PrependUnlocked(page);
+		return;
+	}
+
+	VMPageQueue::PageList& pages = clear ? cache.clear_pages : cache.free_pages;
+	uint32& cachedCount = clear ? cache.clear_count : cache.free_count;
+
+	pages.Add(page, false);
+	if (++cachedCount > kPageCPUCacheSize)
+		drain_page_cpu_cache(cache, clear, kPageCPUCacheBatch);
+}
+
+
 static void
 free_page(vm_page* page, bool clear)
 {
@@ -1537,13 +1946,11 @@ free_page(vm_page* page, bool clear)
 
 	DEBUG_PAGE_ACCESS_END(page);
 
-	if (clear) {
-		page->SetState(PAGE_STATE_CLEAR);
-		sClearPageQueue.PrependUnlocked(page);
-	} else {
-		page->SetState(PAGE_STATE_FREE);
-		sFreePageQueue.PrependUnlocked(page);
-	}
+	page->SetState(clear ? PAGE_STATE_CLEAR : PAGE_STATE_FREE);
+
+	InterruptsLocker interruptsLocker;
+	free_page_to_cpu_cache(page, clear);
+	interruptsLocker.Unlock();
 
 	locker.Unlock();
 
@@ -1710,6 +2117,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 	}
 
 	WriteLocker locker(sFreePageQueuesLock);
+	drain_page_cpu_caches();
 
 	for (page_num_t i = 0; i < length; i++) {
 		vm_page *page = &sPages[startPage + i];
@@ -1721,9 +2129,8 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 // the free/clear queues without having reserved them before. This should happen
 // in the early boot process only, though.
 				DEBUG_PAGE_ACCESS_START(page);
-				VMPageQueue& queue = page->State() == PAGE_STATE_FREE
-					? sFreePageQueue : sClearPageQueue;
-				queue.Remove(page);
+				free_queue_for_page(page, page->State() == PAGE_STATE_CLEAR)
+					.Remove(page);
 				page->SetState(wired ? PAGE_STATE_WIRED : PAGE_STATE_UNUSED);
 				page->busy = false;
 				atomic_add(&sUnreservedFreePages, -1);
@@ -1751,9 +2158,10 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 
 /*!
 	This is a background thread that wakes up every now and then (every 100ms)
-	and moves some pages from the free queue over to the clear queue.
-	Given enough time, it will clear out all pages from the free queue - we
+	and moves some pages from the free queues over to the clear queues.
+	Given enough time, it will clear out all pages from the free queues - we
 	could probably slow it down after having reached a certain threshold.
+	The nodes' free queues are scrubbed in turn, the pages stay on their node.
 */
 static int32
 page_scrubber(void *unused)
@@ -1762,10 +2170,12 @@ page_scrubber(void *unused)
 
 	TRACE(("page_scrubber starting...\n"));
 
+	uint32 nextNode = 0;
+
 	for (;;) {
 		snooze(100000); // 100ms
 
-		if (sFreePageQueue.Count() == 0
+		if (queued_free_pages(false) == 0
 				|| sUnreservedFreePages < (int32)sFreePagesTarget) {
 			continue;
 		}
@@ -1780,13 +2190,21 @@ page_scrubber(void *unused)
 		if (reserved == 0)
 			continue;
 
-		// get some pages from the free queue
+		// get some pages from the free queue of the next node that has any
 		ReadLocker locker(sFreePageQueuesLock);
 
+		VMPageQueue* freeQueue = NULL;
+		for (uint32 i = 0; i < sPageNodeCount; i++) {
+			freeQueue = &sPageNodes[nextNode].free_queue;
+			nextNode = (nextNode + 1) % sPageNodeCount;
+			if (freeQueue->Count() > 0)
+				break;
+		}
+
 		vm_page *page[SCRUB_SIZE];
 		int32 scrubCount = 0;
 		for (int32 i = 0; i < reserved; i++) {
-			page[i] = sFreePageQueue.RemoveHeadUnlocked();
+			page[i] = freeQueue->RemoveHeadUnlocked();
 			if (page[i] == NULL)
 				break;
 
@@ -1817,7 +2235,7 @@ page_scrubber(void *unused)
 			page[i]->SetState(PAGE_STATE_CLEAR);
 			page[i]->busy = false;
 			DEBUG_PAGE_ACCESS_END(page[i]);
-			sClearPageQueue.PrependUnlocked(page[i]);
+			free_queue_for_page(page[i], true).PrependUnlocked(page[i]);
 		}
 
 		locker.Unlock();
@@ -2595,7 +3013,7 @@ free_cached_pages(uint32 pagesToFree, bool dontWait)
 			ReadLocker locker(sFreePageQueuesLock);
 			page->SetState(PAGE_STATE_FREE);
 			DEBUG_PAGE_ACCESS_END(page);
-			sFreePageQueue.PrependUnlocked(page);
+			free_queue_for_page(page, false).PrependUnlocked(page);
 			locker.Unlock();
 
 			TA(StolenPage());
@@ -3006,11 +3424,20 @@ reserve_pages(uint32 count, int priority, bool dontWait)
 {
 	int32 dontTouch = kPageReserveForPriority[priority];
 
+	if (sUnsatisfiedPageReservations == 0
+		&& reserve_pages_from_cpu_cache(count, dontTouch)) {
+		return 0;
+	}
+
 	while (true) {
 		count -= reserve_some_pages(count, dontTouch);
 		if (count == 0)
 			return 0;
 
+		// get back the reservations the CPU caches are sitting on
+		if (flush_cached_page_reservations() > 0)
+			continue;
+
 		if (sUnsatisfiedPageReservations == 0) {
 			count -= free_cached_pages(count, dontWait);
 			if (count == 0)
@@ -3027,6 +3454,10 @@ reserve_pages(uint32 count, int priority, bool dontWait)
 		bool notifyDaemon = sUnsatisfiedPageReservations == 0;
 		sUnsatisfiedPageReservations += count;
 
+		// Now that no more reservations are cached, flush the caches once
+		// more to get the ones that were cached in the meantime.
+		flush_cached_page_reservations();
+
 		if (sUnreservedFreePages > dontTouch) {
 			// the situation changed
 			sUnsatisfiedPageReservations -= count;
@@ -3267,6 +3698,78 @@ vm_page_init_num_pages(kernel_args *args)
 }
 
 
+/*!	Sets up the NUMA nodes the free pages are distributed over from the
+	topology the boot loader found. Without one, all pages and CPUs belong
+	to node 0.
+*/
+static void
+init_page_nodes(kernel_args* args)
+{
+	sPageNodeCount = 1;
+	sPageNodeRangeCount = 0;
+
+	if (args->num_numa_nodes > 1 && args->num_numa_nodes <= MAX_NUMA_NODES
+		&& args->num_numa_memory_ranges <= MAX_NUMA_MEMORY_RANGES) {
+		sPageNodeCount = args->num_numa_nodes;
+
+		for (uint32 i = 0; i < args->num_numa_memory_ranges; i++) {
+			const numa_addr_range& range = args->numa_memory_range[i];
+			if (range.node >= sPageNodeCount)
+				continue;
+
+			page_node_range& pageRange = sPageNodeRanges[sPageNodeRangeCount++];
+			pageRange.start = range.start / B_PAGE_SIZE;
+			pageRange.end = (range.start + range.size) / B_PAGE_SIZE;
+			pageRange.node = range.node;
+		}
+
+		for (uint32 i = 0; i < args->num_cpus && i < MAX_BOOT_CPUS; i++) {
+			if (args->cpu_numa_node[i] < sPageNodeCount)
+				sCPUPageNode[i] = args->cpu_numa_node[i];
+		}
+	}
+
+	for (uint32 i = 0; i < sPageNodeCount; i++) {
+		page_node& node = sPageNodes[i];
+		snprintf(node.free_queue_name, sizeof(node.free_queue_name),
+			"node %" B_PRIu32 " free pages queue", i);
+		snprintf(node.clear_queue_name, sizeof(node.clear_queue_name),
+			"node %" B_PRIu32 " clear pages queue", i);
+		node.free_queue.Init(node.free_queue_name);
+		node.clear_queue.Init(node.clear_queue_name);
+		node.total_pages = 0;
+		node.remote_allocations = 0;
+
+		for (uint32 j = 0; j < sPageNodeCount; j++) {
+			node.distance[j] = sPageNodeCount > 1
+				? args->numa_distance[i][j] : 10;
+		}
+
+		// order the nodes by distance, this node always comes first
+		node.fallback[0] = i;
+		uint32 count = 1;
+		for (uint32 j = 0; j < sPageNodeCount; j++) {
+			if (j == i)
+				continue;
+
+			uint32 k = count++;
+			while (k > 1 && node.distance[node.fallback[k - 1]]
+					> node.distance[j]) {
+				node.fallback[k] = node.fallback[k - 1];
+				k--;
+			}
+			node.fallback[k] = j;
+		}
+	}
+
+	for (int32 i = 0; i < B_MAX_CPU_COUNT; i++)
+		sPageCPUCaches[i].node = sCPUPageNode[i];
+
+	if (sPageNodeCount > 1)
+		dprintf("vm_page_init: %" B_PRIu32 " NUMA nodes\n", sPageNodeCount);
+}
+
+
 status_t
 vm_page_init(kernel_args *args)
 {
@@ -3277,8 +3780,7 @@ vm_page_init(kernel_args *args)
 	sInactivePageQueue.Init("inactive pages queue");
 	sActivePageQueue.Init("active pages queue");
 	sCachedPageQueue.Init("cached pages queue");
-	sFreePageQueue.Init("free pages queue");
-	sClearPageQueue.Init("clear pages queue");
+	init_page_nodes(args);
 
 	new (&sPageReservationWaiters) PageReservationWaiterList;
 
@@ -3292,8 +3794,9 @@ vm_page_init(kernel_args *args)
 
 	// initialize the free page table
 	for (uint32 i = 0; i < sNumPages; i++) {
-		sPages[i].Init(sPhysicalPageOffset + i);
-		sFreePageQueue.Append(&sPages[i]);
+		sPages[i].Init(sPhysicalPageOffset + i,
+			find_page_node(sPhysicalPageOffset + i));
+		free_queue_for_page(&sPages[i], false).Append(&sPages[i]);
 
 #if VM_PAGE_ALLOCATION_TRACKING_AVAILABLE
 		sPages[i].allocation_tracking_info.Clear();
@@ -3316,6 +3819,10 @@ vm_page_init(kernel_args *args)
 		previousEnd = base + size;
 	}
 
+	// the pages that are left are those that actually exist
+	for (uint32 i = 0; i < sPageNodeCount; i++)
+		sPageNodes[i].total_pages = sPageNodes[i].free_queue.Count();
+
 	// mark the allocated physical page ranges wired
 	for (uint32 i = 0; i < args->num_physical_allocated_ranges; i++) {
 		mark_page_range_in_use(
@@ -3417,7 +3924,7 @@ status_t
 vm_page_init_post_thread(kernel_args *args)
 {
 	new (&sFreePageCondition) ConditionVariable;
-	sFreePageCondition.Publish(&sFreePageQueue, "free page");
+	sFreePageCondition.Publish(&sPageNodes, "free page");
 
 	// create a kernel thread to clear out pages
 
@@ -3529,44 +4036,38 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
-
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
+	bool clear = (flags & VM_PAGE_ALLOC_CLEAR) != 0;
 
 	ReadLocker locker(sFreePageQueuesLock);
 
-	vm_page* page = queue->RemoveHeadUnlocked();
-	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+	InterruptsLocker interruptsLocker;
+	vm_page* page = allocate_page_from_cpu_cache(clear);
+	interruptsLocker.Unlock();
 
-		if (page == NULL) {
-			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
-			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
+	if (page == NULL) {
+		// Unlikely, but possible: the page we have reserved is in another
+		// CPU's cache, or has moved between the queues after we checked
+		// the first queue. Grab the write locker to make sure this doesn't
+		// happen again.
+		locker.Unlock();
+		WriteLocker writeLocker(sFreePageQueuesLock);
+		drain_page_cpu_caches();
 
-			page = queue->RemoveHead();
+		page_node& localNode = sPageNodes[current_page_node()];
+		for (uint32 i = 0; i < sPageNodeCount && page == NULL; i++) {
+			page_node& node = sPageNodes[localNode.fallback[i]];
+			page = (clear ? node.clear_queue : node.free_queue).RemoveHead();
 			if (page == NULL)
-				otherQueue->RemoveHead();
-
-			if (page == NULL) {
-				panic("Had reserved page, but there is none!");
-				return NULL;
-			}
+				page = (clear ? node.free_queue : node.clear_queue).RemoveHead();
+		}
 
-			// downgrade to read lock
-			locker.Lock();
+		if (page == NULL) {
+			panic("Had reserved page, but there is none!");
+			return NULL;
 		}
+
+		// downgrade to read lock
+		locker.Lock();
 	}
 
 	if (page->CacheRef() != NULL)
@@ -3610,14 +4111,14 @@ allocate_page_run_cleanup(VMPageQueue::PageList& freePages,
 		page->busy = false;
 		page->SetState(PAGE_STATE_FREE);
 		DEBUG_PAGE_ACCESS_END(page);
-		sFreePageQueue.PrependUnlocked(page);
+		free_queue_for_page(page, false).PrependUnlocked(page);
 	}
 
 	while (vm_page* page = clearPages.RemoveHead()) {
 		page->busy = false;
 		page->SetState(PAGE_STATE_CLEAR);
 		DEBUG_PAGE_ACCESS_END(page);
-		sClearPageQueue.PrependUnlocked(page);
+		free_queue_for_page(page, true).PrependUnlocked(page);
 	}
 }
 
@@ -3664,12 +4165,12 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 		switch (page.State()) {
 			case PAGE_STATE_CLEAR:
 				DEBUG_PAGE_ACCESS_START(&page);
-				sClearPageQueue.Remove(&page);
+				free_queue_for_page(&page, true).Remove(&page);
 				clearPages.Add(&page);
 				break;
 			case PAGE_STATE_FREE:
 				DEBUG_PAGE_ACCESS_START(&page);
-				sFreePageQueue.Remove(&page);
+				free_queue_for_page(&page, false).Remove(&page);
 				freePages.Add(&page);
 				break;
 			case PAGE_STATE_CACHED:
@@ -3850,6 +4351,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 	vm_page_reserve_pages(&reservation, length, priority);
 
 	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
+	drain_page_cpu_caches();
 
 	// First we try to get a run with free pages only. If that fails, we also
 	// consider cached pages. If there are only few free pages and many cached
@@ -3915,6 +4417,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 			// apparently a cached page couldn't be allocated -- skip it and
 			// continue
 			freeClearQueueLocker.Lock();
+			drain_page_cpu_caches();
 		}
 
 		start += i + 1;
@@ -4053,7 +4556,8 @@ vm_page_num_available_pages(void)
 page_num_t
 vm_page_num_free_pages(void)
 {
-	int32 count = sUnreservedFreePages + sCachedPageQueue.Count();
+	int32 count = sUnreservedFreePages + cached_page_reservations()
+		+ sCachedPageQueue.Count();
 	return count > 0 ? count : 0;
 }
 
@@ -4061,7 +4565,7 @@ vm_page_num_free_pages(void)
 page_num_t
 vm_page_num_unused_pages(void)
 {
-	int32 count = sUnreservedFreePages;
+	int32 count = sUnreservedFreePages + cached_page_reservations();
 	return count > 0 ? count : 0;
 }
 
@@ -4097,8 +4601,8 @@ vm_page_get_stats(system_info *info)
 	//	active + inactive + unused + wired + modified + cached + free + clear
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
-	int32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+	int32 subtractPages = info->cached_pages + queued_free_pages(false)
+		+ queued_free_pages(true) + cached_free_pages();
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
@@ -4110,11 +4614,50 @@ vm_page_get_stats(system_info *info)
 
 	info->page_faults = vm_num_page_faults();
 	info->ignored_pages = sIgnoredPages;
+	info->large_pages = gLargeMappedPagesCount;
 
 	// TODO: We don't consider pages used for page directories/tables yet.
 }
 
 
+/*!	Fills in the NUMA topology and the per node memory usage. Like
+	vm_page_get_stats() this doesn't lock anything, the values are informal.
+*/
+void
+vm_page_get_numa_info(system_numa_info* info)
+{
+	memset(info, 0, sizeof(system_numa_info));
+
+	uint32 nodeCount = std::min(sPageNodeCount, (uint32)B_MAX_NUMA_NODES);
+	info->node_count = nodeCount;
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++)
+		info->cpu_node[i] = sCPUPageNode[i];
+
+	for (uint32 i = 0; i < nodeCount; i++) {
+		page_node& node = sPageNodes[i];
+		system_numa_node_info& nodeInfo = info->nodes[i];
+
+		page_num_t freePages = node.free_queue.Count()
+			+ node.clear_queue.Count();
+		for (int32 j = 0; j < cpuCount; j++) {
+			if (sPageCPUCaches[j].node == i) {
+				freePages += sPageCPUCaches[j].free_count
+					+ sPageCPUCaches[j].clear_count;
+			}
+		}
+
+		nodeInfo.total_memory = (uint64)node.total_pages * B_PAGE_SIZE;
+		nodeInfo.free_memory = (uint64)std::min(freePages, node.total_pages)
+			* B_PAGE_SIZE;
+		nodeInfo.remote_allocations = node.remote_allocations;
+		for (uint32 j = 0; j < nodeCount; j++)
+			nodeInfo.distance[j] = node.distance[j];
+	}
+}
+
+
 /*!	Returns the greatest address within the last page of accessible physical
 	memory.
 	The value is inclusive, i.e. in case of a 32 bit phys_addr_t 0xffffffff
@@ -15,10 +15,12 @@
 #include <errno_private.h>
 #include <syscalls.h>
 #include <syscall_utils.h>
+#include <vfs_defs.h>
 
 
 // TODO: think about adding special syscalls for the read/write/stat functions
-// to speed them up
+// to speed them up; fs_read_attrs() and friends should be used when several
+// attributes are needed at once
 
 
 static DIR *
@@ -99,6 +101,82 @@ fs_stat_attr(int fd, const char* attribute, struct attr_info* attrInfo)
 }
 
 
+/*!	Reads the attributes in \a vecs, MAX_ATTR_VECS per syscall. Returns the
+	number of attributes that could be read; the result of each one is in its
+	attr_vec::result.
+*/
+extern "C" ssize_t
+fs_read_attrs(int fd, attr_vec* vecs, size_t count)
+{
+	ssize_t total = 0;
+
+	while (count > 0) {
+		size_t chunk = min_c(count, MAX_ATTR_VECS);
+		ssize_t read = _kern_read_attrs(fd, vecs, chunk);
+		if (read < 0)
+			RETURN_AND_SET_ERRNO(read);
+
+		total += read;
+		vecs += chunk;
+		count -= chunk;
+	}
+
+	return total;
+}
+
+
+extern "C" ssize_t
+fs_write_attrs(int fd, attr_vec* vecs, size_t count)
+{
+	ssize_t total = 0;
+
+	while (count > 0) {
+		size_t chunk = min_c(count, MAX_ATTR_VECS);
+		ssize_t written = _kern_write_attrs(fd, vecs, chunk);
+		if (written < 0)
+			RETURN_AND_SET_ERRNO(written);
+
+		total += written;
+		vecs += chunk;
+		count -= chunk;
+	}
+
+	return total;
+}
+
+
+/*!	Reads the same \a count attributes from each of the \a nodes; \a vecs
+	must contain \a count attr_vecs per node.
+*/
+extern "C" ssize_t
+fs_read_node_attrs(dev_t device, const ino_t* nodes, size_t nodeCount,
+	attr_vec* vecs, size_t count)
+{
+	if (count > MAX_ATTR_VECS)
+		RETURN_AND_SET_ERRNO(B_BAD_VALUE);
+	if (count == 0)
+		return 0;
+
+	size_t nodesPerCall = MAX_ATTR_VECS / count;
+	ssize_t total = 0;
+
+	while (nodeCount > 0) {
+		size_t chunk = min_c(nodeCount, nodesPerCall);
+		ssize_t read = _kern_read_node_attrs(device, nodes, chunk, vecs,
+			count);
+		if (read < 0)
+			RETURN_AND_SET_ERRNO(read);
+
+		total += read;
+		nodes += chunk;
+		vecs += chunk * count;
+		nodeCount -= chunk;
+	}
+
+	return total;
+}
+
+
 int
 fs_open_attr(const char *path, const char *attribute, uint32 type, int openMode)
 {
@@ -0,0 +1,398 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+/*!	Models how the BFS BlockAllocator hands out blocks from its free extents,
+	the block bitmap, and the per-file reservation windows, and checks that
+	interleaving reservations, freed (pending) runs, extent invalidation, and
+	allocations never gives the same block to two files.
+*/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static const int32_t kNumBits = 256;
+static const int32_t kNumFiles = 4;
+static const int32_t kWindow = 16;
+static const int32_t kMaxPending = 1024;
+
+
+struct reservation {
+	int32_t	start;
+	int32_t	length;
+};
+
+struct pending_run {
+	int32_t	start;
+	int32_t	length;
+};
+
+static bool sUsed[kNumBits];
+	// the block bitmap
+static bool sSavedUsed[kNumBits];
+	// the block bitmap when the transaction started
+static int32_t sOwner[kNumBits];
+static int32_t sSavedOwner[kNumBits];
+static bool sInExtents[kNumBits];
+static bool sExtentsValid = true;
+static reservation sReservations[kNumFiles];
+static pending_run sPending[kMaxPending];
+static int32_t sPendingCount;
+static bool sInTransaction;
+static int32_t sFailures;
+
+
+static void
+check(bool condition, const char* message, int32_t step)
+{
+	if (condition)
+		return;
+
+	fprintf(stderr, "step %d: %s\n", (int)step, message);
+	sFailures++;
+}
+
+
+static void
+start_transaction()
+{
+	if (sInTransaction)
+		return;
+
+	memcpy(sSavedUsed, sUsed, sizeof(sUsed));
+	memcpy(sSavedOwner, sOwner, sizeof(sOwner));
+	sInTransaction = true;
+}
+
+
+static void
+invalidate_extents()
+{
+	memset(sInExtents, 0, sizeof(sInExtents));
+	sExtentsValid = false;
+}
+
+
+static void
+release_reservation(int32_t file)
+{
+	reservation& reservation = sReservations[file];
+	for (int32_t i = 0; i < reservation.length; i++) {
+		if (sExtentsValid)
+			sInExtents[reservation.start + i] = true;
+	}
+	reservation.length = 0;
+}
+
+
+static void
+release_reservations()
+{
+	for (int32_t file = 0; file < kNumFiles; file++)
+		release_reservation(file);
+}
+
+
+static void
+add_pending(int32_t start, int32_t length)
+{
+	start_transaction();
+	if (!sExtentsValid)
+		return;
+
+	if (sPendingCount == kMaxPending) {
+		release_reservations();
+		invalidate_extents();
+		return;
+	}
+
+	sPending[sPendingCount].start = start;
+	sPending[sPendingCount].length = length;
+	sPendingCount++;
+}
+
+
+static void
+transaction_done(bool success)
+{
+	if (!sInTransaction)
+		return;
+
+	if (!success) {
+		memcpy(sUsed, sSavedUsed, sizeof(sUsed));
+		memcpy(sOwner, sSavedOwner, sizeof(sOwner));
+	}
+
+	for (int32_t i = 0; i < sPendingCount; i++) {
+		for (int32_t bit = sPending[i].start;
+				bit < sPending[i].start + sPending[i].length; bit++) {
+			sInExtents[bit] = sExtentsValid && !sUsed[bit];
+		}
+	}
+
+	sPendingCount = 0;
+	sInTransaction = false;
+}
+
+
+/*!	Finds the largest free range, either in the extents, or in the bitmap. */
+static int32_t
+find_range(bool useExtents, int32_t maximum, int32_t& _start)
+{
+	int32_t bestStart = -1;
+	int32_t bestLength = -1;
+	int32_t start = -1;
+
+	for (int32_t bit = 0; bit <= kNumBits; bit++) {
+		bool free = bit < kNumBits
+			&& (useExtents ? sInExtents[bit] : !sUsed[bit]);
+		if (free) {
+			if (start < 0)
+				start = bit;
+			if (bit - start + 1 >= maximum) {
+				_start = start;
+				return maximum;
+			}
+			continue;
+		}
+
+		if (start >= 0 && bit - start > bestLength) {
+			bestStart = start;
+			bestLength = bit - start;
+		}
+		start = -1;
+	}
+
+	_start = bestStart;
+	return bestLength;
+}
+
+
+static void
+allocate_run(int32_t file, int32_t start, int32_t length)
+{
+	for (int32_t bit = start; bit < start + length; bit++) {
+		if (sUsed[bit]) {
+			fprintf(stderr, "block %d of file %d is already used by file "
+				"%d\n", (int)bit, (int)file, (int)sOwner[bit]);
+			sFailures++;
+		}
+		sUsed[bit] = true;
+		sOwner[bit] = file;
+		sInExtents[bit] = false;
+	}
+
+	add_pending(start, length);
+}
+
+
+/*!	Mirrors BlockAllocator::Allocate() and AllocateBlocks(). */
+static bool
+allocate(int32_t file, int32_t numBlocks)
+{
+	reservation& reservation = sReservations[file];
+
+	int32_t length = numBlocks < reservation.length
+		? numBlocks : reservation.length;
+	if (length > 0) {
+		for (int32_t bit = reservation.start;
+				bit < reservation.start + length; bit++) {
+			if (sUsed[bit]) {
+				// a bitmap scan handed out reserved blocks
+				reservation.length = 0;
+				length = 0;
+				break;
+			}
+		}
+	}
+
+	if (length > 0) {
+		allocate_run(file, reservation.start, length);
+		reservation.start += length;
+		reservation.length -= length;
+		return true;
+	}
+
+	release_reservation(file);
+
+	int32_t start;
+	int32_t bestLength = -1;
+	bool fromBitmap = !sExtentsValid;
+	if (sExtentsValid)
+		bestLength = find_range(true, numBlocks + kWindow, start);
+	if (bestLength < 1) {
+		release_reservations();
+		fromBitmap = true;
+		bestLength = find_range(false, numBlocks + kWindow, start);
+	} else if (fromBitmap)
+		release_reservations();
+
+	if (bestLength < 1)
+		return false;
+
+	int32_t freeLength = bestLength;
+	if (bestLength > numBlocks)
+		bestLength = numBlocks;
+
+	allocate_run(file, start, bestLength);
+
+	if (!fromBitmap && freeLength > bestLength) {
+		reservation.start = start + bestLength;
+		reservation.length = freeLength - bestLength;
+		if (reservation.length > kWindow)
+			reservation.length = kWindow;
+		for (int32_t bit = reservation.start;
+				bit < reservation.start + reservation.length; bit++) {
+			sInExtents[bit] = false;
+		}
+	}
+
+	return true;
+}
+
+
+static void
+free_blocks(int32_t file, int32_t count)
+{
+	for (int32_t bit = 0; bit < kNumBits && count > 0; bit++) {
+		if (!sUsed[bit] || sOwner[bit] != file)
+			continue;
+
+		sUsed[bit] = false;
+		sOwner[bit] = -1;
+		add_pending(bit, 1);
+		count--;
+	}
+}
+
+
+static void
+check_invariants(int32_t step)
+{
+	for (int32_t file = 0; file < kNumFiles; file++) {
+		const reservation& reservation = sReservations[file];
+		for (int32_t bit = reservation.start;
+				bit < reservation.start + reservation.length; bit++) {
+			check(!sInExtents[bit], "reserved block is in the extents", step);
+			check(!sSavedUsed[bit] || !sInTransaction,
+				"reserved block was freed by the running transaction", step);
+
+			for (int32_t other = 0; other < kNumFiles; other++) {
+				const struct reservation& otherReservation
+					= sReservations[other];
+				check(other == file || bit < otherReservation.start
+						|| bit >= otherReservation.start
+							+ otherReservation.length,
+					"block is reserved twice", step);
+			}
+		}
+	}
+
+	for (int32_t bit = 0; bit < kNumBits; bit++) {
+		check(!sInExtents[bit] || !sUsed[bit], "used block is in the extents",
+			step);
+	}
+}
+
+
+int
+main()
+{
+	for (int32_t bit = 0; bit < kNumBits; bit++) {
+		sInExtents[bit] = true;
+		sOwner[bit] = -1;
+	}
+
+	// file 0 gets a reservation, then the group stops tracking its extents,
+	// and file 1 allocates from the bitmap
+	allocate(0, 4);
+	check(sReservations[0].length == kWindow, "no reservation", 0);
+	transaction_done(true);
+
+	invalidate_extents();
+	allocate(1, 8);
+	check(sReservations[0].length == 0, "reservation survived", 1);
+	allocate(0, 4);
+	transaction_done(true);
+	check_invariants(2);
+
+	// blocks freed by a transaction must not end up in a reservation, even
+	// if the transaction is aborted
+	memset(sUsed, 0, sizeof(sUsed));
+	memset(sReservations, 0, sizeof(sReservations));
+	for (int32_t bit = 0; bit < kNumBits; bit++) {
+		sInExtents[bit] = false;
+		sUsed[bit] = true;
+		sOwner[bit] = 3;
+	}
+	sExtentsValid = true;
+
+	free_blocks(3, 32);
+	allocate(2, 4);
+	check(sReservations[2].length == 0, "reserved pending blocks", 3);
+	check_invariants(3);
+	transaction_done(false);
+	allocate(2, 4);
+	check_invariants(4);
+	transaction_done(true);
+
+	// random interleaving of all operations
+	memset(sUsed, 0, sizeof(sUsed));
+	memset(sReservations, 0, sizeof(sReservations));
+	for (int32_t bit = 0; bit < kNumBits; bit++) {
+		sInExtents[bit] = true;
+		sOwner[bit] = -1;
+	}
+	sExtentsValid = true;
+
+	srand(42);
+	for (int32_t step = 5; step < 100000; step++) {
+		int32_t file = rand() % kNumFiles;
+		switch (rand() % 8) {
+			case 0:
+			case 1:
+			case 2:
+				allocate(file, rand() % 8 + 1);
+				break;
+			case 3:
+			case 4:
+				free_blocks(file, rand() % 12 + 1);
+				break;
+			case 5:
+				transaction_done(rand() % 4 != 0);
+				break;
+			case 6:
+				if (rand() % 16 == 0)
+					invalidate_extents();
+				break;
+			case 7:
+				if (!sExtentsValid && !sInTransaction && rand() % 4 == 0) {
+					// rescan the group
+					release_reservations();
+					sExtentsValid = true;
+					for (int32_t bit = 0; bit < kNumBits; bit++)
+						sInExtents[bit] = !sUsed[bit];
+				} else
+					release_reservation(file);
+				break;
+		}
+
+		check_invariants(step);
+		if (sFailures > 10)
+			break;
+	}
+
+	if (sFailures != 0) {
+		printf("%d failures\n", (int)sFailures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+/*!	Checks the estimates, the plans, and the results of BFS queries that
+	combine two indices with && and ||, one of which was created after
+	some of the data had already been written, and therefore lacks those
+	entries.
+	Must be run on a BFS volume (\c /tmp by default).
+*/
+
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fs_attr.h>
+#include <fs_index.h>
+#include <fs_query.h>
+#include <StorageDefs.h>
+#include <SupportDefs.h>
+#include <TypeConstants.h>
+
+#include <query_private.h>
+
+
+static const char* kTestDirectory = "/tmp/query_planning_test";
+static const char* kIndexA = "test:query_plan_a";
+static const char* kIndexB = "test:query_plan_b";
+
+static const int32 kOldFiles = 40;
+	// files written before the index for kIndexB exists
+static const int32 kNewFiles = 10;
+static const int32 kFileCount = kOldFiles + kNewFiles;
+
+static dev_t sDevice;
+static int32 sFailures;
+
+
+static const char*
+value_b(int32 file)
+{
+	if (file < kOldFiles)
+		return file % 4 == 0 ? "x" : "y";
+	return file % 2 == 0 ? "x" : "y";
+}
+
+
+static void
+file_path(int32 file, char* path, size_t size)
+{
+	snprintf(path, size, "%s/file_%" B_PRId32, kTestDirectory, file);
+}
+
+
+static void
+remove_test_files()
+{
+	for (int32 file = 0; file < kFileCount; file++) {
+		char path[B_PATH_NAME_LENGTH];
+		file_path(file, path, sizeof(path));
+		unlink(path);
+	}
+	rmdir(kTestDirectory);
+
+	fs_remove_index(sDevice, kIndexA);
+	fs_remove_index(sDevice, kIndexB);
+}
+
+
+static void
+create_file(int32 file)
+{
+	char path[B_PATH_NAME_LENGTH];
+	file_path(file, path, sizeof(path));
+
+	int fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Creating \"%s\" failed: %s\n", path, strerror(errno));
+		remove_test_files();
+		exit(1);
+	}
+
+	int32 a = file;
+	const char* b = value_b(file);
+	if (fs_write_attr(fd, kIndexA, B_INT32_TYPE, 0, &a, sizeof(a))
+			!= sizeof(a)
+		|| fs_write_attr(fd, kIndexB, B_STRING_TYPE, 0, b, strlen(b) + 1)
+			!= (ssize_t)strlen(b) + 1) {
+		fprintf(stderr, "Writing the attributes of \"%s\" failed: %s\n", path,
+			strerror(errno));
+		close(fd);
+		remove_test_files();
+		exit(1);
+	}
+
+	close(fd);
+}
+
+
+/*!	Runs \a predicate, and checks that it returns exactly the files for
+	which \a expected is \c true, each of them once.
+*/
+static void
+test_query(const char* predicate, const bool* expected)
+{
+	int32 found[kFileCount];
+	memset(found, 0, sizeof(found));
+
+	DIR* query = fs_open_query(sDevice, predicate, 0);
+	if (query == NULL) {
+		fprintf(stderr, "%s: could not open query: %s\n", predicate,
+			strerror(errno));
+		sFailures++;
+		return;
+	}
+
+	while (struct dirent* dirent = fs_read_query(query)) {
+		int32 file;
+		if (sscanf(dirent->d_name, "file_%" B_SCNd32, &file) != 1
+			|| file < 0 || file >= kFileCount) {
+			fprintf(stderr, "%s: unexpected entry \"%s\"\n", predicate,
+				dirent->d_name);
+			sFailures++;
+			continue;
+		}
+		found[file]++;
+	}
+
+	fs_close_query(query);
+
+	for (int32 file = 0; file < kFileCount; file++) {
+		int32 count = expected[file] ? 1 : 0;
+		if (found[file] != count) {
+			fprintf(stderr, "%s: file_%" B_PRId32 " returned %" B_PRId32
+				" times, expected %" B_PRId32 "\n", predicate, file,
+				found[file], count);
+			sFailures++;
+		}
+	}
+}
+
+
+/*!	Checks that the plan of \a predicate contains all of the given lines,
+	which must be terminated by \c NULL.
+*/
+static void
+test_plan(const char* predicate, ...)
+{
+	char plan[4096];
+	plan[0] = '\0';
+
+	DIR* query = fs_open_query(sDevice, predicate, B_QUERY_EXPLAIN);
+	if (query == NULL) {
+		fprintf(stderr, "%s: could not explain query: %s\n", predicate,
+			strerror(errno));
+		sFailures++;
+		return;
+	}
+
+	while (struct dirent* dirent = fs_read_query(query)) {
+		strlcat(plan, dirent->d_name, sizeof(plan));
+		strlcat(plan, "\n", sizeof(plan));
+	}
+
+	fs_close_query(query);
+
+	va_list args;
+	va_start(args, predicate);
+	while (const char* line = va_arg(args, const char*)) {
+		if (strstr(plan, line) == NULL) {
+			fprintf(stderr, "%s: plan lacks \"%s\":\n%s", predicate, line,
+				plan);
+			sFailures++;
+		}
+	}
+	va_end(args);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	struct stat st;
+	if (stat("/tmp", &st) != 0) {
+		fprintf(stderr, "Could not stat /tmp: %s\n", strerror(errno));
+		return 1;
+	}
+	sDevice = st.st_dev;
+
+	remove_test_files();
+
+	if (mkdir(kTestDirectory, 0755) != 0
+		|| fs_create_index(sDevice, kIndexA, B_INT32_TYPE, 0) != 0) {
+		fprintf(stderr, "Preparing the test failed: %s\n", strerror(errno));
+		remove_test_files();
+		return 1;
+	}
+
+	for (int32 file = 0; file < kOldFiles; file++)
+		create_file(file);
+
+	// the index for kIndexB only contains the files written from now on
+	if (fs_create_index(sDevice, kIndexB, B_STRING_TYPE, 0) != 0) {
+		fprintf(stderr, "Creating index \"%s\" failed: %s\n", kIndexB,
+			strerror(errno));
+		remove_test_files();
+		return 1;
+	}
+
+	for (int32 file = kOldFiles; file < kFileCount; file++)
+		create_file(file);
+
+	// The estimates of unique keys are exact, as the indices fit into a
+	// single leaf; "test:query_plan_b" only has duplicates, whose number is
+	// estimated
+
+	test_plan("test:query_plan_a<2",
+		"1 scan(s)", "scan 1: index for \"test:query_plan_a\" < \"2\", "
+			"about 2 entries", NULL);
+	test_plan("test:query_plan_a>=45",
+		"scan 1: index for \"test:query_plan_a\" >= \"45\", about 5 entries",
+		NULL);
+	test_plan("test:query_plan_b==x",
+		"scan 1: index for \"test:query_plan_b\" == \"x\", about ", NULL);
+
+	// && only scans the side with fewer expected matches
+
+	test_plan("(test:query_plan_a>=41)&&(test:query_plan_b==x)",
+		"1 scan(s)", "scan 1: index for \"test:query_plan_b\"",
+		"match the remaining && terms", NULL);
+	test_plan("(test:query_plan_a<2)&&(test:query_plan_b==x)",
+		"1 scan(s)", "scan 1: index for \"test:query_plan_a\"",
+		"match the remaining && terms", NULL);
+
+	// || scans both sides
+
+	test_plan("(test:query_plan_a<2)||(test:query_plan_b==x)",
+		"2 scan(s)", "skip the entries of earlier scans", NULL);
+
+	bool expected[kFileCount];
+
+	// Only the entries of the scanned index can be found, but those must
+	// not be ruled out by the other index, which lacks the old files
+
+	for (int32 file = 0; file < kFileCount; file++) {
+		// files from 41 on are all in the index for kIndexB
+		expected[file] = file >= 41 && !strcmp(value_b(file), "x");
+	}
+	test_query("(test:query_plan_a>=41)&&(test:query_plan_b==x)", expected);
+
+	for (int32 file = 0; file < kFileCount; file++)
+		expected[file] = file < 2 && !strcmp(value_b(file), "x");
+	test_query("(test:query_plan_a<2)&&(test:query_plan_b==x)", expected);
+	test_query("(test:query_plan_b==x)&&(test:query_plan_a<2)", expected);
+
+	// Every entry is returned once, even if an earlier scan would have
+	// matched it, but did not see it because it is not in its index
+
+	for (int32 file = 0; file < kFileCount; file++) {
+		expected[file] = file < 2
+			|| (file >= kOldFiles && !strcmp(value_b(file), "x"));
+	}
+	test_query("(test:query_plan_a<2)||(test:query_plan_b==x)", expected);
+	test_query("(test:query_plan_b==x)||(test:query_plan_a<2)", expected);
+
+	remove_test_files();
+
+	if (sFailures != 0) {
+		printf("%" B_PRId32 " failures\n", sFailures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures the receive path of the stack over the loopback device: every
+	flow has a sender that floods small UDP datagrams at a receiver socket on
+	127.0.0.1, and the rate at which they arrive is reported. Run it before
+	and after a change to the receive path to compare the packet rates.
+*/
+
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define MAX_FLOWS			16
+#define DEFAULT_DURATION	2000000
+#define DEFAULT_SIZE		64
+
+
+struct flow_data {
+	int			receiver;
+	int			sender;
+	sockaddr_in	address;
+	int64		sent;
+	int64		received;
+};
+
+static vint32 sStop;
+static size_t sPacketSize = DEFAULT_SIZE;
+
+
+static status_t
+sender_thread(void* _data)
+{
+	flow_data* data = (flow_data*)_data;
+	char buffer[65536];
+	memset(buffer, 'x', sPacketSize);
+
+	int64 sent = 0;
+	while (sStop == 0) {
+		if (sendto(data->sender, buffer, sPacketSize, 0,
+				(sockaddr*)&data->address, sizeof(data->address)) >= 0)
+			sent++;
+		else if (errno != ENOBUFS && errno != B_WOULD_BLOCK)
+			break;
+	}
+
+	data->sent = sent;
+	return B_OK;
+}
+
+
+static status_t
+receiver_thread(void* _data)
+{
+	flow_data* data = (flow_data*)_data;
+	char buffer[65536];
+
+	int64 received = 0;
+	while (true) {
+		ssize_t bytes = recv(data->receiver, buffer, sizeof(buffer), 0);
+		if (bytes < 0) {
+			// the timeout is only hit once the senders are done
+			if (sStop != 0)
+				break;
+			continue;
+		}
+
+		received++;
+	}
+
+	data->received = received;
+	return B_OK;
+}
+
+
+static bool
+open_flow(flow_data& data)
+{
+	data.sent = 0;
+	data.received = 0;
+
+	data.receiver = socket(AF_INET, SOCK_DGRAM, 0);
+	data.sender = socket(AF_INET, SOCK_DGRAM, 0);
+	if (data.receiver < 0 || data.sender < 0)
+		return false;
+
+	memset(&data.address, 0, sizeof(data.address));
+	data.address.sin_len = sizeof(sockaddr_in);
+	data.address.sin_family = AF_INET;
+	data.address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(data.receiver, (sockaddr*)&data.address, sizeof(data.address))
+			!= 0)
+		return false;
+
+	socklen_t length = sizeof(data.address);
+	if (getsockname(data.receiver, (sockaddr*)&data.address, &length) != 0)
+		return false;
+
+	int size = 1024 * 1024;
+	setsockopt(data.receiver, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	struct timeval timeout = {0, 100000};
+	setsockopt(data.receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+		sizeof(timeout));
+	return true;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 flowCount = 1;
+	if (argc > 1)
+		flowCount = atol(argv[1]);
+	if (flowCount < 1 || flowCount > MAX_FLOWS) {
+		fprintf(stderr, "usage: %s [flows (1-%d)] [duration (us)] "
+			"[packet size]\n", argv[0], MAX_FLOWS);
+		return 1;
+	}
+
+	bigtime_t duration = DEFAULT_DURATION;
+	if (argc > 2)
+		duration = atoll(argv[2]);
+	if (argc > 3)
+		sPacketSize = min_c(max_c(atol(argv[3]), 1), 65000);
+
+	flow_data flows[MAX_FLOWS];
+	thread_id senders[MAX_FLOWS];
+	thread_id receivers[MAX_FLOWS];
+
+	for (int32 i = 0; i < flowCount; i++) {
+		if (!open_flow(flows[i])) {
+			fprintf(stderr, "%s: could not open socket: %s\n", argv[0],
+				strerror(errno));
+			return 1;
+		}
+	}
+
+	sStop = 0;
+
+	for (int32 i = 0; i < flowCount; i++) {
+		receivers[i] = spawn_thread(receiver_thread, "receiver",
+			B_NORMAL_PRIORITY, &flows[i]);
+		resume_thread(receivers[i]);
+	}
+
+	bigtime_t startTime = system_time();
+
+	for (int32 i = 0; i < flowCount; i++) {
+		senders[i] = spawn_thread(sender_thread, "sender", B_NORMAL_PRIORITY,
+			&flows[i]);
+		resume_thread(senders[i]);
+	}
+
+	snooze(duration);
+	atomic_set(&sStop, 1);
+
+	bigtime_t elapsed = system_time() - startTime;
+
+	int64 sent = 0;
+	int64 received = 0;
+	for (int32 i = 0; i < flowCount; i++) {
+		status_t status;
+		wait_for_thread(senders[i], &status);
+		wait_for_thread(receivers[i], &status);
+
+		sent += flows[i].sent;
+		received += flows[i].received;
+
+		close(flows[i].sender);
+		close(flows[i].receiver);
+	}
+
+	printf("%" B_PRId32 " flows, %" B_PRIuSIZE " bytes per packet, %" B_PRId64
+		" us\n", flowCount, sPacketSize, elapsed);
+	printf("sent:     %12" B_PRId64 " packets, %10.0f packets/s\n", sent,
+		sent * 1000000.0 / elapsed);
+	printf("received: %12" B_PRId64 " packets, %10.0f packets/s\n", received,
+		received * 1000000.0 / elapsed);
+	if (sent > 0) {
+		printf("lost:     %12" B_PRId64 " packets, %9.2f %%\n",
+			sent - received, (sent - received) * 100.0 / sent);
+	}
+
+	if (received == 0) {
+		fprintf(stderr, "No packets were received!\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Tests sendfile() over TCP and unix domain sockets: the offset handling,
+	clamping at the end of the file, partial sends on non-blocking sockets,
+	and the rejection of file descriptors that are not regular files.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+static const size_t kFileSize = 600 * 1024 + 123;
+	// more than two of the chunks the kernel maps at once, and not page
+	// aligned
+
+static int sFailures;
+
+
+#define CHECK(condition, ...)								\
+	do {													\
+		if (!(condition)) {									\
+			fprintf(stderr, "%s:%d: ", __func__, __LINE__);	\
+			fprintf(stderr, __VA_ARGS__);					\
+			fputc('\n', stderr);							\
+			sFailures++;									\
+		}													\
+	} while (false)
+
+
+struct receive_data {
+	int		socket;
+	off_t	offset;
+	size_t	count;
+	bool	matches;
+};
+
+
+static uint8_t
+file_byte(off_t offset)
+{
+	return (uint8_t)(offset * 13 + offset / 4096);
+}
+
+
+static int
+create_file()
+{
+	char path[] = "/tmp/sendfile_test.XXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		fprintf(stderr, "Creating the test file failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+	unlink(path);
+
+	uint8_t buffer[4096];
+	for (size_t offset = 0; offset < kFileSize; offset += sizeof(buffer)) {
+		size_t length = kFileSize - offset;
+		if (length > sizeof(buffer))
+			length = sizeof(buffer);
+		for (size_t i = 0; i < length; i++)
+			buffer[i] = file_byte(offset + i);
+
+		if (write(fd, buffer, length) != (ssize_t)length) {
+			fprintf(stderr, "Writing the test file failed: %s\n",
+				strerror(errno));
+			exit(1);
+		}
+	}
+
+	lseek(fd, 0, SEEK_SET);
+	return fd;
+}
+
+
+static void
+create_tcp_sockets(int& sender, int& receiver)
+{
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener < 0) {
+		fprintf(stderr, "Creating the listener socket failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addressLength = sizeof(address);
+
+	sender = socket(AF_INET, SOCK_STREAM, 0);
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0
+		|| getsockname(listener, (sockaddr*)&address, &addressLength) != 0
+		|| listen(listener, 1) != 0
+		|| sender < 0
+		|| connect(sender, (sockaddr*)&address, sizeof(address)) != 0
+		|| (receiver = accept(listener, NULL, NULL)) < 0) {
+		fprintf(stderr, "Connecting the TCP sockets failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+
+	close(listener);
+}
+
+
+static void
+create_unix_sockets(int& sender, int& receiver)
+{
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+		fprintf(stderr, "Creating the unix sockets failed: %s\n",
+			strerror(errno));
+		exit(1);
+	}
+
+	sender = sockets[0];
+	receiver = sockets[1];
+}
+
+
+/*!	Receives \a count bytes from \a socket, and checks that they match the
+	file contents at \a offset.
+*/
+static bool
+receive_and_compare(int socket, off_t offset, size_t count)
+{
+	bool matches = true;
+	uint8_t buffer[4096];
+
+	while (count > 0) {
+		size_t length = count < sizeof(buffer) ? count : sizeof(buffer);
+		ssize_t bytesRead = recv(socket, buffer, length, 0);
+		if (bytesRead <= 0) {
+			fprintf(stderr, "Receiving failed: %s\n",
+				bytesRead < 0 ? strerror(errno) : "connection closed");
+			return false;
+		}
+
+		for (ssize_t i = 0; i < bytesRead; i++) {
+			if (buffer[i] != file_byte(offset + i))
+				matches = false;
+		}
+
+		offset += bytesRead;
+		count -= bytesRead;
+	}
+
+	return matches;
+}
+
+
+static void*
+receive_thread(void* _data)
+{
+	receive_data* data = (receive_data*)_data;
+	data->matches = receive_and_compare(data->socket, data->offset,
+		data->count);
+	return NULL;
+}
+
+
+static void
+test_offsets(const char* type, int sender, int receiver, int file)
+{
+	// an explicit offset is updated, but the file position is not
+	lseek(file, 17, SEEK_SET);
+	off_t offset = 1000;
+	ssize_t bytesSent = sendfile(sender, file, &offset, 5000);
+	CHECK(bytesSent == 5000, "%s: sent %zd bytes", type, bytesSent);
+	CHECK(offset == 6000, "%s: offset is %lld", type, (long long)offset);
+	CHECK(lseek(file, 0, SEEK_CUR) == 17, "%s: file position changed", type);
+	CHECK(receive_and_compare(receiver, 1000, 5000),
+		"%s: received wrong data", type);
+
+	// without an offset, the file position is used, and advanced
+	bytesSent = sendfile(sender, file, NULL, 3000);
+	CHECK(bytesSent == 3000, "%s: sent %zd bytes", type, bytesSent);
+	CHECK(lseek(file, 0, SEEK_CUR) == 3017,
+		"%s: file position not advanced", type);
+	CHECK(receive_and_compare(receiver, 17, 3000),
+		"%s: received wrong data", type);
+
+	// the count is clamped at the end of the file
+	offset = kFileSize - 100;
+	bytesSent = sendfile(sender, file, &offset, 1000);
+	CHECK(bytesSent == 100, "%s: sent %zd bytes at the end", type,
+		bytesSent);
+	CHECK(offset == (off_t)kFileSize, "%s: offset is %lld", type,
+		(long long)offset);
+	CHECK(receive_and_compare(receiver, kFileSize - 100, 100),
+		"%s: received wrong data", type);
+
+	bytesSent = sendfile(sender, file, &offset, 1000);
+	CHECK(bytesSent == 0, "%s: sent %zd bytes after the end", type,
+		bytesSent);
+	CHECK(offset == (off_t)kFileSize, "%s: offset is %lld", type,
+		(long long)offset);
+
+	lseek(file, kFileSize - 10, SEEK_SET);
+	bytesSent = sendfile(sender, file, NULL, 1000);
+	CHECK(bytesSent == 10, "%s: sent %zd bytes at the end", type, bytesSent);
+	CHECK(lseek(file, 0, SEEK_CUR) == (off_t)kFileSize,
+		"%s: file position not at the end", type);
+	CHECK(receive_and_compare(receiver, kFileSize - 10, 10),
+		"%s: received wrong data", type);
+
+	// the whole file, in more than one chunk, while the other side reads
+	receive_data data = {receiver, 0, kFileSize, false};
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, receive_thread, &data) != 0) {
+		fprintf(stderr, "Creating the receive thread failed\n");
+		exit(1);
+	}
+
+	offset = 0;
+	size_t total = 0;
+	while (total < kFileSize) {
+		bytesSent = sendfile(sender, file, &offset, kFileSize - total);
+		if (bytesSent <= 0) {
+			CHECK(false, "%s: sending the file failed: %s", type,
+				bytesSent < 0 ? strerror(errno) : "nothing sent");
+			shutdown(sender, SHUT_WR);
+			break;
+		}
+		total += bytesSent;
+		CHECK(offset == (off_t)total, "%s: offset is %lld", type,
+			(long long)offset);
+	}
+
+	pthread_join(thread, NULL);
+	CHECK(data.matches, "%s: received wrong data", type);
+}
+
+
+static void
+test_non_blocking(const char* type, int sender, int receiver, int file)
+{
+	// nobody reads, so the socket buffers fill up before the file is sent
+	int bufferSize = 32768;
+	setsockopt(sender, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(int));
+	setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(int));
+	fcntl(sender, F_SETFL, fcntl(sender, F_GETFL) | O_NONBLOCK);
+
+	off_t offset = 0;
+	ssize_t bytesSent = sendfile(sender, file, &offset, kFileSize);
+	CHECK(bytesSent > 0 && (size_t)bytesSent < kFileSize,
+		"%s: non-blocking send of %zu bytes sent %zd", type, kFileSize,
+		bytesSent);
+	CHECK(offset == (bytesSent > 0 ? bytesSent : 0),
+		"%s: offset is %lld", type, (long long)offset);
+
+	off_t previousOffset = offset;
+	ssize_t result = sendfile(sender, file, &offset, kFileSize);
+	CHECK(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK),
+		"%s: sending to a full socket returned %zd", type, result);
+	CHECK(offset == previousOffset, "%s: offset changed to %lld", type,
+		(long long)offset);
+
+	if (bytesSent > 0) {
+		CHECK(receive_and_compare(receiver, 0, bytesSent),
+			"%s: received wrong data", type);
+	}
+
+	fcntl(sender, F_SETFL, fcntl(sender, F_GETFL) & ~O_NONBLOCK);
+}
+
+
+static void
+test_invalid_files(int sender)
+{
+	int pipes[2];
+	if (pipe(pipes) != 0) {
+		fprintf(stderr, "Creating a pipe failed: %s\n", strerror(errno));
+		exit(1);
+	}
+	write(pipes[1], "data", 4);
+
+	ssize_t result = sendfile(sender, pipes[0], NULL, 4);
+	CHECK(result < 0 && errno == EINVAL, "pipe: returned %zd (%s)", result,
+		strerror(errno));
+
+	result = sendfile(sender, sender, NULL, 4);
+	CHECK(result < 0 && errno == EINVAL, "socket: returned %zd (%s)", result,
+		strerror(errno));
+
+	close(pipes[0]);
+	close(pipes[1]);
+
+	result = sendfile(sender, pipes[0], NULL, 4);
+	CHECK(result < 0 && errno == EBADF, "closed file: returned %zd (%s)",
+		result, strerror(errno));
+}
+
+
+int
+main()
+{
+	int file = create_file();
+	int sender;
+	int receiver;
+
+	create_tcp_sockets(sender, receiver);
+	test_offsets("TCP", sender, receiver, file);
+	test_invalid_files(sender);
+	test_non_blocking("TCP", sender, receiver, file);
+	close(sender);
+	close(receiver);
+
+	create_unix_sockets(sender, receiver);
+	test_offsets("unix", sender, receiver, file);
+	test_non_blocking("unix", sender, receiver, file);
+	close(sender);
+	close(receiver);
+
+	close(file);
+
+	if (sFailures != 0) {
+		printf("%d failures\n", sFailures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
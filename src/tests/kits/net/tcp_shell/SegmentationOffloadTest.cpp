@@ -0,0 +1,344 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Feeds TCP super segments through the software offloading of the
+	ethernet_frame datalink protocol, and checks the segments it sends:
+	their number and sizes, the IP length, ID, and checksum, the TCP
+	sequence number (wrapping around within the super segment), which
+	segments keep the FIN, PSH, and CWR flags, the TCP checksum, and the
+	payload. A buffer that only asks for the checksum is checked as well.
+*/
+
+
+#include <ethernet.h>
+#include <net_buffer.h>
+#include <net_datalink.h>
+#include <net_datalink_protocol.h>
+#include <net_device.h>
+
+#include <net/if_dl.h>
+#include <net/if_types.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <stdio.h>
+#include <string.h>
+
+
+extern "C" status_t _add_builtin_module(module_info *info);
+
+extern struct net_buffer_module_info gNetBufferModule;
+	// from net_buffer.cpp
+extern struct net_buffer_module_info* gBufferModule;
+	// from ethernet_frame.cpp
+
+status_t ethernet_frame_send_data(net_datalink_protocol* protocol,
+	net_buffer* buffer);
+
+
+static const uint32 kMaxSegments = 16;
+
+static const uint32 kIPHeaderLength = 20;
+static const uint32 kTCPHeaderLength = 32;
+	// with 12 bytes of options
+static const uint32 kHeaderLength = ETHER_HEADER_LENGTH + kIPHeaderLength
+	+ kTCPHeaderLength;
+
+static const uint32 kSequence = 0xfffff000;
+	// wraps around within the super segment
+static const uint16 kPacketID = 0xfffe;
+static const uint8 kFlagFinish = 0x01;
+static const uint8 kFlagPush = 0x08;
+static const uint8 kFlagAcknowledge = 0x10;
+static const uint8 kFlagCongestionWindowReduced = 0x80;
+
+static const uint8 kSourceAddress[ETHER_ADDRESS_LENGTH]
+	= {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static const uint8 kDestinationAddress[ETHER_ADDRESS_LENGTH]
+	= {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+
+static net_buffer* sSegments[kMaxSegments];
+static uint32 sSegmentCount;
+static int32 sFailures;
+
+
+static void
+check(bool condition, const char* test, uint32 segment, const char* message)
+{
+	if (condition)
+		return;
+
+	printf("%s, segment %" B_PRIu32 ": %s\n", test, segment, message);
+	sFailures++;
+}
+
+
+static status_t
+capture_send_data(net_datalink_protocol* protocol, net_buffer* buffer)
+{
+	if (sSegmentCount == kMaxSegments)
+		return B_NO_MEMORY;
+
+	sSegments[sSegmentCount++] = buffer;
+	return B_OK;
+}
+
+
+/*!	Returns the one's complement sum of \a length bytes of \a data, added to
+	\a sum.
+*/
+static uint32
+add_to_sum(uint32 sum, const uint8* data, uint32 length)
+{
+	for (uint32 i = 0; i + 1 < length; i += 2)
+		sum += (data[i] << 8) | data[i + 1];
+	if ((length & 1) != 0)
+		sum += data[length - 1] << 8;
+
+	return sum;
+}
+
+
+static uint16
+fold_sum(uint32 sum)
+{
+	while ((sum >> 16) != 0)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return sum;
+}
+
+
+static uint8
+payload_byte(uint32 offset)
+{
+	return (offset * 7 + 3) & 0xff;
+}
+
+
+/*!	Creates an IPv4/TCP buffer the way TCP and IPv4 leave it for the
+	framing: with the pseudo header sum in the TCP checksum field, and the
+	given offloading still to be done.
+*/
+static net_buffer*
+create_buffer(uint32 payload, uint8 flags, uint8 offload, uint16 segmentSize)
+{
+	net_buffer* buffer = gBufferModule->create(256);
+	if (buffer == NULL)
+		return NULL;
+
+	uint8 header[kIPHeaderLength + kTCPHeaderLength];
+	memset(header, 0, sizeof(header));
+
+	struct ip& ipHeader = *(struct ip*)header;
+	ipHeader.ip_v = IPVERSION;
+	ipHeader.ip_hl = kIPHeaderLength / 4;
+	ipHeader.ip_len = htons(sizeof(header) + payload);
+	ipHeader.ip_id = htons(kPacketID);
+	ipHeader.ip_ttl = 64;
+	ipHeader.ip_p = IPPROTO_TCP;
+	ipHeader.ip_src.s_addr = htonl(0xc0a80001);
+	ipHeader.ip_dst.s_addr = htonl(0xc0a80002);
+	ipHeader.ip_sum = htons((uint16)~fold_sum(add_to_sum(0, header,
+		kIPHeaderLength)));
+
+	uint8* tcpHeader = header + kIPHeaderLength;
+	tcpHeader[0] = 0x12;
+	tcpHeader[1] = 0x34;
+	tcpHeader[2] = 0x56;
+	tcpHeader[3] = 0x78;
+	*(uint32*)&tcpHeader[4] = htonl(kSequence);
+	*(uint32*)&tcpHeader[8] = htonl(0x01020304);
+	tcpHeader[12] = (kTCPHeaderLength / 4) << 4;
+	tcpHeader[13] = flags;
+	tcpHeader[14] = 0xff;
+	tcpHeader[15] = 0xff;
+	for (uint32 i = 20; i < kTCPHeaderLength; i++)
+		tcpHeader[i] = 1;
+			// NOP options
+
+	uint32 sum = add_to_sum(0, (uint8*)&ipHeader.ip_src, 8);
+	sum += IPPROTO_TCP;
+	*(uint16*)&tcpHeader[16] = htons(fold_sum(sum));
+
+	uint8 data[4096];
+	for (uint32 offset = 0; offset < payload; offset += sizeof(data)) {
+		uint32 length = payload - offset;
+		if (length > sizeof(data))
+			length = sizeof(data);
+		for (uint32 i = 0; i < length; i++)
+			data[i] = payload_byte(offset + i);
+
+		if (gBufferModule->append(buffer, data, length) != B_OK) {
+			gBufferModule->free(buffer);
+			return NULL;
+		}
+	}
+
+	if (gBufferModule->prepend(buffer, header, sizeof(header)) != B_OK) {
+		gBufferModule->free(buffer);
+		return NULL;
+	}
+
+	sockaddr_dl& source = *(sockaddr_dl*)buffer->source;
+	memset(&source, 0, sizeof(sockaddr_dl));
+	source.sdl_len = sizeof(sockaddr_dl);
+	source.sdl_family = AF_LINK;
+	source.sdl_type = IFT_ETHER;
+	source.sdl_e_type = htons(ETHER_TYPE_IP);
+	source.sdl_alen = ETHER_ADDRESS_LENGTH;
+	memcpy(LLADDR(&source), kSourceAddress, ETHER_ADDRESS_LENGTH);
+
+	sockaddr_dl& destination = *(sockaddr_dl*)buffer->destination;
+	memcpy(&destination, &source, sizeof(sockaddr_dl));
+	memcpy(LLADDR(&destination), kDestinationAddress, ETHER_ADDRESS_LENGTH);
+
+	buffer->offload = offload;
+	buffer->segment_size = segmentSize;
+	return buffer;
+}
+
+
+/*!	Sends a buffer with \a payload bytes through the framing, and checks
+	that it arrives as segments of at most \a segmentSize bytes, with valid
+	headers and checksums.
+*/
+static void
+test_offload(const char* test, uint32 payload, uint8 flags, uint8 offload,
+	uint16 segmentSize)
+{
+	net_device device;
+	memset(&device, 0, sizeof(device));
+	net_interface interface;
+	memset(&interface, 0, sizeof(interface));
+	interface.device = &device;
+
+	net_datalink_protocol_module_info captureModule;
+	memset(&captureModule, 0, sizeof(captureModule));
+	captureModule.send_data = capture_send_data;
+
+	net_datalink_protocol capture;
+	memset(&capture, 0, sizeof(capture));
+	capture.module = &captureModule;
+	capture.interface = &interface;
+
+	net_datalink_protocol protocol;
+	memset(&protocol, 0, sizeof(protocol));
+	protocol.next = &capture;
+	protocol.interface = &interface;
+
+	net_buffer* buffer = create_buffer(payload, flags, offload, segmentSize);
+	if (buffer == NULL) {
+		printf("%s: creating the buffer failed\n", test);
+		sFailures++;
+		return;
+	}
+
+	sSegmentCount = 0;
+	status_t status = ethernet_frame_send_data(&protocol, buffer);
+	if (status != B_OK) {
+		printf("%s: sending failed: %s\n", test, strerror(status));
+		sFailures++;
+		gBufferModule->free(buffer);
+	}
+
+	uint32 segmentCount = segmentSize != 0
+		? (payload + segmentSize - 1) / segmentSize : 1;
+	check(sSegmentCount == segmentCount, test, sSegmentCount,
+		"unexpected number of segments");
+
+	uint32 offset = 0;
+	for (uint32 i = 0; i < sSegmentCount; i++) {
+		net_buffer* segment = sSegments[i];
+		uint32 length = segment->size - kHeaderLength;
+
+		uint8 frame[kHeaderLength + 2048];
+		if (segment->size < kHeaderLength || segment->size > sizeof(frame)
+			|| gBufferModule->read(segment, 0, frame, segment->size) != B_OK) {
+			check(false, test, i, "invalid segment size");
+			gBufferModule->free(segment);
+			continue;
+		}
+
+		check(segment->offload == 0, test, i, "offloading left to do");
+		check(segmentSize == 0 || length <= segmentSize, test, i,
+			"segment too large");
+		check(i + 1 == sSegmentCount || length == segmentSize, test, i,
+			"segment too small");
+
+		const ether_header& ether = *(ether_header*)frame;
+		check(ether.type == htons(ETHER_TYPE_IP)
+			&& !memcmp(ether.source, kSourceAddress, ETHER_ADDRESS_LENGTH)
+			&& !memcmp(ether.destination, kDestinationAddress,
+				ETHER_ADDRESS_LENGTH), test, i, "wrong ethernet header");
+
+		const uint8* ipHeader = frame + ETHER_HEADER_LENGTH;
+		const struct ip& ip = *(const struct ip*)ipHeader;
+		check(ntohs(ip.ip_len) == kIPHeaderLength + kTCPHeaderLength + length,
+			test, i, "wrong IP length");
+		check(ntohs(ip.ip_id) == (uint16)(kPacketID + i), test, i,
+			"wrong IP ID");
+		check(fold_sum(add_to_sum(0, ipHeader, kIPHeaderLength)) == 0xffff,
+			test, i, "wrong IP checksum");
+
+		const uint8* tcpHeader = ipHeader + kIPHeaderLength;
+		check(ntohl(*(uint32*)&tcpHeader[4]) == (uint32)(kSequence + offset),
+			test, i, "wrong sequence");
+
+		uint8 expectedFlags = flags;
+		if (i > 0)
+			expectedFlags &= ~kFlagCongestionWindowReduced;
+		if (i + 1 < sSegmentCount)
+			expectedFlags &= ~(kFlagFinish | kFlagPush);
+		check(tcpHeader[13] == expectedFlags, test, i, "wrong flags");
+
+		uint32 tcpLength = kTCPHeaderLength + length;
+		uint32 sum = add_to_sum(0, (const uint8*)&ip.ip_src, 8);
+		sum += IPPROTO_TCP + tcpLength;
+		sum = add_to_sum(sum, tcpHeader, tcpLength);
+		check(fold_sum(sum) == 0xffff, test, i, "wrong TCP checksum");
+
+		bool payloadMatches = true;
+		for (uint32 j = 0; j < length; j++) {
+			if (tcpHeader[kTCPHeaderLength + j] != payload_byte(offset + j))
+				payloadMatches = false;
+		}
+		check(payloadMatches, test, i, "wrong payload");
+
+		offset += length;
+		gBufferModule->free(segment);
+	}
+
+	check(offset == payload, test, sSegmentCount, "payload incomplete");
+}
+
+
+int
+main()
+{
+	_add_builtin_module((module_info*)&gNetBufferModule);
+	get_module(NET_BUFFER_MODULE_NAME, (module_info**)&gBufferModule);
+
+	const uint8 flags = kFlagAcknowledge | kFlagPush | kFlagFinish
+		| kFlagCongestionWindowReduced;
+	const uint8 offload = NET_OFFLOAD_TCP_CHECKSUM
+		| NET_OFFLOAD_TCP_SEGMENTATION;
+
+	test_offload("uneven super segment", 4000, flags, offload, 1448);
+	test_offload("even super segment", 4 * 1448, flags, offload, 1448);
+	test_offload("odd segment size", 3001, kFlagAcknowledge, offload, 999);
+	test_offload("single segment", 1000, flags, offload, 1448);
+	test_offload("checksum only", 1001, flags, NET_OFFLOAD_TCP_CHECKSUM, 0);
+
+	put_module(NET_BUFFER_MODULE_NAME);
+
+	if (sFailures != 0) {
+		printf("%" B_PRId32 " failures\n", sFailures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -30,6 +30,7 @@
 
 #include <ctype.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <new>
 #include <set>
 #include <stdio.h>
@@ -98,6 +99,10 @@ static set<uint32> sReorderList;
 static bool sSimultaneousConnect = false;
 static bool sSimultaneousClose = false;
 static bool sServerActiveClose = false;
+static bool sVerifyTransfer = false;
+static sem_id sTransferDone = -1;
+static size_t sBytesReceived;
+static bool sPatternMismatch;
 
 static struct net_domain sDomain = {
 	"ipv4",
@@ -919,7 +924,7 @@ domain_receive_data(net_buffer *buffer)
 
 	bool drop = false;
 	if (sDropList.find(packetNumber) != sDropList.end()
-		|| (sRandomDrop > 0.0 && (1.0 * rand() / RAND_MAX) > sRandomDrop))
+		|| (sRandomDrop > 0.0 && (1.0 * rand() / RAND_MAX) < sRandomDrop))
 		drop = true;
 
 	if (!drop && (sRoundTripTime > 0 || sRandomRoundTrip || sIncreasingRoundTrip)) {
@@ -1006,6 +1011,27 @@ domain_receive_data(net_buffer *buffer)
 						printf(" <ts %lu:%lu>", option->timestamp.value, option->timestamp.reply);
 						length = 10;
 						break;
+					case TCP_OPTION_SACK_PERMITTED:
+						printf(" <sack permitted>");
+						length = 2;
+						break;
+					case TCP_OPTION_SACK:
+						length = option->length;
+						if (length < 2 || length > (uint32)size) {
+							// malformed, don't read past the options
+							printf(" <sack invalid>");
+							size = 0;
+							break;
+						}
+
+						printf(" <sack");
+						for (uint32 i = 0; i < (length - 2) / sizeof(tcp_sack);
+								i++) {
+							printf(" %lu:%lu", ntohl(option->sack[i].left_edge),
+								ntohl(option->sack[i].right_edge));
+						}
+						putchar('>');
+						break;
 
 					default:
 						length = option->length;
@@ -1134,10 +1160,10 @@ receiving_thread(void* _data)
 				close_protocol(gClientSocket->first_protocol);
 				sSimultaneousClose = false;
 			}
-			if ((sRandomReorder > 0.0
-					|| sReorderList.find(sPacketNumber) != sReorderList.end())
-				&& reorderBuffer == NULL
-				&& (1.0 * rand() / RAND_MAX) > sRandomReorder) {
+			if (reorderBuffer == NULL
+				&& (sReorderList.find(sPacketNumber) != sReorderList.end()
+					|| (sRandomReorder > 0.0
+						&& (1.0 * rand() / RAND_MAX) < sRandomReorder))) {
 				reorderBuffer = buffer;
 			} else {
 				if (sDomain.module->receive_data(buffer) < B_OK)
@@ -1171,12 +1197,23 @@ server_thread(void*)
 			break;
 		}
 
-		printf("server: got connection from %08x\n", address.sin_addr.s_addr);
+		if (!sVerifyTransfer)
+			printf("server: got connection from %08x\n", address.sin_addr.s_addr);
 
 		char buffer[1024];
 		ssize_t bytesRead;
 		while ((bytesRead = socket_recv(connectionSocket, buffer,
 				sizeof(buffer), 0)) > 0) {
+			if (sVerifyTransfer) {
+				// check for the pattern do_send() and run_transfer() use
+				for (ssize_t i = 0; i < bytesRead; i++) {
+					if (buffer[i] != (char)((sBytesReceived + i) & 0xff))
+						sPatternMismatch = true;
+				}
+				sBytesReceived += bytesRead;
+				continue;
+			}
+
 			printf("server: received %ld bytes\n", bytesRead);
 
 			if (sServerActiveClose) {
@@ -1187,9 +1224,12 @@ server_thread(void*)
 		}
 		if (bytesRead < 0)
 			printf("server: receiving failed: %s\n", strerror(bytesRead));
-		else
+		else if (!sVerifyTransfer)
 			printf("server: peer closed connection.\n");
 
+		if (sVerifyTransfer)
+			release_sem(sTransferDone);
+
 		snooze(1000000);
 		close_protocol(connectionSocket->first_protocol);
 	}
@@ -1529,6 +1569,33 @@ do_round_trip_time(int argc, char** argv)
 }
 
 
+static void
+do_congestion_control(int argc, char** argv)
+{
+	if (argc == 1) {
+		char name[TCP_CA_NAME_MAX];
+		int length = sizeof(name);
+		status_t status = gTCPModule->getsockopt(gClientSocket->first_protocol,
+			IPPROTO_TCP, TCP_CONGESTION, name, &length);
+		if (status < B_OK) {
+			fprintf(stderr, "could not get congestion control: %s\n",
+				strerror(status));
+			return;
+		}
+
+		printf("Congestion control is \"%s\".\n", name);
+		return;
+	}
+
+	status_t status = gTCPModule->setsockopt(gClientSocket->first_protocol,
+		IPPROTO_TCP, TCP_CONGESTION, argv[1], strlen(argv[1]));
+	if (status < B_OK) {
+		fprintf(stderr, "could not set congestion control \"%s\": %s\n",
+			argv[1], strerror(status));
+	}
+}
+
+
 static void
 do_dprintf(int argc, char** argv)
 {
@@ -1545,6 +1612,7 @@ static cmd_entry sBuiltinCommands[] = {
 	{"connect", do_connect, "Connects the client"},
 	{"send", do_send, "Sends data from the client to the server"},
 	{"close", do_close, "Performs an active or simultaneous close"},
+	{"cc", do_congestion_control, "Sets the congestion control algorithm"},
 	{"dprintf", do_dprintf, "Toggles debug output"},
 	{"drop", do_drop, "Lets you drop packets during transfer"},
 	{"reorder", do_reorder, "Lets you reorder packets during transfer"},
@@ -1569,9 +1637,113 @@ do_help(int argc, char** argv)
 //	#pragma mark -
 
 
+/*!	Transfers \a size bytes from a new client socket using the given
+	congestion control \a algorithm, and verifies that they all arrived at
+	the server intact.
+*/
+static bool
+run_transfer(const char* algorithm, size_t size)
+{
+	close_protocol(gClientSocket->first_protocol);
+	if (init_protocol(&gClientSocket) == NULL)
+		return false;
+
+	status_t status = gTCPModule->setsockopt(gClientSocket->first_protocol,
+		IPPROTO_TCP, TCP_CONGESTION, algorithm, strlen(algorithm));
+	if (status < B_OK) {
+		fprintf(stderr, "%s: could not set congestion control: %s\n",
+			algorithm, strerror(status));
+		return false;
+	}
+
+	char* buffer = (char*)malloc(size);
+	if (buffer == NULL)
+		return false;
+
+	for (uint32 i = 0; i < size; i++)
+		buffer[i] = (char)(i & 0xff);
+
+	sBytesReceived = 0;
+	sPatternMismatch = false;
+	sStartTime = system_time();
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(1024);
+	address.sin_addr.s_addr = htonl(0xc0a80001);
+
+	status = socket_connect(gClientSocket, (struct sockaddr*)&address,
+		sizeof(struct sockaddr));
+	if (status == B_OK) {
+		ssize_t bytesWritten = socket_send(gClientSocket, buffer, size, 0);
+		if (bytesWritten < B_OK)
+			status = bytesWritten;
+	}
+	free(buffer);
+
+	if (status < B_OK) {
+		fprintf(stderr, "%s: transfer failed: %s\n", algorithm,
+			strerror(status));
+		return false;
+	}
+
+	gTCPModule->close(gClientSocket->first_protocol);
+
+	status = acquire_sem_etc(sTransferDone, 1, B_RELATIVE_TIMEOUT,
+		60000000LL);
+	if (status < B_OK) {
+		fprintf(stderr, "%s: transfer did not complete: %s\n", algorithm,
+			strerror(status));
+		return false;
+	}
+
+	bigtime_t time = system_time() - sStartTime;
+	printf("%s: %lu bytes in %g ms, %lu packets\n", algorithm, sBytesReceived,
+		time / 1000.0, sPacketNumber);
+
+	if (sBytesReceived != size || sPatternMismatch) {
+		fprintf(stderr, "%s: received %lu bytes of %lu, data %s\n", algorithm,
+			sBytesReceived, size, sPatternMismatch ? "corrupted" : "intact");
+		return false;
+	}
+
+	return true;
+}
+
+
+/*!	Runs a bulk transfer over a lossy link for each congestion control
+	algorithm, and returns the number of failed transfers.
+*/
+static int
+run_transfer_tests()
+{
+	static const char* kAlgorithms[] = {"reno", "cubic"};
+
+	sTCPDump = false;
+	sVerifyTransfer = true;
+	sRandomDrop = 0.02;
+	sRoundTripTime = 2000;
+	srand(42);
+
+	sTransferDone = create_sem(0, "transfer done");
+
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(kAlgorithms) / sizeof(kAlgorithms[0]); i++) {
+		if (!run_transfer(kAlgorithms[i], 384 * 1024))
+			failed++;
+	}
+
+	delete_sem(sTransferDone);
+	return failed;
+}
+
+
 int
 main(int argc, char** argv)
 {
+	bool runTests = argc > 1 && !strcmp(argv[1], "--test");
+
 	status_t status = init_timers();
 	if (status < B_OK) {
 		fprintf(stderr, "tcp_tester: Could not initialize timers: %s\n",
@@ -1619,7 +1791,11 @@ main(int argc, char** argv)
 
 	setup_server();
 
-	while (true) {
+	int failed = 0;
+	if (runTests)
+		failed = run_transfer_tests();
+
+	while (!runTests) {
 		printf("> ");
 		fflush(stdout);
 
@@ -1661,7 +1837,8 @@ main(int argc, char** argv)
 		free(argv);
 	}
 
-	close_protocol(client);
+	close_protocol(gClientSocket->first_protocol);
+		// the client may have been replaced by run_transfer()
 	close_protocol(server);
 
 	snooze(2000000);
@@ -1671,5 +1848,5 @@ main(int argc, char** argv)
 
 	put_module("network/protocols/tcp/v1");
 	uninit_timers();
-	return 0;
+	return failed != 0 ? 1 : 0;
 }
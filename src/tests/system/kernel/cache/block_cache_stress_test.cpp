@@ -0,0 +1,246 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+//!	Stresses concurrent accesses to the block cache, and measures their rate.
+
+
+#define write_pos	block_cache_write_pos
+#define writev_pos	block_cache_writev_pos
+#define read_pos	block_cache_read_pos
+
+#include "block_cache.cpp"
+
+#undef write_pos
+#undef writev_pos
+#undef read_pos
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static const off_t kBlockCount = 16384;
+static const size_t kBlockSize = 2048;
+static const off_t kSharedBlocks = 64;
+	// blocks that are accessed by all threads
+static const int32 kMaxThreads = 32;
+
+static block_cache* sCache;
+static int32 sIterations = 200000;
+static int32 sThreadCount;
+static int32 sErrors;
+static volatile bool sDone;
+
+
+ssize_t
+block_cache_write_pos(int fd, off_t offset, const void* buffer, size_t size)
+{
+	const off_t* data = (const off_t*)buffer;
+	if (data[0] != offset / (off_t)kBlockSize) {
+		fprintf(stderr, "Block %" B_PRIdOFF " written with wrong contents!\n",
+			offset / kBlockSize);
+		atomic_add(&sErrors, 1);
+	}
+
+	return size;
+}
+
+
+ssize_t
+block_cache_writev_pos(int fd, off_t offset, const iovec* vecs, size_t count)
+{
+	ssize_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		ssize_t written = block_cache_write_pos(fd, offset + total,
+			vecs[i].iov_base, vecs[i].iov_len);
+		if (written < 0)
+			return written;
+
+		total += written;
+	}
+
+	return total;
+}
+
+
+ssize_t
+block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
+{
+	off_t* data = (off_t*)buffer;
+	for (size_t i = 0; i < size / sizeof(off_t); i++)
+		data[i] = offset / kBlockSize;
+
+	return size;
+}
+
+
+static void
+check_block(const void* buffer, off_t blockNumber)
+{
+	const off_t* data = (const off_t*)buffer;
+	if (data == NULL || data[0] != blockNumber
+		|| data[kBlockSize / sizeof(off_t) - 1] != blockNumber) {
+		fprintf(stderr, "Block %" B_PRIdOFF " has wrong contents!\n",
+			blockNumber);
+		atomic_add(&sErrors, 1);
+	}
+}
+
+
+/*!	Reads blocks; three quarters of the accesses go to blocks only this
+	thread uses, the rest to blocks shared with all other threads.
+*/
+static status_t
+reader_thread(void* _index)
+{
+	int32 index = (addr_t)_index;
+	off_t privateBlocks = (kBlockCount - kSharedBlocks) / sThreadCount;
+	off_t first = kSharedBlocks + index * privateBlocks;
+	unsigned int seed = index + 1;
+
+	for (int32 i = 0; i < sIterations; i++) {
+		off_t blockNumber;
+		if ((i & 3) == 0)
+			blockNumber = rand_r(&seed) % kSharedBlocks;
+		else
+			blockNumber = first + rand_r(&seed) % privateBlocks;
+
+		check_block(block_cache_get(sCache, blockNumber), blockNumber);
+		block_cache_put(sCache, blockNumber);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Dirties shared blocks outside of a transaction, and discards some of them
+	again, so that the readers have to fall back to the locked path.
+*/
+static status_t
+writer_thread(void*)
+{
+	unsigned int seed = 4711;
+
+	while (!sDone) {
+		off_t blockNumber = rand_r(&seed) % kSharedBlocks;
+
+		void* data = block_cache_get_writable(sCache, blockNumber, -1);
+		check_block(data, blockNumber);
+		block_cache_put(sCache, blockNumber);
+
+		if ((rand_r(&seed) & 15) == 0) {
+			block_cache_sync_etc(sCache, blockNumber, 1);
+			block_cache_discard(sCache, blockNumber, 1);
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*!	Lets the CLOCK hand evict blocks while they are being used. */
+static status_t
+evictor_thread(void*)
+{
+	while (!sDone) {
+		mutex_lock(&sCache->lock);
+		sCache->RemoveUnusedBlocks(256);
+		mutex_unlock(&sCache->lock);
+
+		snooze(1000);
+	}
+
+	return B_OK;
+}
+
+
+static bigtime_t
+run_test(int32 threadCount)
+{
+	sThreadCount = threadCount;
+	sDone = false;
+
+	thread_id writer = spawn_thread(&writer_thread, "writer",
+		B_NORMAL_PRIORITY, NULL);
+	thread_id evictor = spawn_thread(&evictor_thread, "evictor",
+		B_NORMAL_PRIORITY, NULL);
+	resume_thread(writer);
+	resume_thread(evictor);
+
+	bigtime_t start = system_time();
+
+	thread_id readers[kMaxThreads];
+	for (int32 i = 0; i < threadCount; i++) {
+		readers[i] = spawn_thread(&reader_thread, "reader", B_NORMAL_PRIORITY,
+			(void*)(addr_t)i);
+		resume_thread(readers[i]);
+	}
+
+	status_t status;
+	for (int32 i = 0; i < threadCount; i++)
+		wait_for_thread(readers[i], &status);
+
+	bigtime_t time = system_time() - start;
+
+	sDone = true;
+	wait_for_thread(writer, &status);
+	wait_for_thread(evictor, &status);
+
+	return time;
+}
+
+
+static void
+check_references()
+{
+	MutexLocker locker(&sCache->lock);
+
+	block_clock_list::Iterator iterator = sCache->blocks.GetIterator();
+	while (cached_block* block = iterator.Next()) {
+		if (block->ref_count != 0) {
+			fprintf(stderr, "Block %" B_PRIdOFF " still has %" B_PRId32
+				" references!\n", block->block_number, block->ref_count);
+			sErrors++;
+		}
+	}
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = 8;
+	if (argc > 1)
+		maxThreads = min_c(max_c(atoi(argv[1]), 1), kMaxThreads);
+	if (argc > 2)
+		sIterations = max_c(atoi(argv[2]), 1);
+
+	block_cache_init();
+
+	sCache = (block_cache*)block_cache_create(-1, kBlockCount, kBlockSize,
+		false);
+	if (sCache == NULL) {
+		fprintf(stderr, "Could not create block cache!\n");
+		return 1;
+	}
+
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2) {
+		bigtime_t time = run_test(threads);
+		check_references();
+
+		printf("%2" B_PRId32 " threads: %8" B_PRId64 " gets/s\n", threads,
+			(int64)threads * sIterations * 1000000LL / max_c(time, 1));
+	}
+
+	block_cache_delete(sCache, true);
+
+	if (sErrors != 0) {
+		fprintf(stderr, "%" B_PRId32 " errors!\n", sErrors);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
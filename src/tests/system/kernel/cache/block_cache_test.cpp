@@ -5,11 +5,13 @@
 
 
 #define write_pos	block_cache_write_pos
+#define writev_pos	block_cache_writev_pos
 #define read_pos	block_cache_read_pos
 
 #include "block_cache.cpp"
 
 #undef write_pos
+#undef writev_pos
 #undef read_pos
 
 
@@ -133,6 +135,23 @@ block_cache_write_pos(int fd, off_t offset, const void* buffer, size_t size)
 }
 
 
+ssize_t
+block_cache_writev_pos(int fd, off_t offset, const iovec* vecs, size_t count)
+{
+	ssize_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		ssize_t written = block_cache_write_pos(fd, offset + total,
+			vecs[i].iov_base, vecs[i].iov_len);
+		if (written < 0)
+			return written;
+
+		total += written;
+	}
+
+	return total;
+}
+
+
 ssize_t
 block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
 {
@@ -189,7 +208,7 @@ test_blocks(off_t number, int32 count, int32 line)
 	for (int32 i = 0; i < count; i++, number++) {
 		MutexLocker locker(&gCache->lock);
 
-		cached_block* block = (cached_block*)hash_lookup(gCache->hash, &number);
+		cached_block* block = gCache->Lookup(number);
 		if (block == NULL) {
 			if (gBlocks[number].present)
 				error(line, "Block %Ld not found!", number);
@@ -203,9 +222,9 @@ test_blocks(off_t number, int32 count, int32 line)
 				number, block->is_dirty, gBlocks[number].is_dirty);
 		}
 #if 0
-		if (block->unused != gBlocks[number].unused) {
+		if (block->IsUnused() != gBlocks[number].unused) {
 			error("Block %ld: unused bit differs (%d should be %d)!", number,
-				block->unused, gBlocks[number].unused);
+				block->IsUnused(), gBlocks[number].unused);
 		}
 #endif
 		if (block->discard != gBlocks[number].discard) {
@@ -20,7 +20,7 @@ extern const char *__progname;
 void
 usage()
 {
-	fprintf(stderr, "usage: %s [clear | unset | set <module-name>]\n", __progname);
+	fprintf(stderr, "usage: %s [clear | stats | unset | set <module-name>]\n", __progname);
 	exit(0);
 }
 
@@ -42,6 +42,20 @@ main(int argc, char **argv)
 		status = _kern_generic_syscall(CACHE_SYSCALLS, CACHE_CLEAR, NULL, 0);
 		if (status != B_OK)
 			fprintf(stderr, "%s: clearing the cache failed: %s\n", __progname, strerror(status));
+	} else if (!strcmp(argv[1], "stats")) {
+		file_cache_stats stats;
+		status = _kern_generic_syscall(CACHE_SYSCALLS, CACHE_GET_STATS, &stats, sizeof(stats));
+		if (status != B_OK) {
+			fprintf(stderr, "%s: getting the cache statistics failed: %s\n", __progname, strerror(status));
+			return 1;
+		}
+
+		uint64 total = stats.hits + stats.misses;
+		printf("hits:             %" B_PRIu64 " pages (%" B_PRIu64 "%%)\n", stats.hits,
+			total > 0 ? stats.hits * 100 / total : 0);
+		printf("misses:           %" B_PRIu64 " pages\n", stats.misses);
+		printf("read ahead:       %" B_PRIu64 " pages\n", stats.readahead_pages);
+		printf("wasted readahead: %" B_PRIu64 " pages\n", stats.readahead_wasted);
 	} else if (!strcmp(argv[1], "unset")) {
 		status = _kern_generic_syscall(CACHE_SYSCALLS, CACHE_SET_MODULE, NULL, 0);
 		if (status != B_OK)
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <event_queue_defs.h>
+
+
+static sem_id sSemaphore;
+static port_id sPort;
+static int sPipe[2];
+static port_id sWaiterPorts[2];
+
+
+static status_t
+notifier_thread(void* data)
+{
+	snooze(500000);
+	release_sem(sSemaphore);
+	snooze(500000);
+	write_port(sPort, 0xcafe, "test", 4);
+	snooze(500000);
+	write(sPipe[1], "x", 1);
+	snooze(500000);
+	delete_sem(sSemaphore);
+
+	return B_OK;
+}
+
+
+static status_t
+waiter_thread(void* data)
+{
+	int queue = (int)(addr_t)data;
+
+	event_wait_info info;
+	ssize_t count = event_queue_wait(queue, &info, 1, B_RELATIVE_TIMEOUT,
+		2000000);
+	return count == 1 ? B_OK : (count < 0 ? count : B_ERROR);
+}
+
+
+static void
+print_events(const event_wait_info* infos, ssize_t count)
+{
+	if (count < 0) {
+		printf("wait failed: %s\n", strerror(count));
+		return;
+	}
+
+	for (ssize_t i = 0; i < count; i++) {
+		printf("  object %" B_PRId32 " (type %u, cookie %p): events 0x%x\n",
+			infos[i].object, infos[i].type, infos[i].user_data,
+			infos[i].events);
+	}
+}
+
+
+int
+main()
+{
+	sSemaphore = create_sem(0, "event queue test");
+	sPort = create_port(2, "event queue test");
+	if (pipe(sPipe) != 0) {
+		fprintf(stderr, "Failed to create pipe: %s\n", strerror(errno));
+		return 1;
+	}
+
+	int queue = event_queue_create(0);
+	if (queue < 0) {
+		fprintf(stderr, "Failed to create event queue: %s\n", strerror(queue));
+		return 1;
+	}
+
+	event_wait_info infos[3];
+	infos[0].object = sSemaphore;
+	infos[0].type = B_OBJECT_TYPE_SEMAPHORE;
+	infos[0].behavior = B_EVENT_LEVEL_TRIGGERED;
+	infos[0].events = B_EVENT_ACQUIRE_SEMAPHORE;
+	infos[0].user_data = (void*)1;
+
+	infos[1].object = sPort;
+	infos[1].type = B_OBJECT_TYPE_PORT;
+	infos[1].behavior = B_EVENT_EDGE_TRIGGERED;
+	infos[1].events = B_EVENT_READ;
+	infos[1].user_data = (void*)2;
+
+	infos[2].object = sPipe[0];
+	infos[2].type = B_OBJECT_TYPE_FD;
+	infos[2].behavior = B_EVENT_ONE_SHOT;
+	infos[2].events = B_EVENT_READ;
+	infos[2].user_data = (void*)3;
+
+	status_t status = event_queue_select(queue, infos, 3);
+	if (status != B_OK) {
+		fprintf(stderr, "Failed to select objects: %s\n", strerror(status));
+		return 1;
+	}
+
+	thread_id thread = spawn_thread(notifier_thread, "notifier",
+		B_NORMAL_PRIORITY, NULL);
+	resume_thread(thread);
+
+	// The semaphore stays acquirable until we acquire it, so it should be
+	// reported again and again, while the port and the pipe should be
+	// reported only once each. Finally the semaphore is reported invalid.
+	for (int i = 0; i < 8; i++) {
+		ssize_t count = event_queue_wait(queue, infos, 3, B_RELATIVE_TIMEOUT,
+			1000000);
+		printf("wait %d: %" B_PRIdSSIZE " events\n", i, count);
+		print_events(infos, count);
+
+		if (i == 3)
+			acquire_sem(sSemaphore);
+	}
+
+	wait_for_thread(thread, NULL);
+	close(queue);
+
+	// Two threads waiting on the same queue must both be woken up when two
+	// events arrive, even though the second one is queued before the first
+	// waiter got to run.
+	queue = event_queue_create(0);
+	for (int i = 0; i < 2; i++) {
+		sWaiterPorts[i] = create_port(1, "event queue waiter test");
+		infos[i].object = sWaiterPorts[i];
+		infos[i].type = B_OBJECT_TYPE_PORT;
+		infos[i].behavior = B_EVENT_ONE_SHOT;
+		infos[i].events = B_EVENT_READ;
+		infos[i].user_data = NULL;
+	}
+	if (event_queue_select(queue, infos, 2) != B_OK) {
+		fprintf(stderr, "Failed to select waiter ports\n");
+		return 1;
+	}
+
+	thread_id waiters[2];
+	for (int i = 0; i < 2; i++) {
+		waiters[i] = spawn_thread(waiter_thread, "waiter", B_NORMAL_PRIORITY,
+			(void*)(addr_t)queue);
+		resume_thread(waiters[i]);
+	}
+	snooze(200000);
+
+	write_port(sWaiterPorts[0], 1, NULL, 0);
+	write_port(sWaiterPorts[1], 1, NULL, 0);
+
+	int result = 0;
+	for (int i = 0; i < 2; i++) {
+		status_t waiterStatus;
+		wait_for_thread(waiters[i], &waiterStatus);
+		printf("waiter %d: %s\n", i, strerror(waiterStatus));
+		if (waiterStatus != B_OK)
+			result = 1;
+		delete_port(sWaiterPorts[i]);
+	}
+	close(queue);
+
+	return result;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+//!	Tests areas backed by large pages (B_LARGE_PAGES).
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <OS.h>
+
+
+static const size_t kAreaSize = 16 * 1024 * 1024;
+
+
+static int32
+large_pages()
+{
+	system_info info;
+	get_system_info(&info);
+	return info.large_pages;
+}
+
+
+static void
+check_pattern(const uint32* data, size_t size)
+{
+	for (size_t i = 0; i < size / sizeof(uint32); i++) {
+		if (data[i] != i) {
+			fprintf(stderr, "Error: data mismatch at offset %#" B_PRIxSIZE
+				"\n", i * sizeof(uint32));
+			exit(1);
+		}
+	}
+}
+
+
+int
+main()
+{
+	int32 largePagesBefore = large_pages();
+
+	uint32* data;
+	area_id area = create_area("large pages test", (void**)&data,
+		B_ANY_ADDRESS, kAreaSize, B_NO_LOCK,
+		B_READ_AREA | B_WRITE_AREA | B_LARGE_PAGES);
+	if (area < 0) {
+		fprintf(stderr, "Error: Failed to create area: %s\n", strerror(area));
+		return 1;
+	}
+
+	area_info info;
+	get_area_info(area, &info);
+	if (info.lock != B_FULL_LOCK) {
+		fprintf(stderr, "Error: Large page area is not fully locked\n");
+		return 1;
+	}
+
+	int32 largePagesMapped = large_pages() - largePagesBefore;
+	printf("%" B_PRId32 " of %" B_PRIuSIZE " pages mapped via large pages\n",
+		largePagesMapped, kAreaSize / B_PAGE_SIZE);
+
+	for (size_t i = 0; i < kAreaSize / sizeof(uint32); i++)
+		data[i] = i;
+	check_pattern(data, kAreaSize);
+
+	// change the protection of a single page in the middle, which splits the
+	// large page it is in
+	uint8* page = (uint8*)data + kAreaSize / 2 + B_PAGE_SIZE;
+	if (mprotect(page, B_PAGE_SIZE, PROT_READ) != 0) {
+		fprintf(stderr, "Error: mprotect() failed: %s\n", strerror(errno));
+		return 1;
+	}
+	check_pattern(data, kAreaSize);
+
+	if (largePagesMapped > 0 && large_pages() - largePagesBefore
+			>= largePagesMapped) {
+		fprintf(stderr, "Error: Large page wasn't split\n");
+		return 1;
+	}
+
+	delete_area(area);
+
+	if (large_pages() > largePagesBefore) {
+		fprintf(stderr, "Error: Large pages still mapped after deleting the "
+			"area\n");
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
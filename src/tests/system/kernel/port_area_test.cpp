@@ -0,0 +1,201 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Passes an area larger than any port message along with a message from
+	one team to another, and checks that it arrives with its contents, and
+	that the sending team no longer has it.
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <syscalls.h>
+
+
+static const size_t kAreaSize = 4 * 1024 * 1024;
+	// way above the maximum port message size
+static const char* kAreaName = "port area test";
+static const int32 kMessageCode = 'artt';
+static const char kMessage[] = "here comes the area";
+
+
+static uint8
+area_byte(size_t offset)
+{
+	return (uint8)(offset * 11 + offset / B_PAGE_SIZE);
+}
+
+
+static area_id
+create_test_area()
+{
+	uint8* address;
+	area_id area = create_area(kAreaName, (void**)&address, B_ANY_ADDRESS,
+		kAreaSize, B_NO_LOCK, B_READ_AREA | B_WRITE_AREA);
+	if (area < 0) {
+		fprintf(stderr, "Could not create area: %s\n", strerror(area));
+		return area;
+	}
+
+	for (size_t offset = 0; offset < kAreaSize; offset++)
+		address[offset] = area_byte(offset);
+
+	return area;
+}
+
+
+static bool
+team_has_test_area()
+{
+	area_info info;
+	ssize_t cookie = 0;
+	while (get_next_area_info(B_CURRENT_TEAM, &cookie, &info) == B_OK) {
+		if (strcmp(info.name, kAreaName) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+
+static int
+send_area(port_id port)
+{
+	area_id area = create_test_area();
+	if (area < 0)
+		return 1;
+
+	status_t status = _kern_write_port_area_etc(port, kMessageCode, kMessage,
+		sizeof(kMessage), area, 0, 0);
+	if (status != B_OK) {
+		fprintf(stderr, "Sending the area failed: %s\n", strerror(status));
+		return 1;
+	}
+
+	area_info info;
+	if (get_area_info(area, &info) == B_OK || team_has_test_area()) {
+		fprintf(stderr, "The sender still has the area\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+static int
+receive_area(port_id port)
+{
+	char buffer[sizeof(kMessage)];
+	int32 code;
+	area_id area;
+	ssize_t bytesRead = _kern_read_port_area_etc(port, &code, buffer,
+		sizeof(buffer), &area, B_RELATIVE_TIMEOUT, 10000000);
+	if (bytesRead < 0) {
+		fprintf(stderr, "Receiving the area failed: %s\n",
+			strerror(bytesRead));
+		return 1;
+	}
+
+	if (code != kMessageCode || bytesRead != sizeof(kMessage)
+		|| memcmp(buffer, kMessage, sizeof(kMessage)) != 0) {
+		fprintf(stderr, "Received a wrong message\n");
+		return 1;
+	}
+
+	area_info info;
+	if (area < 0 || get_area_info(area, &info) != B_OK) {
+		fprintf(stderr, "Received no area\n");
+		return 1;
+	}
+
+	if (info.team != getpid() || info.size != kAreaSize) {
+		fprintf(stderr, "Received an area of %" B_PRIuSIZE " bytes in team %"
+			B_PRId32 "\n", info.size, info.team);
+		return 1;
+	}
+
+	const uint8* address = (const uint8*)info.address;
+	for (size_t offset = 0; offset < kAreaSize; offset++) {
+		if (address[offset] != area_byte(offset)) {
+			fprintf(stderr, "Wrong area contents at offset %" B_PRIuSIZE "\n",
+				offset);
+			return 1;
+		}
+	}
+
+	delete_area(area);
+	return 0;
+}
+
+
+/*!	A write that fails must leave the area with the sender. */
+static int
+send_to_deleted_port()
+{
+	port_id port = create_port(1, "port area test deleted");
+	delete_port(port);
+
+	area_id area = create_test_area();
+	if (area < 0)
+		return 1;
+
+	status_t status = _kern_write_port_area_etc(port, kMessageCode, kMessage,
+		sizeof(kMessage), area, 0, 0);
+
+	area_info info;
+	int result = 0;
+	if (status == B_OK || get_area_info(area, &info) != B_OK) {
+		fprintf(stderr, "Sending to a deleted port lost the area\n");
+		result = 1;
+	}
+
+	delete_area(area);
+	return result;
+}
+
+
+int
+main()
+{
+	port_id port = create_port(1, "port area test");
+	if (port < 0) {
+		fprintf(stderr, "Could not create port: %s\n", strerror(port));
+		return 1;
+	}
+
+	pid_t child = fork();
+	if (child < 0) {
+		fprintf(stderr, "fork() failed: %s\n", strerror(errno));
+		return 1;
+	}
+	if (child == 0)
+		return send_area(port);
+
+	int failures = receive_area(port);
+
+	int childStatus;
+	if (waitpid(child, &childStatus, 0) != child || !WIFEXITED(childStatus)
+		|| WEXITSTATUS(childStatus) != 0)
+		failures++;
+
+	failures += send_to_deleted_port();
+
+	delete_port(port);
+
+	if (failures != 0) {
+		printf("%d failures\n", failures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how port operations scale with the number of threads. Every
+	thread has a port of its own which it writes to and reads from in a loop,
+	so ideally the threads never contend for the same lock and the aggregate
+	throughput grows linearly with the number of CPUs.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+
+#define MAX_THREADS			64
+#define DEFAULT_DURATION	1000000
+
+
+static vint32 sStart;
+static vint32 sStop;
+
+
+struct thread_data {
+	port_id	port;
+	int64	operations;
+};
+
+
+static status_t
+port_thread(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+	char buffer[64];
+	memset(buffer, 0x42, sizeof(buffer));
+
+	while (sStart == 0)
+		snooze(1000);
+
+	int64 operations = 0;
+	while (sStop == 0) {
+		if (write_port(data->port, 0x42, buffer, sizeof(buffer)) != B_OK)
+			return B_ERROR;
+
+		int32 code;
+		if (read_port(data->port, &code, buffer, sizeof(buffer)) < 0)
+			return B_ERROR;
+
+		operations += 2;
+	}
+
+	data->operations = operations;
+	return B_OK;
+}
+
+
+static double
+run_test(int32 threadCount, bigtime_t duration)
+{
+	thread_id threads[MAX_THREADS];
+	thread_data data[MAX_THREADS];
+
+	sStart = 0;
+	sStop = 0;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].port = create_port(1, "port scalability test");
+		data[i].operations = 0;
+		if (data[i].port < 0) {
+			fprintf(stderr, "Failed to create port: %s\n",
+				strerror(data[i].port));
+			exit(1);
+		}
+
+		threads[i] = spawn_thread(port_thread, "port test thread",
+			B_NORMAL_PRIORITY, &data[i]);
+		resume_thread(threads[i]);
+	}
+
+	bigtime_t startTime = system_time();
+	atomic_set(&sStart, 1);
+	snooze(duration);
+	atomic_set(&sStop, 1);
+
+	int64 operations = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t status;
+		wait_for_thread(threads[i], &status);
+		operations += data[i].operations;
+		delete_port(data[i].port);
+	}
+
+	bigtime_t elapsed = system_time() - startTime;
+	return operations * 1000000.0 / elapsed;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = info.cpu_count * 2;
+	if (argc > 1)
+		maxThreads = atol(argv[1]);
+	if (maxThreads < 1 || maxThreads > MAX_THREADS) {
+		fprintf(stderr, "usage: %s [max threads (1-%d)] [duration (us)]\n",
+			argv[0], MAX_THREADS);
+		return 1;
+	}
+
+	bigtime_t duration = DEFAULT_DURATION;
+	if (argc > 2)
+		duration = atoll(argv[2]);
+
+	printf("%" B_PRId32 " CPUs, %" B_PRIdBIGTIME " us per run\n",
+		info.cpu_count, duration);
+	printf("threads        ops/s   per thread   speedup\n");
+
+	double base = 0;
+	for (int32 threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		double rate = run_test(threadCount, duration);
+		if (threadCount == 1)
+			base = rate;
+
+		printf("%7" B_PRId32 " %12.0f %12.0f %9.2f\n", threadCount, rate,
+			rate / threadCount, base > 0 ? rate / base : 0.0);
+	}
+
+	return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how path resolution scales with the number of threads. All
+	threads stat() the same few paths in a loop, so they share the directory
+	vnodes and entry cache entries along the way -- the worst case for any
+	lock on the lookup path.
+*/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+
+#define MAX_THREADS			64
+#define DEFAULT_DURATION	1000000
+
+static const char* kBaseDirectory = "/tmp/stat_scalability_test";
+static const char* kDirectory
+	= "/tmp/stat_scalability_test/a/b/c/d/e/f/g/h";
+static const char* kPaths[] = {
+	"/tmp/stat_scalability_test/a/b/c/d/e/f/g/h/file",
+	"/tmp/stat_scalability_test/a/b/c/d/e/f/g/h",
+	"/tmp/stat_scalability_test/a/b/c/d/e/f/g/h/missing",
+		// must fail with B_ENTRY_NOT_FOUND
+};
+static const int32 kPathCount = sizeof(kPaths) / sizeof(kPaths[0]);
+
+
+static vint32 sStart;
+static vint32 sStop;
+
+
+struct thread_data {
+	int64	operations;
+	int32	errors;
+};
+
+
+static status_t
+stat_thread(void* _data)
+{
+	thread_data* data = (thread_data*)_data;
+
+	while (sStart == 0)
+		snooze(1000);
+
+	int64 operations = 0;
+	int32 errors = 0;
+	while (sStop == 0) {
+		for (int32 i = 0; i < kPathCount; i++) {
+			struct stat st;
+			bool shouldExist = i < kPathCount - 1;
+			if ((stat(kPaths[i], &st) == 0) != shouldExist
+				|| (!shouldExist && errno != B_ENTRY_NOT_FOUND)) {
+				errors++;
+			}
+		}
+
+		operations += kPathCount;
+	}
+
+	data->operations = operations;
+	data->errors = errors;
+	return B_OK;
+}
+
+
+static double
+run_test(int32 threadCount, bigtime_t duration, int32& _errors)
+{
+	thread_id threads[MAX_THREADS];
+	thread_data data[MAX_THREADS];
+
+	sStart = 0;
+	sStop = 0;
+
+	for (int32 i = 0; i < threadCount; i++) {
+		data[i].operations = 0;
+		data[i].errors = 0;
+
+		threads[i] = spawn_thread(stat_thread, "stat test thread",
+			B_NORMAL_PRIORITY, &data[i]);
+		resume_thread(threads[i]);
+	}
+
+	bigtime_t startTime = system_time();
+	atomic_set(&sStart, 1);
+	snooze(duration);
+	atomic_set(&sStop, 1);
+
+	int64 operations = 0;
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t status;
+		wait_for_thread(threads[i], &status);
+		operations += data[i].operations;
+		_errors += data[i].errors;
+	}
+
+	bigtime_t elapsed = system_time() - startTime;
+	return operations * 1000000.0 / elapsed;
+}
+
+
+static void
+create_tree()
+{
+	char path[B_PATH_NAME_LENGTH];
+	strlcpy(path, kDirectory, sizeof(path));
+
+	for (char* slash = path + strlen(kBaseDirectory); slash != NULL;
+			slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		mkdir(path, 0755);
+		*slash = '/';
+	}
+	mkdir(path, 0755);
+
+	FILE* file = fopen(kPaths[0], "w");
+	if (file == NULL) {
+		fprintf(stderr, "Failed to create \"%s\": %s\n", kPaths[0],
+			strerror(errno));
+		exit(1);
+	}
+	fclose(file);
+}
+
+
+static void
+remove_tree()
+{
+	char path[B_PATH_NAME_LENGTH];
+	strlcpy(path, kDirectory, sizeof(path));
+
+	unlink(kPaths[0]);
+
+	while (strlen(path) > strlen(kBaseDirectory)) {
+		rmdir(path);
+		*strrchr(path, '/') = '\0';
+	}
+	rmdir(path);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	system_info info;
+	get_system_info(&info);
+
+	int32 maxThreads = info.cpu_count * 2;
+	if (argc > 1)
+		maxThreads = atol(argv[1]);
+	if (maxThreads < 1 || maxThreads > MAX_THREADS) {
+		fprintf(stderr, "usage: %s [max threads (1-%d)] [duration (us)]\n",
+			argv[0], MAX_THREADS);
+		return 1;
+	}
+
+	bigtime_t duration = DEFAULT_DURATION;
+	if (argc > 2)
+		duration = atoll(argv[2]);
+
+	create_tree();
+
+	printf("%" B_PRId32 " CPUs, %" B_PRIdBIGTIME " us per run\n",
+		info.cpu_count, duration);
+	printf("threads      stats/s   per thread   speedup\n");
+
+	int32 errors = 0;
+	double base = 0;
+	for (int32 threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		double rate = run_test(threadCount, duration, errors);
+		if (threadCount == 1)
+			base = rate;
+
+		printf("%7" B_PRId32 " %12.0f %12.0f %9.2f\n", threadCount, rate,
+			rate / threadCount, base > 0 ? rate / base : 0.0);
+	}
+
+	remove_tree();
+
+	if (errors != 0) {
+		fprintf(stderr, "%" B_PRId32 " stat() calls returned a wrong result!\n",
+			errors);
+		return 1;
+	}
+
+	return 0;
+}
@@ -6,7 +6,9 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include <fs_attr.h>
 #include <TypeConstants.h>
@@ -54,6 +56,115 @@ test_read(int fd, const char* attribute, type_code type, const char* data,
 }
 
 
+void
+test_vec(const attr_vec& vec, type_code type, const char* data, size_t length)
+{
+	if (vec.result < 0) {
+		fprintf(stderr, "Reading \"%s\" failed: %s\n", vec.name,
+			strerror(vec.result));
+		exit(1);
+	}
+
+	if (vec.info.size != (off_t)length || vec.info.type != type) {
+		fprintf(stderr, "Info does not match for \"%s\": size %" B_PRIdOFF
+			", type %#" B_PRIx32 "\n", vec.name, vec.info.size,
+			vec.info.type);
+		exit(1);
+	}
+
+	if (vec.buffer == NULL) {
+		if (vec.result != 0) {
+			fprintf(stderr, "Stat of \"%s\" returned %" B_PRIdSSIZE
+				" bytes\n", vec.name, vec.result);
+			exit(1);
+		}
+		return;
+	}
+
+	if (vec.result != (ssize_t)length
+		|| memcmp(vec.buffer, data, length) != 0) {
+		fprintf(stderr, "Data does not match for \"%s\"\n", vec.name);
+		exit(1);
+	}
+}
+
+
+void
+test_bulk(int fd, const char* large)
+{
+	char small[64];
+	char big[4096];
+	char missing[1];
+
+	attr_vec vecs[4];
+	memset(vecs, 0, sizeof(vecs));
+	vecs[0].name = "TESTbulk";
+	vecs[0].buffer = (void*)"Hello Haiku";
+	vecs[0].buffer_size = 12;
+	vecs[0].info.type = B_STRING_TYPE;
+	vecs[1].name = "TESTbulkLarge";
+	vecs[1].buffer = (void*)large;
+	vecs[1].buffer_size = 4006;
+	vecs[1].info.type = B_RAW_TYPE;
+
+	if (fs_write_attrs(fd, vecs, 2) != 2) {
+		fprintf(stderr, "Bulk write failed: %s, %s\n",
+			strerror(vecs[0].result), strerror(vecs[1].result));
+		exit(1);
+	}
+
+	memset(vecs, 0, sizeof(vecs));
+	vecs[0].name = "TESTbulk";
+	vecs[0].buffer = small;
+	vecs[0].buffer_size = sizeof(small);
+	vecs[1].name = "TESTbulkLarge";
+	vecs[1].buffer = big;
+	vecs[1].buffer_size = sizeof(big);
+	vecs[2].name = "TESTraw";
+		// only stat this one
+	vecs[3].name = "TESTmissing";
+	vecs[3].buffer = missing;
+	vecs[3].buffer_size = sizeof(missing);
+
+	ssize_t read = fs_read_attrs(fd, vecs, 4);
+	if (read != 3) {
+		fprintf(stderr, "Bulk read returned %" B_PRIdSSIZE ", should be 3\n",
+			read);
+		exit(1);
+	}
+
+	test_vec(vecs[0], B_STRING_TYPE, "Hello Haiku", 12);
+	test_vec(vecs[1], B_RAW_TYPE, large, 4006);
+	test_vec(vecs[2], B_RAW_TYPE, "Haiku", 6);
+
+	if (vecs[3].result != B_ENTRY_NOT_FOUND) {
+		fprintf(stderr, "Missing attribute returned %s\n",
+			strerror(vecs[3].result));
+		exit(1);
+	}
+
+	// read the same attributes via the node
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "Could not stat test file: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	memset(small, 0, sizeof(small));
+	vecs[3].result = 0;
+
+	read = fs_read_node_attrs(st.st_dev, &st.st_ino, 1, vecs, 4);
+	if (read != 3) {
+		fprintf(stderr, "Node bulk read returned %" B_PRIdSSIZE
+			", should be 3\n", read);
+		exit(1);
+	}
+
+	test_vec(vecs[0], B_STRING_TYPE, "Hello Haiku", 12);
+}
+
+
 int
 main(int argc, char** argv)
 {
@@ -91,6 +202,10 @@ main(int argc, char** argv)
 	fs_write_attr(fd, "TESTswitch", B_RAW_TYPE, 0, buffer, 4006);
 	test_read(fd, "TESTswitch", B_RAW_TYPE, buffer, 4006);
 
+	// Test the bulk API
+
+	test_bulk(fd, buffer);
+
 	return 0;
 }
 